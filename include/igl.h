@@ -1166,6 +1166,8 @@ typedef long Offset;
 #define GLC_TABLETSCALE         12
 #define GLC_NODESTALPHA         13
 #define GLC_COMPATRATE          15
+#define GLC_PIXTHRESHOLD        16
+#define GLC_QUEUESIZE           17
 
 
 /* defines for getgconfig */
@@ -2662,6 +2664,19 @@ void
 getfontencoding (char *enc);
 
 
+/***************************************
+    IGL extensions
+****************************************/
+long
+lrectreadstart(Screencoord x1, Screencoord y1, Screencoord x2, Screencoord y2);
+
+Boolean
+lrectreadready(long id);
+
+long
+lrectreadend(long id, unsigned long parray[]);
+
+
 /***************************************
     unimplemented functions
 ****************************************/
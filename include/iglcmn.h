@@ -17,6 +17,10 @@
 #   include <X11/Xatom.h>
 #   include <X11/cursorfont.h>
 #   include <X11/keysym.h>
+#   include <X11/extensions/XShm.h>
+#ifdef XINPUT2
+#   include <X11/extensions/XInput2.h>
+#endif
 #   include <GL/gl.h>
 #   include <GL/glu.h>
 #   include <GL/glx.h>
@@ -31,6 +35,7 @@
 #include <time.h>
 #include <stdarg.h>
 #include <limits.h>
+#include <pthread.h>
 
 #include "iglobj.h"
 
@@ -40,6 +45,18 @@ extern "C" {
 
 /* IGL table sizes, should be powers of 2 */
 #define IGL_MAXWINDOWS          256         /* max open windows per process */
+#define IGL_WNDHASHBITS         11          /* HWND hash, 2x max layer windows */
+
+/* locks of shared tables, recursive. Take them in this order */
+#define IGL_LOCK_WINDOWS        0           /* window table and HWND hash */
+#define IGL_LOCK_QUEUE          1           /* event processing and queue */
+#define IGL_LOCK_OBJECTS        2           /* display lists of objects */
+#define IGL_LOCK_FONTS          3           /* shared font resources */
+#define IGL_LOCK_DEFS           4           /* lmdef/texdef/tevdef tables */
+#define IGL_LOCK_STATS          5           /* debug statistics, without atomics */
+#define IGL_MAXLOCKS            6
+#define IGL_PIPEBATCHES         4           /* command batches queued for the render thread */
+#define IGL_PIPEBATCHSIZE       65536       /* bytes recorded before a batch is passed on */
 #define IGL_MAXCOLORS           4096        /* max colors available for color[f]() palette */
 #define IGL_MAXMULTIMAPCOLORS   256         /* max colors available in each multimap palette (16 palettes) */
 
@@ -56,25 +73,45 @@ extern "C" {
 /* other GL constants */
 #define IGL_MAXCURVESEGMENTS    256         /* max curve segments for crv() and crvn() */
 #define IGL_MAXPOLYVERTICES     256         /* max vertices in a polygon */
+#define IGL_MAXMATRIXDEPTH      32          /* max depth of the shadow matrix stacks */
+#define IGL_MAXVIEWPORTDEPTH    16          /* max depth of the shadow viewport stack */
 #define IGL_DEFOBJCHUNKSIZE     1020
+#define IGL_MAXOBJARENASIZE     262144      /* max growth of object payload arena blocks */
 #define IGL_MAXDEVICES          548         /* max devices on IrisGL - the last one is VIDEO */
-#define IGL_MAXDEVQENTRIES      101         /* max entries in device queue */
+#define IGL_DEVQENTRIES         128         /* default entries in device queue (2^n) */
+#define IGL_TIMERHZ             60          /* GL timer device tick rate */
 #define IGL_MAXTIEDVALUATORS    IGL_MAXDEVICES /* max tie()'d valuators */
 
 #define IGL_WINDOWWIDTH         100         /* default window width for winopen() */
 #define IGL_WINDOWHEIGHT        100         /* default window height for winopen() */
+#define IGL_HEADLESSWIDTH       1280        /* default screen width without X server */
+#define IGL_HEADLESSHEIGHT      1024        /* default screen height without X server */
 #define IGL_MAXMENUITEMS        100         /* max entries in a menu */
 
 #define IGL_ZBITS               24          /* bits in emulated Z buffer */
 
 /* other IGL constants */
-#define IGL_VERTEXSTACK_SIZE    3           /* vertex stack size.
-                    Must be at least 2 for swaptmesh, and 3 for perfly demo */
+#define IGL_MINVERTICES         256         /* initial size of the vertex buffer */
+#define IGL_MAXPIXTHREADS       32          /* max threads for software pixel transfers */
+#define IGL_PIXTHRESHOLD        262144      /* min pixels for parallel pixel transfers */
+#define IGL_PIXBANDS            4           /* scanline bands per pixel transfer thread */
+#define IGL_MAXREADS            4           /* max pending asynchronous lrectreads per window */
+#define IGL_MAXPIXBUFS          2           /* scratch buffers kept per window for pixel transfers */
+#define IGL_PIXPOOLMAX          (64 << 20)  /* max size of a kept scratch buffer */
+#define IGL_MAXXIDEVICES        16          /* XInput2 devices with known axes */
 
 
 #if PLATFORM_X11
 extern void
 igl_X11processEvents ();
+extern void
+_igl_X11releaseShm (void);
+#ifdef XINPUT2
+extern void
+_igl_X11initXInput2 (void);
+#endif
+extern void
+(*_igl_getOglFunc (const char *fn))();
 
 #   define IGL_MSG_PROCESS  igl_X11processEvents ();
 
@@ -118,8 +155,7 @@ igl_X11processEvents ();
 
 #define IGL_WSTATE_CURSOROFF        0x10000
 
-#define IGL_WSTATE_CURVIEWPORT      0x40000
-#define IGL_WSTATE_CURMATRICES      0x80000
+#define IGL_WSTATE_SHADOWMATRIX     0x40000
 
 /* vertex state */
 #define IGL_VSTATE_COLORED          0x040000
@@ -146,6 +182,128 @@ igl_X11processEvents ();
 /* TODO: the manual states "many rendering options are shared among the four GL
  * frame buffers". Which are shared, which are not?
  */
+/* vertex collected in bgn*...end* */
+typedef struct
+{
+    GLfloat vertex[4];
+    GLfloat texcoord[4];
+    GLfloat normal[3];
+    GLubyte color[4];
+} igl_vertexT;
+
+/* shadow copy of an OpenGL matrix stack */
+#define IGL_MATRIX_MODELVIEW        0
+#define IGL_MATRIX_PROJECTION       1
+#define IGL_MATRIX_TEXTURE          2
+#define IGL_MATRIX_MAX              (IGL_MATRIX_TEXTURE+1)
+
+typedef struct
+{
+    GLfloat matrix[IGL_MAXMATRIXDEPTH][16];
+    int depth, maxDepth;            /* current and OpenGL maximum depth */
+} igl_matrixStackT;
+
+/* shadow copy of OpenGL viewport and scissor box pushed with pushviewport */
+typedef struct
+{
+    GLint viewport[4];
+    GLint scrmask[4];
+} igl_viewportT;
+
+/* shadow of OpenGL context state, to filter redundant state changes */
+#define IGL_GLCAP_DEPTHTEST         0x0001
+#define IGL_GLCAP_ALPHATEST         0x0002
+#define IGL_GLCAP_BLEND             0x0004
+#define IGL_GLCAP_DITHER            0x0008
+#define IGL_GLCAP_LIGHTING          0x0010
+#define IGL_GLCAP_COLORMATERIAL     0x0020
+#define IGL_GLCAP_TEXTURE2D         0x0040
+#define IGL_GLCAP_TEXTURE3D         0x0080
+
+#define IGL_GLSTATE_CAPS            0x0001
+#define IGL_GLSTATE_DEPTHFUNC       0x0002
+#define IGL_GLSTATE_ALPHAFUNC       0x0004
+#define IGL_GLSTATE_BLENDFUNC       0x0008
+#define IGL_GLSTATE_SHADEMODEL      0x0010
+#define IGL_GLSTATE_CLEARCOLOR      0x0020
+#define IGL_GLSTATE_COLOR           0x0040
+#define IGL_GLSTATE_TEXTURE         0x0080
+#define IGL_GLSTATE_MATERIAL        0x0100
+#define IGL_GLSTATE_BACKMATERIAL    0x0200
+#define IGL_GLSTATE_LMODEL          0x0400
+#define IGL_GLSTATE_COLORMASK       0x0800
+#define IGL_GLSTATE_ALL             0x0fff
+
+typedef struct
+{
+    unsigned int valid;             /* IGL_GLSTATE_XXX matching OpenGL */
+    unsigned int capsValid;         /* IGL_GLCAP_XXX known to OpenGL */
+    unsigned int caps;              /* IGL_GLCAP_XXX enabled */
+    GLenum depthFunc;
+    GLenum alphaFunc;
+    GLfloat alphaRef;
+    GLenum blendSrc, blendDst;
+    GLenum shadeModel;
+    GLfloat clearColor[4];
+    GLubyte color[4];               /* current color */
+    GLboolean colorMask[4];         /* color writemask */
+    GLuint texture[2];              /* bound GL_TEXTURE_2D, GL_TEXTURE_3D */
+    short materialIndex;            /* bound materialDef */
+    short backMaterialIndex;        /* bound backmaterialDef */
+    short lmodelIndex;              /* bound lightmodelDef */
+} igl_glStateT;
+
+/* GL_ARB_pixel_buffer_object and GL_ARB_sync, for asynchronous reads */
+#ifndef GL_PIXEL_PACK_BUFFER_ARB
+#define GL_PIXEL_PACK_BUFFER_ARB        0x88EB
+#define GL_PIXEL_UNPACK_BUFFER_ARB      0x88EC
+#define GL_STREAM_READ_ARB              0x88E1
+#define GL_STREAM_COPY_ARB              0x88E2
+#define GL_READ_WRITE_ARB               0x88BA
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE   0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT      0x00000001
+#define GL_ALREADY_SIGNALED             0x911A
+#define GL_CONDITION_SATISFIED          0x911C
+#endif
+
+/* glyph in a font atlas texture, with the glBitmap parameters */
+typedef struct
+{
+    short x, y, w, h;               /* position in the texture */
+    short xorig, yorig;             /* origin in the glyph bitmap */
+    short xmove, ymove;             /* raster position advance */
+} igl_glyphT;
+
+/* font rasterized into an alpha texture, to draw strings as textured quads */
+typedef struct
+{
+    GLuint texture;                 /* 0 if the font doesn't fit */
+    int width, height;
+    igl_glyphT glyphs[256];
+} igl_fontAtlasT;
+
+/* scratch buffer for pixel transfers */
+typedef struct
+{
+    void *data;
+    size_t size;
+    int busy;
+} igl_pixBufT;
+
+/* pending asynchronous lrectread */
+typedef struct
+{
+    int pending;
+    int width, height;
+    int format, type;               /* OpenGL format and type of the data */
+    long rowBytes, rowStride;       /* row layout if read without conversion */
+    GLuint pbo;                     /* pixel buffer object, or 0 */
+    void *sync;                     /* fence for the read, or NULL */
+    void *data;                     /* client memory if there are no PBOs */
+} igl_readT;
+
 /* per-layer status information */
 typedef struct
 {
@@ -166,6 +324,7 @@ typedef struct
 
     /* character position related */
     unsigned int *_fontBases;        /* OpenGL list bases */
+    igl_fontAtlasT **_fontAtlases;   /* glyph atlas textures */
     unsigned short _currentFont;     /* active font */
 
     /* color related */
@@ -177,14 +336,8 @@ typedef struct
 
     /* vertex related */
     GLenum _bgnPrimitive;            /* stored glBegin primitive */
-    GLenum _bgnDelay;                /* glBegin delay Counter */
+    GLenum _bgnDelay;                /* vertices are collected until end* */
     float _currentNormal[3];         /* current normal vector */
-
-    int _stackIdx;                   /* stack for bgn* and swaptmesh */
-    GLfloat _vertexStack[IGL_VERTEXSTACK_SIZE][4];
-    GLubyte _colorStack[IGL_VERTEXSTACK_SIZE][4];
-    GLfloat _normalStack[IGL_VERTEXSTACK_SIZE][3];
-    GLfloat _texcoordStack[IGL_VERTEXSTACK_SIZE][4];
 } igl_layerT;
 
 
@@ -195,6 +348,7 @@ typedef struct
 #define patternIndex    currentLayer->_patternIndex
 
 #define fontBases       currentLayer->_fontBases
+#define fontAtlases     currentLayer->_fontAtlases
 #define currentFont     currentLayer->_currentFont
 
 #define currentColor    currentLayer->_currentColor
@@ -206,11 +360,6 @@ typedef struct
 #define bgnDelay        currentLayer->_bgnDelay
 #define bgnPrimitive    currentLayer->_bgnPrimitive
 #define currentNormal   currentLayer->_currentNormal
-#define stackIdx        currentLayer->_stackIdx
-#define vertexStack     currentLayer->_vertexStack
-#define normalStack     currentLayer->_normalStack
-#define colorStack      currentLayer->_colorStack
-#define texcoordStack   currentLayer->_texcoordStack
 
 typedef struct
 {
@@ -220,6 +369,8 @@ typedef struct
     igl_layerT *currentLayer;
     int drawMode;
     int swapInterval;
+    int shared;                     /* context shares objects with query window */
+    int bound;                      /* current window of some thread */
 
     /* window related */
     char title[256];
@@ -238,8 +389,11 @@ typedef struct
     unsigned *pickBuffer;           /* local pickbuffer (Ogl->GL conversion) */
 
     GLint viewport[4];              /* current OpenGL viewport */
-    GLdouble projMatrix[16];        /* current OpenGL projection matrix */
-    GLdouble modelMatrix[16];       /* current OpenGL viewing matrix */
+    GLint scrmask[4];               /* current OpenGL scissor box */
+    igl_viewportT viewportStack[IGL_MAXVIEWPORTDEPTH];
+    int viewportDepth;
+    GLdouble projMatrix[16];        /* projection matrix for glu functions */
+    GLdouble modelMatrix[16];       /* viewing matrix for glu functions */
 
     /* gconfig() related */
     long newFlags;                  /* IGL_WFLAGS_XXX before gconfig() */
@@ -267,6 +421,7 @@ typedef struct
 
     /* matrix related */
     short matrixMode;
+    igl_matrixStackT matrixStacks[IGL_MATRIX_MAX];  /* shadow of OpenGL stacks */
 
     /* light related */
     short materialIndex;            /* current materialDef */
@@ -303,6 +458,17 @@ typedef struct
 
     /* device related */
     int cursorIndex;                /* current cursor */
+
+    /* OpenGL state of the NORMALDRAW context */
+    igl_glStateT glState;
+
+    /* asynchronous lrectreads */
+    igl_readT reads[IGL_MAXREADS];
+    GLuint copyPbo;                 /* buffer object for rectcopy between Z and color */
+    long copySize;
+
+    /* scratch buffers for pixel transfers */
+    igl_pixBufT pixBufs[IGL_MAXPIXBUFS];
 } igl_windowT;
 
 
@@ -480,14 +646,88 @@ typedef struct
 } igl_menuT;
 
 
+/* CPU side state an object may depend on or change when executed */
+typedef struct
+{
+    long state;                     /* IGL_[VW]STATE_XXX */
+    long flags;                     /* IGL_WFLAGS_RGBA|IGL_WFLAGS_MULTIMAP */
+    int drawMode;
+    int epoch;                      /* igl->objListEpoch at compile time */
+    unsigned int mask;              /* writemask */
+    unsigned short index;           /* color index */
+    unsigned char multimapIndex;
+    GLubyte color[4];               /* current RGBA color */
+    GLubyte lmcColor[4];
+    short lmcMode;
+    short texgenMode;
+    GLenum textureType;
+    float normal[3];                /* current normal */
+    GLfloat texcoord[4];            /* current texture coordinate */
+    float gposx, gposy, gposz;
+} igl_objStateT;
+
+/* an object compiled into an OpenGL display list of some context */
+typedef struct
+{
+    HGLRC hrc;                      /* context owning the list */
+    GLuint list;                    /* OpenGL display list */
+    int valid;                      /* list reflects the object contents */
+    int misses;                     /* calls with mismatching state */
+    igl_objStateT key;              /* state when the list was compiled */
+    igl_objStateT post;             /* state after the list was executed */
+} igl_objListT;
+
+#define IGL_OBJLIST_CHECKED         0x01    /* object contents were checked */
+#define IGL_OBJLIST_COMPILE         0x02    /* object can be compiled */
+#define IGL_OBJLIST_MATRIX          0x04    /* object changes the matrices */
+#define IGL_OBJLIST_MAXMISSES       4       /* max recompiles for a context */
+
+/* hash table mapping object/tag ids to slots/offsets */
+typedef struct
+{
+    long id;
+    long val;                       /* < 0 if the entry is empty */
+} igl_hashEntryT;
+
+typedef struct
+{
+    igl_hashEntryT *table;
+    int size;                       /* power of 2 */
+    int count;
+} igl_hashT;
+
+/* block of the bump allocator for object payloads */
+typedef struct igl_objArenaT
+{
+    struct igl_objArenaT *next;
+    long size, used;
+    double data[1];                 /* payloads, aligned for doubles */
+} igl_objArenaT;
+
 typedef struct
 {
     Object id;
     long chunkSize;
     char *chunk;
     char *beginPtr, *curPtr, *endPtr;
+    char *gapPtr;                   /* unused space in the chunk */
+    long gapSize;
+    igl_hashT tags;                 /* tag id -> position relative to the gap */
+    long nextFree;                  /* next free slot if on the free list */
+
+    /* payloads of the functions */
+    igl_objArenaT *arena;           /* newest block first */
+    long arenaUsed, arenaDead;      /* allocated bytes, released bytes */
+
+    /* display lists */
+    int listFlags;                  /* IGL_OBJLIST_XXX */
+    int numLists;
+    igl_objListT *lists;            /* one for every context */
 } igl_objectT;
 
+/* bytes recorded into an object */
+#define IGL_OBJUSED(o)      ((o)->chunkSize - (o)->gapSize + (o)->arenaUsed)
+
 typedef struct
 {
     short id;
@@ -674,6 +914,12 @@ extern void _igl_exitObjectApi (void);
     igl_globalsT
 ********************************************/
 #define IGL_IFLAGS_NOLAYERS     0x0100
+#define IGL_IFLAGS_NOOBJLISTS   0x0200
+#define IGL_IFLAGS_NOSTATECACHE 0x0400
+#define IGL_IFLAGS_NOFONTATLAS  0x0800
+#define IGL_IFLAGS_NOMOTIONCOMP 0x1000
+#define IGL_IFLAGS_PIPELINE     0x2000
+#define IGL_IFLAGS_HEADLESS     0x4000
 #define IGL_IFLAGS_NODEBUG      0x8000
 typedef struct
 {
@@ -691,6 +937,27 @@ typedef struct
     void (*swapInterval)(Display *, GLXDrawable, int);
     void (*swapIntervalSGI)(int);
     int yieldTime;
+    int readExt;                /* PBO support: 0 unknown, 1 yes, -1 no */
+    void (*genBuffers)(GLsizei, GLuint *);
+    void (*deleteBuffers)(GLsizei, const GLuint *);
+    void (*bindBuffer)(GLenum, GLuint);
+    void (*bufferData)(GLenum, long, const void *, GLenum);
+    void *(*mapBuffer)(GLenum, GLenum);
+    GLboolean (*unmapBuffer)(GLenum);
+    void *(*fenceSync)(GLenum, GLbitfield);
+    GLenum (*clientWaitSync)(void *, GLbitfield, uint64_t);
+    void (*deleteSync)(void *);
+    XShmSegmentInfo shmInfo;    /* MIT-SHM segment for readdisplay() */
+    long shmSize;               /* its size, or -1 if MIT-SHM isn't usable */
+#ifdef XINPUT2
+    int xiOpcode;               /* XInput2 extension, 0 if not available */
+    struct {
+        int id;                 /* device id */
+        int absolute;           /* X/Y axes are absolute (tablet) */
+        double min[2], max[2];  /* X/Y axis range */
+    } xiDevices[IGL_MAXXIDEVICES];
+    int numXiDevices;
+#endif
 #endif
 
     /* callback for releasing window resources (used by libfm) */
@@ -699,6 +966,10 @@ typedef struct
     /* glcompat settings */
     int glcSOFTATTACH, glcSLOWMAPCOLORS;
 
+    /* software pixel transfer threads, and pixel count to use them */
+    int pixThreads, pixThreshold;
+    size_t pixPoolMax;          /* max size of kept pixel transfer buffers */
+
     /* cached getgdesc screen parameters */
     long gdXPMAX, gdYPMAX;      /* getgdesc() for XPMAX, YPMAX */
     long gdXMMAX, gdYMMAX;      /* getgdesc() for XMMAX, YMMAX */
@@ -707,10 +978,15 @@ typedef struct
 
     /* window related */
     int winDefWidth, winDefHeight;  /* default width/height of GL windows */
+    char *frameDump;            /* file prefix of frames dumped by swapbuffers() */
     igl_windowT openWindows[IGL_MAXWINDOWS];
+    struct {
+        HWND wnd;
+        short window, layer;
+    } wndHash[1 << IGL_WNDHASHBITS];   /* HWND -> window/layer, linear probing */
     igl_windowT *queryWindow;   /* needed for getgdesc() */
     int winOffsetX, winOffsetY; /* border surrounding client rectangle */
-    int activeWindow, currentWindow;
+    int activeWindow;
     int winPosx, winPosy;
     int winWidth, winHeight;
     int winMinWidth, winMinHeight;
@@ -742,11 +1018,17 @@ typedef struct
     short deviceLast[IGL_MAXDEVICES];           /* last reported values */
     short deviceQueue[IGL_MAXDEVICES];          /* queued devices */
     short deviceNoise[IGL_MAXDEVICES];          /* device noise count */
-    short eventQueue[IGL_MAXDEVQENTRIES*2];     /* event queue */
-    int numQueuedEvents;
+    short *eventQueue;                          /* ring buffer of dev/val pairs */
+    unsigned int eventMask;                     /* queue entries - 1 */
+    unsigned int eventHead, eventTail;          /* read/write position */
+    unsigned int eventHighWater;                /* max queued events */
+    unsigned long eventsDropped;                /* events lost in full queue */
+    unsigned int motionStart, motionEnd;        /* entries of the last motion */
     Device tiedValuators[IGL_MAXTIEDVALUATORS*2];
     int numTiedValuators;
-    struct timeval lastTime;
+    struct timespec timerBase;                  /* time of GL timer tick 0 */
+    unsigned long timerTicks;                   /* GL timer ticks passed */
+    int timerFd;                                /* timerfd for the next tick */
     igl_cursorT cursors[IGL_MAXCURSORS];
     int cursorType;
 
@@ -760,20 +1042,102 @@ typedef struct
     /* object related */
     igl_objectT *objects;
     long objChunkSize;
-    int currentObjIdx;
     long numObjects;
     long numAllocatedObjects;
+    long numUsedObjects;        /* slots used so far, including free ones */
+    long freeObjects;           /* head of free slot list, -1 if empty */
+    igl_hashT objectIds;        /* object id -> slot */
+    Object nextObjectId;        /* next id to try for genobj() */
     igl_apiList *execApi;
     igl_apiList *objApi;
-    igl_apiList *api;   /* equals either execApi or objApi */
+    igl_apiList *pipeApi;       /* objApi recording into the render thread's batches */
+    int objListEpoch;   /* incremented if compiled objects become stale */
+    igl_objListT *deadLists;    /* display lists to be deleted */
+    int numDeadLists;
+
+    /* OpenGL state cache statistics, only counted with IGL_DEBUG */
+    unsigned long glStateIssued;    /* state changes sent to OpenGL */
+    unsigned long glStateFiltered;  /* redundant state changes dropped */
 
     /* text related */
     igl_fontT fontDefs[IGL_MAXFONTS];
+
+    /* font cache of the share group, used by all windows sharing objects */
+    unsigned int sharedFontBases[IGL_MAXFONTS];
+    igl_fontAtlasT *sharedFontAtlases[IGL_MAXFONTS];
+    int sharedFontUsers;        /* number of windows using it */
+
+    /* locks for the tables shared by all threads */
+    pthread_mutex_t locks[IGL_MAXLOCKS];
+    pthread_rwlock_t objectLock;    /* object table, read locked while executing */
+    pthread_key_t threadKey;    /* releases the per-thread state on exit */
 } igl_globalsT;
 
 extern igl_globalsT *igl;
 
 
+/* per-thread state. Every thread has its own current window, and builds
+ * objects and primitives independently of other threads
+ */
+typedef struct
+{
+    int currentWindow;
+    igl_apiList *api;           /* equals either execApi, objApi or pipeApi */
+    int currentObjIdx;
+    igl_objectT *recordObj;     /* object recorded into by objApi/pipeApi */
+    int callDepth;              /* nesting of callobj, read locks objectLock if > 0 */
+
+    /* render thread */
+    struct igl_pipeT *pipe;     /* command batches, NULL if not pipelined */
+    int pipelined;              /* render thread owns the GL context */
+
+    /* vertex related, moves with the GL context to and from the render thread.
+     * Must stay at the end, see _igl_pipeSwapVertices
+     */
+    igl_vertexT *vertices;      /* vertex buffer for primitives */
+    int numVertices, maxVertices;
+    int firstVertex;            /* first vertex of the current primitive */
+    GLuint *indices;            /* indices of merged primitives */
+    int numIndices, maxIndices;
+    int firstIndex;             /* first index of the current primitive */
+    int tmeshRegister[2];       /* vertices in the triangle mesh registers */
+    int tmeshReplace;           /* register replaced by the next mesh vertex */
+    GLenum indexPrimitive;      /* OpenGL primitive for the indices */
+    long indexState;            /* IGL_VSTATE_XXX of the indices */
+} igl_threadT;
+
+/* the state is in TLS where the toolchain is known to support it, else in
+ * thread specific data, which costs a function call on every access
+ */
+#if defined(__GNUC__) && defined(__linux__)
+#define IGL_THREADTLS
+extern __thread igl_threadT iglThread;
+#else
+extern igl_threadT *_igl_getThread (void);
+#define iglThread           (*_igl_getThread ())
+#endif
+
+#define IGL_LOCK(l)         pthread_mutex_lock (&igl->locks[l])
+#define IGL_UNLOCK(l)       pthread_mutex_unlock (&igl->locks[l])
+
+/* objects can't be moved or freed while any thread is executing one. A
+ * thread editing an object holds the write lock until closeobj
+ */
+#define IGL_RDLOCKOBJS()    do { if (iglThread.currentObjIdx == -1) \
+                                pthread_rwlock_rdlock (&igl->objectLock); } while (0)
+#define IGL_WRLOCKOBJS()    do { if (iglThread.currentObjIdx == -1) \
+                                pthread_rwlock_wrlock (&igl->objectLock); } while (0)
+#define IGL_UNLOCKOBJS()    do { if (iglThread.currentObjIdx == -1) \
+                                pthread_rwlock_unlock (&igl->objectLock); } while (0)
+
+/* rendering into pbuffers without X server */
+#ifdef HEADLESS
+#   define IGL_HEADLESS     (igl->flags & IGL_IFLAGS_HEADLESS)
+#else
+#   define IGL_HEADLESS     0
+#endif
+
+
 #if PLATFORM_X11
 #   define IGL_NULLWND      0
 #   define IGL_NULLCTX      NULL
@@ -810,7 +1174,7 @@ extern int _igl_mapIDalloc (short *map, int size, int offset, short id, int flag
 
 /* returns current window context (igl_windowT *) */
 #define IGL_WINDOW(w)       (&igl->openWindows[w])
-#define IGL_CTX()           IGL_WINDOW(igl->currentWindow)
+#define IGL_CTX()           IGL_WINDOW(iglThread.currentWindow)
 #define IGL_PARENT(p)       ((p)->parent >= 0 ? IGL_WINDOW ((p)->parent) : NULL)
 
 /* returns current HRC of current window */
@@ -824,7 +1188,10 @@ extern int _igl_mapIDalloc (short *map, int size, int offset, short id, int flag
 extern void _igl_initColor (void);
 extern void _igl_resetColor (void);
 
+extern int _igl_initQueue (long size);
 extern void _igl_qenter (Device dev, short val, Boolean filter);
+extern void _igl_qmotion (Device *devs, int n);
+extern void _igl_initTimers (void);
 extern void _igl_glTimers (void);
 extern void _igl_recolorCursor (igl_windowT *wptr);
 
@@ -834,35 +1201,108 @@ extern void _igl_defineXfont (int n, char *name);
 
 extern int _igl_pixInMode(int *format, int *type);
 extern void *_igl_pixInConvert(int *format, int *type, int size, void *image, int width, int height);
+extern void *_igl_pixInConvertZoom(int *format, int *type, int size, void *image, int width, int height, int zoom);
 extern void _igl_pixInEnd(int format, int type, void *buffer, void *image);
+extern int _igl_pixOutDirect(int *format, int *type);
 extern void *_igl_pixOutMode(int *format, int *type, void *image, int width, int height);
 extern void _igl_pixOutConvert(int format, int type, void *image, void *buffer, int width, int height);
 extern void _igl_pixOutEnd(int format, int type, void *image, void *buffer);
+extern void _igl_releaseReads (igl_windowT *wptr);
 extern unsigned long _igl_pixPipe (unsigned long pixel);
+extern void _igl_pixExit (void);
+extern void *_igl_pixGetBuffer (igl_windowT *wptr, size_t size);
+extern void _igl_pixPutBuffer (igl_windowT *wptr, void *data);
+extern void _igl_pixTrimBuffers (igl_windowT *wptr);
 
+extern void _igl_initTransform (igl_windowT *wptr);
 extern void _igl_pushTransform (void);
 extern void _igl_popTransform (void);
-extern void _igl_getViewport (void);
+extern void _igl_pushViewport (void);
+extern void _igl_popViewport (void);
+extern GLfloat *_igl_currentMatrix (void);
 extern void _igl_getMatrices (void);
 extern void _igl_ortho2D (int reshape);
 
 extern void _igl_setLmDefaults (short deftype, void *ptr);
 
+extern void _igl_endPrimitive (GLenum next);
+extern void _igl_releaseVertices (void);
+
 extern int _igl_initObjects (void);
 extern void _igl_releaseObjects (void);
-extern igl_objFcnT *_igl_addObjectFcn (igl_objectT *obj, int opcode);
+extern igl_objFcnT *_igl_addObjectFcn (igl_objectT *obj, int opcode, int numParams);
+extern void _igl_initObjectChunk (igl_objectT *obj);
+extern void _igl_resetObject (igl_objectT *obj);
+extern void _igl_clearObject (igl_objectT *obj);
+extern void _igl_execObject (igl_objectT *obj);
+extern void *_igl_allocObjectData (igl_objectT *obj, long size);
+extern void _igl_releaseObjectLists (HGLRC hrc);
+
+extern int _igl_initPipe (void);
+extern void _igl_exitPipe (void);
+extern void _igl_pipeSync (void);
+extern igl_objectT *_igl_pipeFlush (void);
+extern void _igl_defaultApi (void);
+
+extern void _igl_makeCurrent (HWND wnd, HGLRC hrc);
+#ifdef HEADLESS
+extern int _igl_headlessInit (void);
+extern void _igl_headlessExit (void);
+extern HGLRC _igl_headlessCreateContext (HGLRC share);
+extern void _igl_headlessDestroyContext (HGLRC hrc);
+extern HWND _igl_headlessCreateSurface (int width, int height);
+extern void _igl_headlessDestroySurface (HWND wnd);
+extern void _igl_headlessMakeCurrent (HWND wnd, HGLRC hrc);
+extern void _igl_headlessSwap (igl_windowT *wptr);
+#endif
+
+
+/* state cache of the current context. Layers without own context use the
+ * context of the query window
+ */
+#define IGL_GLSTATE(w)      (IGL_HRC (w) == IGL_WINDOW (0)->layers[IGL_WLAYER_NORMALDRAW].hrc ? \
+                                &IGL_WINDOW (0)->glState : &(w)->glState)
+
+extern void _igl_glInvalidate (unsigned int mask);
+extern void _igl_glInvalidateAll (unsigned int mask);
+extern void _igl_glEnable (GLenum cap);
+extern void _igl_glDisable (GLenum cap);
+extern int _igl_glIsEnabled (GLenum cap);
+extern void _igl_glDepthFunc (GLenum func);
+extern void _igl_glAlphaFunc (GLenum func, GLfloat ref);
+extern void _igl_glBlendFunc (GLenum sfactor, GLenum dfactor);
+extern void _igl_glShadeModel (GLenum mode);
+extern void _igl_glClearColor (GLfloat r, GLfloat g, GLfloat b, GLfloat a);
+extern void _igl_glColor (const GLubyte *color);
+extern void _igl_glColorMask (GLboolean r, GLboolean g, GLboolean b, GLboolean a);
+extern void _igl_glGetColorMask (GLboolean *mask);
+extern void _igl_glBindTexture (GLenum target, GLuint texture);
+extern int _igl_glBindLm (short target, short index);
 
 
 /* IGL initialization check */
-#define IGL_CHECKINIT()     if (!igl) _igl_init(NULL)
+#define IGL_CHECKINIT()     if (!iglThread.api || iglThread.pipelined) _igl_initThread()
 #define IGL_CHECKWND(_ret) { \
     IGL_CHECKINIT (); \
-    if (igl->currentWindow == -1 || igl->openWindows[igl->currentWindow].wnd == IGL_NULLWND) \
+    if (iglThread.currentWindow == -1 || igl->openWindows[iglThread.currentWindow].wnd == IGL_NULLWND) \
         return _ret;                                                  \
 }
 #define IGL_CHECKWNDV() { \
     IGL_CHECKINIT (); \
-    if (igl->currentWindow == -1 || igl->openWindows[igl->currentWindow].wnd == IGL_NULLWND) \
+    if (iglThread.currentWindow == -1 || igl->openWindows[iglThread.currentWindow].wnd == IGL_NULLWND) \
+        return;                                                  \
+}
+/* device polling doesn't wait for the render thread, but passes the batch on */
+#define IGL_CHECKDEV(_ret) { \
+    if (!iglThread.api) _igl_initThread (); \
+    if (iglThread.pipe) _igl_pipeFlush (); \
+    if (iglThread.currentWindow == -1 || igl->openWindows[iglThread.currentWindow].wnd == IGL_NULLWND) \
+        return _ret;                                                  \
+}
+#define IGL_CHECKDEVV() { \
+    if (!iglThread.api) _igl_initThread (); \
+    if (iglThread.pipe) _igl_pipeFlush (); \
+    if (iglThread.currentWindow == -1 || igl->openWindows[iglThread.currentWindow].wnd == IGL_NULLWND) \
         return;                                                  \
 }
 
@@ -874,9 +1314,9 @@ extern igl_objFcnT *_igl_addObjectFcn (igl_objectT *obj, int opcode);
 
 /* turn lighting on or off for primitives unlighted in IrisGL */
 #define IGL_ENLIGHT()   if ((IGL_CTX ()->state & (IGL_WSTATE_LIGHTING|IGL_VSTATE_LIGHTED)) == IGL_WSTATE_LIGHTING) \
-        { IGL_CTX ()->state |= IGL_VSTATE_LIGHTED; glEnable (GL_LIGHTING); }
+        { IGL_CTX ()->state |= IGL_VSTATE_LIGHTED; _igl_glEnable (GL_LIGHTING); }
 #define IGL_DISLIGHT()  if (IGL_CTX ()->state & IGL_VSTATE_LIGHTED) \
-        { IGL_CTX ()->state &= ~IGL_VSTATE_LIGHTED; glDisable (GL_LIGHTING); }
+        { IGL_CTX ()->state &= ~IGL_VSTATE_LIGHTED; _igl_glDisable (GL_LIGHTING); }
 
 /* manage current normal */
 #define IGL_BGNN3F()    if (IGL_CTX ()->state & IGL_VSTATE_N3F) \
@@ -894,6 +1334,7 @@ extern igl_objFcnT *_igl_addObjectFcn (igl_objectT *obj, int opcode);
 
 /* tracing stuff */
 extern void _igl_init (HINSTANCE app);
+extern void _igl_initThread (void);
 extern void (_igl_trace) (const char *func, int immed, const char *fmt, ...);
 
 #define IGL_V2FMT(f)    "{%" #f ",%" #f "}"
@@ -912,7 +1353,7 @@ extern void (_igl_trace) (const char *func, int immed, const char *fmt, ...);
 #elif defined(__GNUC__) /* gcc version */
 #define __func__ __FUNCTION__
 /* this provides a significant speedup. It avoids tracing when not debugging. */
-#define _igl_trace(func,immed,fmt...) if (!igl || igl->debug) (_igl_trace)(func,immed,fmt);
+#define _igl_trace(func,immed,fmt...) if (!iglThread.api || igl->debug) (_igl_trace)(func,immed,fmt);
 #else /* mipspro cc doesn't support __FUNCTION__ and the trace macro */
 #define _stringify(x) #x
 #define stringify(x) _stringify(x)
@@ -177,10 +177,12 @@ typedef union
     void *v;
 } _igl_objFcnParamU;
 
+/* NOTE: only numParams params are stored in an object */
 typedef struct
 {
     char type;
-    int opcode;
+    unsigned char numParams;
+    short opcode;
     _igl_objFcnParamU params[10];
 } igl_objFcnT;
 
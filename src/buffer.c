@@ -33,7 +33,7 @@ void
 clear (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->clear ();
+    iglThread.api->clear ();
 }
 
 void
@@ -44,7 +44,7 @@ iglExec_clear (void)
     IGL_CHECKWNDV ();
     wptr = IGL_CTX ();
 
-    glClearColor (wptr->currentColor[0]/255.0f, wptr->currentColor[1]/255.0f,
+    _igl_glClearColor (wptr->currentColor[0]/255.0f, wptr->currentColor[1]/255.0f,
                 wptr->currentColor[2]/255.0f, wptr->currentColor[3]/255.0f);
     glClear (GL_COLOR_BUFFER_BIT);
 }
@@ -140,7 +140,7 @@ void
 backbuffer (Boolean enable)
 {
     _igl_trace (__func__,FALSE,"%d",enable);
-    igl->api->backbuffer (enable);
+    iglThread.api->backbuffer (enable);
 }
 
 void
@@ -180,7 +180,7 @@ void
 frontbuffer (Boolean enable)
 {
     _igl_trace (__func__,FALSE,"%d",enable);
-    igl->api->frontbuffer (enable);
+    iglThread.api->frontbuffer (enable);
 }
 
 void
@@ -220,7 +220,7 @@ void
 leftbuffer (Boolean enable)
 {
     _igl_trace (__func__,FALSE,"%d",enable);
-    igl->api->leftbuffer (enable);
+    iglThread.api->leftbuffer (enable);
 }
 
 void
@@ -269,7 +269,7 @@ void
 rightbuffer (Boolean enable)
 {
     _igl_trace (__func__,FALSE,"%d",enable);
-    igl->api->rightbuffer (enable);
+    iglThread.api->rightbuffer (enable);
 }
 
 void
@@ -370,7 +370,7 @@ void
 zbuffer (Boolean enable)
 {
     _igl_trace (__func__,FALSE,"%d",enable);
-    igl->api->zbuffer (enable);
+    iglThread.api->zbuffer (enable);
 }
 
 void
@@ -379,9 +379,9 @@ iglExec_zbuffer (Boolean enable)
     IGL_CHECKWNDV ();
 
     if (enable)
-        glEnable (GL_DEPTH_TEST);
+        _igl_glEnable (GL_DEPTH_TEST);
     else
-        glDisable (GL_DEPTH_TEST);
+        _igl_glDisable (GL_DEPTH_TEST);
 }
 
 
@@ -401,7 +401,7 @@ void
 zfunction (long func)
 {
     _igl_trace (__func__,FALSE,"%ld",func);
-    igl->api->zfunction (func);
+    iglThread.api->zfunction (func);
 }
 
 void
@@ -424,7 +424,7 @@ iglExec_zfunction (long func)
 
         default:                     return;
     }
-    glDepthFunc (oglFunc);
+    _igl_glDepthFunc (oglFunc);
 }
 
 
@@ -445,7 +445,7 @@ void
 zclear (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->zclear ();
+    iglThread.api->zclear ();
 }
 
 void
@@ -463,7 +463,7 @@ void
 czclear (unsigned long cval, long zval)
 {
     _igl_trace (__func__,FALSE,"%lx,%ld",cval,zval);
-    igl->api->czclear (cval, zval);
+    iglThread.api->czclear (cval, zval);
 }
 
 void
@@ -471,7 +471,7 @@ iglExec_czclear (unsigned long cval, long zval)
 {
     IGL_CHECKWNDV ();
 
-    glClearColor (GetRValue(cval)/255.0f, GetGValue(cval)/255.0f,
+    _igl_glClearColor (GetRValue(cval)/255.0f, GetGValue(cval)/255.0f,
                     GetBValue(cval)/255.0f,GetAValue(cval)/255.0f);
     glClearDepth ((double)zval / igl->gdZMAX);
 
@@ -517,7 +517,7 @@ void
 lsetdepth (long near_, long far_)
 {
     _igl_trace (__func__,FALSE,"%ld,%ld",near_,far_);
-    igl->api->lsetdepth (near_, far_);
+    iglThread.api->lsetdepth (near_, far_);
 }
 
 void
@@ -534,7 +534,7 @@ void
 setdepth (Screencoord near_, Screencoord far_)
 {
     _igl_trace (__func__,FALSE,"%d,%d",near_,far_);
-    igl->api->lsetdepth ((long)near_, (long)far_);
+    iglThread.api->lsetdepth ((long)near_, (long)far_);
 }
 
 
@@ -562,7 +562,7 @@ void
 sclear (unsigned long sval)
 {
     _igl_trace (__func__,FALSE,"%lu",sval);
-    igl->api->sclear (sval);
+    iglThread.api->sclear (sval);
 }
 
 void
@@ -596,7 +596,7 @@ void
 stencil (long enable, unsigned long ref, long func, unsigned long mask, long fail, long pass, long zpass)
 {
     _igl_trace (__func__,FALSE,"%ld,...",enable);
-    igl->api->stencil (enable, ref, func, mask, fail, pass, zpass);
+    iglThread.api->stencil (enable, ref, func, mask, fail, pass, zpass);
 }
 
 void
@@ -671,7 +671,7 @@ void
 acbuf (long op, float value)
 {
     _igl_trace (__func__,FALSE,"%ld,%g",op,value);
-    igl->api->acbuf (op, value);
+    iglThread.api->acbuf (op, value);
 }
 
 void
@@ -742,6 +742,10 @@ ilbuffer (unsigned long buffers)
 {
     _igl_trace (__func__,TRUE,"%lu",buffers);
 
+    /* ilbuffers are X pixmaps */
+    if (IGL_HEADLESS)
+        return (0);
+
     if (buffers && !gpm)
     {
         int w = DisplayWidth(IGL_DISPLAY, IGL_SCREEN);
@@ -765,20 +769,25 @@ ildraw (unsigned long buffer)
 {
     _igl_trace (__func__,TRUE,"%lu",buffer);
 
+    if (IGL_HEADLESS)
+        return;
+
     if (buffer)
     {
         if (!gc)
             gc = glXCreateContext (IGL_DISPLAY, IGL_VISUAL, NULL, False);
+        _igl_glInvalidate (IGL_GLSTATE_ALL);
         glXMakeCurrent (IGL_DISPLAY, gpm, gc);
     }
     else if (gc)
     {
-        if (igl->currentWindow < 0)
+        if (iglThread.currentWindow < 0)
             glXMakeCurrent (IGL_DISPLAY, IGL_WINDOW (0)->wnd, IGL_WINDOW (0)->layers[IGL_WLAYER_NORMALDRAW].hrc);
         else
             glXMakeCurrent (IGL_DISPLAY, IGL_CTX ()->currentLayer->hwnd, IGL_CTX ()->currentLayer->hrc);
         glXDestroyContext (IGL_DISPLAY, gc);
         gc = NULL;
+        _igl_glInvalidate (IGL_GLSTATE_ALL);
     }
 }
 #endif
@@ -790,7 +799,7 @@ zsource (long src)
 {
     _igl_trace (__func__,TRUE,"");
     if (src) /* TODO: valid only for Personal Iris with GL4DPI? */
-        glDepthFunc (GL_ALWAYS);
+        _igl_glDepthFunc (GL_ALWAYS);
 }
 
 
@@ -136,6 +136,7 @@ _igl_resetColor (void)
         igl->popupColorPalette[i] = ovlcolmap[i];
     for(i = 0; i < 4; i++)
         igl->cursorColorPalette[i] = curscolmap[i];
+    igl->objListEpoch ++;
 }
 
 /* set current RGBA color from 8 bit subcolors */
@@ -157,7 +158,7 @@ void
 color (Colorindex c)
 {
     _igl_trace (__func__,FALSE,"%d",c);
-    igl->api->color (c);
+    iglThread.api->color (c);
 }
 
 void
@@ -188,7 +189,7 @@ iglExec_color (Colorindex c)
         /* in other layers than NORMALDRAW color index 0 is transparent */
         _igl_currentColor (GetRValue(clr), GetGValue(clr), GetBValue(clr),
                         (c == 0 && wptr->drawMode != NORMALDRAW ? 0x00 : 0xff));
-        glColor4ubv (wptr->currentColor);
+        _igl_glColor (wptr->currentColor);
     }
 }
 
@@ -197,7 +198,7 @@ void
 colorf (float c)
 {
     _igl_trace (__func__,FALSE,"%g",c);
-    igl->api->color ((Colorindex)c);
+    iglThread.api->color ((Colorindex)c);
 }
 
 
@@ -221,7 +222,7 @@ void
 mapcolor (Colorindex i, short r, short g, short b)
 {
     _igl_trace (__func__,FALSE,"%d,%d,%d,%d",i,r,g,b);
-    igl->api->mapcolor (i, r, g, b);
+    iglThread.api->mapcolor (i, r, g, b);
 }
 
 void
@@ -244,6 +245,8 @@ iglExec_mapcolor (Colorindex i, short r, short g, short b)
     if (i < mapSize)
     {
         wptr->colorPalette[i + mapOffs] = RGB (r, g, b);
+        /* compiled objects may contain the old color */
+        igl->objListEpoch ++;
 
         /* for very old stuff drawing iteratively without qtest/qread */
         if (igl->glcSLOWMAPCOLORS)
@@ -317,7 +320,7 @@ setshade (Colorindex shade)
 {
     /* same as color() */
     _igl_trace (__func__,FALSE,"%d",shade);
-    igl->api->color (shade);
+    iglThread.api->color (shade);
 }
 
 
@@ -336,7 +339,7 @@ void
 RGBcolor (short r, short g, short b)
 {
     _igl_trace (__func__,FALSE,"%d,%d,%d",r,g,b);
-    igl->api->RGBcolor (r, g, b);
+    iglThread.api->RGBcolor (r, g, b);
 }
 
 void
@@ -350,7 +353,7 @@ iglExec_RGBcolor (short r, short g, short b)
     if ((wptr->flags & IGL_WFLAGS_RGBA) && wptr->drawMode == NORMALDRAW)
     {
         _igl_currentColor (r, g, b, 0xff);
-        glColor3ubv (wptr->currentColor);
+        _igl_glColor (wptr->currentColor);
     }
 }
 
@@ -377,7 +380,7 @@ void
 cpack (unsigned long color)
 {
     _igl_trace (__func__,FALSE,"%lx",color);
-    igl->api->cpack (color);
+    iglThread.api->cpack (color);
 }
 
 void
@@ -393,7 +396,7 @@ iglExec_cpack (unsigned long color)
         /* the color is in ABGR mode */
         _igl_currentColor (GetRValue(color), GetGValue(color),
                            GetBValue(color), GetAValue(color));
-        glColor4ubv (wptr->currentColor);
+        _igl_glColor (wptr->currentColor);
     }
 }
 
@@ -410,12 +413,12 @@ RGBwritemask (short redm, short greenm, short bluem)
 void
 gRGBmask (short *redm, short *greenm, short *bluem)
 {
-    GLint wm[4];
+    GLboolean wm[4];
 
     _igl_trace (__func__,TRUE,"%p,%p,%p",redm,greenm,bluem);
     IGL_CHECKWNDV ();
 
-    glGetIntegerv (GL_COLOR_WRITEMASK, wm);
+    _igl_glGetColorMask (wm);
     *redm = wm[0] == GL_TRUE ? 0xff : 0x00;
     *greenm = wm[1] == GL_TRUE ? 0xff : 0x00;
     *bluem = wm[2] == GL_TRUE ? 0xff : 0x00;
@@ -434,7 +437,7 @@ wmpack (unsigned long color)
      * color when writing to the current color, assuming the masked bits are 0.
      * (could maybe do some trickery with glLogicOp?)
      */
-    glColorMask (GetRValue(color) ? GL_TRUE : GL_FALSE,
+    _igl_glColorMask (GetRValue(color) ? GL_TRUE : GL_FALSE,
         GetGValue(color) ? GL_TRUE : GL_FALSE,
         GetBValue(color) ? GL_TRUE : GL_FALSE,
         GetAValue(color) ? GL_TRUE : GL_FALSE);
@@ -446,7 +449,7 @@ void
 afunction (long ref, long func)
 {
     _igl_trace (__func__,FALSE,"%ld,%ld",ref,func);
-    igl->api->afunction (ref, func);
+    iglThread.api->afunction (ref, func);
 }
 
 void
@@ -471,12 +474,12 @@ iglExec_afunction (long ref, long func)
     }
 
     if (func == AF_ALWAYS)
-        glDisable (GL_ALPHA_TEST);
+        _igl_glDisable (GL_ALPHA_TEST);
     else
     {
         /* ref is 0-255 in IrisGL, 0.0f-1.0f in OpenGL */
-        glAlphaFunc (oglFunc, (float)ref/255.0f);
-        glEnable (GL_ALPHA_TEST);
+        _igl_glAlphaFunc (oglFunc, (float)ref/255.0f);
+        _igl_glEnable (GL_ALPHA_TEST);
     }
 }
 
@@ -497,7 +500,7 @@ void
 blendfunction (long sfactor, long dfactor)
 {
     _igl_trace (__func__,FALSE,"%ld,%ld",sfactor,dfactor);
-    igl->api->blendfunction (sfactor, dfactor);
+    iglThread.api->blendfunction (sfactor, dfactor);
 }
 
 void
@@ -552,12 +555,12 @@ iglExec_blendfunction (long sfactor, long dfactor)
     if (sfactor == BF_ONE && dfactor == BF_ZERO)
     {
         /* this disables blending with IrisGL */
-        glDisable (GL_BLEND);
+        _igl_glDisable (GL_BLEND);
     }
     else
     {
-        glEnable (GL_BLEND);
-        glBlendFunc (osf, odf);
+        _igl_glEnable (GL_BLEND);
+        _igl_glBlendFunc (osf, odf);
         /* man page says to force logicop(LO_SRC) = glLogicOp(GL_COPY) */
         glLogicOp (GL_COPY);
     }
@@ -569,7 +572,7 @@ void
 dither (long mode)
 {
     _igl_trace (__func__,FALSE,"%ld",mode);
-    igl->api->dither (mode);
+    iglThread.api->dither (mode);
 }
 
 void
@@ -578,9 +581,9 @@ iglExec_dither (long mode)
     IGL_CHECKWNDV ();
 
     if (mode == DT_OFF)
-        glDisable (GL_DITHER);
+        _igl_glDisable (GL_DITHER);
     else
-        glEnable (GL_DITHER);
+        _igl_glEnable (GL_DITHER);
 }
 
 
@@ -589,7 +592,7 @@ void
 logicop (long opcode)
 {
     _igl_trace (__func__,FALSE,"%ld",opcode);
-    igl->api->logicop (opcode);
+    iglThread.api->logicop (opcode);
 }
 
 void
@@ -625,7 +628,7 @@ iglExec_logicop (long opcode)
     if (opcode != LO_SRC)
     {
         /* man page says to force blending to (BF_ONE, BF_ZERO), = disabled */
-        glDisable (GL_BLEND);
+        _igl_glDisable (GL_BLEND);
     }
 }
 
@@ -712,7 +715,7 @@ pupcolor (long clr)
 
         /* if PUPDRAW is the active layer, color is new current OpenGL color */
         if (IGL_CTX ()->drawMode == PUPDRAW)
-            glColor4ubv (lptr->_currentColor);
+            _igl_glColor (lptr->_currentColor);
     }
 }
 
@@ -766,7 +769,7 @@ void
 c4f (float cv[4])
 {
     _igl_trace (__func__,FALSE,"%p" IGL_V4FMT(g),cv,IGL_V4PAR(cv));
-    igl->api->c4f (cv);
+    iglThread.api->c4f (cv);
 }
 
 void
@@ -778,6 +781,7 @@ iglExec_c4f (float cv[4])
     {
         _igl_currentColor (cv[0]*255, cv[1]*255, cv[2]*255, cv[3]*255);
         glColor4fv (cv);
+        _igl_glInvalidate (IGL_GLSTATE_COLOR);
     }
 }
 
@@ -786,7 +790,7 @@ void
 c4i (int cv[4])
 {
     _igl_trace (__func__,FALSE,"%p" IGL_V4FMT(d),cv,IGL_V4PAR(cv));
-    igl->api->c4i (cv);
+    iglThread.api->c4i (cv);
 }
 
 void
@@ -800,7 +804,7 @@ iglExec_c4i (int cv[4])
     if ((wptr->flags & IGL_WFLAGS_RGBA) && wptr->drawMode == NORMALDRAW)
     {
         _igl_currentColor (cv[0], cv[1], cv[2], cv[3]);
-        glColor4ubv (wptr->currentColor);
+        _igl_glColor (wptr->currentColor);
     }
 }
 
@@ -809,7 +813,7 @@ void
 c4s (short cv[4])
 {
     _igl_trace (__func__,FALSE,"%p" IGL_V4FMT(d),cv,IGL_V4PAR(cv));
-    igl->api->c4s (cv);
+    iglThread.api->c4s (cv);
 }
 
 void
@@ -823,7 +827,7 @@ iglExec_c4s (short cv[4])
     if ((wptr->flags & IGL_WFLAGS_RGBA) && wptr->drawMode == NORMALDRAW)
     {
         _igl_currentColor (cv[0], cv[1], cv[2], cv[3]);
-        glColor4ubv (wptr->currentColor);
+        _igl_glColor (wptr->currentColor);
     }
 }
 
@@ -838,7 +842,7 @@ c3f (float cv[3])
     cv4[1] = cv[1];
     cv4[2] = cv[2];
     cv4[3] = 1.0f;
-    igl->api->c4f (cv4);
+    iglThread.api->c4f (cv4);
 }
 
 void
@@ -851,7 +855,7 @@ c3i (int cv[3])
     cv4[1] = cv[1];
     cv4[2] = cv[2];
     cv4[3] = 255;
-    igl->api->c4i (cv4);
+    iglThread.api->c4i (cv4);
 }
 
 
@@ -865,5 +869,5 @@ c3s (short cv[3])
     cv4[1] = cv[1];
     cv4[2] = cv[2];
     cv4[3] = 255;
-    igl->api->c4s (cv4);
+    iglThread.api->c4s (cv4);
 }
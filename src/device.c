@@ -24,18 +24,31 @@
 #include "igl.h"
 #include "iglcmn.h"
 
+#include <poll.h>
+#ifdef __linux__
+#include <sys/timerfd.h>
+#endif
+
+#ifndef CLOCK_MONOTONIC
+#define CLOCK_MONOTONIC     CLOCK_REALTIME
+#endif
+
+/* time of a GL timer tick in ns since the timer base */
+#define IGL_TIMERTICK(n)    ((n) * 1000000000LL / IGL_TIMERHZ)
+
 
 /* GL: getbutton - returns the state of a button */
 Boolean
 getbutton (Device dev)
 {
     _igl_trace (__func__,TRUE,"%d",dev);
-    IGL_CHECKWND (FALSE);
+    IGL_CHECKDEV (FALSE);
 
     if (dev > IGL_MAXDEVICES || !ISBUTTON(dev))
         return (FALSE);
 
-    glFlush ();
+    if (!iglThread.pipelined)
+        glFlush ();
     IGL_MSG_PROCESS
 
     return (igl->deviceVal[dev]);
@@ -47,12 +60,13 @@ long
 getvaluator (Device dev)
 {
     _igl_trace (__func__,TRUE,"%d",dev);
-    IGL_CHECKWND (0);
+    IGL_CHECKDEV (0);
 
     if (dev > IGL_MAXDEVICES || !ISVALUATOR(dev))
         return (0);
 
-    glFlush ();
+    if (!iglThread.pipelined)
+        glFlush ();
     IGL_MSG_PROCESS
 
     return (igl->deviceVal[dev]);
@@ -93,12 +107,13 @@ getdev (long n, Device devs[], short vals[])
     int i;
 
     _igl_trace (__func__,TRUE,"%ld,%p,%p",n,devs,vals);
-    IGL_CHECKWNDV ();
+    IGL_CHECKDEVV ();
 
     if (n <= 0 || n > 128)
         return;
 
-    glFlush ();
+    if (!iglThread.pipelined)
+        glFlush ();
     IGL_MSG_PROCESS
 
     for (i=0; i < n; i++)
@@ -146,12 +161,52 @@ isqueued (Device dev)
 }
 
 
+/* (re)allocate the device queue with at least size entries, rounded to 2^n */
+int
+_igl_initQueue (long size)
+{
+    unsigned int entries = 2, count, i;
+    short *queue;
+
+    while (entries < size && entries < (1 << 20))
+        entries <<= 1;
+
+    queue = (short *)malloc (entries * 2 * sizeof(short));
+    if (queue == NULL)
+        return (-1);
+
+    /* keep the queued events, as many as fit in */
+    count = igl->eventTail - igl->eventHead;
+    if (count > entries)
+    {
+        igl->eventsDropped += count - entries;
+        count = entries;
+    }
+    for (i = 0; i < count; i++)
+    {
+        short *entry = &igl->eventQueue[((igl->eventHead + i) & igl->eventMask) * 2];
+        queue[i*2] = entry[0];
+        queue[i*2+1] = entry[1];
+    }
+
+    if (igl->eventQueue != NULL)
+        free (igl->eventQueue);
+    igl->eventQueue = queue;
+    igl->eventMask = entries - 1;
+    igl->eventHead = 0;
+    igl->eventTail = count;
+    igl->motionStart = igl->motionEnd = count;
+    return (0);
+}
+
+
 /* internal qenter worker, with or without noise filtering */
 void
 _igl_qenter (Device dev, short val, Boolean filter)
 {
     short diff = igl->deviceVal[dev] - igl->deviceLast[dev];
-    int qidx = igl->numQueuedEvents;
+    unsigned int count = igl->eventTail - igl->eventHead;
+    short *entry;
 
     /* if filtering is set and count not reached, do nothing */
     if (filter && abs(diff) < igl->deviceNoise[dev])
@@ -159,23 +214,91 @@ _igl_qenter (Device dev, short val, Boolean filter)
     igl->deviceLast[dev] = igl->deviceVal[dev];
 
     /* try to avoid duplicate REDRAW events */
-    if (qidx <= 0 || dev != REDRAW ||
-        igl->eventQueue[qidx*2-2] != dev || igl->eventQueue[qidx*2-1] != val)
+    entry = &igl->eventQueue[((igl->eventTail - 1) & igl->eventMask) * 2];
+    if (count > 0 && dev == REDRAW && entry[0] == dev && entry[1] == val)
+        return;
+
+    /* if qdevice(QFULL), the last entry is reserved for reporting overflow */
+    if (count + (igl->deviceQueue[QFULL] != 0) > igl->eventMask)
+    {
+        igl->eventsDropped ++;
+        if (!igl->deviceQueue[QFULL] || count > igl->eventMask)
+            return;
+        dev = QFULL;
+        val = 1;
+    }
+
+    entry = &igl->eventQueue[(igl->eventTail++ & igl->eventMask) * 2];
+    entry[0] = dev;
+    entry[1] = val;
+    if (count + 1 > igl->eventHighWater)
+        igl->eventHighWater = count + 1;
+}
+
+
+/* enter the valuators changed by pointer motion. Unless turned off, the
+ * entries of the previous motion are updated if nothing was queued or read
+ * since, so that fast motion doesn't bury other events in the queue
+ */
+void
+_igl_qmotion (Device *devs, int n)
+{
+    unsigned int start = igl->motionStart, pos;
+    short *entry;
+    int i;
+
+    if ((igl->flags & IGL_IFLAGS_NOMOTIONCOMP) || igl->eventTail != igl->motionEnd ||
+                    start - igl->eventHead > igl->eventTail - igl->eventHead)
+        start = igl->motionStart = igl->eventTail;
+
+    for (i = 0; i < n; i++)
     {
-        if (qidx + 1 < IGL_MAXDEVQENTRIES)
+        Device dev = devs[i];
+
+        if (!igl->deviceQueue[dev])
+            continue;
+
+        for (pos = start; pos != igl->eventTail; pos++)
         {
-            /* queue not full, create entry */
-            igl->eventQueue[qidx*2] = dev;
-            igl->eventQueue[qidx*2+1] = val;
-            igl->numQueuedEvents = qidx+1;
+            entry = &igl->eventQueue[(pos & igl->eventMask) * 2];
+            if (entry[0] == dev)
+                break;
         }
-        else if (igl->deviceQueue[QFULL])
+        if (pos != igl->eventTail)
         {
-            /* report queue overflow in last entry if qdevice(QFULL) */
-            igl->eventQueue[qidx*2-2] = QFULL;
-            igl->eventQueue[qidx*2-1] = 1;
+            entry[1] = (short)igl->deviceVal[dev];
+            igl->deviceLast[dev] = igl->deviceVal[dev];
         }
+        else
+            _igl_qenter (dev, (short)igl->deviceVal[dev], True);
     }
+    igl->motionEnd = igl->eventTail;
+}
+
+
+/* initialize the GL timer emulation */
+void
+_igl_initTimers (void)
+{
+    clock_gettime (CLOCK_MONOTONIC, &igl->timerBase);
+    igl->timerTicks = 0;
+#ifdef __linux__
+    igl->timerFd = timerfd_create (CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+#else
+    igl->timerFd = -1;
+#endif
+}
+
+
+/* ns passed since the timer base */
+static long long
+_igl_timerNow (void)
+{
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - igl->timerBase.tv_sec) * 1000000000LL +
+                (now.tv_nsec - igl->timerBase.tv_nsec);
 }
 
 
@@ -183,45 +306,103 @@ _igl_qenter (Device dev, short val, Boolean filter)
 void
 _igl_glTimers (void)
 {
-    struct timeval currTime;
-    long timeDiff;
+    long long now = _igl_timerNow ();
+    Device dev;
 
-    /* calculate how many timer ticks have passed since the last call */
-    gettimeofday (&currTime, NULL);
-    timeDiff = (currTime.tv_sec  - igl->lastTime.tv_sec ) * 1000 +
-               (currTime.tv_usec - igl->lastTime.tv_usec) / 1000;
-    /* IrisGL timers have a 15 ms tick */
-    while (timeDiff >= 15)
+    /* nothing to report if no timer is queued, just keep up with the time */
+    if (!(igl->deviceQueue[TIMER0] | igl->deviceQueue[TIMER1] |
+          igl->deviceQueue[TIMER2] | igl->deviceQueue[TIMER3]))
     {
-        if (igl->deviceQueue[TIMER0])
-        {
-            igl->deviceVal[TIMER0]--;
-            _igl_qenter (TIMER0, 0, True);
-        }
-        if (igl->deviceQueue[TIMER1])
+        igl->timerTicks = now * IGL_TIMERHZ / 1000000000LL;
+        return;
+    }
+
+    /* report all ticks which have passed since the last call */
+    while (IGL_TIMERTICK (igl->timerTicks + 1) <= now)
+    {
+        igl->timerTicks ++;
+        for (dev = TIMER0; dev <= TIMER3; dev++)
         {
-            igl->deviceVal[TIMER1]--;
-            _igl_qenter (TIMER1, 0, True);
+            if (igl->deviceQueue[dev])
+            {
+                igl->deviceVal[dev]--;
+                _igl_qenter (dev, 0, True);
+            }
         }
-        if (igl->deviceQueue[TIMER2])
+    }
+}
+
+
+/* wait until X events arrive or the next timer tick is due, but at most
+ * timeout microseconds. Wait without limit if timeout is negative
+ */
+static void
+_igl_waitEvents (long timeout)
+{
+#if PLATFORM_X11
+    struct pollfd fds[2];
+    int n = 1, ms = (timeout < 0 ? -1 : (timeout + 999) / 1000);
+
+    if (IGL_HEADLESS)
+    {
+        /* events come from qenter() in other threads, check them regularly */
+        fds[0].fd = -1;
+        if (ms < 0 || ms > (igl->yieldTime + 999) / 1000)
+            ms = (igl->yieldTime + 999) / 1000;
+        /* don't spin if the yield time is below a ms */
+        if (ms < 1)
+            ms = 1;
+    }
+    /* this also flushes the requests, which may cause events */
+    else if (XPending (IGL_DISPLAY) > 0)
+        return;
+    else
+        fds[0].fd = XConnectionNumber (IGL_DISPLAY);
+    fds[0].events = POLLIN;
+
+    if (igl->deviceQueue[TIMER0] | igl->deviceQueue[TIMER1] |
+        igl->deviceQueue[TIMER2] | igl->deviceQueue[TIMER3])
+    {
+        long long due = IGL_TIMERTICK (igl->timerTicks + 1);
+
+#ifdef __linux__
+        if (igl->timerFd >= 0)
         {
-            igl->deviceVal[TIMER2]--;
-            _igl_qenter (TIMER2, 0, True);
+            /* arm the timer for the next tick */
+            struct itimerspec its;
+
+            memset (&its, 0, sizeof(its));
+            due += igl->timerBase.tv_nsec;
+            its.it_value.tv_sec = igl->timerBase.tv_sec + due / 1000000000;
+            its.it_value.tv_nsec = due % 1000000000;
+            timerfd_settime (igl->timerFd, TFD_TIMER_ABSTIME, &its, NULL);
+
+            fds[1].fd = igl->timerFd;
+            fds[1].events = POLLIN;
+            n = 2;
         }
-        if (igl->deviceQueue[TIMER3])
+        else
+#endif
         {
-            igl->deviceVal[TIMER3]--;
-            _igl_qenter (TIMER3, 0, True);
+            /* no timerfd, round up to the next ms */
+            long long wait = (due - _igl_timerNow () + 999999) / 1000000;
+
+            if (wait < 0)
+                wait = 0;
+            if (ms < 0 || wait < ms)
+                ms = wait;
         }
-        timeDiff -= 1000/60;
-        igl->lastTime.tv_usec += 1000000/60;
     }
-    /* normalize timer */
-    while (igl->lastTime.tv_usec >= 1000000)
+
+    if (poll (fds, n, ms) > 0 && n > 1 && (fds[1].revents & POLLIN))
     {
-        igl->lastTime.tv_usec -= 1000000;
-        igl->lastTime.tv_sec += 1;
+        /* tick is due, acknowledge the timer */
+        unsigned long long count;
+
+        if (read (igl->timerFd, &count, sizeof(count)) < 0)
+            count = 0;
     }
+#endif
 }
 
 
@@ -230,9 +411,11 @@ void
 qenter (Device dev, short val)
 {
     _igl_trace (__func__,TRUE,"%d,%d",dev,val);
-    IGL_CHECKWNDV ();
+    IGL_CHECKDEVV ();
 
+    IGL_LOCK (IGL_LOCK_QUEUE);
     _igl_qenter (dev, val, False);
+    IGL_UNLOCK (IGL_LOCK_QUEUE);
 }
 
 
@@ -240,24 +423,30 @@ qenter (Device dev, short val)
 long
 qtest (void)
 {
+    long ret;
+
     _igl_trace (__func__,TRUE,"");
-    IGL_CHECKWND (0);
+    IGL_CHECKDEV (0);
 
     IGL_MSG_PROCESS
 
-    if (igl->currentWindow < 0 || IGL_CTX ()->drawMode != NORMALDRAW ||
-                !(IGL_CTX()->flags & IGL_WFLAGS_DOUBLEBUFFER))
+    if (!iglThread.pipelined && (iglThread.currentWindow < 0 || IGL_CTX ()->drawMode != NORMALDRAW ||
+                !(IGL_CTX()->flags & IGL_WFLAGS_DOUBLEBUFFER)))
         glFlush ();
 
     /* Some sleeping to avoid high speed polling */
-    if (igl->numQueuedEvents == 0)
+    if (igl->eventTail == igl->eventHead)
     {
-        usleep (igl->yieldTime);
+        _igl_waitEvents (igl->yieldTime);
 
         IGL_MSG_PROCESS
     }
 
-    return ((igl->numQueuedEvents > 0) ? igl->eventQueue[0] : 0);
+    IGL_LOCK (IGL_LOCK_QUEUE);
+    ret = ((igl->eventTail != igl->eventHead) ?
+                igl->eventQueue[(igl->eventHead & igl->eventMask) * 2] : 0);
+    IGL_UNLOCK (IGL_LOCK_QUEUE);
+    return (ret);
 }
 
 
@@ -266,9 +455,11 @@ void
 qreset (void)
 {
     _igl_trace (__func__,TRUE,"");
-    IGL_CHECKWNDV ();
+    IGL_CHECKDEVV ();
 
-    igl->numQueuedEvents = 0;
+    IGL_LOCK (IGL_LOCK_QUEUE);
+    igl->eventHead = igl->eventTail;
+    IGL_UNLOCK (IGL_LOCK_QUEUE);
 }
 
 
@@ -276,22 +467,30 @@ qreset (void)
 long
 blkqread (short *data, short n)
 {
-    int numEvents, pendingEvents;
+    unsigned int numEvents, pos, len;
 
     _igl_trace (__func__,TRUE,"%p,%d",data,n);
-    IGL_CHECKWND (0);
+    IGL_CHECKDEV (0);
 
-    if (data == NULL || n == 0 || igl->numQueuedEvents == 0)
+    if (data == NULL || n <= 0)
         return (0);
 
-    numEvents = (n > igl->numQueuedEvents) ? igl->numQueuedEvents : n;
-    memcpy (data, igl->eventQueue, numEvents*sizeof(short)*2);
+    IGL_LOCK (IGL_LOCK_QUEUE);
+    numEvents = igl->eventTail - igl->eventHead;
 
-    pendingEvents = igl->numQueuedEvents - numEvents;
-    if (pendingEvents > 0)
-        memmove (igl->eventQueue, &igl->eventQueue[numEvents*2], pendingEvents*sizeof(short)*2);
+    if (numEvents > n)
+        numEvents = n;
 
-    igl->numQueuedEvents = pendingEvents;
+    /* copy in 2 parts if the entries wrap around the end of the queue */
+    pos = igl->eventHead & igl->eventMask;
+    len = igl->eventMask + 1 - pos;
+    if (len > numEvents)
+        len = numEvents;
+    memcpy (data, &igl->eventQueue[pos*2], len*sizeof(short)*2);
+    memcpy (&data[len*2], igl->eventQueue, (numEvents-len)*sizeof(short)*2);
+
+    igl->eventHead += numEvents;
+    IGL_UNLOCK (IGL_LOCK_QUEUE);
     return (numEvents*2);
 }
 
@@ -304,9 +503,10 @@ qread (short *data)
     short queue[2];
 
     _igl_trace (__func__,TRUE,"%p",data);
-    IGL_CHECKWND (0);
+    IGL_CHECKDEV (0);
 
-    glFlush ();
+    if (!iglThread.pipelined)
+        glFlush ();
 
     /* qread() blocks until something is present in the queue! */
     while (1)
@@ -321,21 +521,9 @@ qread (short *data)
         ret = blkqread (queue, 1);
         if (ret != 0)
             break;
-        else
-        {
-            /* wake up every 15ms if timers are running, else wait for event */
-#if PLATFORM_X11
-            int timers = igl->deviceQueue[TIMER0] | igl->deviceQueue[TIMER1] |
-                         igl->deviceQueue[TIMER2] | igl->deviceQueue[TIMER3];
-            struct timeval tv = { 0, 15000 };
-            int fd = XConnectionNumber (IGL_DISPLAY);
-            fd_set fds;
-
-            FD_ZERO (&fds);
-            FD_SET (fd, &fds);
-            select (fd+1, &fds, NULL, NULL, (timers ? &tv : NULL));
-#endif
-        }
+
+        /* sleep until an event arrives or a timer tick is due */
+        _igl_waitEvents (-1);
     }
 
     *data = queue[1];
@@ -388,6 +576,8 @@ qgetfd (void)
     IGL_CHECKWND (-1);
 
 #if PLATFORM_X11
+    if (IGL_HEADLESS)
+        return (-1);
     return XConnectionNumber(IGL_DISPLAY);
 #endif
 }
@@ -399,6 +589,10 @@ _igl_setCursor (igl_windowT *wptr, Cursor xid)
 {
     int i;
 
+    /* there's no pointer without X server */
+    if (IGL_HEADLESS)
+        return;
+
     /* Set cursor for all attached layers, since these have their own cursors */
     for (i = IGL_WLAYER_CURSORDRAW-1; i >= IGL_WLAYER_NORMALDRAW; i--)
     {
@@ -419,7 +613,7 @@ _igl_recolorCursor (igl_windowT *wptr)
     XColor fg, bg;
     int idx = wptr->cursorIndex, color;
 
-    if (idx > 0)
+    if (idx > 0 && !IGL_HEADLESS)
     {
         /* CCROSS uses color WHITE (== 3), see getgdesc(GD_CROSSHAIR_CINDEX) */
         color = (igl->cursors[idx].type == CCROSS ? 3 : 1);
@@ -472,7 +666,7 @@ cursoff (void)
     /* X has no capability to switch the cursor off. Instead, use a transparant
      * cursor stored in igl cursor 0, which isn't used otherwise.
      */
-    if (! igl->cursors->xid)
+    if (! igl->cursors->xid && !IGL_HEADLESS)
     {
         igl->cursors->src = XCreatePixmap(IGL_DISPLAY, IGL_ROOT, 1, 1, 1);
         igl->cursors->xid = XCreatePixmapCursor(IGL_DISPLAY,
@@ -532,7 +726,7 @@ defcursor (short n, unsigned short *curs)
     igl->cursors[idx].type = igl->cursorType;
 
     /* store bitmaps if this is a user defined cursor */
-    if (igl->cursorType != CCROSS)
+    if (igl->cursorType != CCROSS && !IGL_HEADLESS)
     {
 #if PLATFORM_X11
         /* in GL 1st pixel is lower left, in X11 it's upper left
@@ -602,6 +796,8 @@ setcursor (short n, Colorindex color, Colorindex wtm)
         return;
 
     wptr->cursorIndex = idx;
+    if (IGL_HEADLESS)
+        return;
     if (idx == 0)
     {
         /* system cursor */
@@ -34,7 +34,7 @@ void
 rect (Coord a, Coord b, Coord c, Coord d)
 {
     _igl_trace (__func__,FALSE,"%g,%g,%g,%g",a,b,c,d);
-    igl->api->rect (a, b, c, d);
+    iglThread.api->rect (a, b, c, d);
 }
 
 void
@@ -66,7 +66,7 @@ recti (Icoord a, Icoord b, Icoord c, Icoord d)
     Coord cf = (Coord)c + (a < c ? +0.5 : -0.5);
     Coord df = (Coord)d + (b < d ? +0.5 : -0.5);
     _igl_trace (__func__,FALSE,"%d,%d,%d,%d",a,b,c,d);
-    igl->api->rect ((Coord)af, (Coord)bf, (Coord)cf, (Coord)df);
+    iglThread.api->rect ((Coord)af, (Coord)bf, (Coord)cf, (Coord)df);
 }
 
 
@@ -78,7 +78,7 @@ rects (Scoord a, Scoord b, Scoord c, Scoord d)
     Coord cf = (Coord)c + (a < c ? +0.5 : -0.5);
     Coord df = (Coord)d + (b < d ? +0.5 : -0.5);
     _igl_trace (__func__,FALSE,"%d,%d,%d,%d",a,b,c,d);
-    igl->api->rect ((Coord)af, (Coord)bf, (Coord)cf, (Coord)df);
+    iglThread.api->rect ((Coord)af, (Coord)bf, (Coord)cf, (Coord)df);
 }
 
 
@@ -87,7 +87,7 @@ void
 rectf (Coord a, Coord b, Coord c, Coord d)
 {
     _igl_trace (__func__,FALSE,"%g,%g,%g,%g",a,b,c,d);
-    igl->api->rectf (a, b, c, d);
+    iglThread.api->rectf (a, b, c, d);
 }
 
 
@@ -110,7 +110,7 @@ rectfi (Icoord a, Icoord b, Icoord c, Icoord d)
     Coord cf = (Coord)c + (a < c ? +0.5 : -0.5);
     Coord df = (Coord)d + (b < d ? +0.5 : -0.5);
     _igl_trace (__func__,FALSE,"%d,%d,%d,%d",a,b,c,d);
-    igl->api->rectf ((Coord)af, (Coord)bf, (Coord)cf, (Coord)df);
+    iglThread.api->rectf ((Coord)af, (Coord)bf, (Coord)cf, (Coord)df);
 }
 
 
@@ -122,7 +122,7 @@ rectfs (Scoord a, Scoord b, Scoord c, Scoord d)
     Coord cf = (Coord)c + (a < c ? +0.5 : -0.5);
     Coord df = (Coord)d + (b < d ? +0.5 : -0.5);
     _igl_trace (__func__,FALSE,"%d,%d,%d,%d",a,b,c,d);
-    igl->api->rectf ((Coord)af, (Coord)bf, (Coord)cf, (Coord)df);
+    iglThread.api->rectf ((Coord)af, (Coord)bf, (Coord)cf, (Coord)df);
 }
 
 
@@ -136,7 +136,7 @@ void
 sbox (Coord a, Coord b, Coord c, Coord d)
 {
     _igl_trace (__func__,FALSE,"%g,%g,%g,%g",a,b,c,d);
-    igl->api->sbox (a, b, c, d);
+    iglThread.api->sbox (a, b, c, d);
 }
 
 void
@@ -149,7 +149,6 @@ iglExec_sbox (Coord a, Coord b, Coord c, Coord d)
     wptr = IGL_CTX ();
 
     /* get coordinates of corners */
-    _igl_getViewport ();
     _igl_getMatrices ();
     gluProject (a, b, 0, wptr->modelMatrix, wptr->projMatrix, wptr->viewport, &sx, &sy, &sz);
     gluProject (c, d, 0, wptr->modelMatrix, wptr->projMatrix, wptr->viewport, &tx, &ty, &tz);
@@ -180,7 +179,7 @@ sboxi (Icoord a, Icoord b, Icoord c, Icoord d)
     Coord cf = (Coord)c + (a < c ? +0.5 : -0.5);
     Coord df = (Coord)d + (b < d ? +0.5 : -0.5);
     _igl_trace (__func__,FALSE,"%d,%d,%d,%d",a,b,c,d);
-    igl->api->sbox ((Coord)af, (Coord)bf, (Coord)cf, (Coord)df);
+    iglThread.api->sbox ((Coord)af, (Coord)bf, (Coord)cf, (Coord)df);
 }
 
 void
@@ -191,7 +190,7 @@ sboxs (Scoord a, Scoord b, Scoord c, Scoord d)
     Coord cf = (Coord)c + (a < c ? +0.5 : -0.5);
     Coord df = (Coord)d + (b < d ? +0.5 : -0.5);
     _igl_trace (__func__,FALSE,"%d,%d,%d,%d",a,b,c,d);
-    igl->api->sbox ((Coord)af, (Coord)bf, (Coord)cf, (Coord)df);
+    iglThread.api->sbox ((Coord)af, (Coord)bf, (Coord)cf, (Coord)df);
 }
 
 
@@ -200,7 +199,7 @@ void
 sboxf (Coord a, Coord b, Coord c, Coord d)
 {
     _igl_trace (__func__,FALSE,"%g,%g,%g,%g",a,b,c,d);
-    igl->api->sboxf (a, b, c, d);
+    iglThread.api->sboxf (a, b, c, d);
 }
 
 void
@@ -213,7 +212,6 @@ iglExec_sboxf (Coord a, Coord b, Coord c, Coord d)
     wptr = IGL_CTX ();
 
     /* get coordinates of corners */
-    _igl_getViewport ();
     _igl_getMatrices ();
     gluProject (a, b, 0, wptr->modelMatrix, wptr->projMatrix, wptr->viewport, &sx, &sy, &sz);
     gluProject (c, d, 0, wptr->modelMatrix, wptr->projMatrix, wptr->viewport, &tx, &ty, &tz);
@@ -239,7 +237,7 @@ sboxfi (Icoord a, Icoord b, Icoord c, Icoord d)
     Coord cf = (Coord)c + (a < c ? +0.5 : -0.5);
     Coord df = (Coord)d + (b < d ? +0.5 : -0.5);
     _igl_trace (__func__,FALSE,"%d,%d,%d,%d",a,b,c,d);
-    igl->api->sboxf ((Coord)af, (Coord)bf, (Coord)cf, (Coord)df);
+    iglThread.api->sboxf ((Coord)af, (Coord)bf, (Coord)cf, (Coord)df);
 }
 
 void
@@ -250,7 +248,7 @@ sboxfs (Scoord a, Scoord b, Scoord c, Scoord d)
     Coord cf = (Coord)c + (a < c ? +0.5 : -0.5);
     Coord df = (Coord)d + (b < d ? +0.5 : -0.5);
     _igl_trace (__func__,FALSE,"%d,%d,%d,%d",a,b,c,d);
-    igl->api->sboxf ((Coord)af, (Coord)bf, (Coord)cf, (Coord)df);
+    iglThread.api->sboxf ((Coord)af, (Coord)bf, (Coord)cf, (Coord)df);
 }
 
 
@@ -305,7 +303,7 @@ void
 arc (Coord x, Coord y, Coord radius, Angle startAngle, Angle endAngle)
 {
     _igl_trace (__func__,FALSE,"%g,%g,%g,%d,%d",x,y,radius,startAngle,endAngle);
-    igl->api->arc (x, y, radius, startAngle, endAngle);
+    iglThread.api->arc (x, y, radius, startAngle, endAngle);
 }
 
 void
@@ -326,7 +324,7 @@ void
 arci (Icoord x, Icoord y, Icoord radius, Angle startAngle, Angle endAngle)
 {
     _igl_trace (__func__,FALSE,"%d,%d,%d,%d,%d",x,y,radius,startAngle,endAngle);
-    igl->api->arc ((Coord)x, (Coord)y, (Coord)radius+0.5, startAngle, endAngle);
+    iglThread.api->arc ((Coord)x, (Coord)y, (Coord)radius+0.5, startAngle, endAngle);
 }
 
 
@@ -334,7 +332,7 @@ void
 arcs (Scoord x, Scoord y, Scoord radius, Angle startAngle, Angle endAngle)
 {
     _igl_trace (__func__,FALSE,"%d,%d,%d,%d,%d",x,y,radius,startAngle,endAngle);
-    igl->api->arc ((Coord)x, (Coord)y, (Coord)radius+0.5, startAngle, endAngle);
+    iglThread.api->arc ((Coord)x, (Coord)y, (Coord)radius+0.5, startAngle, endAngle);
 }
 
 
@@ -343,7 +341,7 @@ void
 arcf (Coord x, Coord y, Coord radius, Angle startAngle, Angle endAngle)
 {
     _igl_trace (__func__,FALSE,"%g,%g,%g,%d,%d",x,y,radius,startAngle,endAngle);
-    igl->api->arcf (x, y, radius, startAngle, endAngle);
+    iglThread.api->arcf (x, y, radius, startAngle, endAngle);
 }
 
 void
@@ -364,7 +362,7 @@ void
 arcfi (Icoord x, Icoord y, Icoord radius, Angle startAngle, Angle endAngle)
 {
     _igl_trace (__func__,FALSE,"%d,%d,%d,%d,%d",x,y,radius,startAngle,endAngle);
-    igl->api->arcf ((Coord)x, (Coord)y, (Coord)radius+0.5, startAngle, endAngle);
+    iglThread.api->arcf ((Coord)x, (Coord)y, (Coord)radius+0.5, startAngle, endAngle);
 }
 
 
@@ -372,7 +370,7 @@ void
 arcfs (Scoord x, Scoord y, Scoord radius, Angle startAngle, Angle endAngle)
 {
     _igl_trace (__func__,FALSE,"%d,%d,%d,%d,%d",x,y,radius,startAngle,endAngle);
-    igl->api->arcf ((Coord)x, (Coord)y, (Coord)radius+0.5, startAngle, endAngle);
+    iglThread.api->arcf ((Coord)x, (Coord)y, (Coord)radius+0.5, startAngle, endAngle);
 }
 
 
@@ -404,7 +402,7 @@ void
 circ (Coord x, Coord y, Coord radius)
 {
     _igl_trace (__func__,FALSE,"%g,%g,%g",x,y,radius);
-    igl->api->circ (x, y, radius);
+    iglThread.api->circ (x, y, radius);
 }
 
 void
@@ -425,7 +423,7 @@ void
 circi (Icoord x, Icoord y, Icoord radius)
 {
     _igl_trace (__func__,FALSE,"%d,%d,%d",x,y,radius);
-    igl->api->circ ((float)x, (float)y, (float)radius+0.5);
+    iglThread.api->circ ((float)x, (float)y, (float)radius+0.5);
 }
 
 
@@ -433,7 +431,7 @@ void
 circs (Scoord x, Scoord y, Scoord radius)
 {
     _igl_trace (__func__,FALSE,"%d,%d,%d",x,y,radius);
-    igl->api->circ ((float)x, (float)y, (float)radius+0.5);
+    iglThread.api->circ ((float)x, (float)y, (float)radius+0.5);
 }
 
 
@@ -442,7 +440,7 @@ void
 circf (Coord x, Coord y, Coord radius)
 {
     _igl_trace (__func__,FALSE,"%g,%g,%g",x,y,radius);
-    igl->api->circf (x, y, radius);
+    iglThread.api->circf (x, y, radius);
 }
 
 void
@@ -463,7 +461,7 @@ void
 circfi (Icoord x, Icoord y, Icoord radius)
 {
     _igl_trace (__func__,FALSE,"%d,%d,%d",x,y,radius);
-    igl->api->circf ((float)x, (float)y, (float)radius+0.5);
+    iglThread.api->circf ((float)x, (float)y, (float)radius+0.5);
 }
 
 
@@ -471,7 +469,7 @@ void
 circfs (Scoord x, Scoord y, Scoord radius)
 {
     _igl_trace (__func__,FALSE,"%d,%d,%d",x,y,radius);
-    igl->api->circf ((float)x, (float)y, (float)radius+0.5);
+    iglThread.api->circf ((float)x, (float)y, (float)radius+0.5);
 }
 
 
@@ -583,7 +581,7 @@ void
 crvn (long n, Coord points[][3])
 {
     _igl_trace (__func__,FALSE,"%ld,%p",n,points);
-    igl->api->crvn (n, points);
+    iglThread.api->crvn (n, points);
 }
 
 void
@@ -639,7 +637,7 @@ void
 crv (Coord points[4][3])
 {
     _igl_trace (__func__,FALSE,"%p",points);
-    igl->api->crvn (4, points);
+    iglThread.api->crvn (4, points);
 }
 
 
@@ -648,7 +646,7 @@ void
 rcrvn (long n, Coord points[][4])
 {
     _igl_trace (__func__,FALSE,"%ld,%p",n,points);
-    igl->api->rcrvn (n, points);
+    iglThread.api->rcrvn (n, points);
 }
 
 void
@@ -704,7 +702,7 @@ void
 rcrv (Coord points[4][4])
 {
     _igl_trace (__func__,FALSE,"%p",points);
-    igl->api->rcrvn (4, points);
+    iglThread.api->rcrvn (4, points);
 }
 
 
@@ -713,7 +711,7 @@ void
 curveprecision (short n)
 {
     _igl_trace (__func__,FALSE,"%d",n);
-    igl->api->curveprecision (n);
+    iglThread.api->curveprecision (n);
 }
 
 void
@@ -733,7 +731,7 @@ void
 curvebasis (short id)
 {
     _igl_trace (__func__,FALSE,"%d",id);
-    igl->api->curvebasis (id);
+    iglThread.api->curvebasis (id);
 }
 
 void
@@ -882,7 +880,7 @@ void
 patch (Matrix geomx, Matrix geomy, Matrix geomz)
 {
     _igl_trace (__func__,FALSE,"%p,%p,%p",geomx,geomy,geomz);
-    igl->api->patch (geomx, geomy, geomz);
+    iglThread.api->patch (geomx, geomy, geomz);
 }
 
 void
@@ -899,7 +897,7 @@ void
 rpatch (Matrix geomx, Matrix geomy, Matrix geomz, Matrix geomw)
 {
     _igl_trace (__func__,FALSE,"%p,%p,%p,%p",geomx,geomy,geomz,geomw);
-    igl->api->rpatch (geomx, geomy, geomz, geomw);
+    iglThread.api->rpatch (geomx, geomy, geomz, geomw);
 }
 
 void
@@ -916,7 +914,7 @@ void
 patchcurves (short nu, short nv)
 {
     _igl_trace (__func__,FALSE,"%d,%d",nu,nv);
-    igl->api->patchcurves (nu, nv);
+    iglThread.api->patchcurves (nu, nv);
 }
 
 void
@@ -937,7 +935,7 @@ void
 patchprecision (short nu, short nv)
 {
     _igl_trace (__func__,FALSE,"%d,%d",nu,nv);
-    igl->api->patchprecision (nu, nv);
+    iglThread.api->patchprecision (nu, nv);
 }
 
 void
@@ -958,7 +956,7 @@ void
 patchbasis (short uid, short vid)
 {
     _igl_trace (__func__,FALSE,"%d,%d",uid,vid);
-    igl->api->patchbasis (uid, vid);
+    iglThread.api->patchbasis (uid, vid);
 }
 
 void
@@ -1000,7 +998,7 @@ void
 curveit (short niter)
 {
     _igl_trace (__func__,FALSE,"%d",niter);
-    igl->api->curveit (niter);
+    iglThread.api->curveit (niter);
 }
 
 void
@@ -1012,21 +1010,7 @@ iglExec_curveit (short niter)
     IGL_CHECKWNDV ();
 
     /* get the matrix to operate on */
-    switch (IGL_CTX ()->matrixMode)
-    {
-        case MVIEWING:
-            glGetFloatv (GL_MODELVIEW_MATRIX, (GLfloat *)m);
-            break;
-
-        case MSINGLE:
-        case MPROJECTION:
-            glGetFloatv (GL_PROJECTION_MATRIX, (GLfloat *)m);
-            break;
-
-        case MTEXTURE:
-            glGetFloatv (GL_TEXTURE_MATRIX, (GLfloat *)m);
-            break;
-    }
+    memcpy (m, _igl_currentMatrix (), sizeof (m));
     /* replace with identity, as transformation is already included in matrix */
     glLoadIdentity ();
 
@@ -1047,5 +1031,5 @@ iglExec_curveit (short niter)
 
     /* replace identity with the resulting matrix */
     glLoadMatrixf (m);
-    IGL_CTX ()->flags &= ~IGL_WSTATE_CURMATRICES;
+    memcpy (_igl_currentMatrix (), m, sizeof (m));
 }
@@ -24,6 +24,11 @@
 #include "iglcmn.h"
 #include "ifm.h"
 
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
 
 #if PLATFORM_X11
 #if 0
@@ -129,6 +134,10 @@ struct fmcontext {
     GLuint texid[64];               /* texture IDs */
 };
 
+/* font contexts of the share group, and number of windows using them */
+static struct fmcontext *fmSharedContexts;
+static int fmSharedUsers;
+
 /* bitmap data for a single character */
 struct fmfontchar {
     short w, h;
@@ -140,6 +149,32 @@ struct fmfontdata {
     int cell_width, cell_height;    /* maximal charcell */
     int first_char, num_chars;
     struct fmfontchar *chars;
+    void *map;                      /* bitmaps mapped from the glyph cache */
+    size_t mapsize;
+};
+
+/* directory of the on-disk glyph cache, empty if none */
+static char fmcachedir[256];
+
+/* header of a glyph cache file. It is followed by an entry for each char and
+ * the bitmaps. Everything is in host byte order, since the file is mapped
+ * into memory as is. The font properties are used to validate it.
+ */
+#define FM_CACHEMAGIC   "IGLFMC1"
+struct fmcachehdr {
+    char magic[8];
+    char key[256];                  /* font name, size and server */
+    XCharStruct min_bounds, max_bounds;
+    unsigned int metrics;           /* hash over the per-char metrics */
+    int first_char, num_chars;
+    int cell_width, cell_height;
+    unsigned int size;              /* total file size */
+};
+
+/* char entry of a glyph cache file */
+struct fmcachechar {
+    short w, h;
+    unsigned int offset;            /* offset of bitmap in file */
 };
 
 
@@ -176,6 +211,197 @@ to_pow2 (unsigned int i)
 /* helper macro for per-char properties, if present */
 #define GETPERCHAR(f,i,b,m) ((f)->per_char && (i) >= 0 ? (f)->per_char[i].m : f->b##_bounds.m)
 
+/* FNV-1a hash over a memory area */
+static unsigned int
+_ifm_fmhash (unsigned int h, const void *mem, size_t len)
+{
+    const unsigned char *p = mem;
+
+    while (len--)
+        h = (h ^ *p++) * 16777619;
+    return h;
+}
+
+/* make the header for the glyph cache file of a font and return its path */
+static int
+_ifm_fmcachehdr (struct fmfont *fp, struct fmcachehdr *hdr, char *path, int len)
+{
+    XFontStruct *f = fp->font;
+    struct fmfontdef *fd = &fmfontdefs[fp->index];
+    struct fmfontdata *data = fp->data;
+    int n;
+
+    if (fmcachedir[0] == '\0')
+        return 0;
+
+    memset (hdr, 0, sizeof(*hdr));
+    memcpy (hdr->magic, FM_CACHEMAGIC, sizeof(hdr->magic));
+    snprintf (hdr->key, sizeof(hdr->key), "%s-%s %d %dx%d %s %s %d", fd->xname,
+                fd->encoding, fp->size, fmxdpi, fmydpi, DisplayString (IGL_DISPLAY),
+                ServerVendor (IGL_DISPLAY), VendorRelease (IGL_DISPLAY));
+
+    hdr->min_bounds = f->min_bounds;
+    hdr->max_bounds = f->max_bounds;
+    n = f->max_char_or_byte2 - f->min_char_or_byte2 + 1;
+    n *= f->max_byte1 - f->min_byte1 + 1;
+    hdr->metrics = _ifm_fmhash (2166136261u, &f->ascent, sizeof(f->ascent));
+    hdr->metrics = _ifm_fmhash (hdr->metrics, &f->descent, sizeof(f->descent));
+    if (f->per_char != NULL)
+        hdr->metrics = _ifm_fmhash (hdr->metrics, f->per_char, n * sizeof(XCharStruct));
+    hdr->first_char = data->first_char;
+    hdr->num_chars = data->num_chars;
+    hdr->cell_width = data->cell_width;
+    hdr->cell_height = data->cell_height;
+
+    snprintf (path, len, "%s/fm-%08x", fmcachedir,
+                _ifm_fmhash (2166136261u, hdr->key, strlen (hdr->key)));
+    return 1;
+}
+
+/* map the char bitmaps of a font from the glyph cache, if it is valid */
+static int
+_ifm_fmloadcache (struct fmfont *fp)
+{
+    struct fmfontdata *data = fp->data;
+    struct fmcachehdr hdr, *fhdr;
+    struct fmcachechar *fchar;
+    char path[sizeof(fmcachedir) + 16];
+    struct stat st;
+    void *map;
+    int fd, i;
+
+    if (!_ifm_fmcachehdr (fp, &hdr, path, sizeof(path)))
+        return 0;
+    if ((fd = open (path, O_RDONLY)) < 0)
+        return 0;
+
+    map = MAP_FAILED;
+    if (fstat (fd, &st) == 0 && st.st_size >= sizeof(hdr) +
+                    data->num_chars * sizeof(*fchar))
+        map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED)
+        return 0;
+
+    /* the font must still be the same as when the cache was written */
+    fhdr = map;
+    hdr.size = fhdr->size;
+    if (memcmp (fhdr, &hdr, sizeof(hdr)) != 0 || hdr.size != st.st_size)
+    {
+        munmap (map, st.st_size);
+        return 0;
+    }
+
+    fchar = (struct fmcachechar *)(fhdr + 1);
+    for (i = 0; i < data->num_chars; i++, fchar++)
+    {
+        if (fchar->w < 0 || fchar->h < 0 || fchar->offset > hdr.size ||
+                        fchar->w * fchar->h > hdr.size - fchar->offset)
+            break;
+        data->chars[i].w = fchar->w;
+        data->chars[i].h = fchar->h;
+        data->chars[i].bitmap = (char *)map + fchar->offset;
+    }
+    if (i < data->num_chars)
+    {
+        /* damaged file */
+        memset (data->chars, 0, data->num_chars * sizeof(*data->chars));
+        munmap (map, st.st_size);
+        return 0;
+    }
+
+    data->map = map;
+    data->mapsize = st.st_size;
+    return 1;
+}
+
+/* create a directory and all its parents */
+static void
+_ifm_fmmkdir (char *path)
+{
+    char *p;
+
+    for (p = strchr (path + 1, '/'); p != NULL; p = strchr (p + 1, '/'))
+    {
+        *p = '\0';
+        mkdir (path, 0755);
+        *p = '/';
+    }
+    mkdir (path, 0755);
+}
+
+/* write the char bitmaps of a font to the glyph cache */
+static void
+_ifm_fmstorecache (struct fmfont *fp)
+{
+    struct fmfontdata *data = fp->data;
+    struct fmcachehdr hdr;
+    struct fmcachechar fchar;
+    char path[sizeof(fmcachedir) + 16], tmp[sizeof(path) + 16];
+    unsigned int offset;
+    FILE *file;
+    int i, ok;
+
+    if (!_ifm_fmcachehdr (fp, &hdr, path, sizeof(path)))
+        return;
+
+    offset = sizeof(hdr) + data->num_chars * sizeof(fchar);
+    hdr.size = offset;
+    for (i = 0; i < data->num_chars; i++)
+        hdr.size += data->chars[i].w * data->chars[i].h;
+
+    /* write to a temporary file first, in case other programs are reading */
+    snprintf (tmp, sizeof(tmp), "%s.%d", path, (int)getpid ());
+    if ((file = fopen (tmp, "wb")) == NULL && errno == ENOENT)
+    {
+        _ifm_fmmkdir (fmcachedir);
+        file = fopen (tmp, "wb");
+    }
+    if (file == NULL)
+        return;
+
+    ok = (fwrite (&hdr, sizeof(hdr), 1, file) == 1);
+    for (i = 0; i < data->num_chars && ok; i++)
+    {
+        fchar.w = data->chars[i].w;
+        fchar.h = data->chars[i].h;
+        fchar.offset = offset;
+        offset += fchar.w * fchar.h;
+        ok = (fwrite (&fchar, sizeof(fchar), 1, file) == 1);
+    }
+    for (i = 0; i < data->num_chars && ok; i++)
+    {
+        size_t len = data->chars[i].w * data->chars[i].h;
+        ok = (fwrite (data->chars[i].bitmap, 1, len, file) == len);
+    }
+
+    if (fclose (file) == 0 && ok)
+        rename (tmp, path);
+    else
+        unlink (tmp);
+}
+
+/* copy a char from a bitmap image, converting it to 1 byte per pixel */
+static void
+_ifm_fmgetbitmap (XImage *img, int x0, int cw, int ch, char *bm)
+{
+    /* bytes in a scanline unit are swapped if byte and bit order differ */
+    int swap = (img->byte_order != img->bitmap_bit_order ? img->bitmap_unit/8 - 1 : 0);
+    int msb = (img->bitmap_bit_order == MSBFirst);
+    int x, y;
+
+    for (y = 0; y < ch; y++)
+    {
+        unsigned char *line = (unsigned char *)img->data + y * img->bytes_per_line;
+
+        for (x = x0; x < x0 + cw; x++)
+        {
+            int bit = (msb ? 7 - (x & 7) : x & 7);
+            *bm++ = (line[(x >> 3) ^ swap] >> bit & 1 ? 0xff : 0);
+        }
+    }
+}
+
 /* fetch the character bitmaps for the font from the X server */
 static void
 _ifm_fmfetchfontdata(struct fmfont *fp)
@@ -207,18 +433,22 @@ _ifm_fmfetchfontdata(struct fmfont *fp)
     if (num_chr <= 0)   /* no bitmaps to load */
         return;
 
+    /* no need to render the font if it is in the glyph cache */
+    if (_ifm_fmloadcache (fp))
+        return;
+
     /* limit size of pixmap to 128KB if possible */
     n_grab = 131072 / (data->cell_height * data->cell_width);
     n_grab += !n_grab;  /* must be at least 1 */
     n_grab = (n_grab > num_chr ? num_chr : n_grab);
 
-    /* create the pixmap and the gc used for grabbing */
+    /* create the bitmap and the gc used for grabbing */
     w = data->cell_width * n_grab;
     h = data->cell_height;
-    p = XCreatePixmap (dpy, IGL_WINDOW(0)->wnd, w, h, IGL_VISUAL->depth);
+    p = XCreatePixmap (dpy, IGL_ROOT, w, h, 1);
     gcv.font = f->fid;
-    gcv.foreground = WhitePixel(dpy, IGL_SCREEN);
-    gcv.background = BlackPixel(dpy, IGL_SCREEN);
+    gcv.foreground = 1;
+    gcv.background = 0;
     gc = XCreateGC (dpy, p, (GCFont|GCForeground|GCBackground), &gcv);
 
     for (chr = min_chr; chr <= max_chr; chr += n_grab)
@@ -227,10 +457,10 @@ _ifm_fmfetchfontdata(struct fmfont *fp)
         int idx = chr - min_chr;
         int i;
 
-        /* draw chars into the pixmap */
-        XSetForeground (dpy, gc, BlackPixel (dpy, IGL_SCREEN));
+        /* draw chars into the bitmap */
+        XSetForeground (dpy, gc, 0);
         XFillRectangle (dpy, p, gc, 0, 0, w, h);
-        XSetForeground (dpy, gc, WhitePixel (dpy, IGL_SCREEN));
+        XSetForeground (dpy, gc, 1);
         for (i = 0; i < grab; i++)
         {
             char c = chr + i;
@@ -246,24 +476,17 @@ _ifm_fmfetchfontdata(struct fmfont *fp)
         }
 
         /* get the bitmap and store each char into its char struct */
-        img = XGetImage (dpy, p, 0, 0, w, h, ~0L, ZPixmap);
+        img = XGetImage (dpy, p, 0, 0, w, h, 1, ZPixmap);
         for (i = 0; i < grab; i++)
         {
             int cw = GETPERCHAR(f, idx+i, max, rbearing) - GETPERCHAR(f, idx+i, min, lbearing);
             int ch = GETPERCHAR(f, idx+i, max, ascent) + GETPERCHAR(f, idx+i, max, descent);
             char *bm = malloc (cw * ch);
-            int x, y;
+
+            _ifm_fmgetbitmap (img, i * data->cell_width, cw, ch, bm);
 
             fchar = &data->chars[idx+i];
-            for (y = 0; y < ch; y++)
-                for (x = 0; x < cw; x++)
-                {
-                    unsigned long pix = XGetPixel (img, x + i * data->cell_width, y);
-                    unsigned long r = pix & IGL_VISUAL->visual->red_mask;
-                    bm[y * cw + x] = (r >> 24 | r >> 16 | r >> 8 | r) & 0xff;
-                }
             fchar->bitmap = bm;
-
             fchar->w = cw;
             fchar->h = ch;
         }
@@ -271,6 +494,29 @@ _ifm_fmfetchfontdata(struct fmfont *fp)
     }
     XFreeGC (dpy, gc);
     XFreePixmap (dpy, p);
+
+    _ifm_fmstorecache (fp);
+}
+
+/* release the character bitmaps of a font */
+static void
+_ifm_fmfreefontdata (struct fmfont *fp)
+{
+    struct fmfontdata *data = fp->data;
+    int i;
+
+    if (data == NULL)
+        return;
+
+    if (data->map != NULL)
+        munmap (data->map, data->mapsize);
+    else
+    {
+        for (i = 0; i < data->num_chars; i++)
+            free (data->chars[i].bitmap);
+    }
+    free (data);
+    fp->data = NULL;
 }
 
 
@@ -334,7 +580,7 @@ _ifm_fmusefontdata (struct fmfont *fp, struct fmcontext *ctx)
 
         /* create texture and store tex id in context */
         glGenTextures (1, &ctx->texid[which]);
-        glBindTexture (GL_TEXTURE_2D, ctx->texid[which]);
+        _igl_glBindTexture (GL_TEXTURE_2D, ctx->texid[which]);
 
         glTexImage2D (GL_TEXTURE_2D, 0, iformat, tw, th, 0, format, type, bm);
 
@@ -374,6 +620,8 @@ _ifm_fmfreecontext (struct fmfont *fp, struct fmcontext *ctx)
         if (ctx->texid[i])
             glDeleteTextures (1, &ctx->texid[i]);
     }
+    /* the textures may still be bound in other contexts of the share group */
+    _igl_glInvalidateAll (IGL_GLSTATE_TEXTURE);
     ctx->ntextures = 0;
 }
 
@@ -384,7 +632,15 @@ _ifm_fmloadfont (int n)
     igl_windowT *wptr = IGL_CTX ();
     struct fmfont *fp = &fmfonts[n];
 
-    if (wptr->fmContexts == NULL)
+    if (wptr->fmContexts == NULL && wptr->shared)
+    {
+        /* windows in the share group use the same textures */
+        if (fmSharedContexts == NULL)
+            fmSharedContexts = calloc (FM_MAXFONTS, sizeof(struct fmcontext));
+        wptr->fmContexts = fmSharedContexts;
+        fmSharedUsers ++;
+    }
+    else if (wptr->fmContexts == NULL)
         wptr->fmContexts = calloc (FM_MAXFONTS, sizeof(struct fmcontext));
 
     if (fp->font == NULL)
@@ -397,15 +653,29 @@ _ifm_fmloadfont (int n)
 static void
 _ifm_fmfontRelease (igl_windowT *wptr)
 {
+    struct fmcontext *ctx = wptr->fmContexts;
     int i;
 
-    if (wptr->fmContexts == NULL)
+    if (ctx == NULL)
         return;
+    wptr->fmContexts = NULL;
+
+    /* the shared contexts are released with their last user */
+    if (ctx == fmSharedContexts)
+    {
+        IGL_LOCK (IGL_LOCK_FONTS);
+        i = --fmSharedUsers;
+        if (i == 0)
+            fmSharedContexts = NULL;
+        IGL_UNLOCK (IGL_LOCK_FONTS);
+        if (i > 0)
+            return;
+    }
+
     for (i = 0; i < FM_MAXFONTS; i++)
-        _ifm_fmfreecontext (&fmfonts[i], &wptr->fmContexts[i]);
+        _ifm_fmfreecontext (&fmfonts[i], &ctx[i]);
 
-    free (wptr->fmContexts);
-    wptr->fmContexts = NULL;
+    free (ctx);
 }
 
 
@@ -504,10 +774,11 @@ _ifm_fmoutstr (struct fmfont *fp, float x, float y, float z, const char *str, in
     igl_windowT *wptr = IGL_CTX ();
     GLdouble tx, ty, tz;
 
+    IGL_LOCK (IGL_LOCK_FONTS);
     _ifm_fmloadfont (fp-fmfonts);
+    IGL_UNLOCK (IGL_LOCK_FONTS);
 
     /* get raster cordinates of position */
-    _igl_getViewport ();
     _igl_getMatrices ();
     gluProject (x, y, z, wptr->modelMatrix, wptr->projMatrix, wptr->viewport, &tx, &ty, &tz);
 
@@ -537,6 +808,7 @@ _ifm_fmoutstr (struct fmfont *fp, float x, float y, float z, const char *str, in
     /* restore status */
     _igl_popTransform ();
     glPopAttrib ();
+    _igl_glInvalidate (IGL_GLSTATE_ALL);
 } 
 
 
@@ -648,20 +920,26 @@ void
 fminit (void)
 {
     struct fmfontdef *fp;
-    char name[200];
+    char name[200], *env;
     int count = 0, i;
 
     _igl_trace (__func__,TRUE,"");
     IGL_CHECKINIT ();
 
+    /* glyph cache directory. An empty IGL_FONTCACHE turns it off */
+    if ((env = getenv ("IGL_FONTCACHE")) != NULL)
+        snprintf (fmcachedir, sizeof(fmcachedir), "%s", env);
+    else if ((env = getenv ("XDG_CACHE_HOME")) != NULL && *env)
+        snprintf (fmcachedir, sizeof(fmcachedir), "%s/igl", env);
+    else if ((env = getenv ("HOME")) != NULL)
+        snprintf (fmcachedir, sizeof(fmcachedir), "%s/.cache/igl", env);
+
     /* calculate DPI in x and y */
-    fmxdpi = DisplayWidth (IGL_DISPLAY, IGL_SCREEN) * 254 /
-                            (DisplayWidthMM (IGL_DISPLAY, IGL_SCREEN) * 10);
-    fmydpi = DisplayHeight (IGL_DISPLAY, IGL_SCREEN) * 254 /
-                            (DisplayHeightMM (IGL_DISPLAY, IGL_SCREEN) * 10);
+    fmxdpi = igl->gdXPMAX * 254 / (igl->gdXMMAX * 10);
+    fmydpi = igl->gdYPMAX * 254 / (igl->gdYMMAX * 10);
 
-    /* check which of the fonts is available */
-    for (i = 0, fp = fmfontdefs; fp->fmname; i++, fp++)
+    /* check which of the fonts is available. None without X server */
+    for (i = 0, fp = fmfontdefs; fp->fmname && !IGL_HEADLESS; i++, fp++)
     {
         snprintf(name, sizeof(name), "-*-%s-*-*-10-%d-%d-*-*-%s",
                     fp->xname, fmxdpi, fmydpi, fp->encoding);
@@ -786,6 +1064,7 @@ fmfreefont (fmfonthandle fh)
         XFreeFont (IGL_DISPLAY, fp->font);
         fp->font = NULL;
     }
+    _ifm_fmfreefontdata (fp);
 
     fp->index = -1;
 }
@@ -119,7 +119,7 @@ ____________________________ move functions ____________________________
 /* GL: move, movei, moves, move2, move2i, move2s - moves the current graphics
          position to a specified point */
 DEF3( move, x, y, z,
-    igl->api->move ((Coord)x, (Coord)y, (Coord)z)
+    iglThread.api->move ((Coord)x, (Coord)y, (Coord)z)
 )
 
 void
@@ -132,7 +132,7 @@ iglExec_move (Coord x, Coord y, Coord z)
 
 
 DEF2( move2, x, y,
-    igl->api->move ((Coord)x, (Coord)y, 0.0f)
+    iglThread.api->move ((Coord)x, (Coord)y, 0.0f)
 )
 
 
@@ -141,7 +141,7 @@ ____________________________ rmv functions ____________________________
 #endif
 /* GL: rmv, rmvi, rmvs, rmv2, rmv2i, rmv2s - relative move */
 DEF3( rmv, dx, dy, dz,
-    igl->api->rmv ((Coord)dx, (Coord)dy, (Coord)dz)
+    iglThread.api->rmv ((Coord)dx, (Coord)dy, (Coord)dz)
 )
 
 void
@@ -154,7 +154,7 @@ iglExec_rmv (Coord dx, Coord dy, Coord dz)
 
 
 DEF2( rmv2, dx, dy,
-    igl->api->rmv ((Coord)dx, (Coord)dy, 0.0f)
+    iglThread.api->rmv ((Coord)dx, (Coord)dy, 0.0f)
 )
 
 
@@ -163,7 +163,7 @@ ____________________________ draw functions ____________________________
 #endif
 /* GL: draw, drawi, draws, draw2, draw2i, draw2s - draws a line */
 DEF3( draw, x, y, z,
-    igl->api->draw ((Coord)x, (Coord)y, (Coord)z)
+    iglThread.api->draw ((Coord)x, (Coord)y, (Coord)z)
 )
 
 void
@@ -195,7 +195,7 @@ iglExec_draw (Coord x, Coord y, Coord z)
 
 
 DEF2( draw2, dx, dy,
-    igl->api->draw ((Coord)dx, (Coord)dy, 0.0f)
+    iglThread.api->draw ((Coord)dx, (Coord)dy, 0.0f)
 )
 
 
@@ -205,7 +205,7 @@ ____________________________ rdr functions ____________________________
 #endif
 /* GL: rdr, rdri, rdrs, rdr2, rdr2i, rdr2s - relative draw */
 DEF3( rdr, dx, dy, dz,
-    igl->api->rdr ((Coord)dx, (Coord)dy, (Coord)dz)
+    iglThread.api->rdr ((Coord)dx, (Coord)dy, (Coord)dz)
 )
 
 void
@@ -237,7 +237,7 @@ iglExec_rdr (Coord dx, Coord dy, Coord dz)
 
 
 DEF2( rdr2, dx, dy,
-    igl->api->rdr ((Coord)dx, (Coord)dy, 0.0f);
+    iglThread.api->rdr ((Coord)dx, (Coord)dy, 0.0f);
 )
 
 
@@ -246,7 +246,7 @@ ____________________________ pnt functions ____________________________
 #endif
 /* GL: pnt, pnti, pnts, pnt2, pnt2i, pnt2s - draws a point */
 DEF3( pnt, x, y, z,
-    igl->api->pnt ((Coord)x, (Coord)y, (Coord)z)
+    iglThread.api->pnt ((Coord)x, (Coord)y, (Coord)z)
 )
 
 void
@@ -265,7 +265,7 @@ iglExec_pnt (Coord x, Coord y, Coord z)
 
 
 DEF2( pnt2, x, y,
-    igl->api->pnt ((Coord)x, (Coord)y, 0.0f)
+    iglThread.api->pnt ((Coord)x, (Coord)y, 0.0f)
 )
 
 
@@ -274,7 +274,7 @@ ____________________________ rpmv functions ____________________________
 #endif
 /* GL: rpmv, rpmvi, rpmvs, rpmv2, rpmv2i, rpmv2s - relative polygon move */
 DEF3( rpmv, dx, dy, dz,
-    igl->api->rpmv ((Coord)dx, (Coord)dy, (Coord)dz)
+    iglThread.api->rpmv ((Coord)dx, (Coord)dy, (Coord)dz)
 )
 
 void
@@ -291,7 +291,7 @@ iglExec_rpmv (Coord dx, Coord dy, Coord dz)
 
 
 DEF2( rpmv2, dx, dy,
-    igl->api->rpmv ((Coord)dx, (Coord)dy, 0.0f)
+    iglThread.api->rpmv ((Coord)dx, (Coord)dy, 0.0f)
 )
 
 
@@ -300,7 +300,7 @@ ____________________________ rpdr functions ____________________________
 #endif
 /* GL: rpdr, rpdri, rpdrs, rpdr2, rpdr2i, rpdr2s - relative polygon draw */
 DEF3( rpdr, dx, dy, dz,
-    igl->api->rpdr ((Coord)dx, (Coord)dy, (Coord)dz)
+    iglThread.api->rpdr ((Coord)dx, (Coord)dy, (Coord)dz)
 )
 
 void
@@ -315,7 +315,7 @@ iglExec_rpdr (Coord dx, Coord dy, Coord dz)
 
 
 DEF2( rpdr2, dx, dy,
-    igl->api->rpdr ((Coord)dx, (Coord)dy, 0.0f)
+    iglThread.api->rpdr ((Coord)dx, (Coord)dy, 0.0f)
 )
 
 
@@ -324,7 +324,7 @@ ____________________________ pmv functions ____________________________
 #endif
 /* GL: pmv, pmvi, pmvs, pmv2, pmv2i, pmv2s - specifies the first point of a polygon */
 DEF3( pmv, x, y, z,
-    igl->api->pmv ((Coord)x, (Coord)y, (Coord)z)
+    iglThread.api->pmv ((Coord)x, (Coord)y, (Coord)z)
 )
 
 void
@@ -341,7 +341,7 @@ iglExec_pmv (Coord x, Coord y, Coord z)
 
 
 DEF2( pmv2, x, y,
-    igl->api->pmv ((Coord)x, (Coord)y, 0.0f)
+    iglThread.api->pmv ((Coord)x, (Coord)y, 0.0f)
 )
 
 
@@ -350,7 +350,7 @@ ____________________________ pdr functions ____________________________
 #endif
 /* GL: pdr, pdri, pdrs, pdr2, pdr2i, pdr2s - specifies the next point of a polygon */
 DEF3( pdr, x, y, z,
-    igl->api->pdr ((Coord)x, (Coord)y, (Coord)z)
+    iglThread.api->pdr ((Coord)x, (Coord)y, (Coord)z)
 )
 
 void
@@ -365,7 +365,7 @@ iglExec_pdr (Coord x, Coord y, Coord z)
 
 
 DEF2( pdr2, x, y,
-    igl->api->pdr ((Coord)x, (Coord)y, 0.0f)
+    iglThread.api->pdr ((Coord)x, (Coord)y, 0.0f)
 )
 
 
@@ -374,7 +374,7 @@ void
 pclos (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->pclos ();
+    iglThread.api->pclos ();
 }
 
 void
@@ -391,7 +391,7 @@ iglExec_pclos (void)
 void
 spclos (void)
 {
-    igl->api->pclos ();
+    iglThread.api->pclos ();
 }
 
 
@@ -403,7 +403,7 @@ void
 splf (long n, Coord parray[][3], Colorindex iarray[])
 {
     _igl_trace (__func__,FALSE,"%ld,%p,%p",n,parray,iarray);
-    igl->api->splf (n, parray, iarray);
+    iglThread.api->splf (n, parray, iarray);
 }
 
 void
@@ -438,7 +438,7 @@ void
 splfi (long n, Icoord parray[][3], Colorindex iarray[])
 {
     _igl_trace (__func__,FALSE,"%ld,%p,%p",n,parray,iarray);
-    igl->api->splfi (n, parray, iarray);
+    iglThread.api->splfi (n, parray, iarray);
 }
 
 void
@@ -473,7 +473,7 @@ void
 splfs (long n, Scoord parray[][3], Colorindex iarray[])
 {
     _igl_trace (__func__,FALSE,"%ld,%p,%p",n,parray,iarray);
-    igl->api->splfs (n, parray, iarray);
+    iglThread.api->splfs (n, parray, iarray);
 }
 
 void
@@ -508,7 +508,7 @@ void
 splf2 (long n, Coord parray[][2], Colorindex iarray[])
 {
     _igl_trace (__func__,FALSE,"%ld,%p,%p",n,parray,iarray);
-    igl->api->splf2 (n, parray, iarray);
+    iglThread.api->splf2 (n, parray, iarray);
 }
 
 void
@@ -543,7 +543,7 @@ void
 splf2i (long n, Icoord parray[][2], Colorindex iarray[])
 {
     _igl_trace (__func__,FALSE,"%ld,%p,%p",n,parray,iarray);
-    igl->api->splf2i (n, parray, iarray);
+    iglThread.api->splf2i (n, parray, iarray);
 }
 
 void
@@ -578,7 +578,7 @@ void
 splf2s (long n, Scoord parray[][2], Colorindex iarray[])
 {
     _igl_trace (__func__,FALSE,"%ld,%p,%p",n,parray,iarray);
-    igl->api->splf2s (n, parray, iarray);
+    iglThread.api->splf2s (n, parray, iarray);
 }
 
 void
@@ -617,7 +617,7 @@ void
 polf (long n, const Coord parray[][3])
 {
     _igl_trace (__func__,FALSE,"%ld,%p",n,parray);
-    igl->api->polf (n, parray);
+    iglThread.api->polf (n, parray);
 }
 
 void
@@ -645,7 +645,7 @@ void
 polfi (long n, const Icoord parray[][3])
 {
     _igl_trace (__func__,FALSE,"%ld,%p",n,parray);
-    igl->api->polfi (n, parray);
+    iglThread.api->polfi (n, parray);
 }
 
 void
@@ -673,7 +673,7 @@ void
 polfs (long n, const Scoord parray[][3])
 {
     _igl_trace (__func__,FALSE,"%ld,%p",n,parray);
-    igl->api->polfs (n, parray);
+    iglThread.api->polfs (n, parray);
 }
 
 void
@@ -701,7 +701,7 @@ void
 polf2 (long n, const Coord parray[][2])
 {
     _igl_trace (__func__,FALSE,"%ld,%p",n,parray);
-    igl->api->polf2 (n, parray);
+    iglThread.api->polf2 (n, parray);
 }
 
 void
@@ -729,7 +729,7 @@ void
 polf2i (long n, const Icoord parray[][2])
 {
     _igl_trace (__func__,FALSE,"%ld,%p",n,parray);
-    igl->api->polf2i (n, parray);
+    iglThread.api->polf2i (n, parray);
 }
 
 void
@@ -757,7 +757,7 @@ void
 polf2s (long n, const Scoord parray[][2])
 {
     _igl_trace (__func__,FALSE,"%ld,%p",n,parray);
-    igl->api->polf2s (n, parray);
+    iglThread.api->polf2s (n, parray);
 }
 
 void
@@ -789,7 +789,7 @@ void
 poly (long n, const Coord parray[][3])
 {
     _igl_trace (__func__,FALSE,"%ld,%p",n,parray);
-    igl->api->poly (n, parray);
+    iglThread.api->poly (n, parray);
 }
 
 void
@@ -817,7 +817,7 @@ void
 polyi (long n, const Icoord parray[][3])
 {
     _igl_trace (__func__,FALSE,"%ld,%p",n,parray);
-    igl->api->polyi (n, parray);
+    iglThread.api->polyi (n, parray);
 }
 
 void
@@ -845,7 +845,7 @@ void
 polys (long n, const Scoord parray[][3])
 {
     _igl_trace (__func__,FALSE,"%ld,%p",n,parray);
-    igl->api->polys (n, parray);
+    iglThread.api->polys (n, parray);
 }
 
 void
@@ -873,7 +873,7 @@ void
 poly2 (long n, const Coord parray[][2])
 {
     _igl_trace (__func__,FALSE,"%ld,%p",n,parray);
-    igl->api->poly2 (n, parray);
+    iglThread.api->poly2 (n, parray);
 }
 
 void
@@ -901,7 +901,7 @@ void
 poly2i (long n, const Icoord parray[][2])
 {
     _igl_trace (__func__,FALSE,"%ld,%p",n,parray);
-    igl->api->poly2i (n, parray);
+    iglThread.api->poly2i (n, parray);
 }
 
 void
@@ -929,7 +929,7 @@ void
 poly2s (long n, const Scoord parray[][2])
 {
     _igl_trace (__func__,FALSE,"%ld,%p",n,parray);
-    igl->api->poly2s (n, parray);
+    iglThread.api->poly2s (n, parray);
 }
 
 void
@@ -961,7 +961,7 @@ void
 pntsizef (float n)
 {
     _igl_trace (__func__,FALSE,"%g",n);
-    igl->api->pntsizef (n);
+    iglThread.api->pntsizef (n);
 }
 
 void
@@ -976,7 +976,7 @@ iglExec_pntsizef (float n)
 void
 pntsize (short n)
 {
-    igl->api->pntsizef ((float)n);
+    iglThread.api->pntsizef ((float)n);
 }
 
 
@@ -985,7 +985,7 @@ void
 pntsmooth (unsigned long mode)
 {
     _igl_trace (__func__,FALSE,"%lu",mode);
-    igl->api->pntsmooth (mode);
+    iglThread.api->pntsmooth (mode);
 }
 
 void
@@ -1012,7 +1012,7 @@ void
 linewidthf (float width)
 {
     _igl_trace (__func__,FALSE,"%g",width);
-    igl->api->linewidthf (width);
+    iglThread.api->linewidthf (width);
 }
 
 void
@@ -1028,7 +1028,7 @@ void
 linewidth (short width)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->linewidthf ((float)width);
+    iglThread.api->linewidthf ((float)width);
 }
 
 
@@ -1050,7 +1050,7 @@ void
 linesmooth (unsigned long mode)
 {
     _igl_trace (__func__,FALSE,"%lu",mode);
-    igl->api->linesmooth (mode);
+    iglThread.api->linesmooth (mode);
 }
 
 void
@@ -1078,7 +1078,7 @@ void
 smoothline (long mode)
 {
     _igl_trace (__func__,TRUE,"%ld",mode);
-    igl->api->linesmooth ((unsigned long)mode);
+    iglThread.api->linesmooth ((unsigned long)mode);
 }
 
 
@@ -1104,7 +1104,7 @@ void
 setlinestyle (short n)
 {
     _igl_trace (__func__,FALSE,"%d",n);
-    igl->api->setlinestyle (n);
+    iglThread.api->setlinestyle (n);
 }
 
 void
@@ -1148,7 +1148,7 @@ void
 lsrepeat (long factor)
 {
     _igl_trace (__func__,FALSE,"%ld",factor);
-    igl->api->lsrepeat (factor);
+    iglThread.api->lsrepeat (factor);
 }
 
 void
@@ -1180,7 +1180,7 @@ void
 polymode (long mode)
 {
     _igl_trace (__func__,FALSE,"%ld",mode);
-    igl->api->polymode (mode);
+    iglThread.api->polymode (mode);
 }
 
 void
@@ -1203,7 +1203,7 @@ void
 polysmooth (long mode)
 {
     _igl_trace (__func__,FALSE,"%ld",mode);
-    igl->api->polysmooth (mode);
+    iglThread.api->polysmooth (mode);
 }
 
 void
@@ -1227,7 +1227,7 @@ void
 displacepolygon (float scalefactor)
 {
     _igl_trace (__func__,TRUE,"%g",scalefactor);
-    igl->api->displacepolygon (scalefactor);
+    iglThread.api->displacepolygon (scalefactor);
 }
 
 void
@@ -1257,7 +1257,7 @@ void
 backface (Boolean enable)
 {
     _igl_trace (__func__,FALSE,"%d",enable);
-    igl->api->backface (enable);
+    iglThread.api->backface (enable);
 }
 
 void
@@ -1304,7 +1304,7 @@ void
 frontface (Boolean enable)
 {
     _igl_trace (__func__,FALSE,"%d",enable);
-    igl->api->frontface (enable);
+    iglThread.api->frontface (enable);
 }
 
 void
@@ -1383,7 +1383,7 @@ void
 setpattern (short index)
 {
     _igl_trace (__func__,FALSE,"%d",index);
-    igl->api->setpattern (index);
+    iglThread.api->setpattern (index);
 }
 
 void
@@ -0,0 +1,201 @@
+/*
+ * headless.c
+ *
+ * rendering into EGL pbuffers, without X server
+ *
+ *
+ * Copyright (c) 2004 Matevz Bradac
+ * Copyright (c) 2006-2016 Kai-Uwe Bloem
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "igl.h"
+#include "iglcmn.h"
+
+#ifdef HEADLESS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+
+/* Every GL window renders into a pbuffer of screen size, so that moving and
+ * resizing a window only changes the viewport. The EGLSurface doubles as the
+ * window handle, the EGLContext as the GL context handle. There is no window
+ * system, hence no layers, cursors, pop-up menus or X fonts; events only
+ * come from qenter() and the GL timers.
+ */
+static struct
+{
+    EGLDisplay dpy;
+    EGLConfig config;
+} headless;
+
+static EGLint egl_attribs[] = {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+    EGL_DEPTH_SIZE, 24,
+    EGL_STENCIL_SIZE, 8,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_NONE
+};
+
+
+/* open an EGL display without window system */
+int
+_igl_headlessInit (void)
+{
+    EGLint major, minor, n = 0;
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay;
+
+    getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+                                eglGetProcAddress ("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay != NULL)
+        headless.dpy = getPlatformDisplay (EGL_PLATFORM_SURFACELESS_MESA,
+                                EGL_DEFAULT_DISPLAY, NULL);
+#endif
+    if (headless.dpy == EGL_NO_DISPLAY)
+        headless.dpy = eglGetDisplay (EGL_DEFAULT_DISPLAY);
+
+    if (!eglInitialize (headless.dpy, &major, &minor))
+    {
+        printf ("eglInitialize() failed!\n");
+        return (-1);
+    }
+    if (!eglChooseConfig (headless.dpy, egl_attribs, &headless.config, 1, &n) || n == 0)
+    {
+        printf ("eglChooseConfig() failed!\n");
+        return (-1);
+    }
+
+    /* assume 96 dpi for the virtual screen */
+    igl->gdXMMAX = igl->gdXPMAX * 254 / 960;
+    igl->gdYMMAX = igl->gdYPMAX * 254 / 960;
+
+    return (0);
+}
+
+
+void
+_igl_headlessExit (void)
+{
+    if (headless.dpy != EGL_NO_DISPLAY)
+        eglTerminate (headless.dpy);
+    headless.dpy = EGL_NO_DISPLAY;
+}
+
+
+/* create a GL context, sharing objects with another one if not NULL */
+HGLRC
+_igl_headlessCreateContext (HGLRC share)
+{
+    EGLContext ctx;
+
+    /* the API binding is per thread */
+    eglBindAPI (EGL_OPENGL_API);
+    ctx = eglCreateContext (headless.dpy, headless.config,
+                share != NULL ? (EGLContext)share : EGL_NO_CONTEXT, NULL);
+    return (ctx != EGL_NO_CONTEXT ? (HGLRC)ctx : IGL_NULLCTX);
+}
+
+
+void
+_igl_headlessDestroyContext (HGLRC hrc)
+{
+    eglDestroyContext (headless.dpy, (EGLContext)hrc);
+}
+
+
+/* create the pbuffer backing a GL window */
+HWND
+_igl_headlessCreateSurface (int width, int height)
+{
+    EGLint attribs[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+    EGLSurface surface;
+
+    surface = eglCreatePbufferSurface (headless.dpy, headless.config, attribs);
+    return (surface != EGL_NO_SURFACE ? (HWND)surface : IGL_NULLWND);
+}
+
+
+void
+_igl_headlessDestroySurface (HWND wnd)
+{
+    eglDestroySurface (headless.dpy, (EGLSurface)wnd);
+}
+
+
+/* make a context current in the calling thread, None for none */
+void
+_igl_headlessMakeCurrent (HWND wnd, HGLRC hrc)
+{
+    EGLSurface surface = (wnd != IGL_NULLWND ? (EGLSurface)wnd : EGL_NO_SURFACE);
+
+    eglBindAPI (EGL_OPENGL_API);
+    eglMakeCurrent (headless.dpy, surface, surface,
+                hrc != IGL_NULLCTX ? (EGLContext)hrc : EGL_NO_CONTEXT);
+}
+
+
+/* pbuffers have no front buffer to swap to. If IGL_DUMPFRAMES is set, write
+ * the window content to <prefix><window>-<frame>.ppm instead
+ */
+void
+_igl_headlessSwap (igl_windowT *wptr)
+{
+    int width = wptr->width, height = wptr->height;
+    unsigned char *pixels;
+    char name[1024];
+    FILE *fp;
+    int y;
+
+    if (igl->frameDump == NULL)
+        return;
+
+    /* the window is in the lower left corner of its pbuffer */
+    if (width > igl->gdXPMAX)
+        width = igl->gdXPMAX;
+    if (height > igl->gdYPMAX)
+        height = igl->gdYPMAX;
+    if (width <= 0 || height <= 0)
+        return;
+
+    pixels = malloc ((size_t)width * height * 3);
+    if (pixels == NULL)
+        return;
+
+    glPushAttrib (GL_PIXEL_MODE_BIT);
+    glPushClientAttrib (GL_CLIENT_PIXEL_STORE_BIT);
+    glPixelStorei (GL_PACK_ALIGNMENT, 1);
+    glPixelStorei (GL_PACK_ROW_LENGTH, 0);
+    glPixelStorei (GL_PACK_SKIP_ROWS, 0);
+    glPixelStorei (GL_PACK_SKIP_PIXELS, 0);
+    glReadBuffer (GL_BACK);
+    glReadPixels (0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+    glPopClientAttrib ();
+    glPopAttrib ();
+
+    snprintf (name, sizeof(name), "%s%d-%05d.ppm", igl->frameDump,
+                (int)(wptr - igl->openWindows), wptr->swapCounter);
+    if ((fp = fopen (name, "wb")) != NULL)
+    {
+        /* PPM starts with the top row */
+        fprintf (fp, "P6\n%d %d\n255\n", width, height);
+        for (y = height-1; y >= 0; y--)
+            fwrite (pixels + (size_t)y * width * 3, 1, width * 3, fp);
+        fclose (fp);
+    }
+    free (pixels);
+}
+#endif      /* HEADLESS */
@@ -21,6 +21,9 @@
  * along with this program; if not, see <http://www.gnu.org/licenses/>.
  */
 
+#ifdef __linux__
+#define _GNU_SOURCE     /* pthread_rwlockattr_setkind_np */
+#endif
 #include "igl.h"
 #include "iglcmn.h"
 
@@ -44,6 +47,36 @@
 
 /* globals */
 igl_globalsT *igl;
+#ifdef IGL_THREADTLS
+__thread igl_threadT iglThread = { -1, NULL, -1 };
+#else
+static pthread_key_t _igl_threadKey;
+static pthread_once_t _igl_threadOnce = PTHREAD_ONCE_INIT;
+static void _igl_freeThread (void *arg);
+
+static void
+_igl_createThreadKey (void)
+{
+    pthread_key_create (&_igl_threadKey, _igl_freeThread);
+}
+
+/* get the state of the calling thread, allocate it on the first call */
+igl_threadT *
+_igl_getThread (void)
+{
+    igl_threadT *thread;
+
+    pthread_once (&_igl_threadOnce, _igl_createThreadKey);
+    thread = (igl_threadT *)pthread_getspecific (_igl_threadKey);
+    if (thread == NULL)
+    {
+        thread = (igl_threadT *)calloc (1, sizeof (igl_threadT));
+        thread->currentWindow = thread->currentObjIdx = -1;
+        pthread_setspecific (_igl_threadKey, thread);
+    }
+    return (thread);
+}
+#endif
 
 #if PLATFORM_X11
 #if 0
@@ -52,8 +85,8 @@ ____________________________ X11 common stuph ____________________________
 /* TODO: better use one of the available extension helpers for this? */
 void *dlHandle;
 
-/* helper functions for OpenGL swapcontrol extension */
-static void
+/* helper functions for OpenGL extensions */
+void
 (*_igl_getOglFunc (const char *fn))()
 {
     if (dlHandle == NULL)
@@ -133,6 +166,11 @@ _igl_systemInit (HINSTANCE disp)
     int tmp[2];
     int i;
 
+#ifdef HEADLESS
+    if (IGL_HEADLESS)
+        return (_igl_headlessInit ());
+#endif
+
     /* open display and check for OpenGL */
     XInitThreads ();
     igl->appInstance = XOpenDisplay (NULL);
@@ -163,6 +201,9 @@ _igl_systemInit (HINSTANCE disp)
 
     /* setup miscellanous stuff */
     _igl_X11swapFunc ();
+#ifdef XINPUT2
+    _igl_X11initXInput2 ();
+#endif
 
     if (igl->debug)
         XSynchronize (igl->appInstance, 1);
@@ -200,8 +241,15 @@ _igl_systemExit (void)
         dlclose (dlHandle);
     dlHandle = NULL;
 
+#ifdef HEADLESS
+    if (IGL_HEADLESS)
+        _igl_headlessExit ();
+#endif
     if (IGL_DISPLAY != NULL)
+    {
+        _igl_X11releaseShm ();
         XCloseDisplay (IGL_DISPLAY);
+    }
 }
 #endif      /* PLATFORM_X11 */
 
@@ -210,16 +258,39 @@ _igl_systemExit (void)
 static void
 _igl_exit (void)
 {
+    int i;
+
     /* nothing to do if not initialized */
     if (igl == NULL)
         return;
 
+    if (igl->debug)
+    {
+        printf ("IGL: %lu OpenGL state changes issued, %lu filtered\n",
+                    igl->glStateIssued, igl->glStateFiltered);
+        printf ("IGL: max %u events queued, %lu dropped\n",
+                    igl->eventHighWater, igl->eventsDropped);
+    }
+
+    /* stop the render thread before anything it uses goes away */
+    _igl_exitPipe ();
+
     /* cleanup internal structures */
     if (igl->nurbsCurve != NULL)
         gluDeleteNurbsRenderer (igl->nurbsCurve);
 
+    _igl_pixExit ();
     _igl_exitObjectApi ();
     _igl_releaseObjects ();
+    _igl_releaseVertices ();
+    if (igl->eventQueue != NULL)
+        free (igl->eventQueue);
+    if (igl->timerFd >= 0)
+        close (igl->timerFd);
+    pthread_key_delete (igl->threadKey);
+    for (i = 0; i < IGL_MAXLOCKS; i++)
+        pthread_mutex_destroy (&igl->locks[i]);
+    pthread_rwlock_destroy (&igl->objectLock);
 
     /* exit window system */
     _igl_systemExit ();
@@ -228,6 +299,97 @@ _igl_exit (void)
     if (igl != NULL)
         free (igl);
     igl = NULL;
+    iglThread.api = NULL;
+}
+
+
+/* release the state of a thread which used IGL */
+static void
+_igl_exitThread (void *arg)
+{
+    /* an object left open must not block other threads */
+    if (iglThread.currentObjIdx != -1)
+    {
+        iglThread.currentObjIdx = -1;
+        IGL_UNLOCKOBJS ();
+    }
+
+    /* give up the current window, so that other threads can use it */
+    if (iglThread.currentWindow >= 0)
+    {
+        IGL_CTX ()->bound = 0;
+#if PLATFORM_X11
+        _igl_makeCurrent (None, NULL);
+#endif
+    }
+    _igl_releaseVertices ();
+}
+
+#ifndef IGL_THREADTLS
+/* the key is cleared when this is called, but the state is needed meanwhile */
+static void
+_igl_freeThread (void *arg)
+{
+    pthread_setspecific (_igl_threadKey, arg);
+    if (igl != NULL && ((igl_threadT *)arg)->api != NULL)
+        _igl_exitThread (arg);
+    pthread_setspecific (_igl_threadKey, NULL);
+    free (arg);
+}
+#endif
+
+
+/* set up the locks of the shared tables, and per-thread cleanup */
+static void
+_igl_initLocks (void)
+{
+    pthread_mutexattr_t attr;
+    pthread_rwlockattr_t rwattr;
+    int i;
+
+    /* recursive, since locked functions may call each other */
+    pthread_mutexattr_init (&attr);
+    pthread_mutexattr_settype (&attr, PTHREAD_MUTEX_RECURSIVE);
+    for (i = 0; i < IGL_MAXLOCKS; i++)
+        pthread_mutex_init (&igl->locks[i], &attr);
+    pthread_mutexattr_destroy (&attr);
+
+    /* callobj holds the object lock almost all the time when rendering in
+     * several threads. Don't let makeobj/delobj starve, nested read locks
+     * are avoided anyway. Only glibc can be told so
+     */
+    pthread_rwlockattr_init (&rwattr);
+#ifdef __GLIBC__
+    pthread_rwlockattr_setkind_np (&rwattr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+#endif
+    pthread_rwlock_init (&igl->objectLock, &rwattr);
+    pthread_rwlockattr_destroy (&rwattr);
+
+    pthread_key_create (&igl->threadKey, _igl_exitThread);
+}
+
+
+/* set up the state of a thread calling IGL for the first time */
+void
+_igl_initThread (void)
+{
+    if (igl == NULL)
+        _igl_init (NULL);
+
+    if (iglThread.api == NULL)
+    {
+        iglThread.currentWindow = -1;
+        iglThread.currentObjIdx = -1;
+        iglThread.api = igl->execApi;
+#ifdef IGL_THREADTLS
+        /* else the state is released with the thread specific data */
+        pthread_setspecific (igl->threadKey, &iglThread);
+#endif
+    }
+
+    /* calls which aren't recorded need the render thread to catch up */
+    if (iglThread.pipelined)
+        _igl_pipeSync ();
 }
 
 
@@ -246,6 +408,8 @@ _igl_init (HINSTANCE app)
     igl = (igl_globalsT *)calloc (1, sizeof (igl_globalsT));
     FCN_EXIT (igl == NULL, -1,
             printf ("malloc() failed!\n"));
+    igl->timerFd = -1;          /* not yet created, for error exits */
+    _igl_initLocks ();
 
     /* check environment options. TODO: real parsing and error checking */
     if (getenv("IGL_VERSION"))
@@ -267,6 +431,51 @@ _igl_init (HINSTANCE app)
     if (getenv("IGL_NOLAYERS") != NULL)
         igl->flags |= IGL_IFLAGS_NOLAYERS;
 
+    if (getenv("IGL_NOOBJLISTS") != NULL)
+        igl->flags |= IGL_IFLAGS_NOOBJLISTS;
+
+    if (getenv("IGL_NOSTATECACHE") != NULL)
+        igl->flags |= IGL_IFLAGS_NOSTATECACHE;
+    if (getenv("IGL_NOFONTATLAS") != NULL)
+        igl->flags |= IGL_IFLAGS_NOFONTATLAS;
+    if (getenv("IGL_NOMOTIONCOMP") != NULL)
+        igl->flags |= IGL_IFLAGS_NOMOTIONCOMP;
+    if (getenv("IGL_PIPELINE") != NULL)
+        igl->flags |= IGL_IFLAGS_PIPELINE;
+
+#ifdef HEADLESS
+    if ((env_str = getenv("IGL_HEADLESS")) != NULL)
+    {
+        /* virtual screen of the given size, no layers */
+        igl->flags |= IGL_IFLAGS_HEADLESS | IGL_IFLAGS_NOLAYERS;
+        if (sscanf(env_str, "%ldx%ld", &igl->gdXPMAX, &igl->gdYPMAX) != 2)
+        {
+            igl->gdXPMAX = IGL_HEADLESSWIDTH;
+            igl->gdYPMAX = IGL_HEADLESSHEIGHT;
+        }
+        igl->frameDump = getenv("IGL_DUMPFRAMES");
+    }
+#endif
+
+    if ((env_str = getenv("IGL_PIXTHREADS")) != NULL)
+        igl->pixThreads = strtol(env_str, NULL, 10);
+    else
+#ifdef _SC_NPROCESSORS_ONLN
+        igl->pixThreads = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+        igl->pixThreads = sysconf(_SC_NPROC_ONLN); /* IRIX */
+#endif
+
+    if ((env_str = getenv("IGL_PIXTHRESHOLD")) != NULL)
+        igl->pixThreshold = strtol(env_str, NULL, 10);
+    else
+        igl->pixThreshold = IGL_PIXTHRESHOLD;
+
+    if ((env_str = getenv("IGL_PIXPOOL")) != NULL)
+        igl->pixPoolMax = strtol(env_str, NULL, 10);
+    else
+        igl->pixPoolMax = IGL_PIXPOOLMAX;
+
     if ((env_str = getenv("IGL_COMPAT")) != NULL)
     {
         igl->glcSOFTATTACH = (strstr (env_str, "SOFTATTACH") != NULL);
@@ -306,8 +515,11 @@ _igl_init (HINSTANCE app)
     IGL_MAPINIT (igl->fontDefs, IGL_MAXFONTS, 1);
 
     /* device related */
+    env_str = getenv("IGL_QUEUESIZE");
+    FCN_EXIT (_igl_initQueue (env_str ? strtol(env_str, NULL, 10) : IGL_DEVQENTRIES) != 0, -1,
+            printf ("malloc() failed!\n"));
     igl->deviceQueue[INPUTCHANGE] = igl->deviceQueue[REDRAW] = 1;
-    gettimeofday (&igl->lastTime, NULL);
+    _igl_initTimers ();
     igl->tiedValuators[CURSORX*2] = MOUSEX;
     igl->tiedValuators[CURSORY*2] = MOUSEY;
     igl->deviceNoise[TIMER0] = igl->deviceNoise[TIMER1] = 
@@ -331,7 +543,11 @@ _igl_init (HINSTANCE app)
     igl->flags &= ~IGL_IFLAGS_NODEBUG;
     if (queryWindowId != -1)
         igl->queryWindow = IGL_WINDOW (queryWindowId);
-    igl->currentWindow = -1;
+    iglThread.currentWindow = -1;
+
+    /* render thread, runs without it if it can't be started */
+    if ((igl->flags & IGL_IFLAGS_PIPELINE) && _igl_initPipe () != 0)
+        igl->flags &= ~IGL_IFLAGS_PIPELINE;
     return;
 
     /* error exit */
@@ -381,8 +597,8 @@ _igl_mapIDinit (short *map, int mapSize, int mapOffset, int nonzero)
 }
 
 /* map IrisGL id to array index. flags bit 0: alloc, flags bit 1: id non-0 */
-int
-_igl_mapIDalloc (short *map, int mapSize, int mapOffset, short id, int flags)
+static int
+_igl_mapID (short *map, int mapSize, int mapOffset, short id, int flags)
 {
     int idx, empty = -1;
     short *p;
@@ -417,6 +633,21 @@ _igl_mapIDalloc (short *map, int mapSize, int mapOffset, short id, int flags)
 
     return -1;
 }
+
+int
+_igl_mapIDalloc (short *map, int mapSize, int mapOffset, short id, int flags)
+{
+    int idx;
+
+    if (!(flags & 1))
+        return _igl_mapID (map, mapSize, mapOffset, id, flags);
+
+    /* definitions are shared by all threads */
+    IGL_LOCK (IGL_LOCK_DEFS);
+    idx = _igl_mapID (map, mapSize, mapOffset, id, flags);
+    IGL_UNLOCK (IGL_LOCK_DEFS);
+    return idx;
+}
 #undef padd
 #undef pmap
 
@@ -425,7 +656,8 @@ _igl_mapIDalloc (short *map, int mapSize, int mapOffset, short id, int flags)
 static void
 _igl_swapTimer (igl_windowT *wptr)
 {
-    if (wptr->swapInterval && !igl->swapInterval)
+    /* without display there's no retrace to wait for */
+    if (wptr->swapInterval && !igl->swapInterval && !IGL_HEADLESS)
     {
         struct timeval next, now;
         int oldCounter = wptr->swapCounter;
@@ -495,15 +727,15 @@ void (_igl_trace)(const char *func, int immediate, const char *fmt, ...)
     va_list args;
     char objmark[2] = "\0";
 
-    if (!igl)
-        _igl_init (NULL);
+    if (!iglThread.api)
+        _igl_initThread ();
     if (igl->flags & IGL_IFLAGS_NODEBUG)
         return;
 
     if (igl->debug & 1)
     {
         /* if function marked as "objectable", check if in object definition */
-        if (!immediate && igl->api == igl->objApi)
+        if (!immediate && iglThread.api == igl->objApi)
             objmark[0] = '*';
         printf ("%ld %s%s(",(long)getpid (),objmark,func);
         va_start (args, fmt);
@@ -518,6 +750,365 @@ void (_igl_trace)(const char *func, int immediate, const char *fmt, ...)
 }
 
 
+#if 0
+____________________________ OpenGL state cache ____________________________
+#endif
+/*
+ * Legacy programs set the same state around every primitive, and with
+ * indirect rendering every call is sent over the wire. The state of each
+ * OpenGL context is shadowed in an igl_glStateT, and changes that wouldn't
+ * change anything are dropped. Everything changing OpenGL state behind the
+ * back of the cache (glPopAttrib, glCallList, ...) must invalidate it.
+ */
+
+/* statistics are only kept for IGL_DEBUG. All threads count into them */
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 1))
+#define IGL_GLSTAT(c)       do { if (igl->debug) __sync_fetch_and_add (&igl->c, 1); } while (0)
+#else
+#define IGL_GLSTAT(c)       do { if (igl->debug) { IGL_LOCK (IGL_LOCK_STATS); \
+                                igl->c ++; IGL_UNLOCK (IGL_LOCK_STATS); } } while (0)
+#endif
+
+/* get the state cache of the current context, NULL if there is none. Then
+ * every call must be sent to OpenGL
+ */
+static igl_glStateT *
+_igl_glStateCache (void)
+{
+    igl_windowT *wptr;
+
+    if (iglThread.currentWindow < 0 || (igl->flags & IGL_IFLAGS_NOSTATECACHE))
+        return (NULL);
+
+    wptr = IGL_CTX ();
+    return (IGL_GLSTATE (wptr));
+}
+
+
+/* check if a state entry is already set, count the call. returns 0 if not */
+static int
+_igl_glFiltered (igl_glStateT *gs, unsigned int entry, int same)
+{
+    if ((gs->valid & entry) && same)
+    {
+        IGL_GLSTAT (glStateFiltered);
+        return (1);
+    }
+
+    gs->valid |= entry;
+    IGL_GLSTAT (glStateIssued);
+    return (0);
+}
+
+
+static unsigned int
+_igl_glCap (GLenum cap)
+{
+    switch (cap)
+    {
+        case GL_DEPTH_TEST:         return (IGL_GLCAP_DEPTHTEST);
+        case GL_ALPHA_TEST:         return (IGL_GLCAP_ALPHATEST);
+        case GL_BLEND:              return (IGL_GLCAP_BLEND);
+        case GL_DITHER:             return (IGL_GLCAP_DITHER);
+        case GL_LIGHTING:           return (IGL_GLCAP_LIGHTING);
+        case GL_COLOR_MATERIAL:     return (IGL_GLCAP_COLORMATERIAL);
+        case GL_TEXTURE_2D:         return (IGL_GLCAP_TEXTURE2D);
+        case GL_TEXTURE_3D:         return (IGL_GLCAP_TEXTURE3D);
+        default:                    return (0);
+    }
+}
+
+
+/* forget the cached state of the current context */
+void
+_igl_glInvalidate (unsigned int mask)
+{
+    igl_glStateT *gs = _igl_glStateCache ();
+
+    if (gs == NULL)
+        return;
+    gs->valid &= ~mask;
+    if (mask & IGL_GLSTATE_CAPS)
+        gs->capsValid = 0;
+}
+
+
+/* forget the cached state of all contexts, e.g. after deleting shared objects */
+void
+_igl_glInvalidateAll (unsigned int mask)
+{
+    int i;
+
+    for (i = 0; i < IGL_MAXWINDOWS; i++)
+    {
+        igl_glStateT *gs = &IGL_WINDOW (i)->glState;
+
+        gs->valid &= ~mask;
+        if (mask & IGL_GLSTATE_CAPS)
+            gs->capsValid = 0;
+    }
+}
+
+
+void
+_igl_glEnable (GLenum cap)
+{
+    igl_glStateT *gs = _igl_glStateCache ();
+    unsigned int bit = _igl_glCap (cap);
+
+    if (gs != NULL)
+    {
+        if ((gs->capsValid & gs->caps & bit))
+        {
+            IGL_GLSTAT (glStateFiltered);
+            return;
+        }
+
+        gs->capsValid |= bit;
+        gs->caps |= bit;
+    }
+    IGL_GLSTAT (glStateIssued);
+    glEnable (cap);
+}
+
+
+void
+_igl_glDisable (GLenum cap)
+{
+    igl_glStateT *gs = _igl_glStateCache ();
+    unsigned int bit = _igl_glCap (cap);
+
+    if (gs != NULL)
+    {
+        if ((gs->capsValid & ~gs->caps & bit))
+        {
+            IGL_GLSTAT (glStateFiltered);
+            return;
+        }
+
+        gs->capsValid |= bit;
+        gs->caps &= ~bit;
+    }
+    IGL_GLSTAT (glStateIssued);
+    glDisable (cap);
+}
+
+
+/* check if a capability is enabled. OpenGL is only asked if it isn't known */
+int
+_igl_glIsEnabled (GLenum cap)
+{
+    igl_glStateT *gs = _igl_glStateCache ();
+    unsigned int bit = _igl_glCap (cap);
+
+    if (gs == NULL || bit == 0)
+        return (glIsEnabled (cap));
+    if (!(gs->capsValid & bit))
+    {
+        gs->capsValid |= bit;
+        if (glIsEnabled (cap))
+            gs->caps |= bit;
+        else
+            gs->caps &= ~bit;
+    }
+    return ((gs->caps & bit) != 0);
+}
+
+
+void
+_igl_glDepthFunc (GLenum func)
+{
+    igl_glStateT *gs = _igl_glStateCache ();
+
+    if (gs != NULL)
+    {
+        if (_igl_glFiltered (gs, IGL_GLSTATE_DEPTHFUNC, gs->depthFunc == func))
+            return;
+        gs->depthFunc = func;
+    }
+    glDepthFunc (func);
+}
+
+
+void
+_igl_glAlphaFunc (GLenum func, GLfloat ref)
+{
+    igl_glStateT *gs = _igl_glStateCache ();
+
+    if (gs != NULL)
+    {
+        if (_igl_glFiltered (gs, IGL_GLSTATE_ALPHAFUNC, gs->alphaFunc == func && gs->alphaRef == ref))
+            return;
+        gs->alphaFunc = func;
+        gs->alphaRef = ref;
+    }
+    glAlphaFunc (func, ref);
+}
+
+
+void
+_igl_glBlendFunc (GLenum sfactor, GLenum dfactor)
+{
+    igl_glStateT *gs = _igl_glStateCache ();
+
+    if (gs != NULL)
+    {
+        if (_igl_glFiltered (gs, IGL_GLSTATE_BLENDFUNC, gs->blendSrc == sfactor && gs->blendDst == dfactor))
+            return;
+        gs->blendSrc = sfactor;
+        gs->blendDst = dfactor;
+    }
+    glBlendFunc (sfactor, dfactor);
+}
+
+
+void
+_igl_glShadeModel (GLenum mode)
+{
+    igl_glStateT *gs = _igl_glStateCache ();
+
+    if (gs != NULL)
+    {
+        if (_igl_glFiltered (gs, IGL_GLSTATE_SHADEMODEL, gs->shadeModel == mode))
+            return;
+        gs->shadeModel = mode;
+    }
+    glShadeModel (mode);
+}
+
+
+void
+_igl_glClearColor (GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+{
+    igl_glStateT *gs = _igl_glStateCache ();
+
+    if (gs != NULL)
+    {
+        if (_igl_glFiltered (gs, IGL_GLSTATE_CLEARCOLOR, gs->clearColor[0] == r &&
+                    gs->clearColor[1] == g && gs->clearColor[2] == b && gs->clearColor[3] == a))
+            return;
+        gs->clearColor[0] = r, gs->clearColor[1] = g;
+        gs->clearColor[2] = b, gs->clearColor[3] = a;
+    }
+    glClearColor (r, g, b, a);
+}
+
+
+void
+_igl_glColor (const GLubyte *color)
+{
+    igl_glStateT *gs = _igl_glStateCache ();
+
+    if (gs != NULL)
+    {
+        if (_igl_glFiltered (gs, IGL_GLSTATE_COLOR, !memcmp (gs->color, color, sizeof (gs->color))))
+            return;
+        IGL_V4COPY (gs->color, color);
+    }
+    glColor4ubv (color);
+}
+
+
+void
+_igl_glColorMask (GLboolean r, GLboolean g, GLboolean b, GLboolean a)
+{
+    igl_glStateT *gs = _igl_glStateCache ();
+
+    if (gs != NULL)
+    {
+        if (_igl_glFiltered (gs, IGL_GLSTATE_COLORMASK, gs->colorMask[0] == r &&
+                    gs->colorMask[1] == g && gs->colorMask[2] == b && gs->colorMask[3] == a))
+            return;
+        gs->colorMask[0] = r, gs->colorMask[1] = g;
+        gs->colorMask[2] = b, gs->colorMask[3] = a;
+    }
+    glColorMask (r, g, b, a);
+}
+
+
+/* get the color writemask. OpenGL is only asked if it isn't known */
+void
+_igl_glGetColorMask (GLboolean *mask)
+{
+    igl_glStateT *gs = _igl_glStateCache ();
+
+    if (gs == NULL)
+    {
+        glGetBooleanv (GL_COLOR_WRITEMASK, mask);
+        return;
+    }
+    if (!(gs->valid & IGL_GLSTATE_COLORMASK))
+    {
+        glGetBooleanv (GL_COLOR_WRITEMASK, gs->colorMask);
+        gs->valid |= IGL_GLSTATE_COLORMASK;
+    }
+    IGL_V4COPY (mask, gs->colorMask);
+}
+
+
+void
+_igl_glBindTexture (GLenum target, GLuint texture)
+{
+    igl_glStateT *gs = _igl_glStateCache ();
+    int t = (target == GL_TEXTURE_3D);
+
+    if (gs != NULL)
+    {
+        /* the entry covers both targets, mark them unknown if it isn't valid */
+        if (!(gs->valid & IGL_GLSTATE_TEXTURE))
+            gs->texture[0] = gs->texture[1] = (GLuint)-1;
+        if (_igl_glFiltered (gs, IGL_GLSTATE_TEXTURE, gs->texture[t] == texture))
+            return;
+        gs->texture[t] = texture;
+    }
+    glBindTexture (target, texture);
+}
+
+
+/* check if lmbind must send a material or lighting model. returns 0 if not */
+int
+_igl_glBindLm (short target, short index)
+{
+    igl_glStateT *gs = _igl_glStateCache ();
+
+    if (gs == NULL)
+        return (1);
+
+    /* with lmcolor the current color changes the material, and in colormap
+     * mode the material colors depend on the colormap
+     */
+    if (IGL_CTX ()->lmcMode != 0 || !(IGL_CTX ()->flags & IGL_WFLAGS_RGBA))
+        gs->valid &= ~(IGL_GLSTATE_MATERIAL|IGL_GLSTATE_BACKMATERIAL);
+
+    switch (target)
+    {
+        case MATERIAL:
+            if (_igl_glFiltered (gs, IGL_GLSTATE_MATERIAL, gs->materialIndex == index))
+                return (0);
+            gs->materialIndex = index;
+        break;
+
+        case BACKMATERIAL:
+            if (_igl_glFiltered (gs, IGL_GLSTATE_BACKMATERIAL, gs->backMaterialIndex == index))
+                return (0);
+            gs->backMaterialIndex = index;
+        break;
+
+        case LMODEL:
+            if (_igl_glFiltered (gs, IGL_GLSTATE_LMODEL, gs->lmodelIndex == index))
+                return (0);
+            gs->lmodelIndex = index;
+        break;
+
+        default:
+            IGL_GLSTAT (glStateIssued);
+        break;
+    }
+
+    return (1);
+}
+
+
 #if 0
 ____________________________ misc IrisGL stuph ____________________________
 #endif
@@ -691,7 +1282,7 @@ glcompat (long mode, long value)
 
     _igl_trace (__func__,TRUE,"%ld,%ld",mode,value);
     IGL_CHECKINIT ();
-    wptr = (igl->currentWindow >= 0 ? IGL_CTX() : IGL_WINDOW(0));
+    wptr = (iglThread.currentWindow >= 0 ? IGL_CTX() : IGL_WINDOW(0));
 
     switch (mode)
     {
@@ -719,6 +1310,16 @@ glcompat (long mode, long value)
             igl->glcSOFTATTACH = (value != 0);
             break;
 
+        /* IGL: min pixel count for multithreaded pixel transfers, 0 is off */
+        case GLC_PIXTHRESHOLD:
+            igl->pixThreshold = value;
+            break;
+
+        /* IGL: number of entries in the device queue, rounded up to 2^n */
+        case GLC_QUEUESIZE:
+            _igl_initQueue (value);
+            break;
+
         /* the VSYNC stuff is needed for perfly, cimpact et al */
         case GLC_SET_VSYNC:
             wptr->swapCounter = value;
@@ -988,7 +1589,9 @@ void
 swapbuffers (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->swapbuffers ();
+    iglThread.api->swapbuffers ();
+    if (iglThread.pipe)
+        _igl_pipeFlush ();
 }
 
 void
@@ -1001,6 +1604,11 @@ iglExec_swapbuffers(void)
 
     if ((wptr->flags & IGL_WFLAGS_DOUBLEBUFFER) && wptr->drawMode == NORMALDRAW)
     {
+#ifdef HEADLESS
+        if (IGL_HEADLESS)
+            _igl_headlessSwap (wptr);
+        else
+#endif
 #if PLATFORM_X11
         glXSwapBuffers (igl->appInstance, wptr->wnd);
 #endif
@@ -1018,7 +1626,9 @@ void
 mswapbuffers (long fbuf)
 {
     _igl_trace (__func__,FALSE,"%ld",fbuf);
-    igl->api->mswapbuffers (fbuf);
+    iglThread.api->mswapbuffers (fbuf);
+    if (iglThread.pipe)
+        _igl_pipeFlush ();
 }
 
 void
@@ -1029,6 +1639,18 @@ iglExec_mswapbuffers (long fbuf)
     IGL_CHECKWNDV ();
     wptr = IGL_CTX ();
 
+#ifdef HEADLESS
+    /* layers are always emulated in the NORMALDRAW framebuffer */
+    if (IGL_HEADLESS)
+    {
+        if (fbuf & NORMALDRAW)
+        {
+            _igl_headlessSwap (wptr);
+            _igl_swapTimer (wptr);
+        }
+        return;
+    }
+#endif
 #if PLATFORM_X11
     if (fbuf & UNDERDRAW)
         glXSwapBuffers (igl->appInstance, wptr->layers[IGL_WLAYER_UNDERDRAW].hwnd);
@@ -1049,7 +1671,7 @@ void
 pushattributes (void)
 {
     _igl_trace(__func__,FALSE,"");
-    igl->api->pushattributes ();
+    iglThread.api->pushattributes ();
 }
 
 void
@@ -1058,6 +1680,7 @@ iglExec_pushattributes (void)
     IGL_CHECKWNDV ();
 
     glPushAttrib (GL_ALL_ATTRIB_BITS);
+    _igl_pushViewport ();
 }
 
 
@@ -1066,7 +1689,7 @@ void
 popattributes (void)
 {
     _igl_trace(__func__,FALSE,"");
-    igl->api->popattributes ();
+    iglThread.api->popattributes ();
 }
 
 void
@@ -1075,6 +1698,8 @@ iglExec_popattributes (void)
     IGL_CHECKWNDV ();
 
     glPopAttrib ();
+    _igl_popViewport ();
+    _igl_glInvalidate (IGL_GLSTATE_ALL);
 }
 
 
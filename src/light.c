@@ -437,12 +437,12 @@ _igl_checkLighting (igl_windowT *wptr)
     /* if both MATERIAL and LMODEL indexes are non-zero, we are enlightened */
     if (wptr->materialIndex != 0 && wptr->lmodelIndex != 0)
     {
-        glEnable (GL_LIGHTING);
+        _igl_glEnable (GL_LIGHTING);
         wptr->state |= IGL_WSTATE_LIGHTING | IGL_VSTATE_LIGHTED;
     }
     else
     {
-        glDisable (GL_LIGHTING);
+        _igl_glDisable (GL_LIGHTING);
         wptr->state &= ~(IGL_WSTATE_LIGHTING | IGL_VSTATE_LIGHTED);
         wptr->state &= ~(IGL_VSTATE_N3F|IGL_VSTATE_N3FBGN);
     }
@@ -457,19 +457,26 @@ void
 lmdef (short deftype, short index, short np, float *props)
 {
     igl_windowT *wptr;
-    int idx;
+    int idx, i;
 
     _igl_trace (__func__,TRUE,"%d,%d,%d,%p",deftype,index,np,props);
     IGL_CHECKWNDV ();
     wptr = IGL_CTX ();
 
+    /* a definition bound in other contexts must be sent again on lmbind */
+    for (i = 0; i < IGL_MAXWINDOWS; i++)
+        IGL_WINDOW (i)->glState.valid &=
+            ~(IGL_GLSTATE_MATERIAL|IGL_GLSTATE_BACKMATERIAL|IGL_GLSTATE_LMODEL);
+
     /* NOTE: if we're changing a currently bound definition, changes take effect immediately (lmbind!) */
+    /* lmbind in other threads mustn't see a half written definition */
+    IGL_LOCK (IGL_LOCK_DEFS);
     switch (deftype)
     {
         case DEFMATERIAL:
             idx = IGL_MAPID(igl->materialDefs, IGL_MAXLMDEFS, index, 3);
             if (idx < 0)
-                return;
+                break;
 
             _igl_parseLmMaterial (idx, np, props);
             if (wptr->materialIndex == idx)
@@ -481,7 +488,7 @@ lmdef (short deftype, short index, short np, float *props)
         case DEFLIGHT:
             idx = IGL_MAPID(igl->lightDefs, IGL_MAXLMDEFS, index, 3);
             if (idx < 0)
-                return;
+                break;
 
             _igl_parseLmLight (idx, np, props);
             if (igl->lightDefs[idx].lightTarget > 0)
@@ -491,13 +498,14 @@ lmdef (short deftype, short index, short np, float *props)
         case DEFLMODEL:
             idx = IGL_MAPID(igl->lmodelDefs, IGL_MAXLMDEFS, index, 3);
             if (idx < 0)
-                return;
+                break;
 
             _igl_parseLmLightModel (idx, np, props);
             if (wptr->lmodelIndex == idx)
                 _igl_setLmLightModel (LMODEL, idx);
         break;
     }
+    IGL_UNLOCK (IGL_LOCK_DEFS);
 
     _igl_checkLighting (wptr);
 }
@@ -508,7 +516,7 @@ void
 lmbind (short target, short index)
 {
     _igl_trace (__func__,FALSE,"%d,%d",target,index);
-    igl->api->lmbind (target, index);
+    iglThread.api->lmbind (target, index);
 }
 
 void
@@ -520,22 +528,25 @@ iglExec_lmbind (short target, short index)
     IGL_CHECKWNDV ();
     wptr = IGL_CTX ();
 
+    IGL_LOCK (IGL_LOCK_DEFS);
     switch (target)
     {
         case MATERIAL:
             idx = IGL_MAPID(igl->materialDefs, IGL_MAXLMDEFS, index, 0);
             if (idx < 0)
-                return;
+                break;
 
-            _igl_setLmMaterial (target, idx);
+            if (_igl_glBindLm (target, idx))
+                _igl_setLmMaterial (target, idx);
             wptr->materialIndex = idx;
         break;
         case BACKMATERIAL:
             idx = IGL_MAPID(igl->materialDefs, IGL_MAXLMDEFS, index, 0);
             if (idx < 0)
-                return;
+                break;
 
-            _igl_setLmMaterial (target, idx);
+            if (_igl_glBindLm (target, idx))
+                _igl_setLmMaterial (target, idx);
             wptr->backMaterialIndex = idx;
         break;
 
@@ -549,7 +560,7 @@ iglExec_lmbind (short target, short index)
         case LIGHT7:
             idx = IGL_MAPID(igl->lightDefs, IGL_MAXLMDEFS, index, 0);
             if (idx < 0)
-                return;
+                break;
 
             igl->lightDefs[wptr->lightIndex[target - LIGHT0]].lightTarget = 0;
             _igl_setLmLight (target, idx);
@@ -560,12 +571,14 @@ iglExec_lmbind (short target, short index)
         case LMODEL:
             idx = IGL_MAPID(igl->lmodelDefs, IGL_MAXLMDEFS, index, 0);
             if (idx < 0)
-                return;
+                break;
 
-            _igl_setLmLightModel (target, idx);
+            if (_igl_glBindLm (target, idx))
+                _igl_setLmLightModel (target, idx);
             wptr->lmodelIndex = idx;
         break;
     }
+    IGL_UNLOCK (IGL_LOCK_DEFS);
 
     _igl_checkLighting (wptr);
 }
@@ -576,7 +589,7 @@ void
 lmcolor (long mode)
 {
     _igl_trace (__func__,FALSE,"%ld",mode);
-    igl->api->lmcolor (mode);
+    iglThread.api->lmcolor (mode);
 }
 
 void
@@ -593,6 +606,8 @@ iglExec_lmcolor (long mode)
 
     /* lmcolor() doesn't change properties to BACKMATERIAL */
     wptr->state &= ~IGL_WSTATE_LMCNULL;
+    /* materials may have been changed by the color */
+    _igl_glInvalidate (IGL_GLSTATE_MATERIAL);
     switch (mode)
     {
         case LMC_NULL:
@@ -603,7 +618,7 @@ iglExec_lmcolor (long mode)
             wptr->state |= IGL_WSTATE_LMCNULL;
 
         case LMC_COLOR:
-            glDisable (GL_COLOR_MATERIAL);
+            _igl_glDisable (GL_COLOR_MATERIAL);
             wptr->lmcMode = 0;
             return;
         break;
@@ -630,7 +645,7 @@ iglExec_lmcolor (long mode)
     }    
 
     wptr->lmcMode = mode;
-    glEnable (GL_COLOR_MATERIAL);
+    _igl_glEnable (GL_COLOR_MATERIAL);
 }
 
 
@@ -639,7 +654,7 @@ void
 fogvertex (long mode, float *params)
 {
     _igl_trace (__func__,FALSE,"%ld,%p",mode,params);
-    igl->api->fogvertex (mode, params);
+    iglThread.api->fogvertex (mode, params);
 }
 
 void
@@ -715,7 +730,7 @@ void
 depthcue (Boolean enable)
 {
     _igl_trace (__func__,FALSE,"%d",enable);
-    igl->api->depthcue (enable);
+    iglThread.api->depthcue (enable);
 }
 
 void
@@ -754,7 +769,7 @@ void
 lshaderange (Colorindex lowin, Colorindex highin, long znear, long zfar)
 {
     _igl_trace (__func__,FALSE,"%d,%d,%ld,%ld",lowin,highin,znear,zfar);
-    igl->api->lshaderange (lowin, highin, znear, zfar);
+    iglThread.api->lshaderange (lowin, highin, znear, zfar);
 }
 
 void
@@ -774,7 +789,6 @@ iglExec_lshaderange (Colorindex lowin, Colorindex highin, long znear, long zfar)
      * uses screen z. Unproject z values using identity as modelview matrix.
      * NOTE: not working in MSINGLE, since there's no accessible eye space :-/
      */
-    _igl_getViewport ();
     _igl_getMatrices ();
     x = (double)wptr->viewport[0] + wptr->viewport[2] / 2;
     y = (double)wptr->viewport[1] + wptr->viewport[3] / 2;
@@ -815,7 +829,7 @@ void
 shaderange (Colorindex lowin, Colorindex highin, Screencoord z1, Screencoord z2)
 {
     _igl_trace (__func__,FALSE,"%d,%d,%d,%d",lowin,highin,z1,z2);
-    igl->api->lshaderange (lowin, highin, (long)z1, (long)z2);
+    iglThread.api->lshaderange (lowin, highin, (long)z1, (long)z2);
 }
 
 
@@ -824,7 +838,7 @@ void
 lRGBrange (short rmin, short gmin, short bmin, short rmax, short gmax, short bmax, long znear, long zfar)
 {
     _igl_trace (__func__,FALSE,"%d,%d,%d,%d,%d,%d,%ld,%ld",rmin,bmin,gmin,rmax,gmax,bmax,znear,zfar);
-    igl->api->lRGBrange (rmin, gmin, bmin, rmax, gmax, bmax, znear, zfar);
+    iglThread.api->lRGBrange (rmin, gmin, bmin, rmax, gmax, bmax, znear, zfar);
 }
 
 void
@@ -844,7 +858,6 @@ iglExec_lRGBrange (short rmin, short gmin, short bmin, short rmax, short gmax, s
      * uses screen z. Unproject z values using identity as modelview matrix.
      * NOTE: not working in MSINGLE, since there's no accessible eye space :-/
      */
-    _igl_getViewport ();
     _igl_getMatrices ();
     x = (double)wptr->viewport[0] + wptr->viewport[2] / 2;
     y = (double)wptr->viewport[1] + wptr->viewport[3] / 2;
@@ -884,7 +897,7 @@ void
 RGBrange (short rmin, short bmin, short gmin, short rmax, short gmax, short bmax, Screencoord znear, Screencoord zfar)
 {
     _igl_trace (__func__,FALSE,"%d,%d,%d,%d,%d,%d,%d,%d",rmin,bmin,gmin,rmax,gmax,bmax,znear,zfar);
-    igl->api->lRGBrange (rmin, gmin, bmin, rmax, gmax, bmax, znear, zfar);
+    iglThread.api->lRGBrange (rmin, gmin, bmin, rmax, gmax, bmax, znear, zfar);
 }
 
 
@@ -893,7 +906,7 @@ void
 shademodel (int mode)
 {
     _igl_trace (__func__,FALSE,"%d",mode);
-    igl->api->shademodel (mode);
+    iglThread.api->shademodel (mode);
 }
 
 void
@@ -901,7 +914,7 @@ iglExec_shademodel (int mode)
 {
     IGL_CHECKWNDV ();
 
-    glShadeModel (mode == FLAT ? GL_FLAT : GL_SMOOTH);
+    _igl_glShadeModel (mode == FLAT ? GL_FLAT : GL_SMOOTH);
 }
 
 
@@ -36,8 +36,192 @@
  * to achieve this is to replicate all matrix operations on all layers.
  */
 
+/* NOTE: reading back matrices or the viewport from OpenGL stalls the pipeline.
+ * Hence all matrix stacks and the viewport are shadowed in the window, and
+ * every query is answered from there. All changes must go through the
+ * functions below to keep the shadow in sync with OpenGL.
+ * If IGL_WSTATE_SHADOWMATRIX is set, only the shadow is updated. This is used
+ * after calling display lists containing matrix operations.
+ */
+
+static const GLfloat _igl_identity[16] = {
+    1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1
+};
+
+#define IGL_MATRIXTOP(w,i)      ((w)->matrixStacks[i].matrix[(w)->matrixStacks[i].depth])
+
+
+/* matrix stack used by the current matrix mode */
+static int
+_igl_matrixIndex (igl_windowT *wptr)
+{
+    switch (wptr->matrixMode)
+    {
+        case MVIEWING:
+            return (IGL_MATRIX_MODELVIEW);
+
+        case MTEXTURE:
+            return (IGL_MATRIX_TEXTURE);
+
+        default:
+            return (IGL_MATRIX_PROJECTION);
+    }
+}
+
+
+/* m = a * b (column major like OpenGL). m may be the same as a or b */
+static void
+_igl_multMatrices (GLfloat *m, const GLfloat *a, const GLfloat *b)
+{
+    GLfloat t[16];
+    int i, j;
+
+    /* NOTE: the inner loop computes a column of 4 floats, gcc vectorizes this */
+    for (j = 0; j < 16; j += 4)
+        for (i = 0; i < 4; i++)
+            t[j+i] = a[i]*b[j] + a[4+i]*b[j+1] + a[8+i]*b[j+2] + a[12+i]*b[j+3];
+    memcpy (m, t, sizeof (t));
+}
+
+
+/* replace the top of a matrix stack */
+static void
+_igl_loadMatrix (int idx, const GLfloat *m)
+{
+    igl_windowT *wptr = IGL_CTX ();
+
+    memcpy (IGL_MATRIXTOP (wptr, idx), m, sizeof (GLfloat[16]));
+    if (! (wptr->flags & IGL_WSTATE_SHADOWMATRIX))
+        glLoadMatrixf (m);
+}
+
+
+/* multiply the top of a matrix stack */
+static void
+_igl_multMatrix (int idx, const GLfloat *m)
+{
+    igl_windowT *wptr = IGL_CTX ();
+
+    _igl_multMatrices (IGL_MATRIXTOP (wptr, idx), IGL_MATRIXTOP (wptr, idx), m);
+    if (! (wptr->flags & IGL_WSTATE_SHADOWMATRIX))
+        glMultMatrixf (m);
+}
+
+
+/* push a matrix stack. Like OpenGL, overflows are ignored */
+static void
+_igl_pushMatrix (int idx)
+{
+    igl_windowT *wptr = IGL_CTX ();
+    igl_matrixStackT *stack = &wptr->matrixStacks[idx];
+
+    if (stack->depth+1 >= stack->maxDepth)
+        return;
+    memcpy (stack->matrix[stack->depth+1], stack->matrix[stack->depth], sizeof (GLfloat[16]));
+    stack->depth ++;
+    if (! (wptr->flags & IGL_WSTATE_SHADOWMATRIX))
+        glPushMatrix ();
+}
+
+
+/* pop a matrix stack. Like OpenGL, underflows are ignored */
+static void
+_igl_popMatrix (int idx)
+{
+    igl_windowT *wptr = IGL_CTX ();
+    igl_matrixStackT *stack = &wptr->matrixStacks[idx];
+
+    if (stack->depth == 0)
+        return;
+    stack->depth --;
+    if (! (wptr->flags & IGL_WSTATE_SHADOWMATRIX))
+        glPopMatrix ();
+}
+
+
+/* rotate about one of the coordinate axes */
+static void
+_igl_rotate (int idx, float degrees, char axis)
+{
+    GLfloat m[16];
+    float s = sinf (degrees * (float)M_PI / 180), c = cosf (degrees * (float)M_PI / 180);
+
+    memcpy (m, _igl_identity, sizeof (m));
+    if (axis == 'x' || axis == 'X')
+    {
+        m[5] = c; m[6] = s;
+        m[9] = -s; m[10] = c;
+    }
+    else if (axis == 'y' || axis == 'Y')
+    {
+        m[0] = c; m[2] = -s;
+        m[8] = s; m[10] = c;
+    }
+    else if (axis == 'z' || axis == 'Z')
+    {
+        m[0] = c; m[1] = s;
+        m[4] = -s; m[5] = c;
+    }
+    else
+        return;
+    _igl_multMatrix (idx, m);
+}
+
+
+/* translate by x,y,z */
+static void
+_igl_translate (int idx, float x, float y, float z)
+{
+    GLfloat m[16];
+
+    memcpy (m, _igl_identity, sizeof (m));
+    m[12] = x; m[13] = y; m[14] = z;
+    _igl_multMatrix (idx, m);
+}
+
+
+/* orthographic projection like glOrtho */
+static void
+_igl_ortho (int idx, float l, float r, float b, float t, float n, float f)
+{
+    GLfloat m[16];
+
+    if (l == r || b == t || n == f)
+        return;
+
+    memcpy (m, _igl_identity, sizeof (m));
+    m[0] = 2 / (r-l);
+    m[5] = 2 / (t-b);
+    m[10] = -2 / (f-n);
+    m[12] = -(r+l) / (r-l);
+    m[13] = -(t+b) / (t-b);
+    m[14] = -(f+n) / (f-n);
+    _igl_multMatrix (idx, m);
+}
+
+
+/* perspective projection like glFrustum */
+static void
+_igl_frustum (int idx, float l, float r, float b, float t, float n, float f)
+{
+    GLfloat m[16];
+
+    if (n <= 0 || f <= 0 || l == r || b == t || n == f)
+        return;
+
+    memset (m, 0, sizeof (m));
+    m[0] = 2*n / (r-l);
+    m[5] = 2*n / (t-b);
+    m[8] = (r+l) / (r-l);
+    m[9] = (t+b) / (t-b);
+    m[10] = -(f+n) / (f-n);
+    m[11] = -1;
+    m[14] = -2*f*n / (f-n);
+    _igl_multMatrix (idx, m);
+}
+
 
-/* set matrix mode */
+/* set the matrix mode */
 static void
 _igl_setmmode (void)
 {
@@ -59,17 +243,94 @@ _igl_setmmode (void)
 }
 
 
+/* initialize the shadow state for a new OpenGL context. The window needn't
+ * be the current window yet.
+ */
+void
+_igl_initTransform (igl_windowT *wptr)
+{
+    static const GLenum depths[IGL_MATRIX_MAX] = {
+        GL_MAX_MODELVIEW_STACK_DEPTH, GL_MAX_PROJECTION_STACK_DEPTH, GL_MAX_TEXTURE_STACK_DEPTH
+    };
+    GLfloat *proj;
+    GLint depth;
+    int i;
+
+    for (i = 0; i < IGL_MATRIX_MAX; i++)
+    {
+        glGetIntegerv (depths[i], &depth);
+        wptr->matrixStacks[i].maxDepth = (depth < IGL_MAXMATRIXDEPTH ? depth : IGL_MAXMATRIXDEPTH);
+        wptr->matrixStacks[i].depth = 0;
+        memcpy (wptr->matrixStacks[i].matrix[0], _igl_identity, sizeof (_igl_identity));
+    }
+
+    /* OpenGL sets viewport and scissor box to the window size */
+    wptr->viewport[0] = wptr->scrmask[0] = 0;
+    wptr->viewport[1] = wptr->scrmask[1] = 0;
+    wptr->viewport[2] = wptr->scrmask[2] = wptr->width;
+    wptr->viewport[3] = wptr->scrmask[3] = wptr->height;
+    wptr->viewportDepth = 0;
+
+    /* MSINGLE with a 2D orthographic projection, like _igl_ortho2D */
+    proj = wptr->matrixStacks[IGL_MATRIX_PROJECTION].matrix[0];
+    proj[0] = 2.0f / wptr->width;
+    proj[5] = 2.0f / wptr->height;
+    proj[10] = -1;
+    proj[12] = -(wptr->width - 1.0f) / wptr->width;
+    proj[13] = -(wptr->height - 1.0f) / wptr->height;
+    glMatrixMode (GL_PROJECTION);
+    glLoadMatrixf (proj);
+}
+
+
+/* push the viewport shadow. Needed with glPushAttrib (GL_VIEWPORT_BIT) */
+void
+_igl_pushViewport (void)
+{
+    igl_windowT *wptr = IGL_CTX ();
+    igl_viewportT *vp;
+
+    if (wptr->viewportDepth < IGL_MAXVIEWPORTDEPTH)
+    {
+        vp = &wptr->viewportStack[wptr->viewportDepth];
+        memcpy (vp->viewport, wptr->viewport, sizeof (vp->viewport));
+        memcpy (vp->scrmask, wptr->scrmask, sizeof (vp->scrmask));
+    }
+    wptr->viewportDepth ++;
+}
+
+
+/* pop the viewport shadow. Needed with glPopAttrib */
+void
+_igl_popViewport (void)
+{
+    igl_windowT *wptr = IGL_CTX ();
+    igl_viewportT *vp;
+
+    if (wptr->viewportDepth == 0)
+        return;
+    wptr->viewportDepth --;
+    if (wptr->viewportDepth < IGL_MAXVIEWPORTDEPTH)
+    {
+        vp = &wptr->viewportStack[wptr->viewportDepth];
+        memcpy (wptr->viewport, vp->viewport, sizeof (vp->viewport));
+        memcpy (wptr->scrmask, vp->scrmask, sizeof (vp->scrmask));
+    }
+}
+
+
 /* push transformations onto their respective stacks */
 void
 _igl_pushTransform (void)
 {
     glPushAttrib (GL_VIEWPORT_BIT | GL_SCISSOR_BIT);
+    _igl_pushViewport ();
     glMatrixMode (GL_MODELVIEW);
-    glPushMatrix ();
+    _igl_pushMatrix (IGL_MATRIX_MODELVIEW);
     glMatrixMode (GL_PROJECTION);
-    glPushMatrix ();
+    _igl_pushMatrix (IGL_MATRIX_PROJECTION);
     glMatrixMode (GL_TEXTURE);
-    glPushMatrix ();
+    _igl_pushMatrix (IGL_MATRIX_TEXTURE);
 }
 
 
@@ -78,41 +339,40 @@ void
 _igl_popTransform (void)
 {
     glMatrixMode (GL_TEXTURE);
-    glPopMatrix ();
+    _igl_popMatrix (IGL_MATRIX_TEXTURE);
     glMatrixMode (GL_PROJECTION);
-    glPopMatrix ();
+    _igl_popMatrix (IGL_MATRIX_PROJECTION);
     glMatrixMode (GL_MODELVIEW);
-    glPopMatrix ();
+    _igl_popMatrix (IGL_MATRIX_MODELVIEW);
     glPopAttrib ();
+    _igl_popViewport ();
     _igl_setmmode ();
 }
 
 
-/* get the current OpenGL viewport */
-void
-_igl_getViewport (void)
+/* get the matrix of the current matrix mode */
+GLfloat *
+_igl_currentMatrix (void)
 {
     igl_windowT *wptr = IGL_CTX ();
 
-    if (! (wptr->flags & IGL_WSTATE_CURVIEWPORT))
-    {
-        glGetIntegerv (GL_VIEWPORT, wptr->viewport);
-        wptr->flags |= IGL_WSTATE_CURVIEWPORT;
-    }
+    return (IGL_MATRIXTOP (wptr, _igl_matrixIndex (wptr)));
 }
 
 
-/* get the current OpenGL vertex matrices */
+/* get the current vertex matrices for the glu functions */
 void
 _igl_getMatrices (void)
 {
     igl_windowT *wptr = IGL_CTX ();
+    GLfloat *model = IGL_MATRIXTOP (wptr, IGL_MATRIX_MODELVIEW);
+    GLfloat *proj = IGL_MATRIXTOP (wptr, IGL_MATRIX_PROJECTION);
+    int i;
 
-    if (! (wptr->flags & IGL_WSTATE_CURMATRICES))
+    for (i = 0; i < 16; i++)
     {
-        glGetDoublev (GL_MODELVIEW_MATRIX, wptr->modelMatrix);
-        glGetDoublev (GL_PROJECTION_MATRIX, wptr->projMatrix);
-        wptr->flags |= IGL_WSTATE_CURMATRICES;
+        wptr->modelMatrix[i] = model[i];
+        wptr->projMatrix[i] = proj[i];
     }
 }
 
@@ -122,9 +382,9 @@ static void
 _igl_loadProjBase (void)
 {
     if (! (IGL_CTX ()->state & IGL_WSTATE_PICKING))
-        glLoadIdentity ();
+        _igl_loadMatrix (IGL_MATRIX_PROJECTION, _igl_identity);
     else
-        glLoadMatrixf (IGL_CTX ()->pickMatrix);
+        _igl_loadMatrix (IGL_MATRIX_PROJECTION, IGL_CTX ()->pickMatrix);
 }
 
 
@@ -133,39 +393,35 @@ void
 mmode (short mode)
 {
     _igl_trace (__func__,FALSE,"%d",mode);
-    igl->api->mmode (mode);
+    iglThread.api->mmode (mode);
 }
 
 void
 iglExec_mmode (short mode)
 {
+    static const GLenum modes[IGL_MATRIX_MAX] = { GL_MODELVIEW, GL_PROJECTION, GL_TEXTURE };
+    igl_windowT *wptr;
+    int i;
+
     IGL_CHECKWNDV ();
+    wptr = IGL_CTX ();
 
     if (mode != MSINGLE && mode != MVIEWING && mode != MPROJECTION && mode != MTEXTURE)
         return;
 
     /* when entering/leaving MSINGLE, all matrix stacks are reset */
-    if ((IGL_CTX ()->matrixMode == MSINGLE) != (mode == MSINGLE))
+    if ((wptr->matrixMode == MSINGLE) != (mode == MSINGLE))
     {
-        glMatrixMode (GL_MODELVIEW);
-        while (glGetError () == GL_NO_ERROR)
-            glPopMatrix ();
-        glLoadIdentity ();
-
-        glMatrixMode (GL_PROJECTION);
-        while (glGetError () == GL_NO_ERROR)
-            glPopMatrix ();
-        glLoadIdentity ();
-
-        glMatrixMode (GL_TEXTURE);
-        while (glGetError () == GL_NO_ERROR)
-            glPopMatrix ();
-        glLoadIdentity ();
-
-        IGL_CTX ()->flags &= ~IGL_WSTATE_CURMATRICES;
+        for (i = 0; i < IGL_MATRIX_MAX; i++)
+        {
+            glMatrixMode (modes[i]);
+            while (wptr->matrixStacks[i].depth > 0)
+                _igl_popMatrix (i);
+            _igl_loadMatrix (i, _igl_identity);
+        }
     }
 
-    IGL_CTX ()->matrixMode = mode;
+    wptr->matrixMode = mode;
     _igl_setmmode ();
 }
 
@@ -190,7 +446,7 @@ void
 loadmatrix (Matrix m)
 {
     _igl_trace (__func__,FALSE,IGL_MATFMT(g),IGL_MATPAR(m));
-    igl->api->loadmatrix (m);
+    iglThread.api->loadmatrix (m);
 }
 
 void
@@ -201,11 +457,10 @@ iglExec_loadmatrix (Matrix m)
     if (IGL_CTX ()->matrixMode == MSINGLE || IGL_CTX ()->matrixMode == MPROJECTION)
     {
         _igl_loadProjBase ();
-        glMultMatrixf ((GLfloat *)m);
+        _igl_multMatrix (IGL_MATRIX_PROJECTION, (GLfloat *)m);
     }
     else
-        glLoadMatrixf ((GLfloat *)m);
-    IGL_CTX ()->flags &= ~IGL_WSTATE_CURMATRICES;
+        _igl_loadMatrix (_igl_matrixIndex (IGL_CTX ()), (GLfloat *)m);
 }
 
 
@@ -215,21 +470,7 @@ getmatrix (Matrix m)
 {
     IGL_CHECKWNDV ();
 
-    switch (IGL_CTX ()->matrixMode)
-    {
-        case MVIEWING:
-            glGetFloatv (GL_MODELVIEW_MATRIX, (GLfloat *)m);
-            break;
-
-        case MSINGLE:
-        case MPROJECTION:
-            glGetFloatv (GL_PROJECTION_MATRIX, (GLfloat *)m);
-            break;
-
-        case MTEXTURE:
-            glGetFloatv (GL_TEXTURE_MATRIX, (GLfloat *)m);
-            break;
-    }
+    memcpy (m, _igl_currentMatrix (), sizeof (GLfloat[16]));
 
     _igl_trace (__func__,TRUE,IGL_MATFMT(g),IGL_MATPAR(m));
 }
@@ -240,7 +481,7 @@ void
 multmatrix (Matrix m)
 {
     _igl_trace (__func__,FALSE,IGL_MATFMT(g),IGL_MATPAR(m));
-    igl->api->multmatrix (m);
+    iglThread.api->multmatrix (m);
 }
 
 void
@@ -248,8 +489,7 @@ iglExec_multmatrix (Matrix m)
 {
     IGL_CHECKWNDV ();
 
-    glMultMatrixf ((GLfloat *)m);
-    IGL_CTX ()->flags &= ~IGL_WSTATE_CURMATRICES;
+    _igl_multMatrix (_igl_matrixIndex (IGL_CTX ()), (GLfloat *)m);
 }
 
 
@@ -258,7 +498,7 @@ void
 pushmatrix (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->pushmatrix ();
+    iglThread.api->pushmatrix ();
 }
 
 void
@@ -267,7 +507,7 @@ iglExec_pushmatrix (void)
     IGL_CHECKWNDV ();
 
     /* TBD: man page says: "should not be called when mmode is MPROJECTION or MTEXTURE" */
-    glPushMatrix ();
+    _igl_pushMatrix (_igl_matrixIndex (IGL_CTX ()));
 }
 
 
@@ -276,7 +516,7 @@ void
 popmatrix (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->popmatrix ();
+    iglThread.api->popmatrix ();
 }
 
 void
@@ -285,8 +525,7 @@ iglExec_popmatrix (void)
     IGL_CHECKWNDV ();
 
     /* TBD: man page says: "should not be called when mmode is MPROJECTION or MTEXTURE" */
-    glPopMatrix ();
-    IGL_CTX ()->flags &= ~IGL_WSTATE_CURMATRICES;
+    _igl_popMatrix (_igl_matrixIndex (IGL_CTX ()));
 }
 
 
@@ -295,7 +534,7 @@ void
 rot (float amount, char angle)
 {
     _igl_trace (__func__,FALSE,"%g,'%c'",amount,angle);
-    igl->api->rot (amount, angle);
+    iglThread.api->rot (amount, angle);
 }
 
 void
@@ -303,13 +542,7 @@ iglExec_rot (float amount, char angle)
 {
     IGL_CHECKWNDV ();
 
-    if (angle == 'x' || angle == 'X')
-        glRotatef (amount, 1, 0, 0);
-    else if (angle == 'y' || angle == 'Y')
-        glRotatef (amount, 0, 1, 0);
-    else if (angle == 'z' || angle == 'Z')
-        glRotatef (amount, 0, 0, 1);
-    IGL_CTX ()->flags &= ~IGL_WSTATE_CURMATRICES;
+    _igl_rotate (_igl_matrixIndex (IGL_CTX ()), amount, angle);
 }
 
 
@@ -318,7 +551,7 @@ void
 rotate (Angle amount, char angle)
 {
     _igl_trace (__func__,FALSE,"%d,'%c'",amount,angle);
-    igl->api->rotate (amount, angle);
+    iglThread.api->rotate (amount, angle);
 }
 
 void
@@ -327,13 +560,7 @@ iglExec_rotate (Angle amount, char angle)
     IGL_CHECKWNDV ();
 
     /* NOTE: amount is an integer specified in tenths of degrees */
-    if (angle == 'x' || angle == 'X')
-        glRotatef (amount*0.1f, 1, 0, 0);
-    else if (angle == 'y' || angle == 'Y')
-        glRotatef (amount*0.1f, 0, 1, 0);
-    else if (angle == 'z' || angle == 'Z')
-        glRotatef (amount*0.1f, 0, 0, 1);
-    IGL_CTX ()->flags &= ~IGL_WSTATE_CURMATRICES;
+    _igl_rotate (_igl_matrixIndex (IGL_CTX ()), amount*0.1f, angle);
 }
 
 
@@ -342,7 +569,7 @@ void
 translate (Coord x, Coord y, Coord z)
 {
     _igl_trace (__func__,FALSE,"%g,%g,%g",x,y,z);
-    igl->api->translate (x, y, z);
+    iglThread.api->translate (x, y, z);
 }
 
 void
@@ -350,8 +577,7 @@ iglExec_translate (Coord x, Coord y, Coord z)
 {
     IGL_CHECKWNDV ();
 
-    glTranslatef (x, y, z);
-    IGL_CTX ()->flags &= ~IGL_WSTATE_CURMATRICES;
+    _igl_translate (_igl_matrixIndex (IGL_CTX ()), x, y, z);
 }
 
 
@@ -360,16 +586,19 @@ void
 scale (float x, float y, float z)
 {
     _igl_trace (__func__,FALSE,"%g,%g,%g",x,y,z);
-    igl->api->scale (x, y, z);
+    iglThread.api->scale (x, y, z);
 }
 
 void
 iglExec_scale (float x, float y, float z)
 {
+    GLfloat m[16];
+
     IGL_CHECKWNDV ();
 
-    glScalef (x, y, z);
-    IGL_CTX ()->flags &= ~IGL_WSTATE_CURMATRICES;
+    memcpy (m, _igl_identity, sizeof (m));
+    m[0] = x; m[5] = y; m[10] = z;
+    _igl_multMatrix (_igl_matrixIndex (IGL_CTX ()), m);
 }
 
 
@@ -378,19 +607,21 @@ void
 polarview (Coord dist, Angle azim, Angle inc, Angle twist)
 {
     _igl_trace (__func__,FALSE,"%g,%d,%d,%d",dist,azim,inc,twist);
-    igl->api->polarview (dist, azim, inc, twist);
+    iglThread.api->polarview (dist, azim, inc, twist);
 }
 
 void
 iglExec_polarview (Coord dist, Angle azim, Angle inc, Angle twist)
 {
+    int idx;
+
     IGL_CHECKWNDV ();
+    idx = _igl_matrixIndex (IGL_CTX ());
 
-    glTranslatef (0, 0, -dist);
-    glRotatef (-twist*0.1f, 0, 0, 1);
-    glRotatef (-inc*0.1f, 1, 0, 0);
-    glRotatef (-azim*0.1f, 0, 0, 1);
-    IGL_CTX ()->flags &= ~IGL_WSTATE_CURMATRICES;
+    _igl_translate (idx, 0, 0, -dist);
+    _igl_rotate (idx, -twist*0.1f, 'z');
+    _igl_rotate (idx, -inc*0.1f, 'x');
+    _igl_rotate (idx, -azim*0.1f, 'z');
 }
 
 
@@ -399,7 +630,7 @@ void
 clipplane (long index, long mode, float *params)
 {
     _igl_trace (__func__,FALSE,"%ld,%ld,%p",index,mode,params);
-    igl->api->clipplane (index, mode, params);
+    iglThread.api->clipplane (index, mode, params);
 }
 
 void
@@ -437,26 +668,23 @@ _igl_ortho2D (int reshape)
     igl_windowT *wptr = IGL_CTX ();
 
     glMatrixMode (GL_MODELVIEW);
-    glLoadIdentity ();
+    _igl_loadMatrix (IGL_MATRIX_MODELVIEW, _igl_identity);
     glMatrixMode (GL_PROJECTION);
     _igl_loadProjBase ();
-    wptr->flags &= ~IGL_WSTATE_CURMATRICES;
 
     if (reshape) {
-        wptr->viewport[0] = 0;
-        wptr->viewport[1] = 0;
-        wptr->viewport[2] = wptr->width;
-        wptr->viewport[3] = wptr->height;
-        wptr->flags |= IGL_WSTATE_CURVIEWPORT;
+        wptr->viewport[0] = wptr->scrmask[0] = 0;
+        wptr->viewport[1] = wptr->scrmask[1] = 0;
+        wptr->viewport[2] = wptr->scrmask[2] = wptr->width;
+        wptr->viewport[3] = wptr->scrmask[3] = wptr->height;
         glViewport (0, 0, wptr->width, wptr->height);
         glScissor (0, 0, wptr->width, wptr->height);
-        gluOrtho2D (-0.5, wptr->width-0.5, -0.5, wptr->height-0.5);
+        _igl_ortho (IGL_MATRIX_PROJECTION, -0.5f, wptr->width-0.5f, -0.5f, wptr->height-0.5f, -1, 1);
     }
     else
     {
-        _igl_getViewport ();
-        gluOrtho2D (wptr->viewport[0]-0.5, wptr->viewport[0]+wptr->viewport[2]-0.5,
-                    wptr->viewport[1]-0.5, wptr->viewport[1]+wptr->viewport[3]-0.5);
+        _igl_ortho (IGL_MATRIX_PROJECTION, wptr->viewport[0]-0.5f, wptr->viewport[0]+wptr->viewport[2]-0.5f,
+                    wptr->viewport[1]-0.5f, wptr->viewport[1]+wptr->viewport[3]-0.5f, -1, 1);
     }
 }
 
@@ -466,7 +694,7 @@ void
 ortho (Coord left, Coord right, Coord bottom, Coord top, Coord near_, Coord far_)
 {
     _igl_trace (__func__,FALSE,"%g,%g,%g,%g,%g,%g",left,right,bottom,top,near_,far_);
-    igl->api->ortho (left, right, bottom, top, near_, far_);
+    iglThread.api->ortho (left, right, bottom, top, near_, far_);
 }
 
 void
@@ -481,8 +709,7 @@ iglExec_ortho (Coord left, Coord right, Coord bottom, Coord top, Coord near_, Co
     if (IGL_CTX ()->matrixMode == MSINGLE || IGL_CTX ()->matrixMode == MPROJECTION)
     {
         _igl_loadProjBase ();
-        glOrtho ((GLdouble)left, (GLdouble)right, (GLdouble)bottom, (GLdouble)top,
-            (GLdouble)near_, (GLdouble)far_);
+        _igl_ortho (IGL_MATRIX_PROJECTION, left, right, bottom, top, near_, far_);
     }
     else
     {
@@ -490,12 +717,10 @@ iglExec_ortho (Coord left, Coord right, Coord bottom, Coord top, Coord near_, Co
         glMatrixMode (GL_PROJECTION);
 
         _igl_loadProjBase ();
-        glOrtho ((GLdouble)left, (GLdouble)right, (GLdouble)bottom, (GLdouble)top,
-            (GLdouble)near_, (GLdouble)far_);
+        _igl_ortho (IGL_MATRIX_PROJECTION, left, right, bottom, top, near_, far_);
 
         _igl_setmmode ();
     }
-    IGL_CTX ()->flags &= ~IGL_WSTATE_CURMATRICES;
 }
 
 
@@ -504,7 +729,7 @@ void
 ortho2 (Coord left, Coord right, Coord bottom, Coord top)
 {
     _igl_trace (__func__,FALSE,"%g,%g,%g,%g",left,right,bottom,top);
-    igl->api->ortho2 (left, right, bottom, top);
+    iglThread.api->ortho2 (left, right, bottom, top);
 }
 
 void
@@ -515,7 +740,7 @@ iglExec_ortho2 (Coord left, Coord right, Coord bottom, Coord top)
     if (IGL_CTX ()->matrixMode == MSINGLE || IGL_CTX ()->matrixMode == MPROJECTION)
     {
         _igl_loadProjBase ();
-        gluOrtho2D ((GLdouble)left, (GLdouble)right, (GLdouble)bottom, (GLdouble)top);
+        _igl_ortho (IGL_MATRIX_PROJECTION, left, right, bottom, top, -1, 1);
     }
     else
     {
@@ -523,18 +748,17 @@ iglExec_ortho2 (Coord left, Coord right, Coord bottom, Coord top)
         glMatrixMode (GL_PROJECTION);
 
         _igl_loadProjBase ();
-        gluOrtho2D ((GLdouble)left, (GLdouble)right, (GLdouble)bottom, (GLdouble)top);
+        _igl_ortho (IGL_MATRIX_PROJECTION, left, right, bottom, top, -1, 1);
 
         _igl_setmmode ();
     }
-    IGL_CTX ()->flags &= ~IGL_WSTATE_CURMATRICES;
 
     /* TODO: disable lighting fixes powerflip backgrounds, but is it correct? */
-    glDisable (GL_LIGHTING);
+    _igl_glDisable (GL_LIGHTING);
     IGL_CTX ()->state &= ~(IGL_WSTATE_LIGHTING | IGL_VSTATE_LIGHTED);
 
     /* TODO: disable color material fixes perfly GUI, but is it correct? */
-    glDisable (GL_COLOR_MATERIAL);
+    _igl_glDisable (GL_COLOR_MATERIAL);
     IGL_CTX ()->state &= ~(IGL_WSTATE_LMCNULL);
 }
 
@@ -544,7 +768,7 @@ void
 window (Coord left, Coord right, Coord bottom, Coord top, Coord near_, Coord far_)
 {
     _igl_trace (__func__,FALSE,"%g,%g,%g,%g,%g,%g",left,right,bottom,top,near_,far_);
-    igl->api->window (left, right, bottom, top, near_, far_);
+    iglThread.api->window (left, right, bottom, top, near_, far_);
 }
 
 void
@@ -555,8 +779,7 @@ iglExec_window (Coord left, Coord right, Coord bottom, Coord top, Coord near_, C
     if (IGL_CTX ()->matrixMode == MSINGLE || IGL_CTX ()->matrixMode == MPROJECTION)
     {
         _igl_loadProjBase ();
-        glFrustum ((GLdouble)left, (GLdouble)right, (GLdouble)bottom, (GLdouble)top,
-            (GLdouble)near_, (GLdouble)far_);
+        _igl_frustum (IGL_MATRIX_PROJECTION, left, right, bottom, top, near_, far_);
     }
     else
     {
@@ -564,12 +787,10 @@ iglExec_window (Coord left, Coord right, Coord bottom, Coord top, Coord near_, C
         glMatrixMode (GL_PROJECTION);
 
         _igl_loadProjBase ();
-        glFrustum ((GLdouble)left, (GLdouble)right, (GLdouble)bottom, (GLdouble)top,
-            (GLdouble)near_, (GLdouble)far_);
+        _igl_frustum (IGL_MATRIX_PROJECTION, left, right, bottom, top, near_, far_);
 
         _igl_setmmode ();
     }
-    IGL_CTX ()->flags &= ~IGL_WSTATE_CURMATRICES;
 }
 
 
@@ -578,22 +799,27 @@ void
 perspective (Angle fovy, float aspect, Coord near_, Coord far_)
 {
     _igl_trace (__func__,FALSE,"%d,%g,%g,%g",fovy,aspect,near_,far_);
-    igl->api->perspective (fovy, aspect, near_, far_);
+    iglThread.api->perspective (fovy, aspect, near_, far_);
 }
 
 void
 iglExec_perspective (Angle fovy, float aspect, Coord near_, Coord far_)
 {
+    float top;
+
     IGL_CHECKWNDV ();
 
     /* man page says it's invalid */
     if (fovy < 2)
         return;
 
+    /* same as gluPerspective. NOTE: fovy is in tenths of degrees */
+    top = near_ * tanf (fovy * 0.05f * (float)M_PI / 180);
+
     if (IGL_CTX ()->matrixMode == MSINGLE || IGL_CTX ()->matrixMode == MPROJECTION)
     {
         _igl_loadProjBase ();
-        gluPerspective ((GLdouble)0.1*fovy, (GLdouble)aspect, (GLdouble)near_, (GLdouble)far_);
+        _igl_frustum (IGL_MATRIX_PROJECTION, -top*aspect, top*aspect, -top, top, near_, far_);
     }
     else
     {
@@ -601,11 +827,10 @@ iglExec_perspective (Angle fovy, float aspect, Coord near_, Coord far_)
         glMatrixMode (GL_PROJECTION);
 
         _igl_loadProjBase ();
-        gluPerspective ((GLdouble)0.1*fovy, (GLdouble)aspect, (GLdouble)near_, (GLdouble)far_);
+        _igl_frustum (IGL_MATRIX_PROJECTION, -top*aspect, top*aspect, -top, top, near_, far_);
 
         _igl_setmmode ();
     }
-    IGL_CTX ()->flags &= ~IGL_WSTATE_CURMATRICES;
 }
 
 
@@ -614,7 +839,7 @@ void
 lookat (Coord vx, Coord vy, Coord vz, Coord px, Coord py, Coord pz, Angle twist)
 {
     _igl_trace (__func__,FALSE,"%g,%g,%g,%g,%g,%g,%d",vx,vy,vz,px,py,pz,twist);
-    igl->api->lookat (vx, vy, vz, px, py, pz, twist);
+    iglThread.api->lookat (vx, vy, vz, px, py, pz, twist);
 }
 
 void
@@ -624,15 +849,40 @@ iglExec_lookat (Coord vx, Coord vy, Coord vz, Coord px, Coord py, Coord pz, Angl
     GLfloat dy = py - vy;
     GLfloat dz = pz - vz;
     int yup = (dx == 0 && dz == 0);
+    GLfloat m[16], f[3], s[3], u[3], len;
+    int idx;
 
     IGL_CHECKWNDV ();
+    idx = _igl_matrixIndex (IGL_CTX ());
 
     if (yup && dy == 0)
         return;
 
-    glRotatef (-twist*0.1f, 0, 0, 1 );
-    gluLookAt (vx, vy, vz, px, py, pz, 0, !yup, -yup);
-    IGL_CTX ()->flags &= ~IGL_WSTATE_CURMATRICES;
+    /* same as gluLookAt with up vector (0,1,0), or (0,0,-1) if looking along y */
+    len = sqrtf (dx*dx + dy*dy + dz*dz);
+    f[0] = dx / len; f[1] = dy / len; f[2] = dz / len;
+    if (!yup)
+    {
+        s[0] = -f[2]; s[1] = 0; s[2] = f[0];
+    }
+    else
+    {
+        s[0] = -f[1]; s[1] = f[0]; s[2] = 0;
+    }
+    len = sqrtf (s[0]*s[0] + s[1]*s[1] + s[2]*s[2]);
+    s[0] /= len; s[1] /= len; s[2] /= len;
+    u[0] = s[1]*f[2] - s[2]*f[1];
+    u[1] = s[2]*f[0] - s[0]*f[2];
+    u[2] = s[0]*f[1] - s[1]*f[0];
+
+    memcpy (m, _igl_identity, sizeof (m));
+    m[0] = s[0]; m[4] = s[1]; m[8] = s[2];
+    m[1] = u[0]; m[5] = u[1]; m[9] = u[2];
+    m[2] = -f[0]; m[6] = -f[1]; m[10] = -f[2];
+
+    _igl_rotate (idx, -twist*0.1f, 'z');
+    _igl_multMatrix (idx, m);
+    _igl_translate (idx, -vx, -vy, -vz);
 }
 
 
@@ -641,30 +891,31 @@ void
 viewport (Screencoord left, Screencoord right, Screencoord bottom, Screencoord top)
 {
     _igl_trace (__func__,FALSE,"%d,%d,%d,%d",left,right,bottom,top);
-    igl->api->viewport (left, right, bottom, top);
+    iglThread.api->viewport (left, right, bottom, top);
 }
 
 void
 iglExec_viewport (Screencoord left, Screencoord right, Screencoord bottom, Screencoord top)
 {
+    igl_windowT *wptr;
     long width, height;
 
     IGL_CHECKWNDV ();
+    wptr = IGL_CTX ();
 
     width = right-left + 1;
     height = top-bottom + 1;
     if (width <= 0 || height <= 0)
         return;
 
-    IGL_CTX ()->viewport[0] = left;
-    IGL_CTX ()->viewport[1] = bottom;
-    IGL_CTX ()->viewport[2] = width;
-    IGL_CTX ()->viewport[3] = height;
+    wptr->viewport[0] = wptr->scrmask[0] = left;
+    wptr->viewport[1] = wptr->scrmask[1] = bottom;
+    wptr->viewport[2] = wptr->scrmask[2] = width;
+    wptr->viewport[3] = wptr->scrmask[3] = height;
     glViewport (left, bottom, width, height);
     /* viewport() sets scrmask */
     glScissor (left, bottom, width, height);
     glEnable (GL_SCISSOR_TEST);
-    IGL_CTX ()->flags |= IGL_WSTATE_CURVIEWPORT;
 }
 
 
@@ -678,8 +929,6 @@ getviewport (Screencoord *left, Screencoord *right, Screencoord *bottom, Screenc
     if (left == NULL || right == NULL || bottom == NULL || top == NULL)
         return;
 
-    _igl_getViewport ();
-
     *left = IGL_CTX ()->viewport[0];
     *right = IGL_CTX ()->viewport[0] + IGL_CTX ()->viewport[2] - 1;
     *bottom = IGL_CTX ()->viewport[1];
@@ -697,15 +946,14 @@ reshapeviewport (void)
     IGL_CHECKWNDV ();
     wptr = IGL_CTX ();
 
-    wptr->viewport[0] = 0;
-    wptr->viewport[1] = 0;
-    wptr->viewport[2] = wptr->width;
-    wptr->viewport[3] = wptr->height;
+    wptr->viewport[0] = wptr->scrmask[0] = 0;
+    wptr->viewport[1] = wptr->scrmask[1] = 0;
+    wptr->viewport[2] = wptr->scrmask[2] = wptr->width;
+    wptr->viewport[3] = wptr->scrmask[3] = wptr->height;
     glViewport (0, 0, wptr->width, wptr->height);
     /* viewport() sets scrmask */
     glScissor (0, 0, wptr->width, wptr->height);
     glEnable (GL_SCISSOR_TEST);
-    wptr->flags |= IGL_WSTATE_CURVIEWPORT;
 }
 
 
@@ -714,7 +962,7 @@ void
 pushviewport (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->pushviewport ();
+    iglThread.api->pushviewport ();
 }
 
 void
@@ -723,6 +971,7 @@ iglExec_pushviewport (void)
     IGL_CHECKWNDV ();
 
     glPushAttrib (GL_VIEWPORT_BIT | GL_SCISSOR_BIT);
+    _igl_pushViewport ();
 }
 
 
@@ -731,7 +980,7 @@ void
 popviewport (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->popviewport ();
+    iglThread.api->popviewport ();
 }
 
 void
@@ -740,7 +989,7 @@ iglExec_popviewport (void)
     IGL_CHECKWNDV ();
 
     glPopAttrib ();
-    IGL_CTX ()->flags &= ~IGL_WSTATE_CURVIEWPORT;
+    _igl_popViewport ();
 }
 
 
@@ -749,21 +998,27 @@ void
 scrmask (Screencoord left, Screencoord right, Screencoord bottom, Screencoord top)
 {
     _igl_trace (__func__,FALSE,"%d,%d,%d,%d",left,right,bottom,top);
-    igl->api->scrmask (left, right, bottom, top);
+    iglThread.api->scrmask (left, right, bottom, top);
 }
 
 void
 iglExec_scrmask (Screencoord left, Screencoord right, Screencoord bottom, Screencoord top)
 {
+    igl_windowT *wptr;
     long width, height;
 
     IGL_CHECKWNDV ();
+    wptr = IGL_CTX ();
 
     width = right-left+1;
     height = top-bottom+1;
     if (width <= 0 || height <= 0)
         return;
 
+    wptr->scrmask[0] = left;
+    wptr->scrmask[1] = bottom;
+    wptr->scrmask[2] = width;
+    wptr->scrmask[3] = height;
     glScissor (left, bottom, width, height);
     glEnable (GL_SCISSOR_TEST);
 }
@@ -773,7 +1028,7 @@ iglExec_scrmask (Screencoord left, Screencoord right, Screencoord bottom, Screen
 void
 getscrmask (Screencoord *left, Screencoord *right, Screencoord *bottom, Screencoord *top)
 {
-    int cscrmask[4];
+    GLint *cscrmask;
 
     _igl_trace (__func__,TRUE,"%p,%p,%p,%p",left,right,bottom,top);
     IGL_CHECKWNDV ();
@@ -782,7 +1037,7 @@ getscrmask (Screencoord *left, Screencoord *right, Screencoord *bottom, Screenco
         return;
 
     /* if GL_SCISSOR_TEST is disabled, we get the entire window box */
-    glGetIntegerv (GL_SCISSOR_BOX, cscrmask);
+    cscrmask = IGL_CTX ()->scrmask;
 
     *left = cscrmask[0];
     *right = cscrmask[0] + cscrmask[2] - 1;
@@ -798,6 +1053,7 @@ mapw (Object obj, Screencoord x, Screencoord y, Coord *wx1, Coord *wy1, Coord *w
       Coord *wx2, Coord *wy2, Coord *wz2)
 {
     GLdouble tx, ty, tz;
+    GLint viewport[4];
     igl_windowT *wptr;
 
     _igl_trace (__func__,TRUE,"%ld,%d,%d,%p,%p,%p,%p,%p,%p",obj,x,y,wx1,wy1,wz1,wx2,wy2,wz2);
@@ -811,18 +1067,17 @@ mapw (Object obj, Screencoord x, Screencoord y, Coord *wx1, Coord *wy1, Coord *w
     _igl_setmmode ();
 
     callobj (obj);
-    _igl_getViewport ();
+    memcpy (viewport, wptr->viewport, sizeof (viewport));
     _igl_getMatrices ();
 
-    wptr->flags &= ~(IGL_WSTATE_CURMATRICES | IGL_WSTATE_CURVIEWPORT);
     _igl_popTransform ();
 
     /* NOTE: in NDC, z should be [0..1]. For safety, use a small epsilon */
-    gluUnProject (x, y, 0.00001, wptr->modelMatrix, wptr->projMatrix, wptr->viewport, &tx, &ty, &tz);
+    gluUnProject (x, y, 0.00001, wptr->modelMatrix, wptr->projMatrix, viewport, &tx, &ty, &tz);
     *wx1 = (GLfloat)tx;
     *wy1 = (GLfloat)ty;
     *wz1 = (GLfloat)tz;
-    gluUnProject (x, y, 0.99999, wptr->modelMatrix, wptr->projMatrix, wptr->viewport, &tx, &ty, &tz);
+    gluUnProject (x, y, 0.99999, wptr->modelMatrix, wptr->projMatrix, viewport, &tx, &ty, &tz);
     *wx2 = (GLfloat)tx;
     *wy2 = (GLfloat)ty;
     *wz2 = (GLfloat)tz;
@@ -838,6 +1093,7 @@ void
 mapw2 (Object obj, Screencoord x, Screencoord y, Coord *wx, Coord *wy)
 {
     GLdouble tx, ty, tz;
+    GLint viewport[4];
     igl_windowT *wptr;
 
     _igl_trace (__func__,TRUE,"%ld,%d,%d,%p,%p",obj,x,y,wx,wy);
@@ -851,14 +1107,13 @@ mapw2 (Object obj, Screencoord x, Screencoord y, Coord *wx, Coord *wy)
     _igl_setmmode ();
 
     callobj (obj);
-    _igl_getViewport ();
+    memcpy (viewport, wptr->viewport, sizeof (viewport));
     _igl_getMatrices ();
 
-    wptr->flags &= ~(IGL_WSTATE_CURMATRICES | IGL_WSTATE_CURVIEWPORT);
     _igl_popTransform ();
 
     /* NOTE: this only works with orthogonal projections - z doesn't matter */
-    gluUnProject (x, y, 0, wptr->modelMatrix, wptr->projMatrix, wptr->viewport, &tx, &ty, &tz);
+    gluUnProject (x, y, 0, wptr->modelMatrix, wptr->projMatrix, viewport, &tx, &ty, &tz);
     *wx = (GLfloat)tx;
     *wy = (GLfloat)ty;
     _igl_trace (" = ",TRUE,"{%g,%g}",*wx,*wy);
@@ -1082,7 +1337,6 @@ pick (short buffer[], long numnam)
     IGL_MSG_PROCESS
     x = igl->deviceVal[CURSORX] - wptr->x;
     y = igl->deviceVal[CURSORY] - GL_Y(wptr->y + wptr->height - 1);
-    _igl_getViewport ();
 
     /* NOTE: man page states "places a special viewing matrix on the stack".
      * I think that's from times where there was only the MSINGLE mode.
@@ -1093,14 +1347,15 @@ pick (short buffer[], long numnam)
      * projection matrix gets overwritten.
      */
 
-    /* load the picking matrix onto the projection stack and save it */
-    glMatrixMode (GL_PROJECTION);
-    glPushMatrix ();
-    glLoadIdentity ();
-    gluPickMatrix (x, y, wptr->pickDeltax, wptr->pickDeltay, wptr->viewport);
-    glGetFloatv (GL_PROJECTION_MATRIX, wptr->pickMatrix);
-    glPopMatrix ();
-    _igl_setmmode ();
+    /* compute the picking matrix like gluPickMatrix and save it */
+    memcpy (wptr->pickMatrix, _igl_identity, sizeof (wptr->pickMatrix));
+    if (wptr->pickDeltax > 0 && wptr->pickDeltay > 0)
+    {
+        wptr->pickMatrix[0] = (GLfloat)wptr->viewport[2] / wptr->pickDeltax;
+        wptr->pickMatrix[5] = (GLfloat)wptr->viewport[3] / wptr->pickDeltay;
+        wptr->pickMatrix[12] = (GLfloat)(wptr->viewport[2] - 2*(x - wptr->viewport[0])) / wptr->pickDeltax;
+        wptr->pickMatrix[13] = (GLfloat)(wptr->viewport[3] - 2*(y - wptr->viewport[1])) / wptr->pickDeltay;
+    }
 
     /* since OpenGL puts extra information into the pick buffer and uses a
      * different type, a (bigger?) temporary buffer for conversion is needed.
@@ -1188,7 +1443,7 @@ void
 initnames (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->initnames ();
+    iglThread.api->initnames ();
 }
 
 void
@@ -1206,7 +1461,7 @@ void
 loadname (short name)
 {
     _igl_trace (__func__,FALSE,"%d",name);
-    igl->api->loadname (name);
+    iglThread.api->loadname (name);
 }
 
 void
@@ -1223,7 +1478,7 @@ void
 pushname (short name)
 {
     _igl_trace (__func__,FALSE,"%d",name);
-    igl->api->pushname (name);
+    iglThread.api->pushname (name);
 }
 
 void
@@ -1240,7 +1495,7 @@ void
 popname (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->popname ();
+    iglThread.api->popname ();
 }
 
 void
@@ -1274,7 +1529,6 @@ getscrbox (long *left, long *right, long *bottom, long *top)
      * the viewport limits as the maximum */
     if (!sb || sscanf(sb, "%ld,%ld,%ld,%ld", left, right, bottom, top) != 4)
     {
-        _igl_getViewport ();
         *left = IGL_CTX ()->viewport[0];
         *right = IGL_CTX ()->viewport[0] + IGL_CTX ()->viewport[2] - 1;
         *bottom = IGL_CTX ()->viewport[1];
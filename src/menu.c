@@ -524,6 +524,10 @@ defpup (String str, ...)
     _igl_trace (__func__,TRUE,"%p(%s),...",str,str?str:"");
     IGL_CHECKWND (-1);
 
+    /* pop-up menus need an X server */
+    if (IGL_HEADLESS)
+        return (-1);
+
     va_start (mlist, str);
     id = _igl_parseMenu (-1, str, mlist);
     va_end (mlist);
@@ -541,6 +545,9 @@ newpup (void)
     _igl_trace (__func__,TRUE,"");
     IGL_CHECKWND (-1);
 
+    if (IGL_HEADLESS)
+        return (-1);
+
     id = _igl_findMenuPlaceholder ();
     if (id != -1)
 #if PLATFORM_X11
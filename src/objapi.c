@@ -26,15 +26,17 @@
 #include <stdarg.h>
 
 
+/* records into the open object, or the render thread's command batch */
 #define IGL_CHECKOBJV()                     \
 igl_objectT *obj;                           \
 igl_objFcnT *fcn;                           \
-if (igl->currentObjIdx == -1)               \
+if ((obj = iglThread.recordObj) == NULL)    \
     return;                                 \
-obj = &igl->objects[igl->currentObjIdx];
+if (iglThread.pipelined && IGL_OBJUSED (obj) > IGL_PIPEBATCHSIZE) \
+    obj = _igl_pipeFlush ();
 
-#define IGLFCNV(_op)                        \
-fcn = _igl_addObjectFcn (obj, _op);         \
+#define IGLFCNV(_op,_n)                     \
+fcn = _igl_addObjectFcn (obj, _op, _n);     \
 if (fcn == NULL)                            \
     return;
 
@@ -45,14 +47,16 @@ callfunc (void (*fctn)(), long nargs, ...)
     int i;
     va_list ap;
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_CALLFUNC);
+    /* only valid in objects, not in the command stream */
+    if (iglThread.currentObjIdx == -1)
+        return;
+    IGLFCNV (OP_CALLFUNC, 3);
 
     fcn->params[0].v = (void *)fctn;
     fcn->params[1].i = (int)nargs;
-    fcn->params[2].v = malloc (nargs * sizeof (long));
+    fcn->params[2].v = _igl_allocObjectData (obj, nargs * sizeof (long));
     if (fcn->params[2].v == NULL)
     {
-        fcn->type = 0;
         fcn->opcode = OP_NONE;
         return;
     }
@@ -71,14 +75,14 @@ void
 iglObj_clear (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_CLEAR);
+    IGLFCNV (OP_CLEAR, 0);
 }
 
 void
 iglObj_lsetdepth (long near_, long far_)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_LSETDEPTH);
+    IGLFCNV (OP_LSETDEPTH, 2);
     fcn->params[0].i = near_;
     fcn->params[1].i = far_;
 }
@@ -87,14 +91,14 @@ void
 iglObj_swapbuffers (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_SWAPBUFFERS);
+    IGLFCNV (OP_SWAPBUFFERS, 0);
 }
 
 void
 iglObj_mswapbuffers (long fbuf)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_MSWAPBUFFERS);
+    IGLFCNV (OP_MSWAPBUFFERS, 1);
     fcn->params[0].i = fbuf;
 }
 
@@ -102,7 +106,7 @@ void
 iglObj_backbuffer (Boolean enable)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_BACKBUFFER);
+    IGLFCNV (OP_BACKBUFFER, 1);
     fcn->params[0].i = enable;
 }
 
@@ -110,7 +114,7 @@ void
 iglObj_frontbuffer (Boolean enable)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_FRONTBUFFER);
+    IGLFCNV (OP_FRONTBUFFER, 1);
     fcn->params[0].i = enable;
 }
 
@@ -118,7 +122,7 @@ void
 iglObj_leftbuffer (Boolean enable)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_LEFTBUFFER);
+    IGLFCNV (OP_LEFTBUFFER, 1);
     fcn->params[0].i = enable;
 }
 
@@ -126,7 +130,7 @@ void
 iglObj_rightbuffer (Boolean enable)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_RIGHTBUFFER);
+    IGLFCNV (OP_RIGHTBUFFER, 1);
     fcn->params[0].i = enable;
 }
 
@@ -134,7 +138,7 @@ void
 iglObj_backface (Boolean enable)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_BACKFACE);
+    IGLFCNV (OP_BACKFACE, 1);
     fcn->params[0].i = enable;
 }
 
@@ -142,7 +146,7 @@ void
 iglObj_frontface (Boolean enable)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_FRONTFACE);
+    IGLFCNV (OP_FRONTFACE, 1);
     fcn->params[0].i = enable;
 }
 
@@ -150,7 +154,7 @@ void
 iglObj_depthcue (Boolean enable)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_DEPTHCUE);
+    IGLFCNV (OP_DEPTHCUE, 1);
     fcn->params[0].i = enable;
 }
 
@@ -158,7 +162,7 @@ void
 iglObj_lshaderange (Colorindex lowin, Colorindex highin, long znear, long zfar)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_LSHADERANGE);
+    IGLFCNV (OP_LSHADERANGE, 4);
     fcn->params[0].us = lowin;
     fcn->params[1].us = highin;
     fcn->params[2].i = znear;
@@ -169,7 +173,7 @@ void
 iglObj_lRGBrange (short rmin, short gmin, short bmin, short rmax, short gmax, short bmax, long znear, long zfar)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_LRGBRANGE);
+    IGLFCNV (OP_LRGBRANGE, 8);
     fcn->params[0].us = rmin;
     fcn->params[1].us = gmin;
     fcn->params[2].us = bmin;
@@ -184,7 +188,7 @@ void
 iglObj_zbuffer (Boolean enable)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_ZBUFFER);
+    IGLFCNV (OP_ZBUFFER, 1);
     fcn->params[0].i = enable;
 }
 
@@ -192,7 +196,7 @@ void
 iglObj_zfunction (long func)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_ZFUNCTION);
+    IGLFCNV (OP_ZFUNCTION, 1);
     fcn->params[0].i = func;
 }
 
@@ -200,14 +204,14 @@ void
 iglObj_zclear (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_ZCLEAR);
+    IGLFCNV (OP_ZCLEAR, 0);
 }
 
 void
 iglObj_czclear (unsigned long cval, long zval)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_CZCLEAR);
+    IGLFCNV (OP_CZCLEAR, 2);
     fcn->params[0].ui = cval;
     fcn->params[1].i = zval;
 }
@@ -216,7 +220,7 @@ void
 iglObj_sclear (unsigned long sval)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_SCLEAR);
+    IGLFCNV (OP_SCLEAR, 1);
     fcn->params[0].ui = sval;
 }
 
@@ -224,7 +228,7 @@ void
 iglObj_stencil (long enable, unsigned long ref, long func, unsigned long mask, long fail, long pass, long zpass)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_STENCIL);
+    IGLFCNV (OP_STENCIL, 7);
     fcn->params[0].i = enable;
     fcn->params[1].ui = ref;
     fcn->params[2].i = func;
@@ -238,7 +242,7 @@ void
 iglObj_acbuf (long op, float value)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_ACBUF);
+    IGLFCNV (OP_ACBUF, 2);
     fcn->params[0].i = op;
     fcn->params[1].f = value;
 }
@@ -247,7 +251,7 @@ void
 iglObj_shademodel (int mode)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_SHADEMODEL);
+    IGLFCNV (OP_SHADEMODEL, 1);
     fcn->params[0].i = mode;
 }
 
@@ -255,7 +259,7 @@ void
 iglObj_color (Colorindex c)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_COLOR);
+    IGLFCNV (OP_COLOR, 1);
     fcn->params[0].us = c;
 }
 
@@ -263,7 +267,7 @@ void
 iglObj_mapcolor (Colorindex i, short r, short g, short b)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_MAPCOLOR);
+    IGLFCNV (OP_MAPCOLOR, 4);
     fcn->params[0].us = i;
     fcn->params[1].s = r;
     fcn->params[2].s = g;
@@ -274,7 +278,7 @@ void
 iglObj_cpack (unsigned long color)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_CPACK);
+    IGLFCNV (OP_CPACK, 1);
     fcn->params[0].ui = color;
 }
 
@@ -282,7 +286,7 @@ void
 iglObj_RGBcolor (short r, short g, short b)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_RGBCOLOR);
+    IGLFCNV (OP_RGBCOLOR, 3);
     fcn->params[0].s = r;
     fcn->params[1].s = g;
     fcn->params[2].s = b;
@@ -292,7 +296,7 @@ void
 iglObj_afunction (long ref, long func)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_AFUNCTION);
+    IGLFCNV (OP_AFUNCTION, 2);
     fcn->params[0].i = ref;
     fcn->params[1].i = func;
 }
@@ -301,7 +305,7 @@ void
 iglObj_blendfunction (long sfactor, long dfactor)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_BLENDFUNCTION);
+    IGLFCNV (OP_BLENDFUNCTION, 2);
     fcn->params[0].i = sfactor;
     fcn->params[1].i = dfactor;
 }
@@ -310,7 +314,7 @@ void
 iglObj_dither (long mode)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_DITHER);
+    IGLFCNV (OP_DITHER, 1);
     fcn->params[0].i = mode;
 }
 
@@ -318,9 +322,9 @@ void
 iglObj_fogvertex (long mode, float *params)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_FOGVERTEX);
+    IGLFCNV (OP_FOGVERTEX, 2);
     fcn->params[0].i = mode;
-    fcn->params[1].v = (float *)malloc (5*sizeof (float));
+    fcn->params[1].v = (float *)_igl_allocObjectData (obj, 5*sizeof (float));
     if (fcn->params[1].v != NULL)
     {
         if (mode == FG_VTX_LIN || mode == FG_PIX_LIN)
@@ -334,7 +338,7 @@ void
 iglObj_logicop (long opcode)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_LOGICOP);
+    IGLFCNV (OP_LOGICOP, 1);
     fcn->params[0].i = opcode;
 }
 
@@ -342,8 +346,8 @@ void
 iglObj_c4f (float cv[4])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_C4F);
-    fcn->params[0].v = (float *)malloc (4*sizeof (float));
+    IGLFCNV (OP_C4F, 1);
+    fcn->params[0].v = (float *)_igl_allocObjectData (obj, 4*sizeof (float));
     if (fcn->params[0].v != NULL)
         memcpy (fcn->params[0].v, cv, 4*sizeof (float));
 }
@@ -352,8 +356,8 @@ void
 iglObj_c4i (int cv[4])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_C4I);
-    fcn->params[0].v = (int *)malloc (4*sizeof (int));
+    IGLFCNV (OP_C4I, 1);
+    fcn->params[0].v = (int *)_igl_allocObjectData (obj, 4*sizeof (int));
     if (fcn->params[0].v != NULL)
         memcpy (fcn->params[0].v, cv, 4*sizeof (int));
 }
@@ -362,8 +366,8 @@ void
 iglObj_c4s (short cv[4])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_C4S);
-    fcn->params[0].v = (short *)malloc (4*sizeof (short));
+    IGLFCNV (OP_C4S, 1);
+    fcn->params[0].v = (short *)_igl_allocObjectData (obj, 4*sizeof (short));
     if (fcn->params[0].v != NULL)
         memcpy (fcn->params[0].v, cv, 4*sizeof (short));
 }
@@ -372,7 +376,7 @@ void
 iglObj_mmode (short mode)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_MMODE);
+    IGLFCNV (OP_MMODE, 1);
     fcn->params[0].s = mode;
 }
 
@@ -380,8 +384,8 @@ void
 iglObj_loadmatrix (Matrix m)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_LOADMATRIX);
-    fcn->params[0].v = (Matrix *)malloc (sizeof (Matrix));
+    IGLFCNV (OP_LOADMATRIX, 1);
+    fcn->params[0].v = (Matrix *)_igl_allocObjectData (obj, sizeof (Matrix));
     if (fcn->params[0].v != NULL)
         memcpy (fcn->params[0].v, m, sizeof (Matrix));
 }
@@ -390,8 +394,8 @@ void
 iglObj_multmatrix (Matrix m)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_MULTMATRIX);
-    fcn->params[0].v = (Matrix *)malloc (sizeof (Matrix));
+    IGLFCNV (OP_MULTMATRIX, 1);
+    fcn->params[0].v = (Matrix *)_igl_allocObjectData (obj, sizeof (Matrix));
     if (fcn->params[0].v != NULL)
         memcpy (fcn->params[0].v, m, sizeof (Matrix));
 }
@@ -400,21 +404,21 @@ void
 iglObj_pushmatrix (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_PUSHMATRIX);
+    IGLFCNV (OP_PUSHMATRIX, 0);
 }
 
 void
 iglObj_popmatrix (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_POPMATRIX);
+    IGLFCNV (OP_POPMATRIX, 0);
 }
 
 void
 iglObj_rot (float amount, char angle)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_ROT);
+    IGLFCNV (OP_ROT, 2);
     fcn->params[0].f = amount;
     fcn->params[1].c = angle;
 }
@@ -423,7 +427,7 @@ void
 iglObj_rotate (Angle amount, char angle)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_ROTATE);
+    IGLFCNV (OP_ROTATE, 2);
     fcn->params[0].s = amount;
     fcn->params[1].c = angle;
 }
@@ -432,7 +436,7 @@ void
 iglObj_translate (Coord x, Coord y, Coord z)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_TRANSLATE);
+    IGLFCNV (OP_TRANSLATE, 3);
     fcn->params[0].f = x;
     fcn->params[1].f = y;
     fcn->params[2].f = z;
@@ -442,7 +446,7 @@ void
 iglObj_scale (float x, float y, float z)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_SCALE);
+    IGLFCNV (OP_SCALE, 3);
     fcn->params[0].f = x;
     fcn->params[1].f = y;
     fcn->params[2].f = z;
@@ -452,7 +456,7 @@ void
 iglObj_polarview (Coord dist, Angle azim, Angle inc, Angle twist)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_POLARVIEW);
+    IGLFCNV (OP_POLARVIEW, 4);
     fcn->params[0].f = dist;
     fcn->params[1].s = azim;
     fcn->params[2].s = inc;
@@ -463,10 +467,10 @@ void
 iglObj_clipplane (long index, long mode, float *params)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_CLIPPLANE);
+    IGLFCNV (OP_CLIPPLANE, 3);
     fcn->params[0].i = index;
     fcn->params[1].i = mode;
-    fcn->params[2].v = (float *)malloc (4*sizeof (float));
+    fcn->params[2].v = (float *)_igl_allocObjectData (obj, 4*sizeof (float));
     if (fcn->params[2].v != NULL)
         memcpy (fcn->params[2].v, params, 4*sizeof (float));
 }
@@ -475,7 +479,7 @@ void
 iglObj_ortho (Coord left, Coord right, Coord bottom, Coord top, Coord near_, Coord far_)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_ORTHO);
+    IGLFCNV (OP_ORTHO, 6);
     fcn->params[0].f = left;
     fcn->params[1].f = right;
     fcn->params[2].f = bottom;
@@ -488,7 +492,7 @@ void
 iglObj_ortho2 (Coord left, Coord right, Coord bottom, Coord top)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_ORTHO2);
+    IGLFCNV (OP_ORTHO2, 4);
     fcn->params[0].f = left;
     fcn->params[1].f = right;
     fcn->params[2].f = bottom;
@@ -499,7 +503,7 @@ void
 iglObj_window (Coord left, Coord right, Coord bottom, Coord top, Coord near_, Coord far_)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_WINDOW);
+    IGLFCNV (OP_WINDOW, 6);
     fcn->params[0].f = left;
     fcn->params[1].f = right;
     fcn->params[2].f = bottom;
@@ -512,7 +516,7 @@ void
 iglObj_perspective (Angle fovy, float aspect, Coord near_, Coord far_)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_PERSPECTIVE);
+    IGLFCNV (OP_PERSPECTIVE, 4);
     fcn->params[0].s = fovy;
     fcn->params[1].f = aspect;
     fcn->params[2].f = near_;
@@ -523,7 +527,7 @@ void
 iglObj_viewport (Screencoord left, Screencoord right, Screencoord bottom, Screencoord top)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_VIEWPORT);
+    IGLFCNV (OP_VIEWPORT, 4);
     fcn->params[0].s = left;
     fcn->params[1].s = right;
     fcn->params[2].s = bottom;
@@ -534,21 +538,21 @@ void
 iglObj_pushviewport (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_PUSHVIEWPORT);
+    IGLFCNV (OP_PUSHVIEWPORT, 0);
 }
 
 void
 iglObj_popviewport (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_POPVIEWPORT);
+    IGLFCNV (OP_POPVIEWPORT, 0);
 }
 
 void
 iglObj_lookat (Coord vx, Coord vy, Coord vz, Coord px, Coord py, Coord pz, Angle twist)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_LOOKAT);
+    IGLFCNV (OP_LOOKAT, 7);
     fcn->params[0].f = vx;
     fcn->params[1].f = vy;
     fcn->params[2].f = vz;
@@ -562,7 +566,7 @@ void
 iglObj_scrmask (Screencoord left, Screencoord right, Screencoord bottom, Screencoord top)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_SCRMASK);
+    IGLFCNV (OP_SCRMASK, 4);
     fcn->params[0].s = left;
     fcn->params[1].s = right;
     fcn->params[2].s = bottom;
@@ -573,9 +577,9 @@ void
 iglObj_polf (long n, const Coord parray[][3])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_POLF);
+    IGLFCNV (OP_POLF, 2);
     fcn->params[0].i = n;
-    fcn->params[1].v = malloc (n*3*sizeof (Coord));
+    fcn->params[1].v = _igl_allocObjectData (obj, n*3*sizeof (Coord));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, parray, n*3*sizeof (Coord));
 }
@@ -584,9 +588,9 @@ void
 iglObj_polfi (long n, const Icoord parray[][3])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_POLFI);
+    IGLFCNV (OP_POLFI, 2);
     fcn->params[0].i = n;
-    fcn->params[1].v = malloc (n*3*sizeof (Icoord));
+    fcn->params[1].v = _igl_allocObjectData (obj, n*3*sizeof (Icoord));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, parray, n*3*sizeof (Icoord));
 }
@@ -595,9 +599,9 @@ void
 iglObj_polfs (long n, const Scoord parray[][3])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_POLFS);
+    IGLFCNV (OP_POLFS, 2);
     fcn->params[0].i = n;
-    fcn->params[1].v = malloc (n*3*sizeof (Scoord));
+    fcn->params[1].v = _igl_allocObjectData (obj, n*3*sizeof (Scoord));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, parray, n*3*sizeof (Scoord));
 }
@@ -606,9 +610,9 @@ void
 iglObj_polf2 (long n, const Coord parray[][2])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_POLF2);
+    IGLFCNV (OP_POLF2, 2);
     fcn->params[0].i = n;
-    fcn->params[1].v = malloc (n*2*sizeof (Icoord));
+    fcn->params[1].v = _igl_allocObjectData (obj, n*2*sizeof (Icoord));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, parray, n*2*sizeof (Icoord));
 }
@@ -617,9 +621,9 @@ void
 iglObj_polf2i (long n, const Icoord parray[][2])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_POLF2I);
+    IGLFCNV (OP_POLF2I, 2);
     fcn->params[0].i = n;
-    fcn->params[1].v = malloc (n*2*sizeof (Icoord));
+    fcn->params[1].v = _igl_allocObjectData (obj, n*2*sizeof (Icoord));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, parray, n*2*sizeof (Icoord));
 }
@@ -628,9 +632,9 @@ void
 iglObj_polf2s (long n, const Scoord parray[][2])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_POLF2S);
+    IGLFCNV (OP_POLF2S, 2);
     fcn->params[0].i = n;
-    fcn->params[1].v = malloc (n*2*sizeof (Scoord));
+    fcn->params[1].v = _igl_allocObjectData (obj, n*2*sizeof (Scoord));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, parray, n*2*sizeof (Scoord));
 }
@@ -639,9 +643,9 @@ void
 iglObj_poly (long n, const Coord parray[][3])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_POLY);
+    IGLFCNV (OP_POLY, 2);
     fcn->params[0].i = n;
-    fcn->params[1].v = malloc (n*3*sizeof (Coord));
+    fcn->params[1].v = _igl_allocObjectData (obj, n*3*sizeof (Coord));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, parray, n*3*sizeof (Coord));
 }
@@ -650,9 +654,9 @@ void
 iglObj_polyi (long n, const Icoord parray[][3])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_POLYI);
+    IGLFCNV (OP_POLYI, 2);
     fcn->params[0].i = n;
-    fcn->params[1].v = malloc (n*3*sizeof (Icoord));
+    fcn->params[1].v = _igl_allocObjectData (obj, n*3*sizeof (Icoord));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, parray, n*3*sizeof (Icoord));
 }
@@ -661,9 +665,9 @@ void
 iglObj_polys (long n, const Scoord parray[][3])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_POLYS);
+    IGLFCNV (OP_POLYS, 2);
     fcn->params[0].i = n;
-    fcn->params[1].v = malloc (n*3*sizeof (Scoord));
+    fcn->params[1].v = _igl_allocObjectData (obj, n*3*sizeof (Scoord));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, parray, n*3*sizeof (Scoord));
 }
@@ -672,9 +676,9 @@ void
 iglObj_poly2 (long n, const Coord parray[][2])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_POLY2);
+    IGLFCNV (OP_POLY2, 2);
     fcn->params[0].i = n;
-    fcn->params[1].v = malloc (n*2*sizeof (Icoord));
+    fcn->params[1].v = _igl_allocObjectData (obj, n*2*sizeof (Icoord));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, parray, n*2*sizeof (Icoord));
 }
@@ -683,9 +687,9 @@ void
 iglObj_poly2i (long n, const Icoord parray[][2])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_POLY2I);
+    IGLFCNV (OP_POLY2I, 2);
     fcn->params[0].i = n;
-    fcn->params[1].v = malloc (n*2*sizeof (Icoord));
+    fcn->params[1].v = _igl_allocObjectData (obj, n*2*sizeof (Icoord));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, parray, n*2*sizeof (Icoord));
 }
@@ -694,9 +698,9 @@ void
 iglObj_poly2s (long n, const Scoord parray[][2])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_POLY2S);
+    IGLFCNV (OP_POLY2S, 2);
     fcn->params[0].i = n;
-    fcn->params[1].v = malloc (n*2*sizeof (Scoord));
+    fcn->params[1].v = _igl_allocObjectData (obj, n*2*sizeof (Scoord));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, parray, n*2*sizeof (Scoord));
 }
@@ -705,7 +709,7 @@ void
 iglObj_polymode (long mode)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_POLYMODE);
+    IGLFCNV (OP_POLYMODE, 1);
     fcn->params[0].i = mode;
 }
 
@@ -713,7 +717,7 @@ void
 iglObj_polysmooth (long mode)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_POLYSMOOTH);
+    IGLFCNV (OP_POLYSMOOTH, 1);
     fcn->params[0].i = mode;
 }
 
@@ -721,7 +725,7 @@ void
 iglObj_displacepolygon (float scalefactor)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_DISPLACEPOLYGON);
+    IGLFCNV (OP_DISPLACEPOLYGON, 1);
     fcn->params[0].f = scalefactor;
 }
 
@@ -729,7 +733,7 @@ void
 iglObj_pmv (Coord x, Coord y, Coord z)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_PMV);
+    IGLFCNV (OP_PMV, 3);
     fcn->params[0].f = x;
     fcn->params[1].f = y;
     fcn->params[2].f = z;
@@ -739,7 +743,7 @@ void
 iglObj_pdr (Coord x, Coord y, Coord z)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_PDR);
+    IGLFCNV (OP_PDR, 3);
     fcn->params[0].f = x;
     fcn->params[1].f = y;
     fcn->params[2].f = z;
@@ -749,14 +753,14 @@ void
 iglObj_pclos (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_PCLOS);
+    IGLFCNV (OP_PCLOS, 0);
 }
 
 void
 iglObj_pnt (Coord x, Coord y, Coord z)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_PNT);
+    IGLFCNV (OP_PNT, 3);
     fcn->params[0].f = x;
     fcn->params[1].f = y;
     fcn->params[2].f = z;
@@ -766,7 +770,7 @@ void
 iglObj_pntsizef (float n)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_PNTSIZEF);
+    IGLFCNV (OP_PNTSIZEF, 1);
     fcn->params[0].f = n;
 }
 
@@ -774,7 +778,7 @@ void
 iglObj_pntsmooth (unsigned long mode)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_PNTSMOOTH);
+    IGLFCNV (OP_PNTSMOOTH, 1);
     fcn->params[0].ui = mode;
 }
 
@@ -782,7 +786,7 @@ void
 iglObj_rect (Coord a, Coord b, Coord c, Coord d)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_RECT);
+    IGLFCNV (OP_RECT, 4);
     fcn->params[0].f = a;
     fcn->params[1].f = b;
     fcn->params[2].f = c;
@@ -793,7 +797,7 @@ void
 iglObj_rectf (Coord a, Coord b, Coord c, Coord d)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_RECTF);
+    IGLFCNV (OP_RECTF, 4);
     fcn->params[0].f = a;
     fcn->params[1].f = b;
     fcn->params[2].f = c;
@@ -804,7 +808,7 @@ void
 iglObj_sbox (Coord a, Coord b, Coord c, Coord d)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_SBOX);
+    IGLFCNV (OP_SBOX, 4);
     fcn->params[0].f = a;
     fcn->params[1].f = b;
     fcn->params[2].f = c;
@@ -815,7 +819,7 @@ void
 iglObj_sboxf (Coord a, Coord b, Coord c, Coord d)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_SBOXF);
+    IGLFCNV (OP_SBOXF, 4);
     fcn->params[0].f = a;
     fcn->params[1].f = b;
     fcn->params[2].f = c;
@@ -826,8 +830,8 @@ void
 iglObj_v4f (float vector[4])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_V4F);
-    fcn->params[0].v = (float *)malloc (4*sizeof (float));
+    IGLFCNV (OP_V4F, 1);
+    fcn->params[0].v = (float *)_igl_allocObjectData (obj, 4*sizeof (float));
     if (fcn->params[0].v != NULL)
         memcpy (fcn->params[0].v, vector, 4*sizeof (float));
 }
@@ -836,7 +840,7 @@ void
 iglObj_arc (Coord x, Coord y, Coord radius, Angle startAngle, Angle endAngle)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_ARC);
+    IGLFCNV (OP_ARC, 5);
     fcn->params[0].f = x;
     fcn->params[1].f = y;
     fcn->params[2].f = radius;
@@ -848,7 +852,7 @@ void
 iglObj_arcf (Coord x, Coord y, Coord radius, Angle startAngle, Angle endAngle)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_ARCF);
+    IGLFCNV (OP_ARCF, 5);
     fcn->params[0].f = x;
     fcn->params[1].f = y;
     fcn->params[2].f = radius;
@@ -860,7 +864,7 @@ void
 iglObj_circ (Coord x, Coord y, Coord radius)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_CIRC);
+    IGLFCNV (OP_CIRC, 3);
     fcn->params[0].f = x;
     fcn->params[1].f = y;
     fcn->params[2].f = radius;
@@ -870,7 +874,7 @@ void
 iglObj_circf (Coord x, Coord y, Coord radius)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_CIRCF);
+    IGLFCNV (OP_CIRCF, 3);
     fcn->params[0].f = x;
     fcn->params[1].f = y;
     fcn->params[2].f = radius;
@@ -880,52 +884,52 @@ void
 iglObj_bgntmesh (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_BGNTMESH);
+    IGLFCNV (OP_BGNTMESH, 0);
 }
 
 void
 iglObj_swaptmesh (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_SWAPTMESH);
+    IGLFCNV (OP_SWAPTMESH, 0);
 }
 
 void
 iglObj_bgnclosedline (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_BGNCLOSEDLINE);
+    IGLFCNV (OP_BGNCLOSEDLINE, 0);
 }
 
 void
 iglObj_bgncurve (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_BGNCURVE);
+    IGLFCNV (OP_BGNCURVE, 0);
 }
 
 void
 iglObj_endcurve (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_ENDCURVE);
+    IGLFCNV (OP_ENDCURVE, 0);
 }
 
 void
 iglObj_nurbscurve (long knotCount, const double *knotList, long offset, const double *ctlArray, long order, long type)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_NURBSCURVE);
+    IGLFCNV (OP_NURBSCURVE, 6);
 
     /* TODO: store knotList in compact format, minimizing knotCount */
     fcn->params[0].i = knotCount;
-    fcn->params[1].v = malloc (knotCount*sizeof (double));
+    fcn->params[1].v = _igl_allocObjectData (obj, knotCount*sizeof (double));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, knotList, knotCount*sizeof (double));
 
     /* TODO: store ctlArray in compact format, minimizing order */
     fcn->params[2].i = offset;
-    fcn->params[3].v = malloc (order*sizeof (double));
+    fcn->params[3].v = _igl_allocObjectData (obj, order*sizeof (double));
     if (fcn->params[3].v != NULL)
         memcpy (fcn->params[3].v, ctlArray, order*sizeof (double));
 
@@ -937,37 +941,37 @@ void
 iglObj_bgnsurface (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_BGNSURFACE);
+    IGLFCNV (OP_BGNSURFACE, 0);
 }
 
 void
 iglObj_endsurface (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_ENDSURFACE);
+    IGLFCNV (OP_ENDSURFACE, 0);
 }
 
 void
 iglObj_nurbssurface (long scount, const double *sknot, long tcount, const double *tknot, long soffset, long toffset, const double *ctlArray, long sorder, long torder, long type)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_NURBSSURFACE);
+    IGLFCNV (OP_NURBSSURFACE, 10);
 
     /* TODO: store *knot, in compact format, with minimal *count */
     fcn->params[0].i = scount;
-    fcn->params[1].v = malloc (scount*sizeof (double));
+    fcn->params[1].v = _igl_allocObjectData (obj, scount*sizeof (double));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, sknot, scount*sizeof (double));
 
     fcn->params[2].i = tcount;
-    fcn->params[3].v = malloc (tcount*sizeof (double));
+    fcn->params[3].v = _igl_allocObjectData (obj, tcount*sizeof (double));
     if (fcn->params[3].v != NULL)
         memcpy (fcn->params[3].v, tknot, tcount*sizeof (double));
 
     /* TODO: store ctlArray in compact format, with minimal *order */
     fcn->params[4].i = soffset;
     fcn->params[5].i = toffset;
-    fcn->params[6].v = malloc (sorder*sizeof (double));
+    fcn->params[6].v = _igl_allocObjectData (obj, sorder*sizeof (double));
     if (fcn->params[6].v != NULL)
         memcpy (fcn->params[6].v, ctlArray, sorder*sizeof (double));
 
@@ -980,25 +984,25 @@ void
 iglObj_bgntrim (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_BGNTRIM);
+    IGLFCNV (OP_BGNTRIM, 0);
 }
 
 void
 iglObj_endtrim (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_ENDTRIM);
+    IGLFCNV (OP_ENDTRIM, 0);
 }
 
 void
 iglObj_pwlcurve (long n, double *dataArray, long byteSize, long type)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_PWLCURVE);
+    IGLFCNV (OP_PWLCURVE, 4);
 
     /* TODO: store dataArray in compact format, using minimal byteSize */
     fcn->params[0].i = n;
-    fcn->params[1].v = malloc (n*sizeof (double));
+    fcn->params[1].v = _igl_allocObjectData (obj, n*sizeof (double));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, dataArray, n*sizeof (double));
 
@@ -1010,7 +1014,7 @@ void
 iglObj_setnurbsproperty (long property, float value)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_SETNURBSPROPERTY);
+    IGLFCNV (OP_SETNURBSPROPERTY, 2);
     fcn->params[0].i = property;
     fcn->params[1].f = value;
 }
@@ -1019,42 +1023,42 @@ void
 iglObj_bgnline (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_BGNLINE);
+    IGLFCNV (OP_BGNLINE, 0);
 }
 
 void
 iglObj_bgnpoint (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_BGNPOINT);
+    IGLFCNV (OP_BGNPOINT, 0);
 }
 
 void
 iglObj_endpoint (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_ENDPOINT);
+    IGLFCNV (OP_ENDPOINT, 0);
 }
 
 void
 iglObj_bgnpolygon (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_BGNPOLYGON);
+    IGLFCNV (OP_BGNPOLYGON, 0);
 }
 
 void
 iglObj_bgnqstrip (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_BGNQSTRIP);
+    IGLFCNV (OP_BGNQSTRIP, 0);
 }
 
 void
 iglObj_curveit (short niter)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_CURVEIT);
+    IGLFCNV (OP_CURVEIT, 1);
     fcn->params[0].i = niter;
 }
 
@@ -1062,9 +1066,9 @@ void
 iglObj_crvn (long n, Coord points[][3])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_CRVN);
+    IGLFCNV (OP_CRVN, 2);
     fcn->params[0].i = n;
-    fcn->params[1].v = malloc (n*3*sizeof (Coord));
+    fcn->params[1].v = _igl_allocObjectData (obj, n*3*sizeof (Coord));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, points, n*3*sizeof (Coord));
 }
@@ -1073,9 +1077,9 @@ void
 iglObj_rcrvn (long n, Coord points[][4])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_RCRVN);
+    IGLFCNV (OP_RCRVN, 2);
     fcn->params[0].i = n;
-    fcn->params[1].v = malloc (n*4*sizeof (Coord));
+    fcn->params[1].v = _igl_allocObjectData (obj, n*4*sizeof (Coord));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, points, n*4*sizeof (Coord));
 }
@@ -1084,7 +1088,7 @@ void
 iglObj_curveprecision (short n)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_CURVEPRECISION);
+    IGLFCNV (OP_CURVEPRECISION, 1);
     fcn->params[0].i = n;
 }
 
@@ -1092,7 +1096,7 @@ void
 iglObj_curvebasis (short n)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_CURVEBASIS);
+    IGLFCNV (OP_CURVEBASIS, 1);
     fcn->params[0].i = n;
 }
 
@@ -1100,14 +1104,14 @@ void
 iglObj_patch (Matrix geomx, Matrix geomy, Matrix geomz)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_PATCH);
-    fcn->params[0].v = malloc (4*4*sizeof (float));
+    IGLFCNV (OP_PATCH, 3);
+    fcn->params[0].v = _igl_allocObjectData (obj, 4*4*sizeof (float));
     if (fcn->params[0].v != NULL)
         memcpy (fcn->params[0].v, geomx, 4*4*sizeof (float));
-    fcn->params[1].v = malloc (4*4*sizeof (float));
+    fcn->params[1].v = _igl_allocObjectData (obj, 4*4*sizeof (float));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, geomy, 4*4*sizeof (float));
-    fcn->params[2].v = malloc (4*4*sizeof (float));
+    fcn->params[2].v = _igl_allocObjectData (obj, 4*4*sizeof (float));
     if (fcn->params[2].v != NULL)
         memcpy (fcn->params[2].v, geomz, 4*4*sizeof (float));
 }
@@ -1117,17 +1121,17 @@ void
 iglObj_rpatch (Matrix geomx, Matrix geomy, Matrix geomz, Matrix geomw)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_RPATCH);
-    fcn->params[0].v = malloc (4*4*sizeof (float));
+    IGLFCNV (OP_RPATCH, 4);
+    fcn->params[0].v = _igl_allocObjectData (obj, 4*4*sizeof (float));
     if (fcn->params[0].v != NULL)
         memcpy (fcn->params[0].v, geomx, 4*4*sizeof (float));
-    fcn->params[1].v = malloc (4*4*sizeof (float));
+    fcn->params[1].v = _igl_allocObjectData (obj, 4*4*sizeof (float));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, geomy, 4*4*sizeof (float));
-    fcn->params[2].v = malloc (4*4*sizeof (float));
+    fcn->params[2].v = _igl_allocObjectData (obj, 4*4*sizeof (float));
     if (fcn->params[2].v != NULL)
         memcpy (fcn->params[2].v, geomz, 4*4*sizeof (float));
-    fcn->params[3].v = malloc (4*4*sizeof (float));
+    fcn->params[3].v = _igl_allocObjectData (obj, 4*4*sizeof (float));
     if (fcn->params[3].v != NULL)
         memcpy (fcn->params[3].v, geomw, 4*4*sizeof (float));
 }
@@ -1136,7 +1140,7 @@ void
 iglObj_patchcurves (short nu, short nv)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_PATCHCURVES);
+    IGLFCNV (OP_PATCHCURVES, 2);
     fcn->params[0].i = nu;
     fcn->params[1].i = nv;
 }
@@ -1145,7 +1149,7 @@ void
 iglObj_patchprecision (short nu, short nv)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_PATCHPRECISION);
+    IGLFCNV (OP_PATCHPRECISION, 2);
     fcn->params[0].i = nu;
     fcn->params[1].i = nv;
 }
@@ -1154,7 +1158,7 @@ void
 iglObj_patchbasis (short nu, short nv)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_PATCHBASIS);
+    IGLFCNV (OP_PATCHBASIS, 2);
     fcn->params[0].i = nu;
     fcn->params[1].i = nv;
 }
@@ -1163,7 +1167,7 @@ void
 iglObj_nmode (long mode)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_NMODE);
+    IGLFCNV (OP_NMODE, 1);
     fcn->params[0].i = mode;
 }
 
@@ -1171,8 +1175,8 @@ void
 iglObj_n3f (float *vector)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_N3F);
-    fcn->params[0].v = (float *)malloc (3*sizeof (float));
+    IGLFCNV (OP_N3F, 1);
+    fcn->params[0].v = (float *)_igl_allocObjectData (obj, 3*sizeof (float));
     if (fcn->params[0].v != NULL)
         memcpy (fcn->params[0].v, vector, 3*sizeof (float));
 }
@@ -1181,7 +1185,7 @@ void
 iglObj_linesmooth (unsigned long mode)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_LINESMOOTH);
+    IGLFCNV (OP_LINESMOOTH, 1);
     fcn->params[0].ui = mode;
 }
 
@@ -1189,7 +1193,7 @@ void
 iglObj_linewidthf (float width)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_LINEWIDTHF);
+    IGLFCNV (OP_LINEWIDTHF, 1);
     fcn->params[0].f = width;
 }
 
@@ -1197,7 +1201,7 @@ void
 iglObj_setlinestyle (short n)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_SETLINESTYLE);
+    IGLFCNV (OP_SETLINESTYLE, 1);
     fcn->params[0].s = n;
 }
 
@@ -1205,7 +1209,7 @@ void
 iglObj_lsrepeat (long factor)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_LSREPEAT);
+    IGLFCNV (OP_LSREPEAT, 1);
     fcn->params[0].i = factor;
 }
 
@@ -1213,7 +1217,7 @@ void
 iglObj_setpattern (short index)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_SETPATTERN);
+    IGLFCNV (OP_SETPATTERN, 1);
     fcn->params[0].s = index;
 }
 
@@ -1221,7 +1225,7 @@ void
 iglObj_lmbind (short target, short index)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_LMBIND);
+    IGLFCNV (OP_LMBIND, 2);
     fcn->params[0].s = target;
     fcn->params[1].s = index;
 }
@@ -1230,7 +1234,7 @@ void
 iglObj_lmcolor (long mode)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_LMCOLOR);
+    IGLFCNV (OP_LMCOLOR, 1);
     fcn->params[0].i = mode;
 }
 
@@ -1238,7 +1242,7 @@ void
 iglObj_move (Coord x, Coord y, Coord z)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_MOVE);
+    IGLFCNV (OP_MOVE, 3);
     fcn->params[0].f = x;
     fcn->params[1].f = y;
     fcn->params[2].f = z;
@@ -1248,7 +1252,7 @@ void
 iglObj_rmv (Coord dx, Coord dy, Coord dz)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_RMV);
+    IGLFCNV (OP_RMV, 3);
     fcn->params[0].f = dx;
     fcn->params[1].f = dy;
     fcn->params[2].f = dz;
@@ -1258,7 +1262,7 @@ void
 iglObj_rpmv (Coord dx, Coord dy, Coord dz)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_RPMV);
+    IGLFCNV (OP_RPMV, 3);
     fcn->params[0].f = dx;
     fcn->params[1].f = dy;
     fcn->params[2].f = dz;
@@ -1268,7 +1272,7 @@ void
 iglObj_draw (Coord x, Coord y, Coord z)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_DRAW);
+    IGLFCNV (OP_DRAW, 3);
     fcn->params[0].f = x;
     fcn->params[1].f = y;
     fcn->params[2].f = z;
@@ -1278,7 +1282,7 @@ void
 iglObj_rdr (Coord dx, Coord dy, Coord dz)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_RDR);
+    IGLFCNV (OP_RDR, 3);
     fcn->params[0].f = dx;
     fcn->params[1].f = dy;
     fcn->params[2].f = dz;
@@ -1288,7 +1292,7 @@ void
 iglObj_rpdr (Coord dx, Coord dy, Coord dz)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_RPDR);
+    IGLFCNV (OP_RPDR, 3);
     fcn->params[0].f = dx;
     fcn->params[1].f = dy;
     fcn->params[2].f = dz;
@@ -1298,12 +1302,12 @@ void
 iglObj_splf (long n, Coord parray[][3], Colorindex iarray[])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_SPLF);
+    IGLFCNV (OP_SPLF, 3);
     fcn->params[0].i = n;
-    fcn->params[1].v = malloc (n*3*sizeof (Coord));
+    fcn->params[1].v = _igl_allocObjectData (obj, n*3*sizeof (Coord));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, parray, n*3*sizeof (Coord));
-    fcn->params[2].v = malloc (n*sizeof (Colorindex));
+    fcn->params[2].v = _igl_allocObjectData (obj, n*sizeof (Colorindex));
     if (fcn->params[2].v != NULL)
         memcpy (fcn->params[2].v, iarray, n*sizeof (Colorindex));
 }
@@ -1312,12 +1316,12 @@ void
 iglObj_splfi (long n, Icoord parray[][3], Colorindex iarray[])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_SPLFI);
+    IGLFCNV (OP_SPLFI, 3);
     fcn->params[0].i = n;
-    fcn->params[1].v = malloc (n*3*sizeof (Icoord));
+    fcn->params[1].v = _igl_allocObjectData (obj, n*3*sizeof (Icoord));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, parray, n*3*sizeof (Icoord));
-    fcn->params[2].v = malloc (n*sizeof (Colorindex));
+    fcn->params[2].v = _igl_allocObjectData (obj, n*sizeof (Colorindex));
     if (fcn->params[2].v != NULL)
         memcpy (fcn->params[2].v, iarray, n*sizeof (Colorindex));
 }
@@ -1326,12 +1330,12 @@ void
 iglObj_splfs (long n, Scoord parray[][3], Colorindex iarray[])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_SPLFS);
+    IGLFCNV (OP_SPLFS, 3);
     fcn->params[0].i = n;
-    fcn->params[1].v = malloc (n*3*sizeof (Scoord));
+    fcn->params[1].v = _igl_allocObjectData (obj, n*3*sizeof (Scoord));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, parray, n*3*sizeof (Scoord));
-    fcn->params[2].v = malloc (n*sizeof (Colorindex));
+    fcn->params[2].v = _igl_allocObjectData (obj, n*sizeof (Colorindex));
     if (fcn->params[2].v != NULL)
         memcpy (fcn->params[2].v, iarray, n*sizeof (Colorindex));
 }
@@ -1340,12 +1344,12 @@ void
 iglObj_splf2 (long n, Coord parray[][2], Colorindex iarray[])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_SPLF2);
+    IGLFCNV (OP_SPLF2, 3);
     fcn->params[0].i = n;
-    fcn->params[1].v = malloc (n*2*sizeof (Coord));
+    fcn->params[1].v = _igl_allocObjectData (obj, n*2*sizeof (Coord));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, parray, n*2*sizeof (Coord));
-    fcn->params[2].v = malloc (n*sizeof (Colorindex));
+    fcn->params[2].v = _igl_allocObjectData (obj, n*sizeof (Colorindex));
     if (fcn->params[2].v != NULL)
         memcpy (fcn->params[2].v, iarray, n*sizeof (Colorindex));
 }
@@ -1354,12 +1358,12 @@ void
 iglObj_splf2i (long n, Icoord parray[][2], Colorindex iarray[])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_SPLF2I);
+    IGLFCNV (OP_SPLF2I, 3);
     fcn->params[0].i = n;
-    fcn->params[1].v = malloc (n*2*sizeof (Icoord));
+    fcn->params[1].v = _igl_allocObjectData (obj, n*2*sizeof (Icoord));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, parray, n*2*sizeof (Icoord));
-    fcn->params[2].v = malloc (n*sizeof (Colorindex));
+    fcn->params[2].v = _igl_allocObjectData (obj, n*sizeof (Colorindex));
     if (fcn->params[2].v != NULL)
         memcpy (fcn->params[2].v, iarray, n*sizeof (Colorindex));
 }
@@ -1368,12 +1372,12 @@ void
 iglObj_splf2s (long n, Scoord parray[][2], Colorindex iarray[])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_SPLF2S);
+    IGLFCNV (OP_SPLF2S, 3);
     fcn->params[0].i = n;
-    fcn->params[1].v = malloc (n*2*sizeof (Scoord));
+    fcn->params[1].v = _igl_allocObjectData (obj, n*2*sizeof (Scoord));
     if (fcn->params[1].v != NULL)
         memcpy (fcn->params[1].v, parray, n*2*sizeof (Scoord));
-    fcn->params[2].v = malloc (n*sizeof (Colorindex));
+    fcn->params[2].v = _igl_allocObjectData (obj, n*sizeof (Colorindex));
     if (fcn->params[2].v != NULL)
         memcpy (fcn->params[2].v, iarray, n*sizeof (Colorindex));
 }
@@ -1382,7 +1386,7 @@ void
 iglObj_callobj (Object id)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_CALLOBJ);
+    IGLFCNV (OP_CALLOBJ, 1);
     fcn->params[0].i = id;
 }
 
@@ -1390,7 +1394,7 @@ void
 iglObj_tevbind (long target, long index)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_TEVBIND);
+    IGLFCNV (OP_TEVBIND, 2);
     fcn->params[0].i = target;
     fcn->params[1].i = index;
 }
@@ -1399,7 +1403,7 @@ void
 iglObj_texbind (long target, long index)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_TEXBIND);
+    IGLFCNV (OP_TEXBIND, 2);
     fcn->params[0].i = target;
     fcn->params[1].i = index;
 }
@@ -1408,12 +1412,12 @@ void
 iglObj_texgen (long coord, long mode, float *params)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_TEXGEN);
+    IGLFCNV (OP_TEXGEN, 3);
     fcn->params[0].i = coord;
     fcn->params[1].i = mode;
     if (params != NULL)
     {
-        fcn->params[2].v = (float *)malloc (4*sizeof (float));
+        fcn->params[2].v = (float *)_igl_allocObjectData (obj, 4*sizeof (float));
         if (fcn->params[2].v != NULL)
             memcpy (fcn->params[2].v, params, 4*sizeof (float));
     }
@@ -1425,8 +1429,8 @@ void
 iglObj_t4f (float vector[4])
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_T4F);
-    fcn->params[0].v = (float *)malloc (4*sizeof (float));
+    IGLFCNV (OP_T4F, 1);
+    fcn->params[0].v = (float *)_igl_allocObjectData (obj, 4*sizeof (float));
     if (fcn->params[0].v != NULL)
         memcpy (fcn->params[0].v, vector, 4*sizeof (float));
 }
@@ -1435,7 +1439,7 @@ void
 iglObj_cmov (Coord x, Coord y, Coord z)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_CMOV);
+    IGLFCNV (OP_CMOV, 3);
     fcn->params[0].f = x;
     fcn->params[1].f = y;
     fcn->params[2].f = z;
@@ -1445,9 +1449,9 @@ void
 iglObj_lcharstr (long type, void *str)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_LCHARSTR);
+    IGLFCNV (OP_LCHARSTR, 2);
     fcn->params[0].i = type;
-    fcn->params[1].v = malloc (strlen ((char *)str) + 1);
+    fcn->params[1].v = _igl_allocObjectData (obj, strlen ((char *)str) + 1);
     if (fcn->params[1].v != NULL)
         strcpy ((char *)fcn->params[1].v, (char *)str);
 }
@@ -1456,7 +1460,7 @@ void
 iglObj_font (short fntnum)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_FONT);
+    IGLFCNV (OP_FONT, 1);
     fcn->params[0].s = fntnum;
 }
 
@@ -1464,28 +1468,28 @@ void
 iglObj_pushattributes (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_PUSHATTRIBUTES);
+    IGLFCNV (OP_PUSHATTRIBUTES, 0);
 }
 
 void
 iglObj_popattributes (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_POPATTRIBUTES);
+    IGLFCNV (OP_POPATTRIBUTES, 0);
 }
 
 void
 iglObj_initnames (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_INITNAMES);
+    IGLFCNV (OP_INITNAMES, 0);
 }
 
 void
 iglObj_loadname (short name)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_LOADNAME);
+    IGLFCNV (OP_LOADNAME, 1);
     fcn->params[0].s = name;
 }
 
@@ -1493,7 +1497,7 @@ void
 iglObj_pushname (short name)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_PUSHNAME);
+    IGLFCNV (OP_PUSHNAME, 1);
     fcn->params[0].s = name;
 }
 
@@ -1501,7 +1505,7 @@ void
 iglObj_popname (void)
 {
     IGL_CHECKOBJV ();
-    IGLFCNV (OP_POPNAME);
+    IGLFCNV (OP_POPNAME, 0);
 }
 
 
@@ -1667,8 +1671,14 @@ _igl_initObjectApi (void)
     API (pushname);
     API (popname);
 
+    /* the render thread's command stream is recorded like objects */
+    igl->pipeApi = malloc (sizeof (igl_apiList));
+    if (igl->pipeApi == NULL)
+        return -1;
+    memcpy (igl->pipeApi, igl->objApi, sizeof (igl_apiList));
+
     /* now in immediate mode */
-    igl->api = igl->execApi;
+    iglThread.api = igl->execApi;
     return 0;
 }
 
@@ -1679,9 +1689,12 @@ _igl_exitObjectApi (void)
     if (igl->execApi != NULL)
         free (igl->execApi);
     igl->execApi = NULL;
-    if (igl->execApi != NULL)
+    if (igl->objApi != NULL)
         free (igl->objApi);
     igl->objApi = NULL;
+    if (igl->pipeApi != NULL)
+        free (igl->pipeApi);
+    igl->pipeApi = NULL;
 }
 
 
@@ -23,6 +23,7 @@
 
 #include "igl.h"
 #include "iglcmn.h"
+#include <stddef.h>
 
 
 #define IGL_OBJTAG_RANGE    2147483647      /* INT_MAX or MAX_INT */
@@ -39,14 +40,15 @@
 	- add myfunc to igl_apiList struct
 
  object.c:
-	- add case OP_MYFUNC to _igl_callFunc () and optional case OP_MYFUNC to _igl_deleteObjectFcn (void)
+	- add case OP_MYFUNC to _igl_callFunc () and optional case OP_MYFUNC to _igl_getObjectFcnData ()
 
  objapi.c:
 	- define function iglObj_myfunc (), which adds to the object (see e.g. iglObj_clear())
+	  arrays must be copied to memory from _igl_allocObjectData ()
 	- add API(myfunc) to _igl_initObjectApi.
 
  <appropriate .c file>:
-	- define function myfunc (), which runs igl->api->myfunc
+	- define function myfunc (), which runs iglThread.api->myfunc
 	- define function iglExec_myfunc (), which does the job
  *********************************************************************/
 
@@ -54,6 +56,26 @@
 #define IGL_OBJDEF_TAG      1
 #define IGL_OBJDEF_FCN      2
 
+/* size of a function record with _n params */
+#define IGL_OBJFCNSIZE(_n)  (offsetof (igl_objFcnT, params) + (_n)*sizeof (_igl_objFcnParamU))
+#define IGL_OBJFCNLEN(_ptr) IGL_OBJFCNSIZE (((igl_objFcnT *)(_ptr))->numParams)
+
+/* the chunk holds STARTTAG, the records before the gap, the gap, the records
+ * after the gap and ENDTAG at the very end. Walkers must jump over the gap.
+ */
+#define IGL_OBJSKIPGAP(_obj,_ptr)   ((_ptr) == (_obj)->gapPtr ? (_ptr) + (_obj)->gapSize : (_ptr))
+#define IGL_OBJFIRST(_obj)          IGL_OBJSKIPGAP (_obj, (_obj)->beginPtr + sizeof (igl_objTagT))
+/* offset from beginPtr as if there were no gap, and vice versa */
+#define IGL_OBJOFFSET(_obj,_ptr)    ((_ptr) - (_obj)->beginPtr - ((_ptr) > (_obj)->gapPtr ? (_obj)->gapSize : 0))
+#define IGL_OBJPOINTER(_obj,_off)   ((_obj)->beginPtr + (_off) + \
+                                    ((_obj)->beginPtr + (_off) < (_obj)->gapPtr ? 0 : (_obj)->gapSize))
+/* position of a tag relative to the gap, from beginPtr if it's before the gap
+ * or from the end of the chunk if it's after it. The low bit tells which */
+#define IGL_OBJTAGPOS(_obj,_ptr)    ((_ptr) < (_obj)->gapPtr ? ((_ptr) - (_obj)->beginPtr) << 1 : \
+                                    ((_obj)->chunk + (_obj)->chunkSize - (_ptr)) << 1 | 1)
+#define IGL_OBJTAGPTR(_obj,_pos)    ((_pos) & 1 ? (_obj)->chunk + (_obj)->chunkSize - ((_pos) >> 1) : \
+                                    (_obj)->beginPtr + ((_pos) >> 1))
+
 
 typedef struct
 {
@@ -73,8 +95,8 @@ _igl_dumpObject (igl_objectT *obj)
     igl_objFcnT *fcnPtr;
     int idx;
 
-    _igl_printf ("obj ptr=%p id=%ld chunkSize=%ld chunk=%p beginPtr=%p curPtr=%p endPtr=%p\n",
-        obj, obj->id, obj->chunkSize, obj->chunk, obj->beginPtr, obj->curPtr, obj->endPtr);
+    _igl_printf ("obj ptr=%p id=%ld chunkSize=%ld chunk=%p beginPtr=%p curPtr=%p endPtr=%p gapPtr=%p gapSize=%ld\n",
+        obj, obj->id, obj->chunkSize, obj->chunk, obj->beginPtr, obj->curPtr, obj->endPtr, obj->gapPtr, obj->gapSize);
     if (obj->chunk == NULL)
     {
         _igl_printf ("\n");
@@ -98,9 +120,10 @@ _igl_dumpObject (igl_objectT *obj)
                 fcnPtr = (igl_objFcnT *)ptr;
                 _igl_printf ("\t[%d]FCN opcode=%d\n", idx, fcnPtr->opcode);
                 idx ++;
-                ptr += sizeof (igl_objFcnT);
+                ptr += IGL_OBJFCNLEN (ptr);
             break;
         }
+        ptr = IGL_OBJSKIPGAP (obj, ptr);
 
         if (ptr > obj->endPtr)
         {
@@ -112,16 +135,89 @@ _igl_dumpObject (igl_objectT *obj)
 #endif
 
 
-#define FREEPARAM(_idx) if (fcn->params[_idx].v != NULL) free (fcn->params[_idx].v);
+#if 0
+____________________________ payloads ____________________________
+#endif
+/* NOTE: arrays passed to object functions are copied to a per-object bump
+ * allocator, so that building an object doesn't malloc() for every function,
+ * and the payloads are mostly contiguous with the command stream. Each payload
+ * is preceded by its size. Released payloads are only accounted for, and the
+ * live ones are packed into a new block by closeobj() if more than half of
+ * the memory is dead, and by compactify().
+ */
+#define IGL_OBJDATAHDR          sizeof (double)
+#define IGL_OBJDATASIZE(_s)     (((_s) + IGL_OBJDATAHDR-1) & ~(long)(IGL_OBJDATAHDR-1))
+
+void *
+_igl_allocObjectData (igl_objectT *obj, long size)
+{
+    igl_objArenaT *arena = obj->arena;
+    long need = IGL_OBJDATASIZE (size) + IGL_OBJDATAHDR, blockSize;
+    char *ptr;
+
+    if (arena == NULL || arena->used + need > arena->size)
+    {
+        /* grow block sizes geometrically, up to a limit */
+        blockSize = (arena != NULL ? 2*arena->size : igl->objChunkSize);
+        if (blockSize > IGL_MAXOBJARENASIZE)
+            blockSize = IGL_MAXOBJARENASIZE;
+        if (blockSize < need)
+            blockSize = need;
+
+        arena = (igl_objArenaT *)malloc (sizeof (igl_objArenaT) + blockSize);
+        if (arena == NULL)
+            return (NULL);
+        arena->next = obj->arena;
+        arena->size = blockSize;
+        arena->used = 0;
+        obj->arena = arena;
+    }
+
+    ptr = (char *)arena->data + arena->used;
+    *(long *)ptr = need;
+    arena->used += need;
+    obj->arenaUsed += need;
+
+    return (ptr + IGL_OBJDATAHDR);
+}
+
+
+static void
+_igl_freeObjectData (igl_objectT *obj, void *data)
+{
+    if (data != NULL)
+        obj->arenaDead += *(long *)((char *)data - IGL_OBJDATAHDR);
+}
+
+
 static void
-_igl_deleteObjectFcn (igl_objFcnT *fcn)
+_igl_releaseObjectData (igl_objectT *obj)
 {
+    igl_objArenaT *arena, *next;
+
+    for (arena = obj->arena; arena != NULL; arena = next)
+    {
+        next = arena->next;
+        free (arena);
+    }
+    obj->arena = NULL;
+    obj->arenaUsed = obj->arenaDead = 0;
+}
+
+
+/* get the indices of the params pointing to payloads */
+#define DATAPARAM(_idx)     idx[n++] = _idx
+static int
+_igl_getObjectFcnData (igl_objFcnT *fcn, int *idx)
+{
+    int n = 0;
+
     switch (fcn->opcode)
     {
         case OP_CALLFUNC:
         case OP_CLIPPLANE:
         case OP_TEXGEN:
-            FREEPARAM (2);
+            DATAPARAM (2);
         break;
 
         case OP_FOGVERTEX:
@@ -141,7 +237,7 @@ _igl_deleteObjectFcn (igl_objFcnT *fcn)
         case OP_PWLCURVE:
         case OP_CRVN:
         case OP_RCRVN:
-            FREEPARAM (1);
+            DATAPARAM (1);
         break;
 
         case OP_C4F:
@@ -152,26 +248,26 @@ _igl_deleteObjectFcn (igl_objFcnT *fcn)
         case OP_T4F:
         case OP_LOADMATRIX:
         case OP_MULTMATRIX:
-            FREEPARAM (0);
+            DATAPARAM (0);
         break;
 
         case OP_NURBSCURVE:
-            FREEPARAM (1);
-            FREEPARAM (3);
+            DATAPARAM (1);
+            DATAPARAM (3);
         break;
 
         case OP_NURBSSURFACE:
-            FREEPARAM (1);
-            FREEPARAM (3);
-            FREEPARAM (6);
+            DATAPARAM (1);
+            DATAPARAM (3);
+            DATAPARAM (6);
         break;
 
         case OP_RPATCH:
-            FREEPARAM (3);
+            DATAPARAM (3);
         case OP_PATCH:
-            FREEPARAM (0);
-            FREEPARAM (1);
-            FREEPARAM (2);
+            DATAPARAM (0);
+            DATAPARAM (1);
+            DATAPARAM (2);
         break;
 
         case OP_SPLF:
@@ -180,35 +276,548 @@ _igl_deleteObjectFcn (igl_objFcnT *fcn)
         case OP_SPLF2:
         case OP_SPLF2I:
         case OP_SPLF2S:
-            FREEPARAM (1);
-            FREEPARAM (2);
+            DATAPARAM (1);
+            DATAPARAM (2);
         break;
 
         default:
         break;
     }
+
+    return (n);
+}
+
+
+static void
+_igl_deleteObjectFcn (igl_objectT *obj, igl_objFcnT *fcn)
+{
+    int idx[4], i, n;
+
+    n = _igl_getObjectFcnData (fcn, idx);
+    for (i = 0; i < n; i++)
+        _igl_freeObjectData (obj, fcn->params[idx[i]].v);
+}
+
+
+/* move the live payloads to a new block */
+static void
+_igl_packObjectData (igl_objectT *obj)
+{
+    igl_objArenaT *arena = obj->arena, *next;
+    long used = obj->arenaUsed, dead = obj->arenaDead, size;
+    igl_objFcnT *fcn;
+    int idx[4], i, n;
+    char *ptr;
+    void *data;
+
+    if (arena == NULL || (dead == 0 && arena->next == NULL && arena->used == arena->size))
+        return;
+
+    obj->arena = NULL;
+    obj->arenaUsed = obj->arenaDead = 0;
+    if (used > dead)
+    {
+        obj->arena = (igl_objArenaT *)malloc (sizeof (igl_objArenaT) + used - dead);
+        if (obj->arena == NULL)
+        {
+            obj->arena = arena;
+            obj->arenaUsed = used;
+            obj->arenaDead = dead;
+            return;
+        }
+        obj->arena->next = NULL;
+        obj->arena->size = used - dead;
+        obj->arena->used = 0;
+    }
+
+    ptr = IGL_OBJFIRST (obj);
+    while (ptr != obj->endPtr)
+    {
+        switch (*ptr)
+        {
+            case IGL_OBJDEF_TAG:
+                ptr += sizeof (igl_objTagT);
+            break;
+
+            case IGL_OBJDEF_FCN:
+                fcn = (igl_objFcnT *)ptr;
+                n = _igl_getObjectFcnData (fcn, idx);
+                for (i = 0; i < n; i++)
+                {
+                    if (fcn->params[idx[i]].v == NULL)
+                        continue;
+                    size = *(long *)((char *)fcn->params[idx[i]].v - IGL_OBJDATAHDR) - IGL_OBJDATAHDR;
+                    data = _igl_allocObjectData (obj, size);
+                    memcpy (data, fcn->params[idx[i]].v, size);
+                    fcn->params[idx[i]].v = data;
+                }
+                ptr += IGL_OBJFCNLEN (ptr);
+            break;
+        }
+        ptr = IGL_OBJSKIPGAP (obj, ptr);
+    }
+
+    for (; arena != NULL; arena = next)
+    {
+        next = arena->next;
+        free (arena);
+    }
+}
+
+
+
+
+#if 0
+____________________________ display lists ____________________________
+#endif
+/* NOTE: callobj interprets the object's command stream each time it is called.
+ * To reduce the CPU load, objects are compiled into OpenGL display lists on the
+ * first call in a context, using GL_COMPILE_AND_EXECUTE while interpreting.
+ * The IGL functions do however read and modify the IGL state in igl_windowT,
+ * and some of that is baked into the OpenGL commands (e.g. the current color
+ * emitted with each vertex). Hence, a list is only used if the IGL state at
+ * call time matches the state at compile time, and the IGL state after the call
+ * is restored from the state recorded after compilation.
+ * Only objects consisting of opcodes which don't depend on other state (or
+ * query OpenGL state, or have side effects like picking) are compiled. All
+ * other objects are interpreted as before.
+ */
+
+/* get the IGL state relevant to compiled objects */
+static void
+_igl_getObjState (igl_windowT *wptr, igl_objStateT *st)
+{
+    IGL_CLR (st);
+    st->state = wptr->state & ~(IGL_WSTATE_FULLSCREEN|IGL_WSTATE_MAPPED|IGL_WSTATE_CURSOROFF);
+    st->flags = wptr->flags & (IGL_WFLAGS_RGBA|IGL_WFLAGS_MULTIMAP);
+    st->drawMode = wptr->drawMode;
+    st->epoch = igl->objListEpoch;
+    st->mask = wptr->writeMask;
+    st->index = wptr->colorIndex;
+    st->multimapIndex = wptr->multimapIndex;
+    IGL_V4COPY (st->color, wptr->currentColor);
+    IGL_V4COPY (st->lmcColor, wptr->lmcColor);
+    st->lmcMode = wptr->lmcMode;
+    st->texgenMode = wptr->texgenMode;
+    st->textureType = wptr->textureType;
+    IGL_V3COPY (st->normal, wptr->currentNormal);
+    IGL_V4COPY (st->texcoord, wptr->currentTexcoord);
+    st->gposx = wptr->gposx;
+    st->gposy = wptr->gposy;
+    st->gposz = wptr->gposz;
+}
+
+
+/* set the IGL state after executing a compiled object */
+static void
+_igl_setObjState (igl_windowT *wptr, igl_objStateT *st)
+{
+    wptr->state = (wptr->state & (IGL_WSTATE_FULLSCREEN|IGL_WSTATE_MAPPED|IGL_WSTATE_CURSOROFF)) | st->state;
+    wptr->colorIndex = st->index;
+    IGL_V4COPY (wptr->currentColor, st->color);
+    IGL_V3COPY (wptr->currentNormal, st->normal);
+    IGL_V4COPY (wptr->currentTexcoord, st->texcoord);
+    wptr->gposx = st->gposx;
+    wptr->gposy = st->gposy;
+    wptr->gposz = st->gposz;
+}
+
+
+/* check if an opcode can be compiled. returns IGL_OBJLIST_XXX flags */
+static int
+_igl_listOpcode (int opcode)
+{
+    switch (opcode)
+    {
+        case OP_COLOR:
+        case OP_CPACK:
+        case OP_RGBCOLOR:
+        case OP_C4F:
+        case OP_C4I:
+        case OP_C4S:
+        case OP_N3F:
+        case OP_T4F:
+        case OP_V4F:
+        case OP_SWAPTMESH:
+        case OP_RECT:
+        case OP_RECTF:
+        case OP_ARC:
+        case OP_ARCF:
+        case OP_CIRC:
+        case OP_CIRCF:
+        case OP_POLF:
+        case OP_POLFI:
+        case OP_POLFS:
+        case OP_POLF2:
+        case OP_POLF2I:
+        case OP_POLF2S:
+        case OP_POLY:
+        case OP_POLYI:
+        case OP_POLYS:
+        case OP_POLY2:
+        case OP_POLY2I:
+        case OP_POLY2S:
+        case OP_PDR:
+        case OP_RPDR:
+        case OP_PNT:
+        case OP_MOVE:
+        case OP_RMV:
+        case OP_DRAW:
+        case OP_RDR:
+        case OP_SHADEMODEL:
+        case OP_ZBUFFER:
+        case OP_ZFUNCTION:
+        case OP_BLENDFUNCTION:
+        case OP_AFUNCTION:
+        case OP_LOGICOP:
+        case OP_DITHER:
+        case OP_BACKFACE:
+        case OP_FRONTFACE:
+        case OP_LINEWIDTHF:
+        case OP_LINESMOOTH:
+        case OP_PNTSIZEF:
+        case OP_PNTSMOOTH:
+        case OP_POLYMODE:
+        case OP_NMODE:
+            return (IGL_OBJLIST_COMPILE);
+
+        case OP_TRANSLATE:
+        case OP_ROT:
+        case OP_ROTATE:
+        case OP_SCALE:
+        case OP_PUSHMATRIX:
+        case OP_POPMATRIX:
+        case OP_MULTMATRIX:
+            return (IGL_OBJLIST_COMPILE|IGL_OBJLIST_MATRIX);
+
+        /* primitive delimiters, checked by the caller */
+        case OP_BGNLINE:
+        case OP_BGNPOINT:
+        case OP_BGNPOLYGON:
+        case OP_BGNQSTRIP:
+        case OP_BGNTMESH:
+        case OP_BGNCLOSEDLINE:
+        case OP_PMV:
+        case OP_RPMV:
+        case OP_ENDPOINT:
+        case OP_PCLOS:
+            return (IGL_OBJLIST_COMPILE);
+
+        /* everything else depends on more state, or queries OpenGL state */
+        default:
+            return (0);
+    }
+}
+
+
+/* check if an object can be compiled into a display list */
+static void
+_igl_checkObjectList (igl_objectT *obj)
+{
+    igl_objFcnT *fcn;
+    int flags, depth;
+    char *ptr;
+
+    flags = IGL_OBJLIST_CHECKED|IGL_OBJLIST_COMPILE;
+    depth = 0;
+    ptr = IGL_OBJFIRST (obj);
+    while (ptr != obj->endPtr && (flags & IGL_OBJLIST_COMPILE))
+    {
+        switch (*ptr)
+        {
+            case IGL_OBJDEF_TAG:
+                ptr += sizeof (igl_objTagT);
+            break;
+
+            case IGL_OBJDEF_FCN:
+                fcn = (igl_objFcnT *)ptr;
+                if (!_igl_listOpcode (fcn->opcode))
+                    flags &= ~IGL_OBJLIST_COMPILE;
+                flags |= _igl_listOpcode (fcn->opcode) & IGL_OBJLIST_MATRIX;
+
+                /* primitives must be complete inside the object */
+                switch (fcn->opcode)
+                {
+                    case OP_BGNLINE: case OP_BGNPOINT: case OP_BGNPOLYGON:
+                    case OP_BGNQSTRIP: case OP_BGNTMESH: case OP_BGNCLOSEDLINE:
+                    case OP_PMV: case OP_RPMV:
+                        if (depth++ != 0)
+                            flags &= ~IGL_OBJLIST_COMPILE;
+                    break;
+
+                    case OP_ENDPOINT: case OP_PCLOS:
+                        if (--depth != 0)
+                            flags &= ~IGL_OBJLIST_COMPILE;
+                    break;
+                }
+                ptr += IGL_OBJFCNLEN (ptr);
+            break;
+        }
+        ptr = IGL_OBJSKIPGAP (obj, ptr);
+    }
+
+    if (depth != 0)
+        flags &= ~IGL_OBJLIST_COMPILE;
+    obj->listFlags = flags;
+}
+
+
+/* delete display lists which have been left over in the current context */
+static void
+_igl_deleteDeadLists (HGLRC hrc)
+{
+    int i;
+
+    for (i = 0; i < igl->numDeadLists; )
+    {
+        if (igl->deadLists[i].hrc == hrc)
+        {
+            glDeleteLists (igl->deadLists[i].list, 1);
+            igl->deadLists[i] = igl->deadLists[--igl->numDeadLists];
+        }
+        else
+            i ++;
+    }
+}
+
+
+/* free the display lists of an object */
+static void
+_igl_freeObjectLists (igl_objectT *obj)
+{
+    HGLRC hrc = IGL_NULLCTX;
+    igl_objListT *lists;
+    int i;
+
+    if (iglThread.currentWindow >= 0 && IGL_CTX ()->wnd != IGL_NULLWND)
+        hrc = IGL_HRC (IGL_CTX ());
+
+    for (i = 0; i < obj->numLists; i++)
+    {
+        if (obj->lists[i].hrc == hrc)
+            glDeleteLists (obj->lists[i].list, 1);
+        else
+        {
+            /* can only be deleted if the context is current. Do that later */
+            lists = (igl_objListT *)realloc (igl->deadLists,
+                (igl->numDeadLists + 1)*sizeof (igl_objListT));
+            if (lists == NULL)
+                continue;
+            igl->deadLists = lists;
+            igl->deadLists[igl->numDeadLists++] = obj->lists[i];
+        }
+    }
+
+    if (obj->lists != NULL)
+        free (obj->lists);
+    obj->lists = NULL;
+    obj->numLists = 0;
+    obj->listFlags = 0;
+}
+
+
+/* invalidate all display lists of an object, e.g. if it is edited */
+static void
+_igl_invalidateObjectLists (igl_objectT *obj)
+{
+    int i;
+
+    for (i = 0; i < obj->numLists; i++)
+        obj->lists[i].valid = obj->lists[i].misses = 0;
+    obj->listFlags = 0;
+}
+
+
+/* forget about the display lists of a context which is destroyed. Lists of a
+ * context in the share group outlive it, so delete them if it is current
+ */
+void
+_igl_releaseObjectLists (HGLRC hrc)
+{
+    igl_objectT *obj;
+    int i, j, current;
+
+    if (igl == NULL || hrc == IGL_NULLCTX)
+        return;
+
+    current = (iglThread.currentWindow >= 0 && IGL_HRC (IGL_CTX ()) == hrc);
+
+    IGL_RDLOCKOBJS ();
+    IGL_LOCK (IGL_LOCK_OBJECTS);
+    for (i = 0; i < igl->numUsedObjects; i++)
+    {
+        obj = &igl->objects[i];
+        for (j = 0; j < obj->numLists; )
+        {
+            if (obj->lists[j].hrc == hrc)
+            {
+                if (current)
+                    glDeleteLists (obj->lists[j].list, 1);
+                obj->lists[j] = obj->lists[--obj->numLists];
+            }
+            else
+                j ++;
+        }
+    }
+
+    if (current)
+        _igl_deleteDeadLists (hrc);
+    for (i = 0; i < igl->numDeadLists; )
+    {
+        if (igl->deadLists[i].hrc == hrc)
+            igl->deadLists[i] = igl->deadLists[--igl->numDeadLists];
+        else
+            i ++;
+    }
+    IGL_UNLOCK (IGL_LOCK_OBJECTS);
+    IGL_UNLOCKOBJS ();
+}
+
+
+#if 0
+____________________________ id hashing ____________________________
+#endif
+/* NOTE: objects and tags are looked up by id in open addressing hash tables
+ * with linear probing. Deleted entries are removed by moving subsequent entries
+ * of the same probe sequence back, so there are no tombstones.
+ */
+#define IGL_HASHMINSIZE     64
+#define IGL_HASH(_h,_id)    ((unsigned long)(_id) * 2654435761UL & ((_h)->size-1))
+
+static igl_hashEntryT *
+_igl_hashFind (igl_hashT *h, long id)
+{
+    igl_hashEntryT *e;
+    int i;
+
+    if (h->count == 0)
+        return (NULL);
+
+    for (i = IGL_HASH (h, id); ; i = (i+1) & (h->size-1))
+    {
+        e = &h->table[i];
+        if (e->val < 0)
+            return (NULL);
+        if (e->id == id)
+            return (e);
+    }
+}
+
+
+static int
+_igl_hashResize (igl_hashT *h, int size)
+{
+    igl_hashEntryT *table = h->table, *e;
+    int i, j, oldSize = h->size;
+
+    h->table = (igl_hashEntryT *)malloc (size * sizeof (igl_hashEntryT));
+    if (h->table == NULL)
+    {
+        h->table = table;
+        return (-1);
+    }
+    for (i = 0; i < size; i++)
+        h->table[i].val = -1;
+    h->size = size;
+
+    /* rehash the old entries */
+    for (i = 0; i < oldSize; i++)
+    {
+        if (table[i].val < 0)
+            continue;
+        for (j = IGL_HASH (h, table[i].id); h->table[j].val >= 0; j = (j+1) & (size-1))
+            ;
+        e = &h->table[j];
+        *e = table[i];
+    }
+
+    if (table != NULL)
+        free (table);
+    return (0);
+}
+
+
+static int
+_igl_hashSet (igl_hashT *h, long id, long val)
+{
+    igl_hashEntryT *e;
+    int i;
+
+    /* keep the load factor below 1/2 */
+    if (2*(h->count + 1) > h->size)
+    {
+        if (_igl_hashResize (h, h->size ? 2*h->size : IGL_HASHMINSIZE) != 0)
+            return (-1);
+    }
+
+    for (i = IGL_HASH (h, id); ; i = (i+1) & (h->size-1))
+    {
+        e = &h->table[i];
+        if (e->val < 0)
+        {
+            h->count ++;
+            break;
+        }
+        if (e->id == id)
+            break;
+    }
+    e->id = id;
+    e->val = val;
+
+    return (0);
+}
+
+
+static void
+_igl_hashDelete (igl_hashT *h, long id)
+{
+    igl_hashEntryT *e;
+    int i, j, k;
+
+    e = _igl_hashFind (h, id);
+    if (e == NULL)
+        return;
+
+    /* move back entries following in the probe sequence */
+    i = e - h->table;
+    for (j = (i+1) & (h->size-1); h->table[j].val >= 0; j = (j+1) & (h->size-1))
+    {
+        k = IGL_HASH (h, h->table[j].id);
+        /* entry can be moved to i if its home slot isn't in (i,j] */
+        if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j)))
+        {
+            h->table[i] = h->table[j];
+            i = j;
+        }
+    }
+    h->table[i].val = -1;
+    h->count --;
+}
+
+
+static void
+_igl_hashFree (igl_hashT *h)
+{
+    if (h->table != NULL)
+        free (h->table);
+    h->table = NULL;
+    h->size = h->count = 0;
 }
 
 
+#if 0
+_____________________________________________________
+#endif
 static igl_objectT *
 _igl_findObject (Object id, int *idx)
 {
-    int i;
-
-    for (i=0; i < igl->numAllocatedObjects; i++)
-    {
-        if (igl->objects[i].id == id)
-        {
-            if (idx != NULL)
-                *idx = i;
-            return (&igl->objects[i]);
-        }
-    }
+    igl_hashEntryT *e;
 
+    e = _igl_hashFind (&igl->objectIds, id);
     if (idx != NULL)
-        *idx = -1;
+        *idx = (e != NULL ? e->val : -1);
 
-    return (NULL);
+    return (e != NULL ? &igl->objects[e->val] : NULL);
 }
 
 
@@ -216,69 +825,73 @@ static igl_objectT *
 _igl_allocObject (int *idx)
 {
     igl_objectT *objects;
+    long size;
 
-    /* try to find an "empty" object in the list */
-    _igl_findObject (0, idx);
-    if (*idx == -1)
+    /* try to get a free slot from the free list */
+    if (igl->freeObjects >= 0)
+    {
+        *idx = igl->freeObjects;
+        igl->freeObjects = igl->objects[*idx].nextFree;
+    }
+    else
     {
         /* if we don't have room, realloc the list */
-        if (igl->numObjects + 1 >= igl->numAllocatedObjects)
+        if (igl->numUsedObjects >= igl->numAllocatedObjects)
         {
             /* remember old ptr in case of realloc() failure */
             objects = igl->objects;
+            size = 2*igl->numAllocatedObjects;
 
-            igl->objects = (igl_objectT *)realloc (igl->objects,
-                (igl->numAllocatedObjects + 100)*sizeof (igl_objectT));
+            igl->objects = (igl_objectT *)realloc (igl->objects, size*sizeof (igl_objectT));
             if (igl->objects == NULL)
             {
                 igl->objects = objects;
+                *idx = -1;
                 return (NULL);
             }
 
-            igl->numAllocatedObjects += 100;
+            memset (&igl->objects[igl->numAllocatedObjects], 0,
+                (size - igl->numAllocatedObjects)*sizeof (igl_objectT));
+            igl->numAllocatedObjects = size;
         }
 
-        igl->numObjects ++;
-        *idx = igl->numObjects-1;
-    }
-    else
-    {
-        igl->numObjects ++;
+        *idx = igl->numUsedObjects++;
     }
 
+    igl->numObjects ++;
     return (&igl->objects[*idx]);
 }
 
 
-static void
-_igl_deleteObject (igl_objectT *obj)
+/* release the contents of an object */
+void
+_igl_clearObject (igl_objectT *obj)
 {
-    char *ptr;
-
     if (obj->chunk != NULL)
     {
-        ptr = obj->beginPtr + sizeof (igl_objTagT);
-        while (ptr != obj->endPtr)
-        {
-            switch (*ptr)
-            {
-                case IGL_OBJDEF_TAG:
-                    ptr += sizeof (igl_objTagT);
-                break;
-
-                case IGL_OBJDEF_FCN:
-                    _igl_deleteObjectFcn ((igl_objFcnT *)ptr);
-                    ptr += sizeof (igl_objFcnT);
-                break;
-            }
-        }
-
         free (obj->chunk);
         obj->chunk = NULL;
     }
+    _igl_releaseObjectData (obj);
+    _igl_freeObjectLists (obj);
+    _igl_hashFree (&obj->tags);
+    obj->chunkSize = obj->gapSize = 0;
+    obj->beginPtr = obj->curPtr = obj->endPtr = obj->gapPtr = NULL;
+}
+
+
+static void
+_igl_deleteObject (igl_objectT *obj)
+{
+    int idx = obj - igl->objects;
+
+    _igl_clearObject (obj);
+    _igl_hashDelete (&igl->objectIds, obj->id);
     obj->id = 0;
-    obj->chunkSize = 0;
-    obj->beginPtr = obj->curPtr = obj->endPtr = NULL;
+
+    /* put the slot on the free list */
+    obj->nextFree = igl->freeObjects;
+    igl->freeObjects = idx;
     igl->numObjects --;
 }
 
@@ -291,8 +904,11 @@ _igl_initObjects (void)
         return -1;
 
     igl->numAllocatedObjects = 100;
+    igl->numUsedObjects = 0;
     igl->numObjects = 0;
-    igl->currentObjIdx = -1;
+    igl->freeObjects = -1;
+    igl->nextObjectId = 1;
+    iglThread.currentObjIdx = -1;
     igl->objChunkSize = IGL_DEFOBJCHUNKSIZE;    /* 1020 bytes was IRIX default */
 
     return 0;
@@ -304,7 +920,7 @@ _igl_releaseObjects (void)
 {
     int i;
 
-    for (i=0; i < igl->numAllocatedObjects; i++)
+    for (i=0; i < igl->numUsedObjects; i++)
     {
         if (igl->objects[i].id != 0)
             _igl_deleteObject (&igl->objects[i]);
@@ -313,65 +929,171 @@ _igl_releaseObjects (void)
     if (igl->objects != NULL)
         free (igl->objects);
     igl->objects = NULL;
-    igl->numAllocatedObjects = 0;
+    igl->numAllocatedObjects = igl->numUsedObjects = 0;
+    igl->freeObjects = -1;
+    _igl_hashFree (&igl->objectIds);
+
+    if (igl->deadLists != NULL)
+        free (igl->deadLists);
+    igl->deadLists = NULL;
+    igl->numDeadLists = 0;
 }
 
 
+/* NOTE: objects are edited like a gap buffer. The unused space in the chunk
+ * is kept at the insertion point, so that consecutive inserts don't have to
+ * move the rest of the object. Moving the insertion point only moves the
+ * records between the old and the new position. Tag positions are kept
+ * relative to the gap, so inserting or removing records at the gap and
+ * resizing the chunk don't change them. Only the tags the gap moves across
+ * have to be updated.
+ */
+#define IGL_OBJALIGN(_s)    (((_s) + sizeof (double)-1) & ~(long)(sizeof (double)-1))
+
+/* resize the chunk by resizing the gap */
 static int
-_igl_reallocObjectChunk (igl_objectT *obj, int newSize)
+_igl_reallocObjectChunk (igl_objectT *obj, long newSize)
 {
-    int curDiff, endDiff;
+    long curOff, gapOff, tailOff, tailSize, delta;
     char *chunk = obj->chunk;
 
-    curDiff = obj->curPtr - obj->beginPtr;
-    endDiff = obj->endPtr - obj->beginPtr;
+    delta = newSize - obj->chunkSize;
+    if (obj->gapSize + delta < 0)
+        return (-1);
+
+    curOff = IGL_OBJOFFSET (obj, obj->curPtr);
+    gapOff = obj->gapPtr - obj->beginPtr;
+    tailOff = gapOff + obj->gapSize;
+    tailSize = obj->chunkSize - tailOff;
+
+    /* when shrinking, move the records after the gap down before realloc */
+    if (delta < 0)
+        memmove (obj->chunk + tailOff + delta, obj->chunk + tailOff, tailSize);
 
     obj->chunk = realloc (obj->chunk, newSize);
     if (obj->chunk == NULL)
     {
         obj->chunk = chunk;
-        return (-1);
+        if (delta > 0)
+            return (-1);
     }
-    obj->beginPtr = obj->chunk;
-    obj->curPtr = obj->beginPtr + curDiff;
-    obj->endPtr = obj->beginPtr + endDiff;
+
+    /* when growing, move the records after the gap up after realloc */
+    if (delta > 0)
+        memmove (obj->chunk + tailOff + delta, obj->chunk + tailOff, tailSize);
+
     obj->chunkSize = newSize;
+    obj->gapSize += delta;
+    obj->beginPtr = obj->chunk;
+    obj->gapPtr = obj->beginPtr + gapOff;
+    obj->endPtr = obj->chunk + newSize - sizeof (igl_objTagT);
+    obj->curPtr = IGL_OBJPOINTER (obj, curOff);
 
     return (0);
 }
 
 
+/* update the positions of the tags in size bytes of records at ptr */
+static void
+_igl_moveObjectTags (igl_objectT *obj, char *ptr, long size)
+{
+    igl_hashEntryT *e;
+    char *end = ptr + size;
+
+    if (obj->tags.count == 0)
+        return;
+
+    while (ptr < end)
+    {
+        if (*ptr == IGL_OBJDEF_TAG)
+        {
+            e = _igl_hashFind (&obj->tags, ((igl_objTagT *)ptr)->id);
+            if (e != NULL)
+                e->val = IGL_OBJTAGPOS (obj, ptr);
+            ptr += sizeof (igl_objTagT);
+        }
+        else
+            ptr += IGL_OBJFCNLEN (ptr);
+    }
+}
+
+
+/* move the gap to the position of ptr */
+static void
+_igl_moveObjectGap (igl_objectT *obj, char *ptr)
+{
+    long curOff, size;
+
+    curOff = IGL_OBJOFFSET (obj, obj->curPtr);
+    if (ptr < obj->gapPtr)
+    {
+        size = obj->gapPtr - ptr;
+        memmove (ptr + obj->gapSize, ptr, size);
+        obj->gapPtr = ptr;
+        _igl_moveObjectTags (obj, ptr + obj->gapSize, size);
+    }
+    else if (ptr > obj->gapPtr)
+    {
+        size = ptr - (obj->gapPtr + obj->gapSize);
+        memmove (obj->gapPtr, obj->gapPtr + obj->gapSize, size);
+        obj->gapPtr += size;
+        _igl_moveObjectTags (obj, obj->gapPtr - size, size);
+    }
+    obj->curPtr = IGL_OBJPOINTER (obj, curOff);
+}
+
+
 static igl_objTagT *
 _igl_findObjectTag (igl_objectT *obj, Tag t)
 {
-    igl_objTagT *tagPtr;
-    char *ptr;
-
+    igl_hashEntryT *e;
 
     if (t == STARTTAG)
         return ((igl_objTagT *)obj->beginPtr);
     else if (t == ENDTAG)
         return ((igl_objTagT *)obj->endPtr);
 
-    ptr = obj->beginPtr + sizeof (igl_objTagT);
-    while (ptr != obj->endPtr)
-    {
-        switch (*ptr)
-        {
-            case IGL_OBJDEF_TAG:
-                tagPtr = (igl_objTagT *)ptr;
-                if (tagPtr->id == t)
-                    return (tagPtr);
-                ptr += sizeof (igl_objTagT);
-            break;
+    e = _igl_hashFind (&obj->tags, t);
+    return (e != NULL ? (igl_objTagT *)IGL_OBJTAGPTR (obj, e->val) : NULL);
+}
 
-            case IGL_OBJDEF_FCN:
-                ptr += sizeof (igl_objFcnT);
-            break;
-        }
+
+/* make room for a record at curPtr */
+static char *
+_igl_insertObjectRecord (igl_objectT *obj, long size)
+{
+    char *ptr;
+    long grow;
+
+    _igl_moveObjectGap (obj, obj->curPtr);
+
+    /* check whether we need to resize object's chunk. growing it geometrically
+     * keeps the cost of inserting constant on average */
+    if (obj->gapSize < size)
+    {
+        grow = IGL_OBJALIGN (obj->chunkSize > igl->objChunkSize ? obj->chunkSize : igl->objChunkSize);
+        if (obj->gapSize + grow < size)
+            grow = IGL_OBJALIGN (size - obj->gapSize);
+        if (_igl_reallocObjectChunk (obj, obj->chunkSize + grow) != 0)
+            return (NULL);
     }
 
-    return (NULL);
+    ptr = obj->gapPtr;
+    obj->gapPtr += size;
+    obj->gapSize -= size;
+    obj->curPtr = obj->gapPtr;
+
+    return (ptr);
+}
+
+
+/* remove size bytes of records at ptr */
+static void
+_igl_removeObjectRecords (igl_objectT *obj, char *ptr, long size)
+{
+    /* the records are directly after the gap after moving it */
+    _igl_moveObjectGap (obj, ptr);
+    obj->gapSize += size;
 }
 
 
@@ -380,21 +1102,13 @@ _igl_addObjectTag (igl_objectT *obj, Tag t, Boolean addCurrent)
 {
     igl_objTagT *tag;
 
-    /* check whether we need to resize object's chunk (as we must insert a tag) */
-    if ((obj->endPtr + sizeof (igl_objTagT)) >= (obj->chunk + obj->chunkSize))
-    {
-        if (_igl_reallocObjectChunk (obj, obj->chunkSize + igl->objChunkSize) != 0)
-            return;
-    }
+    tag = (igl_objTagT *)_igl_insertObjectRecord (obj, sizeof (igl_objTagT));
+    if (tag == NULL)
+        return;
 
-    memmove (obj->curPtr + sizeof (igl_objTagT), obj->curPtr, obj->endPtr + sizeof (igl_objTagT) - obj->curPtr);
-    obj->endPtr += sizeof (igl_objTagT);
-    /* create a new tag in the middle */
-    tag = (igl_objTagT *)obj->curPtr;
     tag->type = IGL_OBJDEF_TAG;
     tag->id = t;
-
-    obj->curPtr += sizeof (igl_objTagT);
+    _igl_hashSet (&obj->tags, t, IGL_OBJTAGPOS (obj, (char *)tag));
 
 #if 0
     _igl_printf ("_igl_addObjectTag (%d)\n", t);
@@ -406,11 +1120,8 @@ _igl_addObjectTag (igl_objectT *obj, Tag t, Boolean addCurrent)
 static void
 _igl_deleteObjectTag (igl_objectT *obj, igl_objTagT *tag)
 {
-    char *srcPtr;
-
-    srcPtr = (char *)tag + sizeof (igl_objTagT);
-    memmove ((char *)tag, srcPtr, obj->endPtr + sizeof (igl_objTagT) - srcPtr);
-    obj->endPtr -= sizeof (igl_objTagT);
+    _igl_hashDelete (&obj->tags, tag->id);
+    _igl_removeObjectRecords (obj, (char *)tag, sizeof (igl_objTagT));
     obj->curPtr = obj->endPtr;
 
 #if 0
@@ -421,26 +1132,18 @@ _igl_deleteObjectTag (igl_objectT *obj, igl_objTagT *tag)
 
 
 igl_objFcnT *
-_igl_addObjectFcn (igl_objectT *obj, int opcode)
+_igl_addObjectFcn (igl_objectT *obj, int opcode, int numParams)
 {
     igl_objFcnT *fcn;
 
-    /* check whether we need to resize object's chunk (as we must insert a tag) */
-    if ((obj->endPtr + sizeof (igl_objFcnT)) >= (obj->chunk + obj->chunkSize))
-    {
-        if (_igl_reallocObjectChunk (obj, obj->chunkSize + igl->objChunkSize) != 0)
-            return (NULL);
-    }
+    fcn = (igl_objFcnT *)_igl_insertObjectRecord (obj, IGL_OBJFCNSIZE (numParams));
+    if (fcn == NULL)
+        return (NULL);
 
-    memmove (obj->curPtr + sizeof (igl_objFcnT), obj->curPtr, obj->endPtr + sizeof (igl_objTagT) - obj->curPtr);
-    obj->endPtr += sizeof (igl_objFcnT);
-    /* create a new tag in the middle */
-    fcn = (igl_objFcnT *)obj->curPtr;
     fcn->type = IGL_OBJDEF_FCN;
+    fcn->numParams = numParams;
     fcn->opcode = opcode;
 
-    obj->curPtr += sizeof (igl_objFcnT);
-
 #if 0
     _igl_printf ("_igl_addObjectFcn (%d)\n", opcode);
     _igl_dumpObject (obj);
@@ -569,7 +1272,7 @@ _igl_callFunc (igl_objFcnT *fcn)
         break;
 
         case OP_FOGVERTEX:
-            iglExec_fogvertex (fcn->params[0].i, (float *)fcn->params[0].v);
+            iglExec_fogvertex (fcn->params[0].i, (float *)fcn->params[1].v);
         break;
 
         case OP_LOGICOP:
@@ -1089,29 +1792,92 @@ _____________________________________________________
 Boolean
 isobj (Object id)
 {
-    return ((id > 0 && _igl_findObject (id, NULL) != NULL) ? TRUE : FALSE);
+    Boolean ret;
+
+    IGL_RDLOCKOBJS ();
+    ret = ((id > 0 && _igl_findObject (id, NULL) != NULL) ? TRUE : FALSE);
+    IGL_UNLOCKOBJS ();
+    return (ret);
 }
 
 
 Object
 genobj (void)
 {
-    Object id = 1;  /* is 0 a valid object id? */
+    Object id;
+    long i;
 
-    while (1)
+    /* start searching after the last id made, wrapping around once */
+    IGL_RDLOCKOBJS ();
+    id = igl->nextObjectId;     /* is 0 a valid object id? */
+    for (i = 1; i < IGL_OBJTAG_RANGE; i++)
     {
         if (_igl_findObject (id, NULL) == NULL)
         {
             /* not found in the list, this will be ok */
-            return (id);
+            break;
         }
 
         id ++;
         if (id >= IGL_OBJTAG_RANGE)
-            break;
+            id = 1;
     }
+    IGL_UNLOCKOBJS ();
 
-    return (-1);
+    return (i < IGL_OBJTAG_RANGE ? id : -1);
+}
+
+
+/* allocate the first chunk of an object, holding just start and end tags */
+void
+_igl_initObjectChunk (igl_objectT *obj)
+{
+    igl_objTagT *tag;
+
+    obj->chunkSize = IGL_OBJALIGN (igl->objChunkSize);
+    if (obj->chunkSize < 2*sizeof (igl_objTagT))
+        obj->chunkSize = 2*sizeof (igl_objTagT);
+    obj->chunk = (char *)malloc (obj->chunkSize);
+    memset (obj->chunk, 0, obj->chunkSize);
+
+    /* add start and end tags to the object */
+    obj->beginPtr = obj->chunk;
+    tag = (igl_objTagT *)obj->beginPtr;
+    tag->type = IGL_OBJDEF_TAG;
+    tag->id = STARTTAG;
+
+    obj->endPtr = obj->chunk + obj->chunkSize - sizeof (igl_objTagT);
+    tag = (igl_objTagT *)obj->endPtr;
+    tag->type = IGL_OBJDEF_TAG;
+    tag->id = ENDTAG;
+
+    /* everything in between is gap */
+    obj->gapPtr = obj->beginPtr + sizeof (igl_objTagT);
+    obj->gapSize = obj->endPtr - obj->gapPtr;
+    obj->curPtr = obj->gapPtr;
+}
+
+
+/* empty an object without tags for recording again. The chunk and the
+ * newest payload block are kept, so that a steady stream doesn't allocate
+ */
+void
+_igl_resetObject (igl_objectT *obj)
+{
+    igl_objArenaT *arena = obj->arena;
+
+    obj->gapPtr = obj->beginPtr + sizeof (igl_objTagT);
+    obj->gapSize = obj->endPtr - obj->gapPtr;
+    obj->curPtr = obj->gapPtr;
+
+    if (arena != NULL)
+    {
+        obj->arena = arena->next;
+        _igl_releaseObjectData (obj);
+        arena->next = NULL;
+        arena->used = 0;
+        obj->arena = arena;
+    }
 }
 
 
@@ -1119,46 +1885,45 @@ void
 makeobj (Object id)
 {
     igl_objectT *obj;
-    igl_objTagT *tag;
 
     /* should we allow makeobj() if no windows are created yet? */
     _igl_trace (__func__,TRUE,"%ld",id);
     IGL_CHECKINIT ();
 
     /* makeobj() cannot be used within makeobj() */
-    if (id <= 0 || igl->currentObjIdx != -1)
+    if (id <= 0 || iglThread.currentObjIdx != -1)
         return;
 
-    obj = _igl_findObject (id, &igl->currentObjIdx);
+    IGL_WRLOCKOBJS ();
+    obj = _igl_findObject (id, &iglThread.currentObjIdx);
     /* if obj already exists it will be overwritten */
     if (obj != NULL)
-        _igl_deleteObject (obj);
+        _igl_clearObject (obj);
     else
-        obj = _igl_allocObject (&igl->currentObjIdx);
-
-    if (obj == NULL || igl->currentObjIdx == -1)
+    {
+        obj = _igl_allocObject (&iglThread.currentObjIdx);
+        if (obj != NULL && iglThread.currentObjIdx != -1 &&
+                    _igl_hashSet (&igl->objectIds, id, iglThread.currentObjIdx) != 0)
+        {
+            _igl_deleteObject (obj);
+            iglThread.currentObjIdx = -1;
+        }
+    }
+    if (obj == NULL || iglThread.currentObjIdx == -1)
+    {
+        iglThread.currentObjIdx = -1;
+        IGL_UNLOCKOBJS ();
         return;
+    }
 
     obj->id = id;
+    if (id >= igl->nextObjectId && id+1 < IGL_OBJTAG_RANGE)
+        igl->nextObjectId = id+1;
 
-    /* allocate the first chunk for this object */
-    obj->chunk = (char *)malloc (igl->objChunkSize);
-    memset (obj->chunk, 0, igl->objChunkSize);
-    obj->chunkSize = igl->objChunkSize;
-    igl->api = igl->objApi;
-
-    /* add start and end tags to the object */
-    obj->beginPtr = obj->chunk;
-    tag = (igl_objTagT *)obj->beginPtr;
-    tag->type = IGL_OBJDEF_TAG;
-    tag->id = STARTTAG;
-
-    obj->endPtr = obj->beginPtr + sizeof (igl_objTagT);
-    tag = (igl_objTagT *)obj->endPtr;
-    tag->type = IGL_OBJDEF_TAG;
-    tag->id = ENDTAG;
-
-    obj->curPtr = obj->endPtr;
+    /* the object lock stays write locked until closeobj */
+    _igl_initObjectChunk (obj);
+    iglThread.api = igl->objApi;
+    iglThread.recordObj = obj;
 #if 0
     _igl_printf ("makeobj (%d)\n", id);
     _igl_dumpObject (obj);
@@ -1174,12 +1939,19 @@ closeobj (void)
     _igl_trace (__func__,TRUE,"");
     IGL_CHECKINIT ();
 
-    if (igl->currentObjIdx != -1)
+    if (iglThread.currentObjIdx != -1)
     {
-        obj = &igl->objects[igl->currentObjIdx];
+        obj = &igl->objects[iglThread.currentObjIdx];
         obj->curPtr = obj->beginPtr + sizeof (igl_objTagT);
-        igl->currentObjIdx = -1;
-        igl->api = igl->execApi;
+
+        /* get rid of payloads released by editing */
+        if (2*obj->arenaDead > obj->arenaUsed)
+            _igl_packObjectData (obj);
+
+        /* objects may be executed by other threads again */
+        iglThread.currentObjIdx = -1;
+        IGL_UNLOCKOBJS ();
+        _igl_defaultApi ();
     }
 }
 
@@ -1195,9 +1967,11 @@ delobj (Object id)
     if (id <= 0)
         return;
 
+    IGL_WRLOCKOBJS ();
     obj = _igl_findObject (id, NULL);
     if (obj != NULL)
         _igl_deleteObject (obj);
+    IGL_UNLOCKOBJS ();
 }
 
 
@@ -1209,22 +1983,29 @@ editobj (Object id)
     _igl_trace (__func__,TRUE,"%ld",id);
     IGL_CHECKINIT();
 
-    if (igl->currentObjIdx != -1 || id <= 0)
+    if (iglThread.currentObjIdx != -1 || id <= 0)
         return;
 
-    obj = _igl_findObject (id, &igl->currentObjIdx);
+    /* the object lock stays write locked until closeobj if the object exists */
+    IGL_WRLOCKOBJS ();
+    obj = _igl_findObject (id, &iglThread.currentObjIdx);
     if (obj != NULL)
     {
         obj->curPtr = obj->endPtr;
-        igl->api = igl->objApi;
+        iglThread.api = igl->objApi;
+        iglThread.recordObj = obj;
+
+        /* contents may change, recompile on next callobj */
+        _igl_invalidateObjectLists (obj);
     }
+    IGL_UNLOCKOBJS ();
 }
 
 
 Object
 getopenobj (void)
 {
-    return (igl->currentObjIdx != -1 ? igl->objects[igl->currentObjIdx].id : -1);
+    return (iglThread.currentObjIdx != -1 ? igl->objects[iglThread.currentObjIdx].id : -1);
 }
 
 
@@ -1232,26 +2013,67 @@ void
 callobj (Object id)
 {
     _igl_trace (__func__,FALSE,"%ld",id);
-    igl->api->callobj (id);
+    iglThread.api->callobj (id);
 }
 
 
+/* interpret the command stream of an object */
 void
-iglExec_callobj (Object id)
+_igl_execObject (igl_objectT *obj)
 {
-    char *ptr;
-    igl_objectT *obj;
+    igl_objFcnT *fcn;
+    char *ptr, *next;
 
-    IGL_CHECKWNDV ();
+    ptr = IGL_OBJFIRST (obj);
+    while (ptr != obj->endPtr)
+    {
+        switch (*ptr)
+        {
+            case IGL_OBJDEF_TAG:
+                ptr += sizeof (igl_objTagT);
+            break;
 
-    if (id <= 0)
-        return;
+            case IGL_OBJDEF_FCN:
+                fcn = (igl_objFcnT *)ptr;
+                ptr += IGL_OBJFCNLEN (ptr);
+                if (fcn->opcode != OP_ENDPOINT)
+                {
+                    _igl_callFunc (fcn);
+                    break;
+                }
 
-    obj = _igl_findObject (id, NULL);
-    if (obj == NULL)
-        return;
+                /* look ahead if the next primitive can be merged with this one */
+                next = IGL_OBJSKIPGAP (obj, ptr);
+                while (next != obj->endPtr && *next == IGL_OBJDEF_TAG)
+                    next = IGL_OBJSKIPGAP (obj, next + sizeof (igl_objTagT));
+                fcn = (igl_objFcnT *)next;
+                if (next == obj->endPtr)
+                    _igl_endPrimitive (-1);
+                else if (fcn->opcode == OP_BGNTMESH)
+                    _igl_endPrimitive (GL_TRIANGLES);
+                else if (fcn->opcode == OP_BGNPOINT)
+                    _igl_endPrimitive (GL_POINTS);
+                else
+                    _igl_endPrimitive (-1);
+            break;
+        }
+        ptr = IGL_OBJSKIPGAP (obj, ptr);
+    }
+}
+
+
+/* replay the matrix operations of an object called as display list, so that
+ * the shadow matrix stacks are in sync with OpenGL again
+ */
+static void
+_igl_shadowObjectMatrices (igl_objectT *obj)
+{
+    igl_windowT *wptr = IGL_CTX ();
+    igl_objFcnT *fcn;
+    char *ptr;
 
-    ptr = obj->beginPtr + sizeof (igl_objTagT);
+    wptr->flags |= IGL_WSTATE_SHADOWMATRIX;
+    ptr = IGL_OBJFIRST (obj);
     while (ptr != obj->endPtr)
     {
         switch (*ptr)
@@ -1261,11 +2083,157 @@ iglExec_callobj (Object id)
             break;
 
             case IGL_OBJDEF_FCN:
-                _igl_callFunc ((igl_objFcnT *)ptr);
-                ptr += sizeof (igl_objFcnT);
+                fcn = (igl_objFcnT *)ptr;
+                if (_igl_listOpcode (fcn->opcode) & IGL_OBJLIST_MATRIX)
+                    _igl_callFunc (fcn);
+                ptr += IGL_OBJFCNLEN (ptr);
             break;
         }
+        ptr = IGL_OBJSKIPGAP (obj, ptr);
     }
+    wptr->flags &= ~IGL_WSTATE_SHADOWMATRIX;
+}
+
+
+/* find the display list of a context, create one if not found and requested */
+static igl_objListT *
+_igl_getObjectList (igl_objectT *obj, HGLRC hrc, int create)
+{
+    igl_objListT *entry, *lists;
+    int i;
+
+    for (i = 0, entry = obj->lists; i < obj->numLists; i++, entry++)
+    {
+        if (entry->hrc == hrc)
+            return (entry);
+    }
+    if (!create)
+        return (NULL);
+
+    lists = (igl_objListT *)realloc (obj->lists, (obj->numLists + 1)*sizeof (igl_objListT));
+    if (lists == NULL)
+        return (NULL);
+    obj->lists = lists;
+    entry = &obj->lists[obj->numLists];
+    IGL_CLR (entry);
+    entry->hrc = hrc;
+    entry->list = glGenLists (1);
+    if (entry->list == 0)
+        return (NULL);
+    obj->numLists ++;
+    return (entry);
+}
+
+
+/* execute an object using a display list. returns 0 if it must be interpreted.
+ * The lists are shared by all threads, so they are looked up and updated with
+ * IGL_LOCK_OBJECTS held, but the object executes without it
+ */
+static int
+_igl_callObjectList (igl_objectT *obj)
+{
+    igl_windowT *wptr = IGL_CTX ();
+    HGLRC hrc = IGL_HRC (wptr);
+    igl_objListT *entry;
+    igl_objStateT key, post;
+    GLuint list;
+    int flags, hit;
+
+    if (igl->flags & IGL_IFLAGS_NOOBJLISTS)
+        return (0);
+    /* not inside of primitives or while picking, the state isn't known */
+    if (wptr->bgnDelay || (wptr->state & IGL_WSTATE_PICKING))
+        return (0);
+
+    IGL_LOCK (IGL_LOCK_OBJECTS);
+    if (!(obj->listFlags & IGL_OBJLIST_CHECKED))
+        _igl_checkObjectList (obj);
+    flags = obj->listFlags;
+    if (!(flags & IGL_OBJLIST_COMPILE))
+    {
+        IGL_UNLOCK (IGL_LOCK_OBJECTS);
+        return (0);
+    }
+
+    if (igl->numDeadLists)
+        _igl_deleteDeadLists (hrc);
+
+    /* look for the list of the current context */
+    entry = _igl_getObjectList (obj, hrc, 1);
+    if (entry == NULL)
+    {
+        IGL_UNLOCK (IGL_LOCK_OBJECTS);
+        return (0);
+    }
+
+    _igl_getObjState (wptr, &key);
+    list = entry->list;
+    hit = (entry->valid && !memcmp (&key, &entry->key, sizeof (key)));
+    if (hit)
+        post = entry->post;
+    /* if the state keeps changing, stop recompiling and interpret instead */
+    else if (entry->valid && ++entry->misses > IGL_OBJLIST_MAXMISSES)
+    {
+        IGL_UNLOCK (IGL_LOCK_OBJECTS);
+        return (0);
+    }
+    IGL_UNLOCK (IGL_LOCK_OBJECTS);
+
+    if (hit)
+    {
+        /* state matches, execute the list and update the IGL state */
+        glCallList (list);
+        _igl_glInvalidate (IGL_GLSTATE_ALL);
+        _igl_setObjState (wptr, &post);
+        if (flags & IGL_OBJLIST_MATRIX)
+            _igl_shadowObjectMatrices (obj);
+        return (1);
+    }
+
+    /* (re)compile the list while interpreting the object. The list must
+     * contain all state changes, so none may be filtered away
+     */
+    _igl_glInvalidate (IGL_GLSTATE_ALL);
+    glNewList (list, GL_COMPILE_AND_EXECUTE);
+    _igl_execObject (obj);
+    glEndList ();
+    _igl_getObjState (wptr, &post);
+
+    /* the entry may have been moved by other contexts meanwhile */
+    IGL_LOCK (IGL_LOCK_OBJECTS);
+    entry = _igl_getObjectList (obj, hrc, 0);
+    if (entry != NULL && entry->list == list)
+    {
+        entry->key = key;
+        entry->post = post;
+        entry->valid = 1;
+    }
+    IGL_UNLOCK (IGL_LOCK_OBJECTS);
+
+    return (1);
+}
+
+
+void
+iglExec_callobj (Object id)
+{
+    igl_objectT *obj;
+
+    IGL_CHECKWNDV ();
+
+    if (id <= 0)
+        return;
+
+    /* objects mustn't be deleted or moved by other threads while executing.
+     * Nested calls are covered by the read lock of the outermost one
+     */
+    if (iglThread.callDepth++ == 0)
+        IGL_RDLOCKOBJS ();
+    obj = _igl_findObject (id, NULL);
+    if (obj != NULL && !_igl_callObjectList (obj))
+        _igl_execObject (obj);
+    if (--iglThread.callDepth == 0)
+        IGL_UNLOCKOBJS ();
 }
 
 
@@ -1277,12 +2245,12 @@ gentag (void)
 {
     int id = 1;
 
-    if (igl->currentObjIdx == -1)
+    if (iglThread.currentObjIdx == -1)
         return (-1);
 
     while (1)
     {
-        if (_igl_findObjectTag (&igl->objects[igl->currentObjIdx], id) == NULL)
+        if (_igl_findObjectTag (&igl->objects[iglThread.currentObjIdx], id) == NULL)
             return (id);
 
         id ++;
@@ -1300,10 +2268,10 @@ maketag (Tag t)
     igl_objectT *obj;
 
 
-    if (igl->currentObjIdx == -1 || t == STARTTAG || t == ENDTAG)
+    if (iglThread.currentObjIdx == -1 || t == STARTTAG || t == ENDTAG)
         return;
 
-    obj = &igl->objects[igl->currentObjIdx];
+    obj = &igl->objects[iglThread.currentObjIdx];
     if (_igl_findObjectTag (obj, t) != NULL)
     {
         /* tag exists within current object, nothing to do here */
@@ -1320,10 +2288,10 @@ deltag (Tag t)
     igl_objectT *obj;
 
 
-    if (igl->currentObjIdx == -1 || t == STARTTAG || t == ENDTAG)
+    if (iglThread.currentObjIdx == -1 || t == STARTTAG || t == ENDTAG)
         return;
 
-    obj = &igl->objects[igl->currentObjIdx];
+    obj = &igl->objects[iglThread.currentObjIdx];
     tag = _igl_findObjectTag (obj, t);
     if (tag != NULL)
         _igl_deleteObjectTag (obj, tag);
@@ -1333,10 +2301,10 @@ deltag (Tag t)
 Boolean
 istag (Tag t)
 {
-    if (igl->currentObjIdx == -1)
+    if (iglThread.currentObjIdx == -1)
         return (FALSE);
     else if (t == STARTTAG || t == ENDTAG ||
-            _igl_findObjectTag (&igl->objects[igl->currentObjIdx], t) != NULL)
+            _igl_findObjectTag (&igl->objects[iglThread.currentObjIdx], t) != NULL)
         return (TRUE);
 
     return (FALSE);
@@ -1352,10 +2320,10 @@ newtag (Tag newtg, Tag oldtg, Offset offset)
     char *ptr;
 
     /* note: oldtg can be STARTTAG */
-    if (igl->currentObjIdx == -1 || newtg == STARTTAG || newtg == ENDTAG || oldtg == ENDTAG)
+    if (iglThread.currentObjIdx == -1 || newtg == STARTTAG || newtg == ENDTAG || oldtg == ENDTAG)
         return;
 
-    obj = &igl->objects[igl->currentObjIdx];
+    obj = &igl->objects[iglThread.currentObjIdx];
     if (_igl_findObjectTag (obj, newtg) != NULL)
     {
         /* newtg already exists, bail out */
@@ -1369,7 +2337,7 @@ newtag (Tag newtg, Tag oldtg, Offset offset)
     }
 
     count = 0;
-    ptr = (char *)tag + sizeof (igl_objTagT);
+    ptr = IGL_OBJSKIPGAP (obj, (char *)tag + sizeof (igl_objTagT));
     while (ptr != obj->endPtr && count != offset)
     {
         switch (*ptr)
@@ -1382,10 +2350,11 @@ newtag (Tag newtg, Tag oldtg, Offset offset)
                 count ++;
                 if (count != offset)
                 {
-                    ptr += sizeof (igl_objFcnT);
+                    ptr += IGL_OBJFCNLEN (ptr);
                 }
             break;
         }
+        ptr = IGL_OBJSKIPGAP (obj, ptr);
     }
 
     /* new tag placeholder wasn't found */
@@ -1406,10 +2375,10 @@ objinsert (Tag t)
     igl_objectT *obj;
     igl_objTagT *tag;
 
-    if (igl->currentObjIdx == -1 || t == ENDTAG)
+    if (iglThread.currentObjIdx == -1 || t == ENDTAG)
         return;
 
-    obj = &igl->objects[igl->currentObjIdx];
+    obj = &igl->objects[iglThread.currentObjIdx];
     tag = _igl_findObjectTag (obj, t);
     if (tag == NULL)
         return;
@@ -1423,28 +2392,47 @@ objdelete (Tag tag1, Tag tag2)
 {
     igl_objectT *obj;
     igl_objTagT *t1, *t2;
-    int size;
+    long off1, off2;
+    char *ptr;
 
-    if (igl->currentObjIdx == -1)
+    if (iglThread.currentObjIdx == -1)
         return;
-    obj = &igl->objects[igl->currentObjIdx];
+    obj = &igl->objects[iglThread.currentObjIdx];
 
     t1 = _igl_findObjectTag (obj, tag1);
     if (t1 == NULL)
         return;
 
     t2 = _igl_findObjectTag (obj, tag2);
-    if (t2 == NULL || ((char *)t2 < (char *)t1) || ((char *)t2 - (char *)t1 == sizeof (igl_objTagT)))
+    if (t2 == NULL)
+        return;
+
+    /* delete the records from after t1 up to t2 */
+    off1 = IGL_OBJOFFSET (obj, (char *)t1) + sizeof (igl_objTagT);
+    off2 = IGL_OBJOFFSET (obj, (char *)t2);
+    if (off2 <= off1)
         return;
 
-    size = obj->endPtr + sizeof (igl_objTagT) - (char *)t2;
-    memmove ((char *)t1 + sizeof (igl_objTagT), t2, size);
-    /*
-        (char *)t2 - (char *)t1 - sizeof (igl_objTagT) is the amount
-        of bytes for which we moved t2 towards t1. so we must move endPtr
-        for the same amount
-    */
-    obj->endPtr -= ((char *)t2 - (char *)t1 - sizeof (igl_objTagT));
+    /* drop the tags and release the functions between t1 and t2 */
+    ptr = IGL_OBJSKIPGAP (obj, (char *)t1 + sizeof (igl_objTagT));
+    while (ptr != (char *)t2)
+    {
+        switch (*ptr)
+        {
+            case IGL_OBJDEF_TAG:
+                _igl_hashDelete (&obj->tags, ((igl_objTagT *)ptr)->id);
+                ptr += sizeof (igl_objTagT);
+            break;
+
+            case IGL_OBJDEF_FCN:
+                _igl_deleteObjectFcn (obj, (igl_objFcnT *)ptr);
+                ptr += IGL_OBJFCNLEN (ptr);
+            break;
+        }
+        ptr = IGL_OBJSKIPGAP (obj, ptr);
+    }
+
+    _igl_removeObjectRecords (obj, IGL_OBJPOINTER (obj, off1), off2 - off1);
     obj->curPtr = obj->endPtr;
 #if 0
     _igl_printf ("objdelete (%d, %d)\n", tag1, tag2);
@@ -1461,15 +2449,15 @@ objreplace (Tag t)
     Tag t1, t2;
     char *ptr;
 
-    if (igl->currentObjIdx == -1 || t == ENDTAG)
+    if (iglThread.currentObjIdx == -1 || t == ENDTAG)
         return;
-    obj = &igl->objects[igl->currentObjIdx];
+    obj = &igl->objects[iglThread.currentObjIdx];
 
     tag1 = _igl_findObjectTag (obj, t);
     if (tag1 == NULL)
         return;
 
-    ptr = (char *)tag1 + sizeof (igl_objTagT);
+    ptr = IGL_OBJSKIPGAP (obj, (char *)tag1 + sizeof (igl_objTagT));
     tag2 = NULL;
     while (tag2 == NULL)
     {
@@ -1480,7 +2468,8 @@ objreplace (Tag t)
             break;
 
             case IGL_OBJDEF_FCN:
-                ptr += sizeof (igl_objFcnT);
+                ptr += IGL_OBJFCNLEN (ptr);
+                ptr = IGL_OBJSKIPGAP (obj, ptr);
             break;
         }
     }
@@ -1503,17 +2492,20 @@ chunksize (long chunk)
 void
 compactify (Object id)
 {
-    int newSize;
     igl_objectT *obj;
 
     if (id <= 0)
         return;
-    obj = _igl_findObject (id, NULL);
-    if (obj == NULL || obj->chunkSize <= 0)
-        return;
 
-    /* compact the chunk to fit tags/ops from STARTTAG to ENDTAG */
-    newSize = obj->endPtr + sizeof (igl_objTagT) - obj->beginPtr;
-    if (obj->chunkSize > newSize)
-        _igl_reallocObjectChunk (obj, newSize);
+    IGL_WRLOCKOBJS ();
+    obj = _igl_findObject (id, NULL);
+    if (obj != NULL && obj->chunkSize > 0)
+    {
+        /* close the gap and shrink the chunk to fit tags/ops from STARTTAG to ENDTAG */
+        _igl_moveObjectGap (obj, obj->endPtr);
+        if (obj->gapSize > 0)
+            _igl_reallocObjectChunk (obj, obj->chunkSize - obj->gapSize);
+        _igl_packObjectData (obj);
+    }
+    IGL_UNLOCKOBJS ();
 }
@@ -0,0 +1,318 @@
+/*
+ * pipeline.c
+ *
+ * render thread, executing the API calls recorded by the application thread
+ *
+ *
+ * Copyright (c) 2004 Matevz Bradac
+ * Copyright (c) 2006-2016 Kai-Uwe Bloem
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "igl.h"
+#include "iglcmn.h"
+
+#include <stddef.h>
+#include <errno.h>
+#include <semaphore.h>
+
+
+/* The application thread records the calls into batches, using the same
+ * encoding as objects. Full batches are passed to the render thread through
+ * a ring, which executes them with the GL context of the window they were
+ * recorded for. Head and tail are only written by the application and the
+ * render thread respectively, the semaphores just put them to sleep if the
+ * ring is full or empty.
+ *
+ * Calls which aren't recorded (queries, window management, ...) wait until
+ * the render thread has executed everything, and then run directly in the
+ * application thread until the next swapbuffers or device poll.
+ */
+typedef struct
+{
+    igl_objectT obj;
+    int window;                 /* window the batch was recorded for */
+    int release;                /* release the GL context after the batch */
+    int acquire;                /* take the vertices before the batch */
+    int quit;                   /* stop the render thread */
+} igl_pipeBatchT;
+
+typedef struct igl_pipeT
+{
+    igl_pipeBatchT batch[IGL_PIPEBATCHES];
+    unsigned int head, tail;    /* batches recorded/executed so far */
+    sem_t filled, free;         /* batches to execute/to record into */
+    long emptySize;             /* IGL_OBJUSED() of an empty batch */
+    pthread_t thread;
+
+    /* GL context current in the render thread */
+    HWND wnd;
+    HGLRC hrc;
+
+    /* vertices passed between the threads with the GL context */
+    igl_threadT handover;
+} igl_pipeT;
+
+static igl_pipeT pipeRing;
+
+#define IGL_PIPEBATCH(p,n)  (&(p)->batch[(n) % IGL_PIPEBATCHES])
+
+
+static void
+_igl_pipeWait (sem_t *sem)
+{
+    while (sem_wait (sem) != 0 && errno == EINTR)
+        ;
+}
+
+
+/* exchange the vertices of the calling thread with those in the handover.
+ * A primitive begun in one thread can thus be finished by the other one.
+ */
+static void
+_igl_pipeSwapVertices (igl_pipeT *pipe)
+{
+    size_t ofs = offsetof (igl_threadT, vertices);
+    igl_threadT tmp;
+
+    memcpy ((char *)&tmp + ofs, (char *)&iglThread + ofs, sizeof (igl_threadT) - ofs);
+    memcpy ((char *)&iglThread + ofs, (char *)&pipe->handover + ofs, sizeof (igl_threadT) - ofs);
+    memcpy ((char *)&pipe->handover + ofs, (char *)&tmp + ofs, sizeof (igl_threadT) - ofs);
+}
+
+
+/* execute the batches of the ring */
+static void *
+_igl_pipeThread (void *arg)
+{
+    igl_pipeT *pipe = (igl_pipeT *)arg;
+    igl_pipeBatchT *b;
+    igl_windowT *wptr;
+
+    _igl_initThread ();
+    while (1)
+    {
+        _igl_pipeWait (&pipe->filled);
+        b = IGL_PIPEBATCH (pipe, pipe->tail);
+        if (b->quit)
+            break;
+        if (b->acquire)
+            _igl_pipeSwapVertices (pipe);
+
+        /* windows closed meanwhile have been synchronized before */
+        if (b->window >= 0 && IGL_WINDOW (b->window)->wnd != IGL_NULLWND)
+        {
+            iglThread.currentWindow = b->window;
+            wptr = IGL_CTX ();
+            if (wptr->currentLayer->hwnd != pipe->wnd || wptr->currentLayer->hrc != pipe->hrc)
+            {
+                pipe->wnd = wptr->currentLayer->hwnd;
+                pipe->hrc = wptr->currentLayer->hrc;
+#if PLATFORM_X11
+                _igl_makeCurrent (pipe->wnd, pipe->hrc);
+#endif
+            }
+            _igl_execObject (&b->obj);
+
+            /* single buffered drawing must show up without a swap */
+            if (wptr->drawMode != NORMALDRAW || !(wptr->flags & IGL_WFLAGS_DOUBLEBUFFER))
+                glFlush ();
+            iglThread.currentWindow = -1;
+        }
+
+        /* the application thread is going to use the context. It also gets
+         * the vertices, which may hold a primitive not yet ended
+         */
+        if (b->release)
+            _igl_pipeSwapVertices (pipe);
+        if (b->release && pipe->hrc != IGL_NULLCTX)
+        {
+#if PLATFORM_X11
+            _igl_makeCurrent (None, NULL);
+#endif
+            pipe->wnd = IGL_NULLWND;
+            pipe->hrc = IGL_NULLCTX;
+        }
+
+        _igl_resetObject (&b->obj);
+        b->release = b->acquire = 0;
+        pipe->tail ++;
+        sem_post (&pipe->free);
+    }
+
+    if (pipe->hrc != IGL_NULLCTX)
+    {
+#if PLATFORM_X11
+        _igl_makeCurrent (None, NULL);
+#endif
+        pipe->wnd = IGL_NULLWND;
+        pipe->hrc = IGL_NULLCTX;
+    }
+    return NULL;
+}
+
+
+/* pass the current batch to the render thread, and start recording into the
+ * next one. Blocks if the render thread is IGL_PIPEBATCHES-1 batches behind.
+ */
+static void
+_igl_pipePush (igl_pipeT *pipe)
+{
+    IGL_PIPEBATCH (pipe, pipe->head)->window = iglThread.currentWindow;
+    pipe->head ++;
+    sem_post (&pipe->filled);
+
+    _igl_pipeWait (&pipe->free);
+    iglThread.recordObj = &IGL_PIPEBATCH (pipe, pipe->head)->obj;
+}
+
+
+/* select the API for the calling thread if not in an object definition */
+void
+_igl_defaultApi (void)
+{
+    if (iglThread.currentObjIdx != -1)
+        return;
+
+    if (iglThread.pipelined)
+    {
+        iglThread.api = igl->pipeApi;
+        iglThread.recordObj = &IGL_PIPEBATCH (iglThread.pipe, iglThread.pipe->head)->obj;
+    }
+    else
+    {
+        iglThread.api = igl->execApi;
+        iglThread.recordObj = NULL;
+    }
+}
+
+
+/* wait until the render thread has executed all batches, and continue
+ * directly in the calling thread
+ */
+void
+_igl_pipeSync (void)
+{
+    igl_pipeT *pipe = iglThread.pipe;
+    int i;
+
+    if (!iglThread.pipelined)
+        return;
+
+    IGL_PIPEBATCH (pipe, pipe->head)->release = 1;
+    _igl_pipePush (pipe);
+
+    /* all but the batch being recorded are free if the ring is empty */
+    for (i = 0; i < IGL_PIPEBATCHES-1; i++)
+        _igl_pipeWait (&pipe->free);
+    for (i = 0; i < IGL_PIPEBATCHES-1; i++)
+        sem_post (&pipe->free);
+    _igl_pipeSwapVertices (pipe);
+
+    iglThread.pipelined = 0;
+#if PLATFORM_X11
+    if (iglThread.currentWindow >= 0 && IGL_CTX ()->wnd != IGL_NULLWND)
+        _igl_makeCurrent (IGL_CTX ()->currentLayer->hwnd, IGL_CTX ()->currentLayer->hrc);
+#endif
+    _igl_defaultApi ();
+}
+
+
+/* pass the recorded calls to the render thread. In direct mode this hands
+ * the GL context back to it. Returns the batch to record into.
+ */
+igl_objectT *
+_igl_pipeFlush (void)
+{
+    igl_pipeT *pipe = iglThread.pipe;
+
+    /* object definitions aren't recorded into the batches */
+    if (pipe == NULL || iglThread.currentObjIdx != -1)
+        return (iglThread.recordObj);
+
+    if (!iglThread.pipelined)
+    {
+#if PLATFORM_X11
+        _igl_makeCurrent (None, NULL);
+#endif
+        /* the render thread continues with the vertices of this thread */
+        _igl_pipeSwapVertices (pipe);
+        IGL_PIPEBATCH (pipe, pipe->head)->acquire = 1;
+        iglThread.pipelined = 1;
+        _igl_defaultApi ();
+    }
+    else if (IGL_OBJUSED (iglThread.recordObj) > pipe->emptySize)
+        _igl_pipePush (pipe);
+
+    return (iglThread.recordObj);
+}
+
+
+/* start the render thread. The calling thread continues in direct mode */
+int
+_igl_initPipe (void)
+{
+    igl_pipeT *pipe = &pipeRing;
+    int i;
+
+    memset (pipe, 0, sizeof (igl_pipeT));
+    for (i = 0; i < IGL_PIPEBATCHES; i++)
+        _igl_initObjectChunk (&pipe->batch[i].obj);
+    pipe->emptySize = IGL_OBJUSED (&pipe->batch[0].obj);
+
+    /* the application thread always holds the batch it records into */
+    sem_init (&pipe->filled, 0, 0);
+    sem_init (&pipe->free, 0, IGL_PIPEBATCHES-1);
+    if (pthread_create (&pipe->thread, NULL, _igl_pipeThread, pipe) != 0)
+    {
+        for (i = 0; i < IGL_PIPEBATCHES; i++)
+            _igl_clearObject (&pipe->batch[i].obj);
+        sem_destroy (&pipe->filled);
+        sem_destroy (&pipe->free);
+        return -1;
+    }
+
+    iglThread.pipe = pipe;
+    iglThread.pipelined = 0;
+    return 0;
+}
+
+
+/* stop the render thread. Must be called by the thread which started it */
+void
+_igl_exitPipe (void)
+{
+    igl_pipeT *pipe = iglThread.pipe;
+    int i;
+
+    if (pipe == NULL)
+        return;
+
+    _igl_pipeSync ();
+    IGL_PIPEBATCH (pipe, pipe->head)->quit = 1;
+    sem_post (&pipe->filled);
+    pthread_join (pipe->thread, NULL);
+
+    for (i = 0; i < IGL_PIPEBATCHES; i++)
+        _igl_clearObject (&pipe->batch[i].obj);
+    if (pipe->handover.vertices != NULL)
+        free (pipe->handover.vertices);
+    if (pipe->handover.indices != NULL)
+        free (pipe->handover.indices);
+    sem_destroy (&pipe->filled);
+    sem_destroy (&pipe->free);
+    iglThread.pipe = NULL;
+    _igl_defaultApi ();
+}
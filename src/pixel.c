@@ -25,6 +25,10 @@
 #include "iglcmn.h"
 
 #include <fcntl.h>
+#if PLATFORM_X11
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif
 
 
 /* NOTE: at the moment only STR_B format is supported! */
@@ -62,7 +66,7 @@ void
 cmov (Coord x, Coord y, Coord z)
 {
     _igl_trace (__func__,FALSE,"%g,%g,%g",x,y,z);
-    igl->api->cmov (x, y, z);
+    iglThread.api->cmov (x, y, z);
 }
 
 void
@@ -80,7 +84,7 @@ void
 cmovi (Icoord x, Icoord y, Icoord z)
 {
     _igl_trace (__func__,FALSE,"%d,%d,%d",x,y,z);
-    igl->api->cmov ((Coord)x, (Coord)y, (Coord)z);
+    iglThread.api->cmov ((Coord)x, (Coord)y, (Coord)z);
 }
 
 
@@ -88,7 +92,7 @@ void
 cmovs (Scoord x, Scoord y, Scoord z)
 {
     _igl_trace (__func__,FALSE,"%d,%d,%d",x,y,z);
-    igl->api->cmov ((Coord)x, (Coord)y, (Coord)z);
+    iglThread.api->cmov ((Coord)x, (Coord)y, (Coord)z);
 }
 
 
@@ -96,7 +100,7 @@ void
 cmov2 (Coord x, Coord y)
 {
     _igl_trace (__func__,FALSE,"%g,%g",x,y);
-    igl->api->cmov (x, y, 0.0f);
+    iglThread.api->cmov (x, y, 0.0f);
 }
 
 
@@ -104,7 +108,7 @@ void
 cmov2i (Icoord x, Icoord y)
 {
     _igl_trace (__func__,FALSE,"%d,%d",x,y);
-    igl->api->cmov ((Coord)x, (Coord)y, 0.0f);
+    iglThread.api->cmov ((Coord)x, (Coord)y, 0.0f);
 }
 
 
@@ -112,7 +116,7 @@ void
 cmov2s (Scoord x, Scoord y)
 {
     _igl_trace (__func__,FALSE,"%d,%d",x,y);
-    igl->api->cmov ((Coord)x, (Coord)y, 0.0f);
+    iglThread.api->cmov ((Coord)x, (Coord)y, 0.0f);
 }
 
 
@@ -125,43 +129,103 @@ _igl_fontInit (igl_windowT *wptr, int idx)
     /* layer context are shared context, sharing the display lists */
     if (idx != IGL_WLAYER_NORMALDRAW) {
         /* layers without a window use the context of the query window */
-        if (layer->hrc != IGL_WINDOW (0)->layers[IGL_WLAYER_NORMALDRAW].hrc)
-            layer->_fontBases = wptr->layers[IGL_WLAYER_NORMALDRAW]._fontBases;
-        else
-            layer->_fontBases = IGL_WINDOW (0)->layers[IGL_WLAYER_NORMALDRAW]._fontBases;
+        if (layer->hrc == IGL_WINDOW (0)->layers[IGL_WLAYER_NORMALDRAW].hrc)
+            wptr = IGL_WINDOW (0);
+        layer->_fontBases = wptr->layers[IGL_WLAYER_NORMALDRAW]._fontBases;
+        layer->_fontAtlases = wptr->layers[IGL_WLAYER_NORMALDRAW]._fontAtlases;
         return;
     }
 
-    if (layer->_fontBases == NULL)
-        layer->_fontBases = malloc(IGL_MAXFONTS*sizeof(unsigned));
-    memset (layer->_fontBases, 0, IGL_MAXFONTS*sizeof(unsigned));
+    if (wptr->shared)
+    {
+        /* windows in the share group use the process wide font cache. The
+         * query window is always there and doesn't count as a user of it */
+        IGL_LOCK (IGL_LOCK_FONTS);
+        layer->_fontBases = igl->sharedFontBases;
+        layer->_fontAtlases = igl->sharedFontAtlases;
+        if (wptr != IGL_WINDOW (0))
+            igl->sharedFontUsers ++;
+        IGL_UNLOCK (IGL_LOCK_FONTS);
+        if (layer->_fontBases[0] != 0)
+            return;
+    }
+    else
+    {
+        if (layer->_fontBases == NULL)
+            layer->_fontBases = malloc(IGL_MAXFONTS*sizeof(unsigned));
+        memset (layer->_fontBases, 0, IGL_MAXFONTS*sizeof(unsigned));
+        if (layer->_fontAtlases == NULL)
+            layer->_fontAtlases = calloc(IGL_MAXFONTS, sizeof(igl_fontAtlasT *));
+    }
 
 #if PLATFORM_X11
-    layer->_fontBases[0] = glGenLists (igl->fontDefs[0].nChars);
-    glXUseXFont (igl->fontDefs[0].xfont->fid, igl->fontDefs[0].firstChar,
+    /* there's no system font without X server */
+    if (igl->fontDefs[0].xfont != NULL)
+    {
+        layer->_fontBases[0] = glGenLists (igl->fontDefs[0].nChars);
+        glXUseXFont (igl->fontDefs[0].xfont->fid, igl->fontDefs[0].firstChar,
                     igl->fontDefs[0].nChars, layer->_fontBases[0]);
+    }
 #endif
 }
 
+/* free a glyph atlas. The texture can only be deleted in its share group */
+static void
+_igl_freeFontAtlas (igl_fontAtlasT **atlas, int current)
+{
+    if (*atlas == NULL)
+        return;
+
+    if (current && (*atlas)->texture != 0)
+    {
+        glDeleteTextures (1, &(*atlas)->texture);
+        /* it may still be bound in other contexts of the share group */
+        _igl_glInvalidateAll (IGL_GLSTATE_TEXTURE);
+    }
+    free (*atlas);
+    *atlas = NULL;
+}
+
 /* release font property resources */
 void
 _igl_fontRelease (igl_windowT *wptr, int idx)
 {
     igl_layerT *layer = &wptr->layers[idx];
+    unsigned int *bases = layer->_fontBases;
+    igl_fontAtlasT **atlases = layer->_fontAtlases;
     int j;
 
     /* Only do this if this is NORMALDRAW, since it destroys the display list */
-    if (layer->_fontBases == NULL || idx != IGL_WLAYER_NORMALDRAW)
+    if (bases == NULL || idx != IGL_WLAYER_NORMALDRAW)
         return;
 
+    layer->_fontBases = NULL;
+    layer->_fontAtlases = NULL;
+
+    /* the shared font cache is released with its last user */
+    if (bases == igl->sharedFontBases)
+    {
+        IGL_LOCK (IGL_LOCK_FONTS);
+        j = (wptr == IGL_WINDOW (0) || --igl->sharedFontUsers > 0);
+        IGL_UNLOCK (IGL_LOCK_FONTS);
+        if (j)
+            return;
+    }
+
     for (j=0; j < IGL_MAXFONTS; j++)
     {
-        if (layer->_fontBases[j] != 0)
-            glDeleteLists (layer->_fontBases[j], igl->fontDefs[j].nChars);
+        if (bases[j] != 0)
+            glDeleteLists (bases[j], igl->fontDefs[j].nChars);
+        bases[j] = 0;
+        if (atlases != NULL)
+            _igl_freeFontAtlas (&atlases[j], 1);
     }
 
-    free (layer->_fontBases);
-    layer->_fontBases = NULL;
+    if (bases != igl->sharedFontBases)
+    {
+        free (bases);
+        free (atlases);
+    }
 }
 
 /* upload a bitmap font to OpenGL */
@@ -220,9 +284,317 @@ _igl_loadfont (int n)
     {
         /* loadXfont */
 #if PLATFORM_X11
-        glXUseXFont (igl->fontDefs[n].xfont->fid, igl->fontDefs[n].firstChar, igl->fontDefs[n].nChars, wptr->fontBases[n]);
+        if (igl->fontDefs[n].xfont != NULL)
+            glXUseXFont (igl->fontDefs[n].xfont->fid, igl->fontDefs[n].firstChar, igl->fontDefs[n].nChars, wptr->fontBases[n]);
+#endif
+    }
+}
+
+/* set the glBitmap parameters of a glyph */
+static void
+_igl_setGlyph (igl_glyphT *g, int w, int h, int xorig, int yorig, int xmove, int ymove)
+{
+    g->w = (w > 0 && h > 0 ? w : 0);
+    g->h = (w > 0 && h > 0 ? h : 0);
+    g->xorig = xorig;
+    g->yorig = yorig;
+    g->xmove = xmove;
+    g->ymove = ymove;
+}
+
+/* pack the glyphs into rows with 1 pixel spacing. returns the used height */
+static int
+_igl_packGlyphs (igl_fontAtlasT *atlas)
+{
+    igl_glyphT *g;
+    int c, x = 0, y = 0, rowh = 0;
+
+    for (c = 0, g = atlas->glyphs; c < 256; c++, g++)
+    {
+        if (g->w == 0)
+            continue;
+        if (g->w >= atlas->width)
+            return (-1);
+        if (x + g->w >= atlas->width)
+        {
+            x = 0;
+            y += rowh + 1;
+            rowh = 0;
+        }
+        g->x = x;
+        g->y = y;
+        x += g->w + 1;
+        if (rowh < g->h)
+            rowh = g->h;
+    }
+    return (y + rowh);
+}
+
+/* copy a glyph from a glBitmap raster into the atlas */
+static void
+_igl_rasterGlyph (igl_fontAtlasT *atlas, GLubyte *bm, igl_glyphT *g, GLubyte *src)
+{
+    int bpl = (g->w + 15) / 16 * 2;     /* lines are aligned to shorts */
+    GLubyte *dst;
+    int x, y;
+
+    for (y = 0; y < g->h; y++, src += bpl)
+    {
+        dst = &bm[(g->y + y)*atlas->width + g->x];
+        for (x = 0; x < g->w; x++)
+            dst[x] = (src[x/8] & (0x80 >> (x&7)) ? 0xff : 0);
+    }
+}
+
+#define IGL_MAXATLASSIZE    2048
+
+/* rasterize a font into an alpha texture for drawing text as textured quads */
+static igl_fontAtlasT *
+_igl_loadFontAtlas (int n)
+{
+    igl_windowT *wptr = IGL_CTX ();
+    igl_fontT *font = &igl->fontDefs[n];
+    igl_fontAtlasT *atlas;
+    igl_glyphT *g;
+    GLubyte *bm;
+    int c, i, x, y, h;
+
+    if (wptr->fontAtlases[n] != NULL)
+        return (wptr->fontAtlases[n]);
+    atlas = wptr->fontAtlases[n] = calloc (1, sizeof(*atlas));
+
+    /* get the glyph sizes, like _igl_loadfont does */
+    if (font->chars != NULL)
+    {
+        Fontchar *fc;
+        for (i = 0, fc = font->chars; i < font->nChars && i < 256; i++, fc++)
+        {
+            signed char xoff = -fc->xoff, yoff = -fc->yoff;
+            _igl_setGlyph (&atlas->glyphs[i], fc->w, fc->h, xoff, yoff, fc->width, 0);
+        }
+    }
+    else if (font->lchars != NULL)
+    {
+        Lfontchar *fc;
+        for (i = 0, fc = font->lchars; i < font->nChars; i++, fc++)
+        {
+            if (fc->value <= 0xff)
+                _igl_setGlyph (&atlas->glyphs[fc->value], fc->w, fc->h, -fc->xoff, -fc->yoff, fc->xmove, fc->ymove);
+        }
+    }
+#if PLATFORM_X11
+    else if (font->xfont != NULL)
+    {
+        /* glXUseXFont parameters from the X character metrics */
+        XFontStruct *f = font->xfont;
+        XCharStruct *cs;
+        for (c = font->firstChar; c < font->firstChar + font->nChars; c++)
+        {
+            if (f->per_char == NULL)
+                cs = &f->max_bounds;
+            else if (f->min_byte1 == 0 && c >= f->min_char_or_byte2 && c <= f->max_char_or_byte2)
+                cs = &f->per_char[c - f->min_char_or_byte2];
+            else
+                continue;
+            _igl_setGlyph (&atlas->glyphs[c], cs->rbearing - cs->lbearing, cs->ascent + cs->descent,
+                        -cs->lbearing, cs->descent, cs->width, 0);
+        }
+    }
+#endif
+
+    /* find a texture size which is about square */
+    for (atlas->width = 64; atlas->width <= IGL_MAXATLASSIZE; atlas->width *= 2)
+    {
+        h = _igl_packGlyphs (atlas);
+        if (h >= 0 && h <= atlas->width)
+            break;
+    }
+    if (atlas->width > IGL_MAXATLASSIZE)
+        return (atlas);
+    for (atlas->height = 1; atlas->height < h; atlas->height *= 2)
+        ;
+
+    /* rasterize the glyphs, with the bottom line first like glBitmap */
+    bm = calloc (atlas->width, atlas->height);
+    if (font->chars != NULL)
+    {
+        for (i = 0; i < font->nChars && i < 256; i++)
+            _igl_rasterGlyph (atlas, bm, &atlas->glyphs[i],
+                        &font->raster[sizeof(short)*font->chars[i].offset]);
+    }
+    else if (font->lchars != NULL)
+    {
+        for (i = 0; i < font->nChars; i++)
+        {
+            if (font->lchars[i].value <= 0xff)
+                _igl_rasterGlyph (atlas, bm, &atlas->glyphs[font->lchars[i].value],
+                        &font->raster[sizeof(short)*font->lchars[i].offset]);
+        }
+    }
+#if PLATFORM_X11
+    else if (font->xfont != NULL)
+    {
+        /* draw the glyphs into a bitmap upside down and read it back */
+        Display *dpy = IGL_DISPLAY;
+        XFontStruct *f = font->xfont;
+        Pixmap p;
+        XImage *img;
+        XGCValues gcv;
+        GC gc;
+
+        p = XCreatePixmap (dpy, IGL_ROOT, atlas->width, atlas->height, 1);
+        gcv.font = f->fid;
+        gcv.foreground = 0;
+        gc = XCreateGC (dpy, p, (GCFont|GCForeground), &gcv);
+        XFillRectangle (dpy, p, gc, 0, 0, atlas->width, atlas->height);
+        XSetForeground (dpy, gc, 1);
+        for (c = 0, g = atlas->glyphs; c < 256; c++, g++)
+        {
+            char ch = c;
+            if (g->w != 0)
+                XDrawString (dpy, p, gc, g->x + g->xorig,
+                        atlas->height - (g->y + g->h) + (g->h - g->yorig), &ch, 1);
+        }
+        img = XGetImage (dpy, p, 0, 0, atlas->width, atlas->height, 1, ZPixmap);
+        if (img != NULL)
+        {
+            for (y = 0; y < atlas->height; y++)
+                for (x = 0; x < atlas->width; x++)
+                    bm[y*atlas->width + x] = (XGetPixel (img, x, atlas->height-1 - y) ? 0xff : 0);
+            XDestroyImage (img);
+        }
+        XFreeGC (dpy, gc);
+        XFreePixmap (dpy, p);
+    }
 #endif
+
+    glGenTextures (1, &atlas->texture);
+    glBindTexture (GL_TEXTURE_2D, atlas->texture);
+    glPixelStorei (GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D (GL_TEXTURE_2D, 0, GL_ALPHA, atlas->width, atlas->height, 0, GL_ALPHA, GL_UNSIGNED_BYTE, bm);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+    glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+    free (bm);
+
+    return (atlas);
+}
+
+/* draw a string with the glyph atlas of the current font. The glyphs are
+ * drawn as textured quads at the pixels glBitmap would cover, with the alpha
+ * test dropping the pixels not set in the glyph. Returns 0 if not possible.
+ */
+static int
+_igl_atlasString (igl_windowT *wptr, const unsigned char *str)
+{
+    igl_fontAtlasT *atlas;
+    igl_glyphT *g;
+    GLdouble *m, *p, e[4], c[4];
+    GLboolean mask[4];
+    float rx, ry, rz, sx, sy, x, y;
+    int i;
+
+    /* picking needs the raster position, texturing applies to bitmaps */
+    if ((igl->flags & IGL_IFLAGS_NOFONTATLAS) || wptr->fontAtlases == NULL ||
+        (wptr->state & (IGL_WSTATE_PICKING|IGL_WSTATE_TEXTURING)))
+        return (0);
+    /* glBitmap blends with the raster color alpha, which can't also be the
+     * alpha tested for the glyph pixels if it is 0
+     */
+    if (wptr->currentColor[3] == 0 && _igl_glIsEnabled (GL_BLEND))
+        return (0);
+
+    /* get the window position like glRasterPos. Nothing is drawn if invalid */
+    _igl_getMatrices ();
+    m = wptr->modelMatrix;
+    p = wptr->projMatrix;
+    for (i = 0; i < 4; i++)
+        e[i] = m[i]*wptr->cposx + m[4+i]*wptr->cposy + m[8+i]*wptr->cposz + m[12+i];
+    for (i = 0; i < 4; i++)
+        c[i] = p[i]*e[0] + p[4+i]*e[1] + p[8+i]*e[2] + p[12+i]*e[3];
+    if (c[3] <= 0 || c[0] < -c[3] || c[0] > c[3] || c[1] < -c[3] || c[1] > c[3] ||
+        c[2] < -c[3] || c[2] > c[3])
+        return (1);
+    rx = wptr->viewport[0] + (c[0]/c[3] + 1) * wptr->viewport[2] / 2;
+    ry = wptr->viewport[1] + (c[1]/c[3] + 1) * wptr->viewport[3] / 2;
+    rz = -c[2]/c[3];    /* window z in the orthographic projection below */
+
+    glPushAttrib (GL_ENABLE_BIT | GL_TEXTURE_BIT | GL_COLOR_BUFFER_BIT | GL_POLYGON_BIT | GL_CURRENT_BIT);
+    IGL_LOCK (IGL_LOCK_FONTS);
+    atlas = _igl_loadFontAtlas (wptr->currentFont);
+    IGL_UNLOCK (IGL_LOCK_FONTS);
+    if (atlas->texture == 0)
+    {
+        glPopAttrib ();
+        return (0);
+    }
+
+    /* window coordinates, pixel centers are at integer positions */
+    _igl_pushTransform ();
+    _igl_ortho2D (0);
+    glMatrixMode (GL_TEXTURE);
+    glLoadIdentity ();
+
+    /* NOTE: the state is restored by glPopAttrib, the state cache stays valid */
+    glDisable (GL_TEXTURE_1D);
+    glDisable (GL_TEXTURE_3D);
+    glDisable (GL_TEXTURE_GEN_S);
+    glDisable (GL_TEXTURE_GEN_T);
+    glDisable (GL_TEXTURE_GEN_R);
+    glDisable (GL_TEXTURE_GEN_Q);
+    glDisable (GL_CULL_FACE);
+    glDisable (GL_POLYGON_STIPPLE);
+    glDisable (GL_POLYGON_SMOOTH);
+    glDisable (GL_POLYGON_OFFSET_FILL);
+    glPolygonMode (GL_FRONT_AND_BACK, GL_FILL);
+    glEnable (GL_TEXTURE_2D);
+    glBindTexture (GL_TEXTURE_2D, atlas->texture);
+    glEnable (GL_ALPHA_TEST);
+    if (wptr->currentColor[3] != 0)
+    {
+        /* the fragments get the raster color, or alpha 0 outside of the glyph */
+        glTexEnvi (GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+        glAlphaFunc (GL_GREATER, 0);
+    }
+    else
+    {
+        /* test the glyph alpha, but don't write it */
+        glTexEnvi (GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+        glAlphaFunc (GL_GREATER, 0.5f);
+        _igl_glGetColorMask (mask);
+        glColorMask (mask[0], mask[1], mask[2], GL_FALSE);
+    }
+
+    sx = 1.0f / atlas->width;
+    sy = 1.0f / atlas->height;
+    glBegin (GL_QUADS);
+    for (; *str; str++)
+    {
+        g = &atlas->glyphs[*str];
+        if (g->w != 0)
+        {
+            /* lower left pixel of the bitmap, as in glBitmap */
+            x = floorf (rx - g->xorig) - 0.5f;
+            y = floorf (ry - g->yorig) - 0.5f;
+            glTexCoord2f (g->x*sx, g->y*sy);
+            glVertex3f (x, y, rz);
+            glTexCoord2f ((g->x + g->w)*sx, g->y*sy);
+            glVertex3f (x + g->w, y, rz);
+            glTexCoord2f ((g->x + g->w)*sx, (g->y + g->h)*sy);
+            glVertex3f (x + g->w, y + g->h, rz);
+            glTexCoord2f (g->x*sx, (g->y + g->h)*sy);
+            glVertex3f (x, y + g->h, rz);
+        }
+        rx += g->xmove;
+        ry += g->ymove;
     }
+    glEnd ();
+
+    _igl_popTransform ();
+    glPopAttrib ();
+    return (1);
 }
 
 /* remove a font from OpenGL */
@@ -240,6 +612,9 @@ _igl_unloadFont (int n)
             glDeleteLists (wptr->fontBases[n], igl->fontDefs[n].nChars);
             wptr->fontBases[n] = 0;
         }
+        if (wptr->wnd != (HWND)0 && wptr->fontAtlases != NULL)
+            _igl_freeFontAtlas (&wptr->fontAtlases[n], i == iglThread.currentWindow ||
+                    (wptr->shared && iglThread.currentWindow >= 0 && IGL_CTX ()->shared));
     }
 
     if (igl->fontDefs[n].raster)
@@ -268,7 +643,8 @@ _igl_defineXfont (int n, char *name)
     _igl_unloadFont (idx);
     IGL_CLR_SAVEID(font);
 #if PLATFORM_X11
-    font->xfont = XLoadQueryFont (IGL_DISPLAY, name);
+    if (!IGL_HEADLESS)
+        font->xfont = XLoadQueryFont (IGL_DISPLAY, name);
     if (font->xfont)
     {
         font->firstChar = 32;
@@ -364,7 +740,7 @@ lstrwidth (long type, String str)
     /* if this is the system font, get width from system */
 #if PLATFORM_X11
     if (font->raster == NULL)
-        return XTextWidth (font->xfont, str, len);
+        return (font->xfont != NULL ? XTextWidth (font->xfont, str, len) : 0);
 #endif
 
     /* sum up the width of all characters in the string */
@@ -405,14 +781,14 @@ void
 charstr (String str)
 {
     _igl_trace (__func__,FALSE,"%p(%s)",str,str?str:"");
-    igl->api->lcharstr (STR_B, str);
+    iglThread.api->lcharstr (STR_B, str);
 }
 
 void
 lcharstr (long type, void *str)
 {
     _igl_trace (__func__,FALSE,"%ld,%p(%s)",type,str,str?str:"");
-    igl->api->lcharstr (type, str);
+    iglThread.api->lcharstr (type, str);
 }
 
 void
@@ -431,9 +807,12 @@ iglExec_lcharstr (long type, void *str)
     font = &igl->fontDefs[wptr->currentFont];
 
     IGL_DISLIGHT ();
-    glRasterPos3f (wptr->cposx, wptr->cposy, wptr->cposz);
-    glListBase (wptr->fontBases[wptr->currentFont] - font->firstChar);
-    glCallLists (strlen(str), GL_UNSIGNED_BYTE, str);
+    if (! _igl_atlasString (wptr, str))
+    {
+        glRasterPos3f (wptr->cposx, wptr->cposy, wptr->cposz);
+        glListBase (wptr->fontBases[wptr->currentFont] - font->firstChar);
+        glCallLists (strlen(str), GL_UNSIGNED_BYTE, str);
+    }
 
     wptr->cposx += lstrwidth (type, str);
 }
@@ -444,7 +823,7 @@ void
 font (short fntnum)
 {
     _igl_trace (__func__,FALSE,"%d",fntnum);
-    igl->api->font (fntnum);
+    iglThread.api->font (fntnum);
 }
 
 void
@@ -460,7 +839,9 @@ iglExec_font (short fntnum)
 
     if (igl->fontDefs[idx].nChars != 0)
     {
+        IGL_LOCK (IGL_LOCK_FONTS);
         _igl_loadfont (idx);
+        IGL_UNLOCK (IGL_LOCK_FONTS);
         IGL_CTX ()->currentFont = idx;
     }
 }
@@ -732,17 +1113,30 @@ lrectwrite(Screencoord x1, Screencoord y1, Screencoord x2, Screencoord y2, unsig
     int oglFormat, oglType, oglSize;
     int w = x2-x1+1, h = y2-y1+1;
     unsigned long *image;
+    igl_windowT *wptr;
+    int flipx, flipy;
 
     _igl_trace (__func__,TRUE,"%d,%d,%d,%d,%p",x1,y1,x2,y2,parray);
     IGL_CHECKWNDV ();
+    wptr = IGL_CTX ();
 
     /* writes a rectangular area of RGB/cmap pixels */
     oglSize = _igl_pixInMode (&oglFormat, &oglType);
 
-    image = _igl_pixInConvert (&oglFormat, &oglType, oglSize, parray, w, h);
+    image = _igl_pixInConvertZoom (&oglFormat, &oglType, oglSize, parray, w, h, 1);
     IGL_DISLIGHT ();
-    _igl_setRasterpos (x1, y1);
+
+    /* if passed directly, PM_RTOL/PM_TTOB are done by drawing from the other
+     * side with negative zoom
+     */
+    flipx = (image == parray && wptr->pixRtoL);
+    flipy = (image == parray && wptr->pixTtoB);
+    if (flipx || flipy)
+        glPixelZoom (flipx ? -wptr->xzoom : wptr->xzoom, flipy ? -wptr->yzoom : wptr->yzoom);
+    _igl_setRasterpos (x1 + (flipx ? w*wptr->xzoom : 0), y1 + (flipy ? h*wptr->yzoom : 0));
     glDrawPixels (w, h, oglFormat, oglType, image); 
+    if (flipx || flipy)
+        glPixelZoom (wptr->xzoom, wptr->yzoom);
 
     _igl_pixInEnd (oglFormat, oglType, parray, image);
 }
@@ -773,6 +1167,318 @@ lrectread(Screencoord x1, Screencoord y1, Screencoord x2, Screencoord y2, unsign
 }
 
 
+/* check for PBO and sync support. needs a current OpenGL context */
+static int
+_igl_initReads (void)
+{
+    const char *ext;
+
+    if (igl->readExt)
+        return (igl->readExt > 0);
+
+    igl->readExt = -1;
+#if PLATFORM_X11
+    ext = (const char *)glGetString (GL_EXTENSIONS);
+    if (ext == NULL)
+        return 0;
+
+    /* TODO: replace strstr */
+    if (strstr (ext, "GL_ARB_pixel_buffer_object") || strstr (ext, "GL_EXT_pixel_buffer_object"))
+    {
+        igl->genBuffers = (void (*)(GLsizei, GLuint *))_igl_getOglFunc ("glGenBuffersARB");
+        igl->deleteBuffers = (void (*)(GLsizei, const GLuint *))_igl_getOglFunc ("glDeleteBuffersARB");
+        igl->bindBuffer = (void (*)(GLenum, GLuint))_igl_getOglFunc ("glBindBufferARB");
+        igl->bufferData = (void (*)(GLenum, long, const void *, GLenum))_igl_getOglFunc ("glBufferDataARB");
+        igl->mapBuffer = (void *(*)(GLenum, GLenum))_igl_getOglFunc ("glMapBufferARB");
+        igl->unmapBuffer = (GLboolean (*)(GLenum))_igl_getOglFunc ("glUnmapBufferARB");
+        if (igl->genBuffers && igl->deleteBuffers && igl->bindBuffer && igl->bufferData &&
+                    igl->mapBuffer && igl->unmapBuffer)
+            igl->readExt = 1;
+    }
+    if (igl->readExt > 0 && strstr (ext, "GL_ARB_sync"))
+    {
+        igl->fenceSync = (void *(*)(GLenum, GLbitfield))_igl_getOglFunc ("glFenceSync");
+        igl->clientWaitSync = (GLenum (*)(void *, GLbitfield, uint64_t))_igl_getOglFunc ("glClientWaitSync");
+        igl->deleteSync = (void (*)(void *))_igl_getOglFunc ("glDeleteSync");
+        if (! igl->fenceSync || ! igl->clientWaitSync || ! igl->deleteSync)
+            igl->fenceSync = NULL;
+    }
+#endif
+    return (igl->readExt > 0);
+}
+
+static void
+_igl_releaseRead (igl_readT *rd)
+{
+    if (rd->sync != NULL)
+        igl->deleteSync (rd->sync);
+    if (rd->data != NULL)
+        free (rd->data);
+    rd->sync = rd->data = NULL;
+    rd->pending = 0;
+}
+
+/* release the pending reads and the rectcopy buffer of a window. Its context
+ * must be current, since buffers and fences are shared in the share group
+ */
+void
+_igl_releaseReads (igl_windowT *wptr)
+{
+    int i;
+
+    for (i = 0; i < IGL_MAXREADS; i++)
+    {
+        _igl_releaseRead (&wptr->reads[i]);
+        if (wptr->reads[i].pbo)
+            igl->deleteBuffers (1, &wptr->reads[i].pbo);
+        IGL_CLR (&wptr->reads[i]);
+    }
+
+    if (wptr->copyPbo)
+        igl->deleteBuffers (1, &wptr->copyPbo);
+    wptr->copyPbo = 0;
+    wptr->copySize = 0;
+}
+
+static igl_readT *
+_igl_getRead (long id)
+{
+    igl_readT *rd;
+
+    if (id < 0 || id >= IGL_MAXREADS)
+        return NULL;
+    rd = &IGL_CTX ()->reads[id];
+    return (rd->pending ? rd : NULL);
+}
+
+
+/* IGL: lrectreadstart - starts reading a rectangular array of pixels. Returns
+ * an id for lrectreadend, or -1 if there are too many reads pending. With
+ * GL_ARB_pixel_buffer_object the read overlaps with subsequent rendering.
+ */
+long
+lrectreadstart(Screencoord x1, Screencoord y1, Screencoord x2, Screencoord y2)
+{
+    igl_windowT *wptr;
+    igl_readT *rd;
+    int w = x2-x1+1, h = y2-y1+1, pxsz;
+    long id, size;
+
+    _igl_trace (__func__,TRUE,"%d,%d,%d,%d",x1,y1,x2,y2);
+    IGL_CHECKWND (-1);
+    wptr = IGL_CTX ();
+
+    /* find a free slot */
+    for (id = 0; id < IGL_MAXREADS && wptr->reads[id].pending; id++)
+        ;
+    if (id == IGL_MAXREADS)
+        return -1;
+    rd = &wptr->reads[id];
+    rd->width = w;
+    rd->height = h;
+
+    /* get the layout of the OpenGL data */
+    pxsz = _igl_pixOutDirect (&rd->format, &rd->type);
+    if (pxsz)
+    {
+        rd->rowBytes = (w*pxsz + 7) / 8;
+        rd->rowStride = (wptr->pixStride ? wptr->pixStride : (w*pxsz + 31) / 32) * 4;
+    }
+    else
+        rd->rowBytes = 0, rd->rowStride = w * sizeof(uint32_t);
+    size = rd->rowStride * h;
+
+    if (_igl_initReads ())
+    {
+        /* read into a PBO, and set a fence to check when it is done */
+        if (rd->pbo == 0)
+            igl->genBuffers (1, &rd->pbo);
+        igl->bindBuffer (GL_PIXEL_PACK_BUFFER_ARB, rd->pbo);
+        igl->bufferData (GL_PIXEL_PACK_BUFFER_ARB, size, NULL, GL_STREAM_READ_ARB);
+        glReadPixels (x1, y1, w, h, rd->format, rd->type, NULL);
+        igl->bindBuffer (GL_PIXEL_PACK_BUFFER_ARB, 0);
+        if (igl->fenceSync)
+            rd->sync = igl->fenceSync (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    else
+    {
+        /* no PBOs, read synchronously */
+        rd->data = malloc (size);
+        glReadPixels (x1, y1, w, h, rd->format, rd->type, rd->data);
+    }
+
+    rd->pending = 1;
+    return id;
+}
+
+/* IGL: lrectreadready - checks if lrectreadend would not block */
+Boolean
+lrectreadready(long id)
+{
+    igl_readT *rd;
+    GLenum ret;
+
+    _igl_trace (__func__,TRUE,"%ld",id);
+    IGL_CHECKWND (FALSE);
+
+    if ((rd = _igl_getRead (id)) == NULL)
+        return FALSE;
+    if (rd->sync == NULL)
+        return TRUE;
+    ret = igl->clientWaitSync (rd->sync, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    return (ret == GL_ALREADY_SIGNALED || ret == GL_CONDITION_SATISFIED);
+}
+
+/* IGL: lrectreadend - finishes lrectreadstart, and stores the pixels in CPU
+ * memory. The pixmode settings must not be changed in between.
+ */
+long
+lrectreadend(long id, unsigned long parray[])
+{
+    igl_readT *rd;
+    char *data;
+    int i;
+
+    _igl_trace (__func__,TRUE,"%ld,%p",id,parray);
+    IGL_CHECKWND (0);
+
+    if ((rd = _igl_getRead (id)) == NULL)
+        return 0;
+
+    data = rd->data;
+    if (rd->pbo)
+    {
+        /* the buffer is converted in place, hence map it read/write */
+        igl->bindBuffer (GL_PIXEL_PACK_BUFFER_ARB, rd->pbo);
+        data = igl->mapBuffer (GL_PIXEL_PACK_BUFFER_ARB, GL_READ_WRITE_ARB);
+    }
+
+    if (data != NULL && rd->rowBytes)
+    {
+        /* copy the lines, but don't touch memory in the PM_STRIDE gaps */
+        for (i = 0; i < rd->height; i++)
+            memcpy ((char *)parray + i*rd->rowStride, data + i*rd->rowStride, rd->rowBytes);
+    }
+    else if (data != NULL)
+        _igl_pixOutConvert (rd->format, rd->type, parray, data, rd->width, rd->height);
+
+    if (rd->pbo)
+    {
+        if (data != NULL)
+            igl->unmapBuffer (GL_PIXEL_PACK_BUFFER_ARB);
+        igl->bindBuffer (GL_PIXEL_PACK_BUFFER_ARB, 0);
+    }
+    _igl_releaseRead (rd);
+
+    return (data != NULL ? rd->width*rd->height : 0);
+}
+
+
+/* do rectcopy with Z values on the GPU. IrisGL uses the upper 24 bits of a Z
+ * value as pixel and vice versa. Together with PM_SHIFT in whole bytes this is
+ * done by moving the data by some bytes in a PBO. Bytes which must be 0 are
+ * cleared by a pixel transfer scale of 0 for their color component.
+ */
+static int
+_igl_rectcopyOgl (igl_windowT *wptr, int x1, int y1, int w, int h, Screencoord newx, Screencoord newy)
+{
+    int zsrc = ((wptr->state & IGL_WSTATE_RDSOURCEZ) != 0);
+    int zdst = ((wptr->state & IGL_WSTATE_ZDRAW) != 0);
+#ifdef GL_EXT_abgr
+    static const GLenum scales[] = { GL_ALPHA_SCALE, GL_BLUE_SCALE, GL_GREEN_SCALE, GL_RED_SCALE };
+    static const GLenum biases[] = { GL_ALPHA_BIAS, GL_BLUE_BIAS, GL_GREEN_BIAS, GL_RED_BIAS };
+    static const uint32_t one = 1;
+    int little = *(const char *)&one;
+    long size = (long)w*h*4 + 8;
+    GLboolean mapped = GL_FALSE;
+    int i, j, m, offs;
+#endif
+
+    if (zsrc && zdst && !wptr->pixFlags)
+    {
+        _igl_setRasterpos (newx, newy);
+        glCopyPixels (x1, y1, w, h, GL_DEPTH);
+        return 1;
+    }
+#ifdef GL_EXT_abgr
+    if (zsrc == zdst || (wptr->pixFlags & ~(1 << PM_SHIFT)) || (wptr->pixShift & 7) ||
+        wptr->pixShift <= -32 || wptr->pixShift >= 32 || !_igl_initReads ())
+        return 0;
+    /* color maps would fill cleared color bytes going into a Z result */
+    if (zdst)
+        glGetBooleanv (GL_MAP_COLOR, &mapped);
+    if (mapped)
+        return 0;
+
+    /* result byte j comes from source byte j+m */
+    m = zsrc - zdst - wptr->pixShift/8;
+    offs = (little ? m : -m);
+
+    if (! wptr->copyPbo)
+        igl->genBuffers (1, &wptr->copyPbo);
+    igl->bindBuffer (GL_PIXEL_PACK_BUFFER_ARB, wptr->copyPbo);
+    if (wptr->copySize < size)
+    {
+        igl->bufferData (GL_PIXEL_PACK_BUFFER_ARB, size, NULL, GL_STREAM_COPY_ARB);
+        wptr->copySize = size;
+    }
+
+    /* a Z result gets some bytes from before or after the color data. Clear
+     * them by reading a pixel with all color components scaled to 0
+     */
+    glPixelStorei (GL_PACK_ROW_LENGTH, 0);
+    glPixelStorei (GL_PACK_ALIGNMENT, 4);
+    glPushAttrib (GL_PIXEL_MODE_BIT);
+    if (zdst && offs)
+    {
+        for (i = 0; i < 4; i++)
+        {
+            glPixelTransferf (scales[i], 0);
+            glPixelTransferf (biases[i], 0);
+        }
+        glReadPixels (x1, y1, 1, 1, GL_ABGR_EXT, GL_UNSIGNED_BYTE,
+                (char *)NULL + (offs < 0 ? -offs : size-4 - offs));
+        glPopAttrib ();
+        glPushAttrib (GL_PIXEL_MODE_BIT);
+    }
+
+    /* clear color bytes not in the result, on reading if the color is source */
+    for (j = 0; j < 4; j++)
+    {
+        i = (little ? j : 3-j);
+        if (zdst && (j-m < 1 || j-m > 3))
+        {
+            glPixelTransferf (scales[i], 0);
+            glPixelTransferf (biases[i], 0);
+        }
+        else if (zsrc && (j+m < 1 || j+m > 3))
+            glPixelTransferf (scales[i], 0);
+    }
+
+    /* move the data by m bytes between reading and drawing */
+    if (zsrc)
+        glReadPixels (x1, y1, w, h, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, (char *)NULL + 4);
+    else
+        glReadPixels (x1, y1, w, h, GL_ABGR_EXT, GL_UNSIGNED_BYTE, (char *)NULL + 4 - offs);
+    igl->bindBuffer (GL_PIXEL_PACK_BUFFER_ARB, 0);
+
+    igl->bindBuffer (GL_PIXEL_UNPACK_BUFFER_ARB, wptr->copyPbo);
+    glPixelStorei (GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
+    _igl_setRasterpos (newx, newy);
+    if (zdst)
+        glDrawPixels (w, h, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, (char *)NULL + 4);
+    else
+        glDrawPixels (w, h, GL_ABGR_EXT, GL_UNSIGNED_BYTE, (char *)NULL + 4 + offs);
+    igl->bindBuffer (GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+    glPopAttrib ();
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+
 /* GL: rectcopy - copies a rectangle of pixels with an optional zoom */
 void
 rectcopy(Screencoord x1, Screencoord y1, Screencoord x2, Screencoord y2, Screencoord newx, Screencoord newy)
@@ -805,6 +1511,25 @@ rectcopy(Screencoord x1, Screencoord y1, Screencoord x2, Screencoord y2, Screenc
         return;
     }
 
+    /* OpenGL only allows zdraw access to depth buffer if it is enabled,
+     * whereas IrisGL only allows this if it is disabled.
+     */
+    IGL_DISLIGHT ();
+    if (wptr->state & IGL_WSTATE_ZDRAW)
+    {
+        glPushAttrib (GL_DEPTH_BUFFER_BIT);
+        glEnable (GL_DEPTH_TEST);
+        glDepthFunc (GL_ALWAYS);
+    }
+
+    /* copy on the GPU if the pixel pipe can be done there */
+    if (_igl_rectcopyOgl (wptr, x1, y1, w, h, newx, newy))
+    {
+        if (wptr->state & IGL_WSTATE_ZDRAW)
+            glPopAttrib ();
+        return;
+    }
+
     /* determine source and destination buffer - either Z or color buffer */
     iformat = formats[!(wptr->state & IGL_WSTATE_RDSOURCEZ)];
     itype = types[!(wptr->state & IGL_WSTATE_RDSOURCEZ)];
@@ -818,8 +1543,7 @@ rectcopy(Screencoord x1, Screencoord y1, Screencoord x2, Screencoord y2, Screenc
     glPixelStorei (GL_PACK_ALIGNMENT, 0);
 
     /* allocate and read image */
-    IGL_DISLIGHT ();
-    buffer = malloc (w*h * sizeof(*buffer));
+    buffer = _igl_pixGetBuffer (wptr, w*h * sizeof(*buffer));
     glReadPixels (x1, y1, w, h, iformat, itype, buffer);
     /* apply pixel pipe */
     for (i = 0; i < w*h; i++)
@@ -839,25 +1563,200 @@ rectcopy(Screencoord x1, Screencoord y1, Screencoord x2, Screencoord y2, Screenc
     /* output image and destroy buffer */
     _igl_setRasterpos (newx, newy);
     glDrawPixels (w, h, oformat, otype, buffer);
-    free (buffer);
+    _igl_pixPutBuffer (wptr, buffer);
+    if (wptr->state & IGL_WSTATE_ZDRAW)
+        glPopAttrib ();
+}
+
+
+#if PLATFORM_X11
+/* MIT-SHM segment for readdisplay(), reused as long as it is large enough.
+ * Attaching fails on remote displays, which is caught by an error handler.
+ */
+static int shmError;
+
+static int
+_igl_X11shmError (Display *dpy, XErrorEvent *event)
+{
+    shmError = 1;
+    return 0;
+}
+
+void
+_igl_X11releaseShm (void)
+{
+    if (igl->shmSize > 0)
+    {
+        XShmDetach (IGL_DISPLAY, &igl->shmInfo);
+        XSync (IGL_DISPLAY, False);
+        shmdt (igl->shmInfo.shmaddr);
+        igl->shmSize = 0;
+    }
+}
+
+static int
+_igl_X11getShm (long size)
+{
+    XShmSegmentInfo *shm = &igl->shmInfo;
+    int (*handler) (Display *, XErrorEvent *);
+
+    if (igl->shmSize < 0 || igl->shmSize >= size)
+        return (igl->shmSize > 0);
+
+    _igl_X11releaseShm ();
+    if (! XShmQueryExtension (IGL_DISPLAY))
+    {
+        igl->shmSize = -1;
+        return 0;
+    }
+
+    shm->shmid = shmget (IPC_PRIVATE, size, IPC_CREAT | 0600);
+    if (shm->shmid < 0)
+        return 0;
+    shm->shmaddr = shmat (shm->shmid, NULL, 0);
+    shm->readOnly = False;
+    shmError = (shm->shmaddr == (char *)-1);
+    if (! shmError)
+    {
+        XSync (IGL_DISPLAY, False);
+        handler = XSetErrorHandler (_igl_X11shmError);
+        XShmAttach (IGL_DISPLAY, shm);
+        XSync (IGL_DISPLAY, False);
+        XSetErrorHandler (handler);
+    }
+    /* the segment is destroyed automatically after the last detach */
+    shmctl (shm->shmid, IPC_RMID, NULL);
+
+    if (shmError)
+    {
+        if (shm->shmaddr != (char *)-1)
+            shmdt (shm->shmaddr);
+        igl->shmSize = -1;
+        return 0;
+    }
+    igl->shmSize = size;
+    return 1;
+}
+
+/* converter from X visual pixels to IrisGL packed RGB */
+typedef struct {
+    unsigned long rm, gm, bm;   /* X component masks */
+    int rr, gr, br;             /* right shifts to get the top bits to bit 7 */
+    int rl, gl, bl;             /* left shifts if the components are narrower */
+} igl_X11convT;
+
+static void
+_igl_X11convMask (unsigned long mask, int *rshift, int *lshift)
+{
+    int s = 0;
+
+    /* make sure value < 0x100, then make sure the top bit is bit 7 */
+    if (mask == 0)
+        mask = 0xff;
+    for (; mask > 0xff; mask >>= 1)
+        s ++;
+    for (; mask < 0x80; mask <<= 1)
+        s --;
+    *rshift = (s > 0 ? s : 0);
+    *lshift = (s < 0 ? -s : 0);
 }
 
+#define IGL_X11CONV(c,p) \
+    ((((p) & (c)->rm) >> (c)->rr << (c)->rl)       | \
+     (((p) & (c)->gm) >> (c)->gr << (c)->gl) << 8  | \
+     (((p) & (c)->bm) >> (c)->br << (c)->bl) << 16)
+
+/* copy an X image to a row of parray. Rows are stored bottom up */
+static void
+_igl_X11convImage (XImage *ximg, unsigned long *parray, int w)
+{
+    static const int one = 1;
+    int swap = (ximg->byte_order == LSBFirst) != *(char *)&one;
+    igl_X11convT conv, *c = &conv;
+    unsigned char *src;
+    unsigned long *dst;
+    uint32_t pix;
+    int i, j;
+
+    c->rm = ximg->red_mask, c->gm = ximg->green_mask, c->bm = ximg->blue_mask;
+    _igl_X11convMask (c->rm, &c->rr, &c->rl);
+    _igl_X11convMask (c->gm, &c->gr, &c->gl);
+    _igl_X11convMask (c->bm, &c->br, &c->bl);
+
+    for (i = 0; i < ximg->height; i++)
+    {
+        src = (unsigned char *)ximg->data + (long)ximg->bytes_per_line * (ximg->height-i-1);
+        dst = parray + (long)i * w;
+
+        switch (ximg->bits_per_pixel)
+        {
+            case 32:
+                if (! swap)
+                    for (j = 0; j < ximg->width; j++)
+                    {
+                        pix = ((uint32_t *)src)[j];
+                        dst[j] = IGL_X11CONV (c, pix);
+                    }
+                else
+                    for (j = 0; j < ximg->width; j++)
+                    {
+                        pix = ((uint32_t *)src)[j];
+                        pix = (pix << 24) | ((pix << 8) & 0xff0000) | ((pix >> 8) & 0xff00) | (pix >> 24);
+                        dst[j] = IGL_X11CONV (c, pix);
+                    }
+                break;
+            case 24:
+                for (j = 0; j < ximg->width; j++, src += 3)
+                {
+                    if (ximg->byte_order == LSBFirst)
+                        pix = src[0] | (src[1] << 8) | (src[2] << 16);
+                    else
+                        pix = (src[0] << 16) | (src[1] << 8) | src[2];
+                    dst[j] = IGL_X11CONV (c, pix);
+                }
+                break;
+            case 16:
+                for (j = 0; j < ximg->width; j++)
+                {
+                    pix = ((uint16_t *)src)[j];
+                    if (swap)
+                        pix = ((pix << 8) & 0xff00) | (pix >> 8);
+                    dst[j] = IGL_X11CONV (c, pix);
+                }
+                break;
+            default:
+                /* TODO: colormap visuals would need XQueryColors */
+                for (j = 0; j < ximg->width; j++)
+                {
+                    pix = XGetPixel (ximg, j, ximg->height-i-1);
+                    dst[j] = IGL_X11CONV (c, pix);
+                }
+                break;
+        }
+    }
+}
+#endif
+
 
 /* GL: readdisplay - reads a rectangular screen region in a packed RGB format */
 long
 readdisplay(Screencoord x1, Screencoord y1, Screencoord x2, Screencoord y2, unsigned long parray[], unsigned long hints)
 {
     int w = x2-x1+1, h = y2-y1+1;
-    int xoff, xlen, yoff, ylen;
-    unsigned i, j;
+    int xoff, xlen, yoff, ylen, ybot;
+    int i;
     int x = x1, y = GL_Y(y2);
 #if PLATFORM_X11
     XImage *ximg = NULL;
-    unsigned long pix, rm, gm, bm, rs, gs, bs;
+    int shm = 0;
 #endif
 
     _igl_trace (__func__,TRUE,"%d,%d,%d,%d,%p,%lx",x1,y1,x2,y2,parray,hints);
 
+    /* without X server the screen content only exists in the pbuffers */
+    if (IGL_HEADLESS)
+        return (0);
+
     /* see if coordinates are swapped */
     if (w <= 0)
         w = x1-x2+1, x = x2;
@@ -868,62 +1767,67 @@ readdisplay(Screencoord x1, Screencoord y1, Screencoord x2, Screencoord y2, unsi
     xoff = 0, xlen = w;
     if (x < 0)
         xoff = -x, xlen -= -x;
-    if (x+w > DisplayWidth(IGL_DISPLAY, IGL_SCREEN)-1)
-        xlen -= x+w - (DisplayWidth(IGL_DISPLAY, IGL_SCREEN)-1);
+    if (x+w > DisplayWidth(IGL_DISPLAY, IGL_SCREEN))
+        xlen -= x+w - DisplayWidth(IGL_DISPLAY, IGL_SCREEN);
     if (xlen < 0)
         xlen = 0;
     yoff = 0, ylen = h;
     if (y < 0)
         yoff = -y, ylen -= -y;
-    if (y+h > DisplayHeight(IGL_DISPLAY, IGL_SCREEN)-1)
-        ylen -= y+h - (DisplayHeight(IGL_DISPLAY, IGL_SCREEN)-1);
+    if (y+h > DisplayHeight(IGL_DISPLAY, IGL_SCREEN))
+        ylen -= y+h - DisplayHeight(IGL_DISPLAY, IGL_SCREEN);
     if (ylen < 0)
         ylen = 0;
-
-    /* clear clipped areas - ouff, rather do memset32 (parray, 0, x*y)? */
-    if (yoff == 0)
-        for (i = 0; i < h-ylen; i++)
-            for (j = 0; j < w; j++)
-                parray[i*w + j] = RGB (0, 0, 0);
-    else
-        for (i = ylen; i < h; i++)
-            for (j = 0; j < w; j++)
-                parray[i*w + j] = RGB (0, 0, 0);
-    if (xoff == 0)
-        for (j = xlen; j < w; j++)
-            for (i = h-yoff - ylen; i < h-yoff; i++)
-                parray[i*w + j] = RGB (0, 0, 0);
-    else
-        for (j = 0; j < w-xlen; j++)
-            for (i = h-yoff - ylen; i < h-yoff; i++)
-                parray[i*w + j] = RGB (0, 0, 0);
+    if (xoff > w)
+        xoff = w;
+    if (yoff > h)
+        yoff = h;
 
 #if PLATFORM_X11
-    /* get the image data */
+    /* get the image data, through shared memory if possible */
     if (xlen != 0 && ylen != 0)
-        ximg = XGetImage (IGL_DISPLAY, IGL_ROOT, x+xoff, y+yoff, xlen, ylen,
+    {
+        if (igl->shmSize >= 0)
+            ximg = XShmCreateImage (IGL_DISPLAY, DefaultVisual (IGL_DISPLAY, IGL_SCREEN),
+                        DefaultDepth (IGL_DISPLAY, IGL_SCREEN), ZPixmap, NULL,
+                        &igl->shmInfo, xlen, ylen);
+        if (ximg != NULL && _igl_X11getShm ((long)ximg->bytes_per_line * ylen))
+        {
+            ximg->data = igl->shmInfo.shmaddr;
+            shm = XShmGetImage (IGL_DISPLAY, IGL_ROOT, ximg, x+xoff, y+yoff, AllPlanes);
+        }
+        if (! shm && ximg != NULL)
+        {
+            ximg->data = NULL;
+            XDestroyImage (ximg);
+        }
+        if (! shm)
+            ximg = XGetImage (IGL_DISPLAY, IGL_ROOT, x+xoff, y+yoff, xlen, ylen,
                             AllPlanes, ZPixmap);
+    }
+    if (ximg == NULL)
+        xlen = ylen = 0;
+#endif
 
-    /* need the image r,g,b bits in the upper bits of the GL RGB bytes.
-     * first, make sure value < 0x100, then make sure the top bit is bit 7
-     */
-    for (i = rm = ximg->red_mask  , rs = 0; i > 0xff; i >>= 1, rs ++) ;
-    for (i = rm >> rs; i < 0x7f; i <<= 1, rs --) ;
-    for (i = gm = ximg->green_mask, gs = 0; i > 0xff; i >>= 1, gs ++) ;
-    for (i = gm >> gs; i < 0x7f; i <<= 1, gs --) ;
-    for (i = bm = ximg->blue_mask , bs = 0; i > 0xff; i >>= 1, bs ++) ;
-    for (i = bm >> bs; i < 0x7f; i <<= 1, bs --) ;
+    /* clear clipped areas; rows below and above, and left and right of image */
+    ybot = h-yoff - ylen;
+    memset (parray, 0, (long)ybot*w * sizeof(*parray));
+    memset (parray + (long)(h-yoff)*w, 0, (long)yoff*w * sizeof(*parray));
+    for (i = ybot; i < h-yoff; i++)
+    {
+        memset (parray + (long)i*w, 0, xoff * sizeof(*parray));
+        memset (parray + (long)i*w + xoff+xlen, 0, (w-xoff-xlen) * sizeof(*parray));
+    }
 
+#if PLATFORM_X11
     /* copy pixel data to destination, with reassembly of the RGB components */
-    for (i = 0; i < ylen; i++)
-        for (j = 0; j < xlen; j++)
-        {
-            pix = XGetPixel (ximg, j, ylen-i-1);
-            parray[(i+ h-ylen-yoff)*w + (j+xoff)] =
-                    RGB ((pix & rm) >> rs, (pix & gm) >> gs, (pix & bm) >> bs);
-        }
-
-    XDestroyImage (ximg);
+    if (ximg != NULL)
+    {
+        _igl_X11convImage (ximg, parray + (long)ybot*w + xoff, w);
+        if (shm)
+            ximg->data = NULL; /* owned by the shared memory segment */
+        XDestroyImage (ximg);
+    }
 #endif
     return w*h;
 }
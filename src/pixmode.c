@@ -24,6 +24,7 @@
 #include "iglcmn.h"
 
 #include <fcntl.h>
+#include <pthread.h>
 
 
 /* IrisGL pixel pipeline: unpack->shift->expand->add24->zoom->pack
@@ -51,17 +52,21 @@ typedef struct igl_pixdataT {
     long format;        /* pixel format */
     long type;          /* component type */
     long size;          /* pixel size */
+    long offset;        /* offset into 1st word in bits */
+    int csize, csigned; /* component size and signedness of the type */
 
-    uint32_t *img;      /* pixel storage */
-    int bit;            /* next bit position to be processed */
-    unsigned long long data; /* pixel stream register */
+    uint32_t *img;      /* pixel storage for the current scanline */
 
     union {             /* pixel format/type conversion register */
         float f;        /*  ... for type PM_FLOAT */
-        unsigned long l;/*  ... everything else */
+        uint32_t l;     /*  ... everything else */
     } pixel;
 } igl_pixdataT;
 
+/* scanline kernels, selected once per transfer */
+typedef void (*igl_pixLineT) (igl_pixdataT *pp, uint32_t *line, int width);
+typedef void (*igl_pixOglLineT) (igl_windowT *wptr, uint32_t *optr, uint32_t *line, int width, int step);
+
 
 /* map IrisGL pixel format to OpenGL */
 static int
@@ -106,7 +111,8 @@ _igl_pixOglType(int type, int *size)
 
 
 /* TODO: the pixmode conversion stuff is still in a somewhat experimental state.
- * This means not everything is tested, and it's unoptimized and rather slow.
+ * This means not everything is tested. Conversion is done a scanline at a time,
+ * with kernels for unpack/format/pipe/pack selected once for each transfer.
  * (maybe more pixmodes could be mapped to OpenGL, see comments in pixmode)
  */
 
@@ -117,57 +123,69 @@ _igl_pixOglType(int type, int *size)
 
 #ifndef GL_EXT_abgr
 /* swap bytes (for ABGR->RGBA and vice versa) */
-static inline long
-_igl_swap32 (long val)
+static inline uint32_t
+_igl_swap32 (uint32_t val)
 {
-    unsigned char b0 = val >> 24, b1 = val >> 16, b2 = val >> 8, b3 = val >> 0;
-    return (b3 << 24) | (b2 << 16) | (b1 << 8) | b0;
+    return (val << 24) | ((val << 8) & 0x00ff0000) | ((val >> 8) & 0x0000ff00) | (val >> 24);
 }
 #endif
 
+/* mask for the lower bits of a pixel or component */
+#define IGL_PIXMASK(size)   ((size) < 32 ? (1UL << (size)) - 1 : 0xffffffffUL)
+
+/* decode PM_INPUT_TYPE/PM_OUTPUT_TYPE once for the whole transfer */
+static void
+_igl_pixSetType (igl_pixdataT *pp)
+{
+    switch (pp->type)
+    {
+        case PM_BITMAP:             pp->csize =  1, pp->csigned = 0; break;
+        case PM_BYTE:               pp->csize =  8, pp->csigned = 1; break;
+        default:
+        case PM_UNSIGNED_BYTE:      pp->csize =  8, pp->csigned = 0; break;
+        case PM_SHORT:              pp->csize = 16, pp->csigned = 1; break;
+        case PM_UNSIGNED_SHORT:     pp->csize = 16, pp->csigned = 0; break;
+        case PM_INT:                pp->csize = 32, pp->csigned = 1; break;
+        case PM_UNSIGNED_INT:       pp->csize = 32, pp->csigned = 0; break;
+        case PM_SHORT_12:           pp->csize = 12, pp->csigned = 1; break;
+        case PM_UNSIGNED_SHORT_12:  pp->csize = 12, pp->csigned = 0; break;
+        case PM_FLOAT:              pp->csize =  0, pp->csigned = 0; break;
+    }
+}
+
+
+#if 0
+____________________________ unpacking ____________________________
+#endif
 /* get one component (applies PM_INPUT_TYPE) */
-static unsigned long
+static inline unsigned long
 _igl_pixInC (igl_pixdataT *pp, int size)
 {
-    int sz = 0, sg;
+    int sz = pp->csize;
     unsigned long ret;
 
-    /* TODO: evaluating this switch for every pixel isn't exactly smart */
-    switch (pp->type)
+    if (sz == 0)
     {
-        case PM_BITMAP:             sz =  1, sg = 0; break;
-        case PM_BYTE:               sz =  8, sg = 1; break;
-	default:
-        case PM_UNSIGNED_BYTE:      sz =  8, sg = 0; break;
-        case PM_SHORT:              sz = 16, sg = 1; break;
-        case PM_UNSIGNED_SHORT:     sz = 16, sg = 0; break;
-        case PM_INT:                sz = 32, sg = 1; break;
-        case PM_UNSIGNED_INT:       sz = 32, sg = 0; break;
-        case PM_SHORT_12:           sz = 12, sg = 1; break;
-        case PM_UNSIGNED_SHORT_12:  sz = 12, sg = 0; break;
-
-        case PM_FLOAT:
-            /* floating point input; treat all 32 bits as a float number */
-            ret = pp->pixel.f * ((1<<size)-1);
-            pp->pixel.l = 0; /* consumes all 32 bits */
-            return ret & ((1<<size)-1);
+        /* floating point input; treat all 32 bits as a float number */
+        ret = pp->pixel.f * IGL_PIXMASK (size);
+        pp->pixel.l = 0; /* consumes all 32 bits */
+        return ret & IGL_PIXMASK (size);
     }
 
     if (sz >= size)
     {
-        /* target has more bits; put component in high bits of target */
+        /* target has less bits; use the high bits of the component */
         ret = pp->pixel.l >> (32-size);
-        ret ^= (sg ? 1<<(size-1) : 0); /* remove sign */
-        ret &= (1<<(sz-size))-1; /* clear unused low bits */
-        pp->pixel.l <<= sz;
-        return ret & ((1<<size)-1);
+        ret ^= (pp->csigned ? 1<<(size-1) : 0); /* remove sign */
+        pp->pixel.l = (sz < 32 ? pp->pixel.l << sz : 0);
+        return ret & IGL_PIXMASK (size);
     }
     else
     {
         /* TODO: right or left aligned? */
         ret = (pp->pixel.l >> (32-sz));
         pp->pixel.l <<= sz;
-        return ret & ((1<<sz)-1);
+        return ret & IGL_PIXMASK (sz);
     }
 }
 
@@ -177,30 +195,29 @@ _igl_pixInFormat (igl_pixdataT *pp, unsigned long pixel)
 {
     unsigned long ret;
 
-    /* TODO: evaluating this switch for every pixel isn't really smart */
     pp->pixel.l = pixel;
     switch (pp->format)
     {
 	default:
         case PM_ABGR:
-            ret = (_igl_pixInC (pp, 8)<<24)| (_igl_pixInC (pp, 8)<<16) |
-                  (_igl_pixInC (pp, 8)<< 8)| (_igl_pixInC (pp, 8)<< 0);
+            ret  = _igl_pixInC (pp, 8)<<24; ret |= _igl_pixInC (pp, 8)<<16;
+            ret |= _igl_pixInC (pp, 8)<< 8; ret |= _igl_pixInC (pp, 8)<< 0;
             break;
         case PM_BGR:
-            ret = (_igl_pixInC (pp, 8)<<16)| (_igl_pixInC (pp, 8)<< 8) |
-                  (_igl_pixInC (pp, 8)<< 0);
+            ret  = _igl_pixInC (pp, 8)<<16; ret |= _igl_pixInC (pp, 8)<< 8;
+            ret |= _igl_pixInC (pp, 8)<< 0;
             break;
         case PM_RGBA:
-            ret = (_igl_pixInC (pp, 8)<< 0)| (_igl_pixInC (pp, 8)<< 8) |
-                  (_igl_pixInC (pp, 8)<<16)| (_igl_pixInC (pp, 8)<<24);
+            ret  = _igl_pixInC (pp, 8)<< 0; ret |= _igl_pixInC (pp, 8)<< 8;
+            ret |= _igl_pixInC (pp, 8)<<16; ret |= _igl_pixInC (pp, 8)<<24;
             break;
         case PM_RGB:
-            ret = (_igl_pixInC (pp, 8)<< 0)| (_igl_pixInC (pp, 8)<< 8) |
-                  (_igl_pixInC (pp, 8)<<16);
+            ret  = _igl_pixInC (pp, 8)<< 0; ret |= _igl_pixInC (pp, 8)<< 8;
+            ret |= _igl_pixInC (pp, 8)<<16;
             break;
         case PM_LUMINANCEA:
-            ret = (_igl_pixInC (pp, 8) * 0x00010101) |
-                  (_igl_pixInC (pp, 8) * 0x01000000);
+            ret  = _igl_pixInC (pp, 8) * 0x00010101;
+            ret |= _igl_pixInC (pp, 8) * 0x01000000;
             break;
         case PM_LUMINANCE:
             ret = _igl_pixInC (pp, 8) * 0x00010101;
@@ -224,65 +241,184 @@ _igl_pixInFormat (igl_pixdataT *pp, unsigned long pixel)
     return ret;
 }
 
-/* get pixel from incoming data stream (applies PM_SIZE) */
-static inline unsigned long
-_igl_pixUnpack (igl_pixdataT *pp)
+/* get a scanline from the incoming data stream (applies PM_SIZE, PM_OFFSET) */
+static void
+_igl_pixUnpack (igl_pixdataT *pp, uint32_t *line, int width)
+{
+    uint32_t *img = pp->img;
+    unsigned long long data = *img++;
+    unsigned long mask = IGL_PIXMASK (pp->size);
+    int size = pp->size, bit = 32 - pp->offset;
+    int x;
+
+    for (x = 0; x < width; x++)
+    {
+        /* get more data if there aren't enough bits available */
+        if (bit < size)
+        {
+            data = (data << 32) | *img++;
+            bit += 32;
+        }
+        /* extract bitfield from data */
+        line[x] = (data >> (bit-size)) & mask;
+        bit -= size;
+    }
+}
+
+/* fast paths for word aligned streams */
+static void
+_igl_pixUnpack32 (igl_pixdataT *pp, uint32_t *line, int width)
 {
-    unsigned long pixel;
-    if (pp->size == 32 && pp->bit == 32)
+    if (line != pp->img)
+        memcpy (line, pp->img, width * sizeof (*line));
+}
+
+static void
+_igl_pixUnpack16 (igl_pixdataT *pp, uint32_t *line, int width)
+{
+    uint32_t *img = pp->img;
+    int x;
+
+    for (x = 0; x < (width & ~1); x += 2)
     {
-        /* shortcut for aligned 32 bit values */
-        pixel = pp->data;
-        pp->data = *pp->img++;
+        line[x+0] = img[x/2] >> 16;
+        line[x+1] = img[x/2] & 0xffff;
     }
+    if (width & 1)
+        line[x] = img[x/2] >> 16;
+}
+
+static void
+_igl_pixUnpack8 (igl_pixdataT *pp, uint32_t *line, int width)
+{
+    uint32_t *img = pp->img;
+    int x;
+
+    for (x = 0; x < (width & ~3); x += 4)
+    {
+        line[x+0] = img[x/4] >> 24;
+        line[x+1] = (img[x/4] >> 16) & 0xff;
+        line[x+2] = (img[x/4] >>  8) & 0xff;
+        line[x+3] = img[x/4] & 0xff;
+    }
+    for (; x < width; x++)
+        line[x] = (img[x/4] >> (24 - 8*(x & 3))) & 0xff;
+}
+
+/* convert a scanline to ABGR (applies PM_INPUT_FORMAT, PM_INPUT_TYPE) */
+static void
+_igl_pixInFormatLine (igl_pixdataT *pp, uint32_t *line, int width)
+{
+    int x;
+
+    for (x = 0; x < width; x++)
+        line[x] = _igl_pixInFormat (pp, line[x]);
+}
+
+/* fast paths for PM_UNSIGNED_BYTE components */
+static void
+_igl_pixInBGR8 (igl_pixdataT *pp, uint32_t *line, int width)
+{
+    int x;
+
+    for (x = 0; x < width; x++)
+        line[x] = line[x] >> 8;
+}
+
+static void
+_igl_pixInRGBA8 (igl_pixdataT *pp, uint32_t *line, int width)
+{
+    int x;
+
+    for (x = 0; x < width; x++)
+    {
+        uint32_t p = line[x];
+        line[x] = (p << 24) | ((p << 8) & 0x00ff0000) | ((p >> 8) & 0x0000ff00) | (p >> 24);
+    }
+}
+
+static void
+_igl_pixInRGB8 (igl_pixdataT *pp, uint32_t *line, int width)
+{
+    int x;
+
+    for (x = 0; x < width; x++)
+    {
+        uint32_t p = line[x];
+        line[x] = ((p << 8) & 0x00ff0000) | ((p >> 8) & 0x0000ff00) | (p >> 24);
+    }
+}
+
+static void
+_igl_pixInLumA8 (igl_pixdataT *pp, uint32_t *line, int width)
+{
+    int x;
+
+    for (x = 0; x < width; x++)
+        line[x] = (line[x] >> 24) * 0x00010101 | ((line[x] >> 16) & 0xff) * 0x01000000;
+}
+
+static void
+_igl_pixInLum8 (igl_pixdataT *pp, uint32_t *line, int width)
+{
+    int x;
+
+    for (x = 0; x < width; x++)
+        line[x] = (line[x] >> 24) * 0x00010101;
+}
+
+/* select the unpack and format kernels for the transfer */
+static void
+_igl_pixInKernels (igl_pixdataT *pp, igl_pixLineT *unpack, igl_pixLineT *format)
+{
+    if (pp->offset != 0 || (pp->size != 8 && pp->size != 16 && pp->size != 32))
+        *unpack = _igl_pixUnpack;
+    else if (pp->size == 8)
+        *unpack = _igl_pixUnpack8;
+    else if (pp->size == 16)
+        *unpack = _igl_pixUnpack16;
     else
+        *unpack = _igl_pixUnpack32;
+
+    *format = _igl_pixInFormatLine;
+    if (pp->type == PM_UNSIGNED_BYTE)
     {
-        /* get more data if there aren't enough bits available */
-        if (pp->bit < pp->size)
+        switch (pp->format)
         {
-            pp->data = (pp->data << 32) | *pp->img++;
-            pp->bit += 32;
+            case PM_ABGR:           *format = NULL; break;
+            case PM_BGR:            *format = _igl_pixInBGR8; break;
+            case PM_RGBA:           *format = _igl_pixInRGBA8; break;
+            case PM_RGB:            *format = _igl_pixInRGB8; break;
+            case PM_LUMINANCEA:     *format = _igl_pixInLumA8; break;
+            case PM_LUMINANCE:      *format = _igl_pixInLum8; break;
         }
-        /* extract bitfield from data */
-        pixel = (pp->data >> (pp->bit-pp->size)) & ((1<<pp->size)-1);
-        pp->bit -= pp->size;
     }
-    return pixel;
 }
 
+
+#if 0
+____________________________ packing ____________________________
+#endif
 /* put one component (applies PM_OUTPUT_TYPE) */
-static void
+static inline void
 _igl_pixOutC (igl_pixdataT *pp, int size, unsigned long comp)
 {
-    int sz = 0, sg;
+    int sz = pp->csize;
 
     /* mask of any unused pixel bits */
-    comp &= ((1<<size)-1);
+    comp &= IGL_PIXMASK (size);
 
-    /* TODO: evaluating this switch for every pixel isn't exactly smart */
-    switch (pp->type)
+    if (sz == 0)
     {
-        case PM_BITMAP:             sz =  1, sg = 0; break;
-        case PM_BYTE:               sz =  8, sg = 1; break;
-	default:
-        case PM_UNSIGNED_BYTE:      sz =  8, sg = 0; break;
-        case PM_SHORT:              sz = 16, sg = 1; break;
-        case PM_UNSIGNED_SHORT:     sz = 16, sg = 0; break;
-        case PM_INT:                sz = 32, sg = 1; break;
-        case PM_UNSIGNED_INT:       sz = 32, sg = 0; break;
-        case PM_SHORT_12:           sz = 12, sg = 1; break;
-        case PM_UNSIGNED_SHORT_12:  sz = 12, sg = 0; break;
-
-        case PM_FLOAT:
-            /* TODO: saturation? */
-            pp->pixel.f = (float)comp / ((1<<size)-1); return;
+        /* TODO: saturation? */
+        pp->pixel.f = (float)comp / IGL_PIXMASK (size); return;
     }
 
-    pp->pixel.l <<= sz;
+    pp->pixel.l = (sz < 32 ? pp->pixel.l << sz : 0);
     if (sz >= size)
     {
         /* component has more bits then output type */
-        comp ^= (sg ? 1<<(size-1) : 0); /* apply sign */
+        comp ^= (pp->csigned ? 1<<(size-1) : 0); /* apply sign */
         pp->pixel.l |= comp << (sz-size);
     }
     else
@@ -298,7 +434,6 @@ _igl_pixOutFormat (igl_pixdataT *pp, unsigned long pixel)
 {
     unsigned long lum;
 
-    /* TODO: evaluating this switch for every pixel isn't really smart */
     pp->pixel.l = 0;
     switch (pp->format)
     {
@@ -347,37 +482,180 @@ _igl_pixOutFormat (igl_pixdataT *pp, unsigned long pixel)
     return pp->pixel.l;
 }
 
-/* write pixel to outgoing data stream (applies PM_SIZE) */
-static inline void
-_igl_pixPack (igl_pixdataT *pp, unsigned long pixel)
+/* convert a scanline from ABGR (applies PM_OUTPUT_FORMAT, PM_OUTPUT_TYPE) */
+static void
+_igl_pixOutFormatLine (igl_pixdataT *pp, uint32_t *line, int width)
+{
+    int x;
+
+    for (x = 0; x < width; x++)
+        line[x] = _igl_pixOutFormat (pp, line[x]);
+}
+
+/* fast paths for PM_UNSIGNED_BYTE components */
+static void
+_igl_pixOutBGR8 (igl_pixdataT *pp, uint32_t *line, int width)
 {
-    if (pp->size == 32 && pp->bit == 64)
+    int x;
+
+    for (x = 0; x < width; x++)
+        line[x] = line[x] & 0x00ffffff;
+}
+
+static void
+_igl_pixOutRGBA8 (igl_pixdataT *pp, uint32_t *line, int width)
+{
+    int x;
+
+    for (x = 0; x < width; x++)
     {
-        /* shortcut for aligned 32 bit data */
-        *pp->img++ = pixel;
+        uint32_t p = line[x];
+        line[x] = (p << 24) | ((p << 8) & 0x00ff0000) | ((p >> 8) & 0x0000ff00) | (p >> 24);
     }
-    else
+}
+
+static void
+_igl_pixOutRGB8 (igl_pixdataT *pp, uint32_t *line, int width)
+{
+    int x;
+
+    for (x = 0; x < width; x++)
+    {
+        uint32_t p = line[x];
+        line[x] = ((p << 16) & 0x00ff0000) | (p & 0x0000ff00) | ((p >> 16) & 0xff);
+    }
+}
+
+static void
+_igl_pixOutLum8 (igl_pixdataT *pp, uint32_t *line, int width)
+{
+    int x;
+
+    for (x = 0; x < width; x++)
+    {
+        uint32_t p = line[x];
+        line[x] = (5*(p & 0xff) + 10*((p >> 8) & 0xff) + ((p >> 16) & 0xff)) >> 4;
+    }
+}
+
+static void
+_igl_pixOutLumA8 (igl_pixdataT *pp, uint32_t *line, int width)
+{
+    int x;
+
+    for (x = 0; x < width; x++)
+    {
+        uint32_t p = line[x];
+        line[x] = ((5*(p & 0xff) + 10*((p >> 8) & 0xff) + ((p >> 16) & 0xff)) >> 4 << 8) | (p >> 24);
+    }
+}
+
+/* write a scanline to the outgoing data stream (applies PM_SIZE, PM_OFFSET).
+ * Partially used words at the start and the end of the line are cleared.
+ */
+static void
+_igl_pixPack (igl_pixdataT *pp, uint32_t *line, int width)
+{
+    uint32_t *img = pp->img;
+    unsigned long long data = 0;
+    unsigned long mask = IGL_PIXMASK (pp->size);
+    int size = pp->size, bit = 64 - pp->offset;
+    int x;
+
+    for (x = 0; x < width; x++)
     {
         /* if there isn't enough space in data, store some */
-        if (pp->bit < pp->size )
+        if (bit < size)
         {
-            *pp->img++ = pp->data >> 32;
-            pp->data = (pp->data << 32);
-            pp->bit += 32;
+            *img++ = data >> 32;
+            data = (data << 32);
+            bit += 32;
         }
         /* stash bitfield in data */
-        pixel &= ((1<<pp->size)-1);
-        pp->data |= pixel << (pp->bit - pp->size);
-        pp->bit -= pp->size;
+        data |= (unsigned long long)(line[x] & mask) << (bit - size);
+        bit -= size;
+    }
+
+    /* flush output buffer */
+    if (bit < 64)
+        *img++ = data >> 32;
+    if (bit < 32)
+        *img++ = data;
+}
+
+/* fast paths for word aligned streams */
+static void
+_igl_pixPack32 (igl_pixdataT *pp, uint32_t *line, int width)
+{
+    if (line != pp->img)
+        memcpy (pp->img, line, width * sizeof (*line));
+}
+
+static void
+_igl_pixPack16 (igl_pixdataT *pp, uint32_t *line, int width)
+{
+    uint32_t *img = pp->img;
+    int x;
+
+    for (x = 0; x < (width & ~1); x += 2)
+        img[x/2] = (line[x+0] << 16) | (line[x+1] & 0xffff);
+    if (width & 1)
+        img[x/2] = line[x] << 16;
+}
+
+static void
+_igl_pixPack8 (igl_pixdataT *pp, uint32_t *line, int width)
+{
+    uint32_t *img = pp->img;
+    int x;
+
+    for (x = 0; x < (width & ~3); x += 4)
+        img[x/4] = (line[x+0] << 24) | ((line[x+1] & 0xff) << 16) |
+                   ((line[x+2] & 0xff) << 8) | (line[x+3] & 0xff);
+    if (width & 3)
+    {
+        img[x/4] = 0;
+        for (; x < width; x++)
+            img[x/4] |= (line[x] & 0xff) << (24 - 8*(x & 3));
     }
 }
 
-/* pixel pipe (applies PM_SHIFT, PM_ADD24, PM_EXPAND/C0/C1) */
-unsigned long
-_igl_pixPipe (unsigned long pixel)
+/* select the format and pack kernels for the transfer */
+static void
+_igl_pixOutKernels (igl_pixdataT *pp, igl_pixLineT *format, igl_pixLineT *pack)
 {
-    igl_windowT *wptr = IGL_CTX ();
+    if (pp->offset != 0 || (pp->size != 8 && pp->size != 16 && pp->size != 32))
+        *pack = _igl_pixPack;
+    else if (pp->size == 8)
+        *pack = _igl_pixPack8;
+    else if (pp->size == 16)
+        *pack = _igl_pixPack16;
+    else
+        *pack = _igl_pixPack32;
 
+    *format = _igl_pixOutFormatLine;
+    if (pp->type == PM_UNSIGNED_BYTE)
+    {
+        switch (pp->format)
+        {
+            case PM_ABGR:           *format = NULL; break;
+            case PM_BGR:            *format = _igl_pixOutBGR8; break;
+            case PM_RGBA:           *format = _igl_pixOutRGBA8; break;
+            case PM_RGB:            *format = _igl_pixOutRGB8; break;
+            case PM_LUMINANCEA:     *format = _igl_pixOutLumA8; break;
+            case PM_LUMINANCE:      *format = _igl_pixOutLum8; break;
+        }
+    }
+}
+
+
+#if 0
+____________________________ pixel pipe ____________________________
+#endif
+/* pixel pipe (applies PM_SHIFT, PM_ADD24, PM_EXPAND/C0/C1) */
+static inline unsigned long
+_igl_pixPipeWin (igl_windowT *wptr, unsigned long pixel)
+{
     if (wptr->pixShift < 0)
         pixel >>= -wptr->pixShift;
     else
@@ -389,6 +667,384 @@ _igl_pixPipe (unsigned long pixel)
     return pixel;
 }
 
+unsigned long
+_igl_pixPipe (unsigned long pixel)
+{
+    return _igl_pixPipeWin (IGL_CTX (), pixel);
+}
+
+/* check if the pixel pipe changes anything */
+#define IGL_PIXPIPE(w)  ((w)->pixShift || (w)->pixExpand || (w)->pixAdd24)
+
+static void
+_igl_pixPipeLine (igl_windowT *wptr, uint32_t *line, int width)
+{
+    int x;
+
+    for (x = 0; x < width; x++)
+        line[x] = _igl_pixPipeWin (wptr, line[x]);
+}
+
+
+#if 0
+____________________________ OpenGL side ____________________________
+#endif
+/* write a converted scanline to the OpenGL buffer. step is -1 for RTOL */
+static void
+_igl_pixStoreZ (igl_windowT *wptr, uint32_t *optr, uint32_t *line, int width, int step)
+{
+    int x;
+
+    /* OpenGL uses top bits, but IrisGL uses the bottom bits */
+    for (x = 0; x < width; x++, optr += step)
+        *optr = line[x] << (32-IGL_ZBITS);
+}
+
+static void
+_igl_pixStoreRGBA (igl_windowT *wptr, uint32_t *optr, uint32_t *line, int width, int step)
+{
+    int x;
+
+#ifdef GL_EXT_abgr
+    if (step > 0)
+    {
+        if (optr != line)
+            memcpy (optr, line, width * sizeof (*optr));
+        return;
+    }
+    for (x = 0; x < width; x++, optr += step)
+        *optr = line[x];
+#else
+    for (x = 0; x < width; x++, optr += step)
+        *optr = _igl_swap32 (line[x]);
+#endif
+}
+
+static void
+_igl_pixStoreCmap (igl_windowT *wptr, uint32_t *optr, uint32_t *line, int width, int step)
+{
+    int x;
+
+    for (x = 0; x < width; x++, optr += step)
+#ifdef GL_EXT_abgr
+        *optr = IGL_CMAP2ABGR (wptr, line[x]);
+#else
+        *optr = _igl_swap32 (IGL_CMAP2ABGR (wptr, line[x]));
+#endif
+}
+
+/* read a scanline from the OpenGL buffer for conversion. step is -1 for RTOL */
+static void
+_igl_pixLoadZ (igl_windowT *wptr, uint32_t *iptr, uint32_t *line, int width, int step)
+{
+    int x;
+
+    /* OpenGL uses top bits, but IrisGL uses the bottom bits */
+    for (x = 0; x < width; x++, iptr += step)
+        line[x] = *iptr >> (32-IGL_ZBITS);
+}
+
+static void
+_igl_pixLoadRGBA (igl_windowT *wptr, uint32_t *iptr, uint32_t *line, int width, int step)
+{
+    int x;
+
+#ifdef GL_EXT_abgr
+    if (step > 0)
+    {
+        if (iptr != line)
+            memcpy (line, iptr, width * sizeof (*line));
+        return;
+    }
+    for (x = 0; x < width; x++, iptr += step)
+        line[x] = *iptr;
+#else
+    for (x = 0; x < width; x++, iptr += step)
+        line[x] = _igl_swap32 (*iptr);
+#endif
+}
+
+static void
+_igl_pixLoadCmap (igl_windowT *wptr, uint32_t *iptr, uint32_t *line, int width, int step)
+{
+    /* NOTE: no real colormap mode -> BLACK */
+    memset (line, 0, width * sizeof (*line));
+}
+
+
+#if 0
+____________________________ scratch buffers ____________________________
+#endif
+/* get a scratch buffer for a pixel transfer. Each window keeps a small pool of
+ * buffers which grow to the largest transfer, up to igl->pixPoolMax bytes.
+ */
+void *
+_igl_pixGetBuffer (igl_windowT *wptr, size_t size)
+{
+    igl_pixBufT *pb, *best = NULL;
+    int i;
+
+    /* take the smallest idle buffer large enough, or else the largest one */
+    for (i = 0; i < IGL_MAXPIXBUFS; i++)
+    {
+        pb = &wptr->pixBufs[i];
+        if (pb->busy)
+            continue;
+        if (best == NULL || (best->size < size ? pb->size > best->size :
+                                (pb->size >= size && pb->size < best->size)))
+            best = pb;
+    }
+    if (best == NULL || size > igl->pixPoolMax)
+        return malloc (size);
+
+    if (best->data == NULL || best->size < size)
+    {
+        free (best->data);
+        best->data = malloc (size);
+        best->size = (best->data ? size : 0);
+        if (best->data == NULL)
+            return NULL;
+    }
+    best->busy = 1;
+    return best->data;
+}
+
+/* return a scratch buffer to the pool */
+void
+_igl_pixPutBuffer (igl_windowT *wptr, void *data)
+{
+    int i;
+
+    for (i = 0; i < IGL_MAXPIXBUFS; i++)
+    {
+        if (wptr->pixBufs[i].busy && wptr->pixBufs[i].data == data)
+        {
+            wptr->pixBufs[i].busy = 0;
+            return;
+        }
+    }
+    free (data);
+}
+
+/* release the idle scratch buffers of a window */
+void
+_igl_pixTrimBuffers (igl_windowT *wptr)
+{
+    int i;
+
+    for (i = 0; i < IGL_MAXPIXBUFS; i++)
+    {
+        if (! wptr->pixBufs[i].busy)
+        {
+            free (wptr->pixBufs[i].data);
+            wptr->pixBufs[i].data = NULL;
+            wptr->pixBufs[i].size = 0;
+        }
+    }
+}
+
+
+#if 0
+____________________________ transfer jobs ____________________________
+#endif
+/* software pixel transfer, processed in bands of scanlines */
+typedef struct igl_pixJobT {
+    void (*lines) (struct igl_pixJobT *job, int y0, int y1, uint32_t *buf);
+    igl_windowT *wptr;
+    igl_pixdataT pd;            /* stream descriptor template */
+    igl_pixLineT stream;        /* unpack or pack kernel */
+    igl_pixLineT convert;       /* format kernel */
+    igl_pixOglLineT ogl;        /* OpenGL store or load kernel */
+    uint32_t *img, *buf;        /* IrisGL stream and OpenGL buffer */
+    uint32_t *lineBufs;         /* line buffer for each band */
+    int width, height;
+    int stride;                 /* words per stream scanline */
+} igl_pixJobT;
+
+/* address in the OpenGL buffer of the 1st pixel of stream scanline y */
+static inline uint32_t *
+_igl_pixOglLine (igl_pixJobT *job, int y)
+{
+    igl_windowT *wptr = job->wptr;
+    uint32_t *ptr;
+
+    /* for TTOB start with top line, for RTOL with last pixel in line */
+    ptr = job->buf + (long)(wptr->pixTtoB ? job->height-1 - y : y) * job->width;
+    return (wptr->pixRtoL ? ptr + job->width-1 : ptr);
+}
+
+/* convert IrisGL stream scanlines y0..y1-1 to OpenGL */
+static void
+_igl_pixInLines (igl_pixJobT *job, int y0, int y1, uint32_t *buf)
+{
+    igl_windowT *wptr = job->wptr;
+    igl_pixdataT pd = job->pd;
+    int width = job->width, step = (wptr->pixRtoL ? -1 : 1);
+    uint32_t *line, *optr;
+    int y;
+
+    for (y = y0; y < y1; y++)
+    {
+        pd.img = job->img + (long)y * job->stride;
+        optr = _igl_pixOglLine (job, y);
+        line = buf;
+        if (step > 0 && job->ogl == _igl_pixStoreRGBA)
+            line = optr; /* convert in place in the output buffer */
+
+        /* unpack and convert line, and write OpenGL output */
+        job->stream (&pd, line, width);
+        if (job->convert)
+            job->convert (&pd, line, width);
+        if (IGL_PIXPIPE (wptr))
+            _igl_pixPipeLine (wptr, line, width);
+        job->ogl (wptr, optr, line, width, step);
+    }
+}
+
+/* convert OpenGL scanlines to IrisGL stream scanlines y0..y1-1 */
+static void
+_igl_pixOutLines (igl_pixJobT *job, int y0, int y1, uint32_t *buf)
+{
+    igl_windowT *wptr = job->wptr;
+    igl_pixdataT pd = job->pd;
+    int width = job->width, step = (wptr->pixRtoL ? -1 : 1);
+    uint32_t *line, *iptr;
+    int y;
+
+    for (y = y0; y < y1; y++)
+    {
+        pd.img = job->img + (long)y * job->stride;
+        iptr = _igl_pixOglLine (job, y);
+        /* the OpenGL buffer is private, convert in place if possible */
+        line = (step > 0 ? iptr : buf);
+
+        /* get OpenGL input line, process and output pixel stream */
+        job->ogl (wptr, iptr, line, width, step);
+        if (IGL_PIXPIPE (wptr))
+            _igl_pixPipeLine (wptr, line, width);
+        if (job->convert)
+            job->convert (&pd, line, width);
+        job->stream (&pd, line, width);
+    }
+}
+
+
+/* worker pool for large transfers. Each transfer is split into bands of
+ * scanlines, which are processed by the workers and the calling thread.
+ */
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work, done;
+    pthread_t thread[IGL_MAXPIXTHREADS];
+    int threads, quit;
+
+    igl_pixJobT *job;           /* current transfer, NULL if idle */
+    int band, bands;            /* next band to process, number of bands */
+    int pending;                /* bands not yet finished */
+} pixPool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER };
+
+/* process the next band of the current job. called with the pool locked */
+static void
+_igl_pixBand (void)
+{
+    igl_pixJobT *job = pixPool.job;
+    int band = pixPool.band++, bands = pixPool.bands;
+
+    pthread_mutex_unlock (&pixPool.lock);
+    job->lines (job, job->height * band / bands, job->height * (band+1) / bands,
+                job->lineBufs + (long)band * job->width);
+    pthread_mutex_lock (&pixPool.lock);
+
+    if (--pixPool.pending == 0)
+        pthread_cond_signal (&pixPool.done);
+}
+
+static void *
+_igl_pixWorker (void *arg)
+{
+    pthread_mutex_lock (&pixPool.lock);
+    while (1)
+    {
+        while (! pixPool.quit && pixPool.band >= pixPool.bands)
+            pthread_cond_wait (&pixPool.work, &pixPool.lock);
+        if (pixPool.quit)
+            break;
+        _igl_pixBand ();
+    }
+    pthread_mutex_unlock (&pixPool.lock);
+    return NULL;
+}
+
+/* run a transfer job, in parallel if it is large enough */
+static void
+_igl_pixRun (igl_pixJobT *job)
+{
+    int threads = igl->pixThreads, bands = 1;
+
+    if (threads > IGL_MAXPIXTHREADS)
+        threads = IGL_MAXPIXTHREADS;
+
+    /* small transfers aren't worth the synchronization overhead */
+    if (threads > 1 && igl->pixThreshold > 0 && job->height > 1 &&
+        (long)job->width * job->height >= igl->pixThreshold)
+    {
+        pthread_mutex_lock (&pixPool.lock);
+
+        /* start workers on first use. The calling thread works as well */
+        while (pixPool.threads < threads-1 && pthread_create
+            (&pixPool.thread[pixPool.threads], NULL, _igl_pixWorker, NULL) == 0)
+            pixPool.threads++;
+
+        /* the pool may be in use by another thread; do it alone then */
+        if (pixPool.job == NULL && pixPool.threads > 0)
+        {
+            bands = (pixPool.threads+1) * IGL_PIXBANDS;
+            if (bands > job->height)
+                bands = job->height;
+            job->lineBufs = _igl_pixGetBuffer (job->wptr, (long)bands * job->width * sizeof(uint32_t));
+
+            pixPool.job = job;
+            pixPool.band = 0;
+            pixPool.bands = bands;
+            pixPool.pending = bands;
+            pthread_cond_broadcast (&pixPool.work);
+
+            while (pixPool.band < pixPool.bands)
+                _igl_pixBand ();
+            while (pixPool.pending > 0)
+                pthread_cond_wait (&pixPool.done, &pixPool.lock);
+
+            pixPool.job = NULL;
+            pixPool.band = pixPool.bands = 0;
+            pthread_mutex_unlock (&pixPool.lock);
+            _igl_pixPutBuffer (job->wptr, job->lineBufs);
+            return;
+        }
+        pthread_mutex_unlock (&pixPool.lock);
+    }
+
+    job->lineBufs = _igl_pixGetBuffer (job->wptr, job->width * sizeof(uint32_t));
+    job->lines (job, 0, job->height, job->lineBufs);
+    _igl_pixPutBuffer (job->wptr, job->lineBufs);
+}
+
+/* stop the worker pool */
+void
+_igl_pixExit (void)
+{
+    int i;
+
+    pthread_mutex_lock (&pixPool.lock);
+    pixPool.quit = 1;
+    pthread_cond_broadcast (&pixPool.work);
+    pthread_mutex_unlock (&pixPool.lock);
+
+    for (i = 0; i < pixPool.threads; i++)
+        pthread_join (pixPool.thread[i], NULL);
+    pixPool.threads = pixPool.quit = 0;
+}
+
+
 /* map IrisGL output mode to OpenGL */
 int
 _igl_pixInMode(int *format, int *type)
@@ -402,84 +1058,65 @@ _igl_pixInMode(int *format, int *type)
     return cnm*csz; /* OpenGL pixel size in bits */
 }
 
-/* convert IrisGL output data to OpenGL (applies PM_OFFSET, PM_STRIDE, PM_TTOB, PM_RTOL) */
+/* convert IrisGL output data to OpenGL (applies PM_OFFSET, PM_STRIDE, PM_TTOB, PM_RTOL).
+ * If zoom is set, the caller can apply PM_TTOB and PM_RTOL with negative zoom
+ * factors if the data is passed directly to OpenGL.
+ */
 void *
-_igl_pixInConvert(int *format, int *type, int size, void *image, int width, int height)
+_igl_pixInConvertZoom(int *format, int *type, int size, void *image, int width, int height, int zoom)
 {
     uint32_t *imgIn = image, *imgOgl = image;
     igl_windowT *wptr = IGL_CTX ();
     int pxsz = wptr->pixSize ? wptr->pixSize : 32;
+    long flags = wptr->pixFlags, words = wptr->pixStride, skip = 0;
+
+    if (zoom)
+        flags &= ~((1 << PM_TTOB) | (1 << PM_RTOL));
+    /* PM_OFFSET in whole pixels can be done with GL_UNPACK_SKIP_PIXELS */
+    if (! words)
+        words = (wptr->pixOffset + width*pxsz + 31) / 32;
+    if (wptr->pixOffset % pxsz == 0 && (words*32) % pxsz == 0)
+    {
+        flags &= ~(1 << PM_OFFSET);
+        skip = wptr->pixOffset / pxsz;
+    }
 
     /* see if the transfer can be handled by OpenGL pixeltransfer stuff */
-    if (size > 0 && (size != pxsz || wptr->pixFlags ||
+    if (size > 0 && (size != pxsz || flags ||
         (wptr->state & IGL_WSTATE_ZDRAW) || !(wptr->flags & IGL_WFLAGS_RGBA)))
     {
-        igl_pixdataT pd;
-        uint32_t *iptr;
-        int x, y;
+        igl_pixJobT job;
 
         /* no, use software transfer engine to produce GL_RGBA/DEPTH output */
-        pd.format = wptr->pixInFormat;
-        pd.type = wptr->pixInType;
-        pd.size = wptr->pixSize;
-
-        iptr = imgOgl = malloc(width*height * sizeof(*imgOgl));
-
-        /* for TTOB start with top line, for RTOL with last pixel in line */
-        if (wptr->pixTtoB)
-            iptr += width * (height-1);
-        if (wptr->pixRtoL)
-            iptr += width - 1;
-
-        for (y = 0; y < height; y++)
-        {
-            /* prepare pixel stream for this line */
-            pd.img = imgIn;
-            pd.data = *pd.img++;
-            pd.bit = 32-wptr->pixOffset;
-
-            for (x = 0; x < width; x++)
-            {
-                /* get pixel from input stream */
-                unsigned long pixel = _igl_pixUnpack (&pd);
-
-                if (pd.format != PM_ABGR || pd.type != PM_UNSIGNED_BYTE)
-                    pixel = _igl_pixInFormat (&pd, pixel);
-
-                /* process, and write OpenGL output */
-                pixel = _igl_pixPipe (pixel);
+        job.pd.format = wptr->pixInFormat;
+        job.pd.type = wptr->pixInType;
+        job.pd.size = wptr->pixSize;
+        job.pd.offset = wptr->pixOffset;
+        _igl_pixSetType (&job.pd);
+
+        /* select the kernels for the scanlines */
+        _igl_pixInKernels (&job.pd, &job.stream, &job.convert);
+        if (wptr->pixZ || (wptr->state & IGL_WSTATE_ZDRAW))
+            job.ogl = _igl_pixStoreZ;
+        else if (wptr->flags & IGL_WFLAGS_RGBA)
+            job.ogl = _igl_pixStoreRGBA;
+        else
+            job.ogl = _igl_pixStoreCmap;
+
+        imgOgl = _igl_pixGetBuffer (wptr, width*height * sizeof(*imgOgl));
+
+        job.lines = _igl_pixInLines;
+        job.wptr = wptr;
+        job.img = imgIn;
+        job.buf = imgOgl;
+        job.width = width;
+        job.height = height;
+        /* without stride, scanlines start at the next word boundary */
+        job.stride = wptr->pixStride;
+        if (! job.stride)
+            job.stride = (job.pd.offset + width*job.pd.size + 31) / 32;
+        _igl_pixRun (&job);
 
-                if (wptr->pixZ || (wptr->state & IGL_WSTATE_ZDRAW))
-                    /* OpenGL uses top bits, but IrisGL uses the bottom bits */
-                    *iptr = pixel << (32-IGL_ZBITS);
-#ifdef GL_EXT_abgr
-                else if (wptr->flags & IGL_WFLAGS_RGBA)
-                    *iptr = pixel;
-                else
-                    *iptr = IGL_CMAP2ABGR (wptr, pixel);
-#else
-                else if (wptr->flags & IGL_WFLAGS_RGBA)
-                    *iptr = _igl_swap32 (pixel);
-                else
-                    *iptr = _igl_swap32 (IGL_CMAP2ABGR (wptr, pixel));
-#endif
-                /* advance to next output pixel */
-                if (wptr->pixRtoL)
-                    iptr --;
-                else
-                    iptr ++;
-            }
-            /* advance to next stream scanline */
-            if (wptr->pixStride)
-                imgIn += wptr->pixStride;
-            else /* advance to next word boundary, but consider cached data */
-                imgIn = pd.img - (pd.bit >= 32);
-            /* advance to next output line */
-            if (wptr->pixTtoB)
-                iptr -= 2*width;
-            if (wptr->pixRtoL)
-                iptr += 2*width;
-        }
         if (wptr->pixZ || (wptr->state & IGL_WSTATE_ZDRAW))
         {
             *format = GL_DEPTH_COMPONENT;
@@ -510,13 +1147,20 @@ _igl_pixInConvert(int *format, int *type, int size, void *image, int width, int
     else
     {
         /* set stride and row alignment. IrisGL stride is in 32 bit words. */
-        glPixelStorei (GL_UNPACK_ROW_LENGTH, wptr->pixStride*32 / pxsz);
+        glPixelStorei (GL_UNPACK_ROW_LENGTH, wptr->pixStride || skip ? words*32 / pxsz : 0);
+        glPixelStorei (GL_UNPACK_SKIP_PIXELS, skip);
         glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
     }
 
     return imgOgl;
 }
 
+void *
+_igl_pixInConvert(int *format, int *type, int size, void *image, int width, int height)
+{
+    return _igl_pixInConvertZoom (format, type, size, image, width, height, 0);
+}
+
 void
 _igl_pixInEnd(int format, int type, void *image, void *buffer)
 {
@@ -529,16 +1173,19 @@ _igl_pixInEnd(int format, int type, void *image, void *buffer)
     }
 
     if (image != buffer)
-        free (buffer);
+        _igl_pixPutBuffer (IGL_CTX (), buffer);
+    else if (IGL_CTX ()->pixOffset)
+        glPixelStorei (GL_UNPACK_SKIP_PIXELS, 0);
 }
 
-/* map IrisGL input mode to OpenGL */
-void *
-_igl_pixOutMode(int *format, int *type, void *image, int width, int height)
+/* map IrisGL input mode to OpenGL. Returns the pixel size in bits if OpenGL
+ * can read directly to IrisGL memory, or 0 if a software transfer is needed.
+ */
+int
+_igl_pixOutDirect(int *format, int *type)
 {
     igl_windowT *wptr = IGL_CTX ();
     int pxsz = wptr->pixSize ? wptr->pixSize : 32, cnm, csz;
-    uint32_t *imgOgl = image;
 
     *format = _igl_pixOglFormat (wptr->pixOutFormat, &cnm);
     *type = _igl_pixOglType (wptr->pixOutType, &csz);
@@ -554,7 +1201,6 @@ _igl_pixOutMode(int *format, int *type, void *image, int width, int height)
             !(wptr->flags & IGL_WFLAGS_RGBA) || wptr->pixFlags)
     {
         /* no, use software transfer through buffer */
-        imgOgl = malloc(width*height * sizeof(*imgOgl));
         if (wptr->pixZ || (wptr->state & IGL_WSTATE_RDSOURCEZ))
         {
             *format = GL_DEPTH_COMPONENT;
@@ -571,15 +1217,23 @@ _igl_pixOutMode(int *format, int *type, void *image, int width, int height)
         }
         glPixelStorei (GL_PACK_ROW_LENGTH, 0);
         glPixelStorei (GL_PACK_ALIGNMENT, 0);
-    }
-    else
-    {
-        /* set stride and row alignment. IrisGL stride is in 32 bit words. */
-        glPixelStorei (GL_PACK_ROW_LENGTH, wptr->pixStride*32 / pxsz);
-        glPixelStorei (GL_PACK_ALIGNMENT, 4);
+        return 0;
     }
 
-    return imgOgl;
+    /* set stride and row alignment. IrisGL stride is in 32 bit words. */
+    glPixelStorei (GL_PACK_ROW_LENGTH, wptr->pixStride*32 / pxsz);
+    glPixelStorei (GL_PACK_ALIGNMENT, 4);
+    return pxsz;
+}
+
+/* map IrisGL input mode to OpenGL, and get a buffer for the transfer */
+void *
+_igl_pixOutMode(int *format, int *type, void *image, int width, int height)
+{
+    if (_igl_pixOutDirect (format, type))
+        return image;
+
+    return _igl_pixGetBuffer (IGL_CTX (), width*height * sizeof(uint32_t));
 }
 
 /* convert OpenGL input data to IrisGL (applies PM_OFFSET, PM_STRIDE, PM_TTOB, PM_RTOL) */
@@ -587,77 +1241,38 @@ void
 _igl_pixOutConvert(int format, int type, void *image, void *buffer, int width, int height)
 {
     igl_windowT *wptr = IGL_CTX ();
-    uint32_t *iptr = buffer, *imgOut = image;
 
     if (image != buffer)
     {
-        igl_pixdataT pd;
-        int x, y;
+        igl_pixJobT job;
 
         /* use software engine to convert GL_RGBA/DEPTH to IrisGL */
-        pd.format = wptr->pixOutFormat;
-        pd.type = wptr->pixOutType;
-        pd.size = wptr->pixSize;
-
-        /* for TTOB start with top line, for RTOL with last pixel in line */
-        if (wptr->pixTtoB)
-            iptr += width * (height-1);
-        if (wptr->pixRtoL)
-            iptr += width - 1;
-
-        for (y = 0; y < height; y++)
-        {
-            /* prepare pixel stream for this line */
-            pd.img = imgOut;
-            pd.data = 0;
-            pd.bit = 64-wptr->pixOffset;
-
-            for (x = 0; x < width; x++)
-            {
-                unsigned long pixel;
-
-                /* get OpenGL input pixel */
-                if (wptr->pixZ || (wptr->state & IGL_WSTATE_RDSOURCEZ))
-                    /* OpenGL uses top bits, but IrisGL uses the bottom bits */
-                    pixel = *iptr >> (32-IGL_ZBITS);
-                else if (wptr->flags & IGL_WFLAGS_RGBA)
-#ifdef GL_EXT_abgr
-                    pixel = *iptr;
-#else
-                    pixel = _igl_swap32 (*iptr);
-#endif
-                else
-                    pixel = 0; /* NOTE: no real colormap mode -> BLACK */
-                /* advance to next input pixel */
-                if (wptr->pixRtoL)
-                    iptr --;
-                else
-                    iptr ++;
-
-                /* process and output pixel stream */
-                pixel = _igl_pixPipe (pixel);
-
-                if (pd.format != PM_ABGR || pd.type != PM_UNSIGNED_BYTE)
-                    pixel = _igl_pixOutFormat (&pd, pixel);
-
-                _igl_pixPack (&pd, pixel);
-            }
-            /* flush output buffer */
-            if (pd.bit < 64)
-                *pd.img++ = pd.data >> 32;
-            if (pd.bit < 32)
-                *pd.img++ = pd.data;
-            /* advance to next stream scanline */
-            if (wptr->pixStride)
-                imgOut += wptr->pixStride;
-            else
-                imgOut = pd.img;
-            /* advance to next input line */
-            if (wptr->pixTtoB)
-                iptr -= 2*width;
-            if (wptr->pixRtoL)
-                iptr += 2*width;
-        }
+        job.pd.format = wptr->pixOutFormat;
+        job.pd.type = wptr->pixOutType;
+        job.pd.size = wptr->pixSize;
+        job.pd.offset = wptr->pixOffset;
+        _igl_pixSetType (&job.pd);
+
+        /* select the kernels for the scanlines */
+        _igl_pixOutKernels (&job.pd, &job.convert, &job.stream);
+        if (wptr->pixZ || (wptr->state & IGL_WSTATE_RDSOURCEZ))
+            job.ogl = _igl_pixLoadZ;
+        else if (wptr->flags & IGL_WFLAGS_RGBA)
+            job.ogl = _igl_pixLoadRGBA;
+        else
+            job.ogl = _igl_pixLoadCmap;
+
+        job.lines = _igl_pixOutLines;
+        job.wptr = wptr;
+        job.img = image;
+        job.buf = buffer;
+        job.width = width;
+        job.height = height;
+        /* without stride, scanlines start at the next word boundary */
+        job.stride = wptr->pixStride;
+        if (! job.stride)
+            job.stride = (job.pd.offset + width*job.pd.size + 31) / 32;
+        _igl_pixRun (&job);
     }
 }
 
@@ -666,7 +1281,7 @@ void
 _igl_pixOutEnd(int format, int type, void *image, void *buffer)
 {
     if (image != buffer)
-        free (buffer);
+        _igl_pixPutBuffer (IGL_CTX (), buffer);
 }
 
 
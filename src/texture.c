@@ -38,14 +38,14 @@ _igl_checkTexturing (igl_windowT *wptr)
 {
     if (wptr->state & IGL_WSTATE_TEXTURING)
     {
-        glDisable (GL_TEXTURE_2D);
-        glDisable (GL_TEXTURE_3D);
+        _igl_glDisable (GL_TEXTURE_2D);
+        _igl_glDisable (GL_TEXTURE_3D);
     }
 
     /* tev and tex must both be non-zero for texturing to be enabled */
     if (wptr->tevIndex != 0 && wptr->texIndex != 0)
     {
-        glEnable (wptr->textureType);
+        _igl_glEnable (wptr->textureType);
         wptr->state |= IGL_WSTATE_TEXTURING;
     }
     else
@@ -147,7 +147,11 @@ _igl_parseTexDef (long index, long np, float *props)
 
     txptr = &igl->texDefs[index];
     if (txptr->glName)
+    {
         glDeleteTextures (1, &txptr->glName);
+        /* deleting a bound texture binds 0 instead, in the share group too */
+        _igl_glInvalidateAll (IGL_GLSTATE_TEXTURE);
+    }
 
     IGL_CLR_SAVEID (txptr);
     txptr->internalFormat = TX_RGBA_8;
@@ -526,11 +530,12 @@ tevdef (long index, long np, float *props)
     if (props == NULL)
         return;
 
+    /* tevbind in other threads mustn't see a half written definition */
+    IGL_LOCK (IGL_LOCK_DEFS);
     idx = IGL_MAPID(igl->tevDefs, IGL_MAXTEVDEFS, index, 3);
-    if (idx < 0)
-        return;
-
-    _igl_parseTevDef (idx, np, props);
+    if (idx >= 0)
+        _igl_parseTevDef (idx, np, props);
+    IGL_UNLOCK (IGL_LOCK_DEFS);
 }
 
 
@@ -539,7 +544,7 @@ void
 tevbind (long target, long index)
 {
     _igl_trace (__func__,FALSE,"%ld,%ld",target,index);
-    igl->api->tevbind (target, index);
+    iglThread.api->tevbind (target, index);
 }
 
 void
@@ -552,11 +557,14 @@ iglExec_tevbind (long target, long index)
     if (target != TV_ENV0)
         return;
 
+    IGL_LOCK (IGL_LOCK_DEFS);
     idx = IGL_MAPID(igl->tevDefs, IGL_MAXTEVDEFS, index, 0);
+    if (idx >= 0)
+        _igl_setTevDef (idx);
+    IGL_UNLOCK (IGL_LOCK_DEFS);
     if (idx < 0)
         return;
 
-    _igl_setTevDef (idx);
     _igl_checkTexturing (IGL_CTX ());
 }
 
@@ -575,9 +583,14 @@ texdef2d (long index, long nc, long width, long height, unsigned long *image, lo
     if (props == NULL || width <= 0 || height <= 0 || nc < 1 || nc > 4)
         return;
 
+    /* texbind in other threads mustn't see a half written definition */
+    IGL_LOCK (IGL_LOCK_DEFS);
     idx = IGL_MAPID(igl->texDefs, IGL_MAXTEXDEFS, index, 3);
     if (idx < 0)
+    {
+        IGL_UNLOCK (IGL_LOCK_DEFS);
         return;
+    }
 
     /* parse */
     _igl_parseTexDef (idx, np, props);
@@ -587,6 +600,7 @@ texdef2d (long index, long nc, long width, long height, unsigned long *image, lo
     txptr->width = width;
     txptr->height = height;
     txptr->size = nc;
+    IGL_UNLOCK (IGL_LOCK_DEFS);
 
     osize = _igl_texFormatType (txptr, &oFormat, &type);
     ointernalFormat = _igl_texIntFormat (txptr);
@@ -614,7 +628,7 @@ texdef2d (long index, long nc, long width, long height, unsigned long *image, lo
 
     /* TODO: is there something to be done for TX_TILE? */
 
-    glBindTexture (GL_TEXTURE_2D, txptr->glName);
+    _igl_glBindTexture (GL_TEXTURE_2D, txptr->glName);
     /* TODO: TX_DETAIL for 2D: glTexImage2D (GL_DETAIL_TEXTURE_2D_SGIS, ...)  */
     /* TODO: TX_MIN/MAG_FILTER TX_BILINEAR_{L|G}EQUAL: glTexImage2D (GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, ...)  */
     glTexImage2D (GL_TEXTURE_2D, 0, ointernalFormat, width, height, 0, oFormat, type, img);
@@ -642,9 +656,14 @@ texdef3d (long index, long nc, long width, long height, long depth, unsigned lon
     if (props == NULL || width <= 0 || height <= 0 || depth <= 0 || nc < 1 || nc > 4)
         return;
 
+    /* texbind in other threads mustn't see a half written definition */
+    IGL_LOCK (IGL_LOCK_DEFS);
     idx = IGL_MAPID(igl->texDefs, IGL_MAXTEXDEFS, index, 3);
     if (idx < 0)
+    {
+        IGL_UNLOCK (IGL_LOCK_DEFS);
         return;
+    }
 
     /* parse */
     _igl_parseTexDef (idx, np, props);
@@ -655,6 +674,7 @@ texdef3d (long index, long nc, long width, long height, long depth, unsigned lon
     txptr->width = width;
     txptr->height = height;
     txptr->size = nc;
+    IGL_UNLOCK (IGL_LOCK_DEFS);
 
     osize = _igl_texFormatType (txptr, &oFormat, &type);
     ointernalFormat = _igl_texIntFormat (txptr);
@@ -662,7 +682,7 @@ texdef3d (long index, long nc, long width, long height, long depth, unsigned lon
     if (image)
         img = _igl_pixInConvert (&oFormat, &type, osize, image, width, height*depth);
 
-    glBindTexture (GL_TEXTURE_3D, txptr->glName);
+    _igl_glBindTexture (GL_TEXTURE_3D, txptr->glName);
     glTexImage3D (GL_TEXTURE_3D, 0, ointernalFormat, width, height, depth, 0, oFormat, type, img);
     if (img != NULL)
         gluBuild3DMipmaps (GL_TEXTURE_3D, ointernalFormat, width, height, depth, oFormat, type, img);
@@ -677,7 +697,7 @@ void
 texbind (long target, long index)
 {
     _igl_trace (__func__,FALSE,"%ld,%ld",target,index);
-    igl->api->texbind (target, index);
+    iglThread.api->texbind (target, index);
 }
 
 void
@@ -692,24 +712,29 @@ iglExec_texbind (long target, long index)
     if (target != TX_TEXTURE_0/* && target != TX_TEXTURE_DETAIL && target != TX_TEXTURE_IDLE*/)
         return;
 
+    IGL_LOCK (IGL_LOCK_DEFS);
     idx = IGL_MAPID(igl->texDefs, IGL_MAXTEXDEFS, index, 0);
     if (idx < 0 && index != 0)
+    {
+        IGL_UNLOCK (IGL_LOCK_DEFS);
         return;
+    }
     txptr = &igl->texDefs[idx];
 
     if (index == 0 || txptr->glName == 0)
     {
-        glBindTexture (GL_TEXTURE_2D, 0);
-        glBindTexture (GL_TEXTURE_3D, 0);
+        _igl_glBindTexture (GL_TEXTURE_2D, 0);
+        _igl_glBindTexture (GL_TEXTURE_3D, 0);
         IGL_CTX ()->texIndex = 0;
     }
     else
     {
         IGL_CTX ()->textureType =
             (txptr->flags & IGL_TEXDEFFLAGS_3D ? GL_TEXTURE_3D : GL_TEXTURE_2D);
-        glBindTexture (IGL_CTX ()->textureType, txptr->glName);
+        _igl_glBindTexture (IGL_CTX ()->textureType, txptr->glName);
         _igl_setTexDef (idx);
     }
+    IGL_UNLOCK (IGL_LOCK_DEFS);
     _igl_checkTexturing (IGL_CTX ());
 }
 
@@ -719,7 +744,7 @@ void
 texgen (long coord, long mode, float *params)
 {
     _igl_trace (__func__,TRUE,"%ld,%ld,%p",coord,mode,params);
-    igl->api->texgen (coord, mode, params);
+    iglThread.api->texgen (coord, mode, params);
 }
 
 void
@@ -811,7 +836,7 @@ subtexload (long target, long id, float s0, float s1, float t0, float t1,
         img = _igl_pixInConvert (&format, &type, size, texture, width, height);
     }
 
-    glBindTexture (GL_TEXTURE_2D, txptr->glName);
+    _igl_glBindTexture (GL_TEXTURE_2D, txptr->glName);
     glTexSubImage2D (GL_TEXTURE_2D, 0, tx, ty, width, height, format, type, img);
 
     _igl_pixInEnd (format, type, texture, img);
@@ -841,7 +866,7 @@ fbsubtexload (long x, long y, long target, long id, float s0, float s1, float t0
     width = (s1-s0) * txptr->width;
     height = (t1-t0) * txptr->height;
 
-    glBindTexture (GL_TEXTURE_2D, txptr->glName);
+    _igl_glBindTexture (GL_TEXTURE_2D, txptr->glName);
     glCopyTexSubImage2D (GL_TEXTURE_2D, 0, tx, ty, x, y, width, height);
 }
 
@@ -877,7 +902,7 @@ void
 t4f (float vector[4])
 {
     _igl_trace (__func__,FALSE,"%p" IGL_V4FMT(g),vector,IGL_V4PAR(vector));
-    igl->api->t4f (vector);
+    iglThread.api->t4f (vector);
 }
 
 void
@@ -890,8 +915,7 @@ iglExec_t4f (float vector[4])
 
     if (!wptr->bgnDelay)
         glTexCoord4fv (vector);
-    if (wptr->bgnDelay || (wptr->state & IGL_VSTATE_TMESH))
-        IGL_V4COPY (wptr->currentTexcoord, vector);
+    IGL_V4COPY (wptr->currentTexcoord, vector);
     wptr->state |= IGL_VSTATE_TEXTURED;
 }
 
@@ -907,7 +931,7 @@ t4s (short vector[4])
     vector4[2] = (float)vector[2];
     vector4[3] = (float)vector[3];
 
-    igl->api->t4f (vector4);
+    iglThread.api->t4f (vector4);
 }
 
 
@@ -922,7 +946,7 @@ t4i (long vector[4])
     vector4[2] = (float)vector[2];
     vector4[3] = (float)vector[3];
 
-    igl->api->t4f (vector4);
+    iglThread.api->t4f (vector4);
 }
 
 
@@ -937,7 +961,7 @@ t4d (double vector[4])
     vector4[2] = (float)vector[2];
     vector4[3] = (float)vector[3];
 
-    igl->api->t4f (vector4);
+    iglThread.api->t4f (vector4);
 }
 
 
@@ -952,7 +976,7 @@ t3s (short vector[3])
     vector4[2] = (float)vector[2];
     vector4[3] = 1.0f;
 
-    igl->api->t4f (vector4);
+    iglThread.api->t4f (vector4);
 }
 
 
@@ -967,7 +991,7 @@ t3i (long vector[3])
     vector4[2] = (float)vector[2];
     vector4[3] = 1.0f;
 
-    igl->api->t4f (vector4);
+    iglThread.api->t4f (vector4);
 }
 
 
@@ -982,7 +1006,7 @@ t3f (float vector[3])
     vector4[2] = vector[2];
     vector4[3] = 1.0f;
 
-    igl->api->t4f (vector4);
+    iglThread.api->t4f (vector4);
 }
 
 
@@ -997,7 +1021,7 @@ t3d (double vector[3])
     vector4[2] = (float)vector[2];
     vector4[3] = 1.0f;
 
-    igl->api->t4f (vector4);
+    iglThread.api->t4f (vector4);
 }
 
 
@@ -1012,7 +1036,7 @@ t2s (short vector[2])
     vector4[2] = 0.0f;
     vector4[3] = 1.0f;
 
-    igl->api->t4f (vector4);
+    iglThread.api->t4f (vector4);
 }
 
 
@@ -1027,7 +1051,7 @@ t2i (long vector[2])
     vector4[2] = 0.0f;
     vector4[3] = 1.0f;
 
-    igl->api->t4f (vector4);
+    iglThread.api->t4f (vector4);
 }
 
 
@@ -1042,7 +1066,7 @@ t2f (float vector[2])
     vector4[2] = 0.0f;
     vector4[3] = 1.0f;
 
-    igl->api->t4f (vector4);
+    iglThread.api->t4f (vector4);
 }
 
 
@@ -1057,7 +1081,7 @@ t2d (double vector[2])
     vector4[2] = 0.0f;
     vector4[3] = 1.0f;
 
-    igl->api->t4f (vector4);
+    iglThread.api->t4f (vector4);
 }
 
 
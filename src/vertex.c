@@ -37,37 +37,101 @@
  * It only adds to the nuisance that OpenGL lighting cannot be enabled within
  * glBegin/glEnd :-(
  *
- * To emulate IrisGL behaviour correctly, it would be necessary to store all
- * vertices from bgn* upto end*, then decide upon lighting and push everything
- * to OpenGL, but that's rather slow on those old SGI systems. Instead, store
- * the glBegin primitive and delay the execution until the 3rd vertex is given,
- * which is the most I've seen in the wild. Only enable lighting if a normal
- * was set with n3f by then, and enable texturing if a t* was given.
+ * To emulate IrisGL behaviour correctly, all vertices from bgn* upto end* are
+ * stored, together with their color, normal and texture coordinate. On end*
+ * it is decided upon lighting and texturing, and everything is pushed to
+ * OpenGL as vertex arrays with a single draw call. Lighting is only enabled if
+ * a normal was set with n3f, and texturing if a t* was given.
  *
- * TODO: lmbind/lmdef are allowed within bgn*,end* sequences. Hence,
- * additionally track material changes (lmbind/lmdef) in the vertex stack?
+ * Consecutive triangle meshes or points in an object are merged into a single
+ * draw call (see _igl_execObject), if nothing else happens in between.
+ *
+ * TODO: lmbind/lmdef are allowed within bgn*,end* sequences. Since the
+ * vertices are only sent on end*, material changes affect the whole primitive.
  */
 
-/* NOTE: OpenGL doesn't offer swaptmesh. To emulate this, a 2-vertex stack must
- * be kept, and on swaptmesh the older vertex is pushed to OpenGL, effectively
- * exchanging the two vertices inside the OpenGL renderer, at the cost of
- * rendering a zero-width triangle along the edge (and possible artifacts :-/).
+/* NOTE: OpenGL doesn't offer swaptmesh. Triangle meshes are hence built as
+ * GL_TRIANGLES, with IrisGL's two vertex registers kept in iglThread.tmeshRegister.
+ * Each new vertex forms a triangle with both registers and then replaces the
+ * register iglThread.tmeshReplace points to, which is toggled afterwards. swaptmesh
+ * just toggles the pointer, so e.g. fans can be drawn without extra vertices.
  * Apparently, IrisGL doesn't only swap the vertices, it also swaps the
  * colors, normals, and texture coordinates associated with these vertices.
- * So, the vertex stack must also include these.
+ * Since they are stored with the vertex, this is automatically handled.
  */
 
+#define IGL_VSTATE_PRIMITIVE    (IGL_VSTATE_N3F|IGL_VSTATE_N3FBGN|IGL_VSTATE_TEXTURED|IGL_WSTATE_LMCNULL)
+
+
+/* get space for a new vertex in the vertex buffer */
+static igl_vertexT *
+_igl_newVertex (void)
+{
+    igl_vertexT *vertices;
+    int size;
+
+    if (iglThread.numVertices >= iglThread.maxVertices)
+    {
+        size = (iglThread.maxVertices ? 2*iglThread.maxVertices : IGL_MINVERTICES);
+        vertices = (igl_vertexT *)realloc (iglThread.vertices, size * sizeof (igl_vertexT));
+        if (vertices == NULL)
+            return (NULL);
+        iglThread.vertices = vertices;
+        iglThread.maxVertices = size;
+    }
+
+    return (&iglThread.vertices[iglThread.numVertices++]);
+}
+
+
+/* get space for count new indices */
+static GLuint *
+_igl_newIndices (int count)
+{
+    GLuint *indices;
+    int size;
 
-/* flush the vertex stack to OpenGL, deciding on lighting on the way */
+    if (iglThread.numIndices + count > iglThread.maxIndices)
+    {
+        size = (iglThread.maxIndices ? 2*iglThread.maxIndices : 3*IGL_MINVERTICES);
+        while (iglThread.numIndices + count > size)
+            size *= 2;
+        indices = (GLuint *)realloc (iglThread.indices, size * sizeof (GLuint));
+        if (indices == NULL)
+            return (NULL);
+        iglThread.indices = indices;
+        iglThread.maxIndices = size;
+    }
+
+    iglThread.numIndices += count;
+    return (&iglThread.indices[iglThread.numIndices - count]);
+}
+
+
+void
+_igl_releaseVertices (void)
+{
+    if (iglThread.vertices != NULL)
+        free (iglThread.vertices);
+    if (iglThread.indices != NULL)
+        free (iglThread.indices);
+    iglThread.vertices = NULL;
+    iglThread.indices = NULL;
+    iglThread.numVertices = iglThread.maxVertices = iglThread.firstVertex = 0;
+    iglThread.numIndices = iglThread.maxIndices = iglThread.firstIndex = 0;
+}
+
+
+/* send vertices to OpenGL, deciding on lighting on the way */
 static void
-_igl_flushstack(igl_windowT *wptr, int tidx)
+_igl_drawVertices (igl_windowT *wptr, GLenum mode, long state, int first, int count, GLuint *indices)
 {
-    int i;
+    igl_vertexT *v = iglThread.vertices;
 
     /* lighting enabled? */
     if (wptr->state & IGL_WSTATE_LIGHTING)
     {
-        if (wptr->state & (IGL_VSTATE_N3F|IGL_VSTATE_N3FBGN)) {
+        if (state & (IGL_VSTATE_N3F|IGL_VSTATE_N3FBGN)) {
             IGL_ENLIGHT ();
         } else {
             IGL_DISLIGHT ();
@@ -77,51 +141,156 @@ _igl_flushstack(igl_windowT *wptr, int tidx)
     /* texturing enabled? */
     if (wptr->state & IGL_WSTATE_TEXTURING)
     {
-        if (wptr->texgenMode || (wptr->state & IGL_VSTATE_TEXTURED))
-            glEnable(wptr->textureType);
+        if (wptr->texgenMode || (state & IGL_VSTATE_TEXTURED))
+            _igl_glEnable (wptr->textureType);
         else
-            glDisable(wptr->textureType);
+            _igl_glDisable (wptr->textureType);
     }
 
-    /* OpenGL startup */
-    glBegin (wptr->bgnPrimitive);
- 
+    glVertexPointer (4, GL_FLOAT, sizeof (*v), v->vertex);
+    glEnableClientState (GL_VERTEX_ARRAY);
+
     /* if colors are disabled via lmcolor, use stored color */
-    if (wptr->state & IGL_WSTATE_LMCNULL)
+    if (state & IGL_WSTATE_LMCNULL)
     {
-        if (wptr->state & IGL_VSTATE_COLORED)
-        {
-            glColor4ubv (wptr->lmcColor);
-            wptr->state &= ~IGL_VSTATE_COLORED;
-        }
+        _igl_glColor (wptr->lmcColor);
+        wptr->state &= ~IGL_VSTATE_COLORED;
+    }
+    else
+    {
+        glColorPointer (4, GL_UNSIGNED_BYTE, sizeof (*v), v->color);
+        glEnableClientState (GL_COLOR_ARRAY);
     }
+    if (state & IGL_VSTATE_N3F)
+    {
+        glNormalPointer (GL_FLOAT, sizeof (*v), v->normal);
+        glEnableClientState (GL_NORMAL_ARRAY);
+    }
+    if (state & IGL_VSTATE_TEXTURED)
+    {
+        glTexCoordPointer (4, GL_FLOAT, sizeof (*v), v->texcoord);
+        glEnableClientState (GL_TEXTURE_COORD_ARRAY);
+    }
+
+    if (indices != NULL)
+        glDrawElements (mode, count, GL_UNSIGNED_INT, indices);
+    else
+        glDrawArrays (mode, first, count);
+
+    /* the current attributes are undefined after using arrays, restore them */
+    glDisableClientState (GL_VERTEX_ARRAY);
+    if (!(state & IGL_WSTATE_LMCNULL))
+    {
+        glDisableClientState (GL_COLOR_ARRAY);
+        _igl_glInvalidate (IGL_GLSTATE_COLOR);
+        _igl_glColor (wptr->currentColor);
+    }
+    if (state & IGL_VSTATE_N3F)
+    {
+        glDisableClientState (GL_NORMAL_ARRAY);
+        glNormal3fv (wptr->currentNormal);
+    }
+    if (state & IGL_VSTATE_TEXTURED)
+    {
+        glDisableClientState (GL_TEXTURE_COORD_ARRAY);
+        glTexCoord4fv (wptr->currentTexcoord);
+    }
+}
+
+
+/* draw the indices of merged primitives */
+static void
+_igl_flushIndices (igl_windowT *wptr)
+{
+    if (iglThread.numIndices > 0)
+        _igl_drawVertices (wptr, iglThread.indexPrimitive, iglThread.indexState, 0, iglThread.numIndices, iglThread.indices);
+    iglThread.numIndices = 0;
+}
+
+
+/* add a triangle for a new mesh vertex and put it into the mesh registers */
+static void
+_igl_tmeshVertex (int vertex)
+{
+    GLuint *idx;
+
+    if (vertex - iglThread.firstVertex >= 2 && (idx = _igl_newIndices (3)) != NULL)
+    {
+        idx[0] = iglThread.tmeshRegister[0];
+        idx[1] = iglThread.tmeshRegister[1];
+        idx[2] = vertex;
+    }
+    iglThread.tmeshRegister[iglThread.tmeshReplace] = vertex;
+    iglThread.tmeshReplace ^= 1;
+}
+
+
+/* end the current primitive. If the next primitive is of the same kind, the
+ * vertices of points and triangle meshes are kept to draw them together.
+ */
+void
+_igl_endPrimitive (GLenum next)
+{
+    igl_windowT *wptr = IGL_CTX ();
+    GLenum mode = wptr->bgnPrimitive;
+    long state = wptr->state & IGL_VSTATE_PRIMITIVE;
+    int first = iglThread.firstVertex, count = iglThread.numVertices - first;
+    GLuint *idx;
+    int i;
 
-    /* shove stashed data to OpenGL */
-    /* TODO: use glDrawElements, or glDrawArrays? */
-    for (i = IGL_VERTEXSTACK_SIZE-1; i >= wptr->bgnDelay; i--)
+    /* kludge for old stuff drawing a line of length 0 to produce a point */
+    if (count == 2 && mode == GL_LINE_STRIP &&
+            !memcmp (iglThread.vertices[first].vertex, iglThread.vertices[first+1].vertex, sizeof (GLfloat[4])))
     {
-        if (!(wptr->state & IGL_WSTATE_LMCNULL))
-            glColor4ubv (wptr->colorStack[i]);
-        if (wptr->state & IGL_VSTATE_N3F)
-            glNormal3fv (wptr->normalStack[i]);
-        if (wptr->state & IGL_VSTATE_TEXTURED)
-            glTexCoord4fv (wptr->texcoordStack[i]);
-        glVertex4fv (wptr->vertexStack[i]);
+        mode = GL_POINTS;
+        count = 1;
     }
 
-    /* must copy data to correct position for swaptmesh if needed */
-    if ((wptr->state & IGL_VSTATE_TMESH) && wptr->bgnDelay > tidx)
+    if (mode == GL_POINTS || mode == GL_TRIANGLES)
     {
-        for (i = 0; i <= 1; i++)
+        /* merged primitives with different lighting/texturing go separately */
+        if (iglThread.firstIndex > 0 && (iglThread.indexState != state || iglThread.indexPrimitive != mode))
         {
-            IGL_V4COPY (wptr->colorStack[tidx+i]   , wptr->colorStack[wptr->bgnDelay+i]);
-            IGL_V3COPY (wptr->normalStack[tidx+i]  , wptr->normalStack[wptr->bgnDelay+i]);
-            IGL_V4COPY (wptr->texcoordStack[tidx+i], wptr->texcoordStack[wptr->bgnDelay+i]);
-            IGL_V4COPY (wptr->vertexStack[tidx+i]  , wptr->vertexStack[wptr->bgnDelay+i]);
+            i = iglThread.numIndices - iglThread.firstIndex;
+            iglThread.numIndices = iglThread.firstIndex;
+            _igl_flushIndices (wptr);
+            memmove (iglThread.indices, iglThread.indices + iglThread.firstIndex, i * sizeof (GLuint));
+            iglThread.numIndices = i;
         }
+
+        /* triangle mesh indices are already there, see _igl_tmeshVertex */
+        if (mode == GL_POINTS && count > 0 && (idx = _igl_newIndices (count)) != NULL)
+        {
+            for (i = 0; i < count; i++)
+                *idx++ = first + i;
+        }
+        iglThread.indexPrimitive = mode;
+        iglThread.indexState = state;
+
+        if (next != wptr->bgnPrimitive)
+            _igl_flushIndices (wptr);
     }
+    else
+    {
+        _igl_flushIndices (wptr);
+        if (count > 0)
+            _igl_drawVertices (wptr, mode, state, first, count, NULL);
+    }
+
+    if (iglThread.numIndices == 0)
+        iglThread.numVertices = 0;
+    iglThread.firstVertex = iglThread.numVertices;
+    iglThread.firstIndex = iglThread.numIndices;
 
-    wptr->stackIdx = 0;
+    /* reset states valid only inside primitives */
+    if (wptr->state & IGL_WSTATE_LMCNULL)
+    {
+        _igl_glColor (wptr->currentColor);
+        wptr->state |= IGL_VSTATE_COLORED;
+    }
+    wptr->state &= ~(IGL_VSTATE_N3F | IGL_VSTATE_TEXTURED | IGL_VSTATE_TMESH);
+
+    wptr->bgnPrimitive = -1;
     wptr->bgnDelay = 0;
 }
 
@@ -133,71 +302,36 @@ void
 v4f (float vector[4])
 {
     _igl_trace (__func__,FALSE,"%p" IGL_V4FMT(g),vector,IGL_V4PAR(vector));
-    igl->api->v4f (vector);
+    iglThread.api->v4f (vector);
 }
 
 void
 iglExec_v4f (float vector[4])
 {
     igl_windowT *wptr;
+    igl_vertexT *v;
 
     IGL_CHECKWNDV ();
     wptr = IGL_CTX ();
 
-    /* lighting+texturing state machine at the start of the primitive */
-    switch (wptr->bgnDelay)
+    if (!wptr->bgnDelay)
     {
-        default:   /* still delaying, store data */
-            wptr->bgnDelay--;
-            if (!(wptr->state & IGL_WSTATE_LMCNULL))
-                IGL_V4COPY (wptr->colorStack[wptr->bgnDelay], wptr->currentColor);
-            if (wptr->state & IGL_VSTATE_N3F)
-                IGL_V3COPY (wptr->normalStack[wptr->bgnDelay], wptr->currentNormal);
-            if (wptr->state & IGL_VSTATE_TEXTURED)
-                IGL_V4COPY (wptr->texcoordStack[wptr->bgnDelay], wptr->currentTexcoord);
-            IGL_V4COPY (wptr->vertexStack[wptr->bgnDelay], vector);
-            return;
-    
-        case 1:    /* set lighting/texturing accordingly, then start OpenGL */
-            _igl_flushstack (wptr, 1);
-            wptr->stackIdx = 0;
-    
-            /* must resend data for current vertex (overwritten by flush) */
-            if (!(wptr->state & IGL_WSTATE_LMCNULL))
-                glColor4ubv (wptr->currentColor);
-            if (wptr->state & IGL_VSTATE_N3F)
-                glNormal3fv (wptr->currentNormal);
-            if (wptr->state & IGL_VSTATE_TEXTURED)
-                glTexCoord4fv (wptr->currentTexcoord);
-            glVertex4fv (vector);
-            break;
-    
-        case 0:     /* pass all subsequent data directly to OpenGL */
-            if (wptr->state & IGL_WSTATE_LMCNULL)
-            {
-                if (wptr->state & IGL_VSTATE_COLORED)
-                {
-                    /* color set, but disabled by lmcolor. reset it */
-                    glColor4ubv (wptr->lmcColor);
-                    wptr->state &= ~IGL_VSTATE_COLORED;
-                }
-            }
-            glVertex4fv (vector);
-            break;
+        /* outside of bgn*, pass directly to OpenGL */
+        glVertex4fv (vector);
+        return;
     }
 
+    /* store vertex and its attributes until end* */
+    v = _igl_newVertex ();
+    if (v == NULL)
+        return;
+    IGL_V4COPY (v->vertex, vector);
+    IGL_V4COPY (v->color, wptr->currentColor);
+    IGL_V3COPY (v->normal, wptr->currentNormal);
+    IGL_V4COPY (v->texcoord, wptr->currentTexcoord);
+
     if (wptr->state & IGL_VSTATE_TMESH)
-    {
-	/* must stash data for swaptmesh */
-        if (!(wptr->state & IGL_WSTATE_LMCNULL))
-            IGL_V4COPY (wptr->colorStack[wptr->stackIdx], wptr->currentColor);
-        if (wptr->state & IGL_VSTATE_N3F)
-            IGL_V3COPY (wptr->normalStack[wptr->stackIdx], wptr->currentNormal);
-        if (wptr->state & IGL_VSTATE_TEXTURED)
-            IGL_V4COPY (wptr->texcoordStack[wptr->stackIdx], wptr->currentTexcoord);
-        IGL_V4COPY (wptr->vertexStack[wptr->stackIdx], vector);
-        wptr->stackIdx ^= 1;
-    }
+        _igl_tmeshVertex (iglThread.numVertices - 1);
 }
 
 
@@ -212,7 +346,7 @@ v4d (double vector[4])
     vector4[2] = (float)vector[2];
     vector4[3] = (float)vector[3];
 
-    igl->api->v4f (vector4);
+    iglThread.api->v4f (vector4);
 }
 
 
@@ -227,7 +361,7 @@ v4i (int vector[4])
     vector4[2] = (float)vector[2];
     vector4[3] = (float)vector[3];
 
-    igl->api->v4f (vector4);
+    iglThread.api->v4f (vector4);
 }
 
 
@@ -242,7 +376,7 @@ v4s (short vector[4])
     vector4[2] = (float)vector[2];
     vector4[3] = (float)vector[3];
 
-    igl->api->v4f (vector4);
+    iglThread.api->v4f (vector4);
 }
 
 
@@ -257,7 +391,7 @@ v3f (float vector[3])
     vector4[2] = vector[2];
     vector4[3] = 1.0f;
 
-    igl->api->v4f (vector4);
+    iglThread.api->v4f (vector4);
 }
 
 
@@ -272,7 +406,7 @@ v3d (double vector[3])
     vector4[2] = (float)vector[2];
     vector4[3] = 1.0f;
 
-    igl->api->v4f (vector4);
+    iglThread.api->v4f (vector4);
 }
 
 
@@ -287,7 +421,7 @@ v3i (int vector[3])
     vector4[2] = (float)vector[2];
     vector4[3] = 1.0f;
 
-    igl->api->v4f (vector4);
+    iglThread.api->v4f (vector4);
 }
 
 
@@ -302,7 +436,7 @@ v3s (short vector[3])
     vector4[2] = (float)vector[2];
     vector4[3] = 1.0f;
 
-    igl->api->v4f (vector4);
+    iglThread.api->v4f (vector4);
 }
 
 
@@ -317,7 +451,7 @@ v2f (float vector[2])
     vector4[2] = 0.0f;
     vector4[3] = 1.0f;
 
-    igl->api->v4f (vector4);
+    iglThread.api->v4f (vector4);
 }
 
 
@@ -332,7 +466,7 @@ v2d (double vector[2])
     vector4[2] = 0.0f;
     vector4[3] = 1.0f;
 
-    igl->api->v4f (vector4);
+    iglThread.api->v4f (vector4);
 }
 
 
@@ -347,7 +481,7 @@ v2i (int vector[2])
     vector4[2] = 0.0f;
     vector4[3] = 1.0f;
 
-    igl->api->v4f (vector4);
+    iglThread.api->v4f (vector4);
 }
 
 
@@ -362,7 +496,7 @@ v2s (short vector[2])
     vector4[2] = 0.0f;
     vector4[3] = 1.0f;
 
-    igl->api->v4f (vector4);
+    iglThread.api->v4f (vector4);
 }
 
 
@@ -374,7 +508,7 @@ void
 nmode (long mode)
 {
     _igl_trace (__func__,FALSE,"%ld",mode);
-    igl->api->nmode (mode);
+    iglThread.api->nmode (mode);
 }
 
 void
@@ -400,7 +534,7 @@ void
 n3f (float *vector)
 {
     _igl_trace (__func__,FALSE,"%p" IGL_V3FMT(g),vector,IGL_V3PAR(vector));
-    igl->api->n3f (vector);
+    iglThread.api->n3f (vector);
 }
 
 void
@@ -420,8 +554,8 @@ iglExec_n3f (float *vector)
         if (!(wptr->state & IGL_VSTATE_N3F))
         {
             int i;
-            for (i = IGL_VERTEXSTACK_SIZE-1; i >= wptr->bgnDelay; i--)
-                IGL_V3COPY (wptr->normalStack[i], vector);
+            for (i = iglThread.firstVertex; i < iglThread.numVertices; i++)
+                IGL_V3COPY (iglThread.vertices[i].normal, vector);
         }
     } else
         glNormal3fv (vector);
@@ -439,7 +573,7 @@ void
 normal (Coord *narray)
 {
     _igl_trace (__func__,FALSE,"%p" IGL_V3FMT(g),narray,IGL_V3PAR(narray));
-    igl->api->n3f (narray);
+    iglThread.api->n3f (narray);
 }
 
 
@@ -449,38 +583,9 @@ ____________________________ bgn functions ____________________________
 void
 iglExec_endpoint (void)
 {
-    igl_windowT *wptr;
-
     IGL_CHECKWNDV ();
-    wptr = IGL_CTX ();
 
-    /* must emit primitive if there is data in the vertex stack */
-    if (wptr->bgnDelay)
-    {
-        GLfloat (*vertex)[4] = &wptr->vertexStack[wptr->bgnDelay];
-        int vCount = IGL_VERTEXSTACK_SIZE - wptr->bgnDelay;
-
-        /* kludge for old stuff drawing a line of length 0 to produce a point */
-        if (vCount == 2 && wptr->bgnPrimitive == GL_LINE_STRIP && !memcmp(vertex, vertex+1, sizeof(*vertex)))
-        {
-            wptr->bgnPrimitive = GL_POINTS;
-            wptr->bgnDelay ++;
-        }
-        _igl_flushstack (wptr, wptr->bgnDelay);
-    }
-
-    glEnd ();
-
-    /* reset states valid only inside primitives */
-    if (wptr->state & IGL_WSTATE_LMCNULL)
-    {
-        glColor4ubv (wptr->currentColor);
-        wptr->state |= IGL_VSTATE_COLORED;
-    }
-    wptr->state &= ~(IGL_VSTATE_N3F | IGL_VSTATE_TEXTURED | IGL_VSTATE_TMESH);
-
-    wptr->bgnPrimitive = -1;
-    wptr->bgnDelay = 0;
+    _igl_endPrimitive (-1);
 }
 
 static void
@@ -489,7 +594,10 @@ bgn (GLenum what)
     igl_windowT *wptr = IGL_CTX ();
 
     wptr->bgnPrimitive = what;
-    wptr->bgnDelay = IGL_VERTEXSTACK_SIZE;
+    wptr->bgnDelay = TRUE;
+    iglThread.firstVertex = iglThread.numVertices;
+    iglThread.firstIndex = iglThread.numIndices;
+    iglThread.tmeshReplace = 0;
 
     /* new normal since last primitive -> set "surface normal" state */
     if (wptr->state & IGL_VSTATE_N3F)
@@ -504,7 +612,7 @@ void
 bgntmesh (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->bgntmesh ();
+    iglThread.api->bgntmesh ();
 }
 
 void
@@ -513,7 +621,7 @@ iglExec_bgntmesh (void)
     IGL_CHECKWNDV ();
 
     IGL_CTX ()->state |= IGL_VSTATE_TMESH;
-    bgn (GL_TRIANGLE_STRIP);
+    bgn (GL_TRIANGLES);
 }
 
 
@@ -522,7 +630,7 @@ void
 endtmesh (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->endpoint ();
+    iglThread.api->endpoint ();
 }
 
 
@@ -531,44 +639,17 @@ void
 swaptmesh (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->swaptmesh ();
+    iglThread.api->swaptmesh ();
 }
 
 /* GL: swaptmesh - toggles the triangle mesh register pointer */
 void
 iglExec_swaptmesh (void)
 {
-    igl_windowT *wptr;
-
     IGL_CHECKWNDV ();
-    wptr = IGL_CTX ();
-
-    /* setup tmesh stack if not yet done */
-    if (wptr->bgnDelay)
-    {
-        _igl_flushstack (wptr, 0);
-        wptr->stackIdx = 1;
-    }
-
-    /* write out 2nd last vertex again to swap in OpenGL */
-    if (wptr->state & IGL_WSTATE_LMCNULL)
-    {
-        if (wptr->state & IGL_VSTATE_COLORED)
-        {
-            glColor4ubv (wptr->lmcColor);
-            wptr->state &= ~IGL_VSTATE_COLORED;
-        }
-    }
-    else
-        glColor4ubv (wptr->colorStack[wptr->stackIdx]);
-    if (wptr->state & IGL_VSTATE_N3F)
-        glNormal3fv (wptr->normalStack[wptr->stackIdx]);
-    if (wptr->state & IGL_VSTATE_TEXTURED)
-        glTexCoord4fv (wptr->texcoordStack[wptr->stackIdx]);
-    glVertex4fv (wptr->vertexStack[wptr->stackIdx]);
 
-    /* flip stack index to reflect swap */
-    wptr->stackIdx ^= 1;
+    if (IGL_CTX ()->state & IGL_VSTATE_TMESH)
+        iglThread.tmeshReplace ^= 1;
 }
 
 
@@ -577,7 +658,7 @@ void
 bgnclosedline (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->bgnclosedline ();
+    iglThread.api->bgnclosedline ();
 }
 
 void
@@ -594,7 +675,7 @@ void
 endclosedline (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->endpoint ();
+    iglThread.api->endpoint ();
 }
 
 
@@ -603,7 +684,7 @@ void
 bgnline (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->bgnline ();
+    iglThread.api->bgnline ();
 }
 
 void
@@ -620,7 +701,7 @@ void
 endline (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->endpoint ();
+    iglThread.api->endpoint ();
 }
 
 
@@ -629,7 +710,7 @@ void
 bgnpoint (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->bgnpoint ();
+    iglThread.api->bgnpoint ();
 }
 
 void
@@ -646,7 +727,7 @@ void
 endpoint (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->endpoint ();
+    iglThread.api->endpoint ();
 }
 
 
@@ -655,7 +736,7 @@ void
 bgnpolygon (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->bgnpolygon ();
+    iglThread.api->bgnpolygon ();
 }
 
 void
@@ -672,7 +753,7 @@ void
 endpolygon (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->endpoint ();
+    iglThread.api->endpoint ();
 }
 
 
@@ -681,7 +762,7 @@ void
 bgnqstrip (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->bgnqstrip ();
+    iglThread.api->bgnqstrip ();
 }
 
 void
@@ -698,7 +779,7 @@ void
 endqstrip (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->endpoint ();
+    iglThread.api->endpoint ();
 }
 
 
@@ -707,7 +788,7 @@ void
 bgncurve (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->bgncurve ();
+    iglThread.api->bgncurve ();
 }
 
 void
@@ -725,7 +806,7 @@ void
 endcurve (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->endcurve ();
+    iglThread.api->endcurve ();
 }
 
 void
@@ -744,7 +825,7 @@ nurbscurve (long knotCount, const double *knotList, long offset, const double *c
             long order, long type)
 {
     _igl_trace (__func__,FALSE,"%ld,%p,%ld,%p,%ld,%ld",knotCount,knotList,offset,ctlArray,order,type);
-    igl->api->nurbscurve (knotCount, knotList, offset, ctlArray, order, type);
+    iglThread.api->nurbscurve (knotCount, knotList, offset, ctlArray, order, type);
 }
 
 void 
@@ -792,7 +873,7 @@ void
 bgnsurface (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->bgnsurface ();
+    iglThread.api->bgnsurface ();
 }
 
 void
@@ -815,7 +896,7 @@ void
 endsurface (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->endsurface ();
+    iglThread.api->endsurface ();
 }
 
 void
@@ -838,7 +919,7 @@ nurbssurface (long scount, const double *sknot, long tcount, const double *tknot
 {
     _igl_trace (__func__,FALSE,"%ld,%p,%ld,%p,%ld,%ld,%p,%ld,%ld,%ld",
          scount,sknot,tcount,tknot,soffset,toffset,ctlArray,sorder,torder,type);
-    igl->api->nurbssurface (scount, sknot, tcount, tknot, soffset, toffset, ctlArray, sorder, torder, type);
+    iglThread.api->nurbssurface (scount, sknot, tcount, tknot, soffset, toffset, ctlArray, sorder, torder, type);
 }
 
 void
@@ -898,7 +979,7 @@ void
 bgntrim (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->bgntrim ();
+    iglThread.api->bgntrim ();
 }
 
 void
@@ -916,7 +997,7 @@ void
 endtrim (void)
 {
     _igl_trace (__func__,FALSE,"");
-    igl->api->endtrim ();
+    iglThread.api->endtrim ();
 }
 
 void
@@ -934,7 +1015,7 @@ void
 pwlcurve (long n, double *dataArray, long byteSize, long type)
 {
     _igl_trace (__func__,FALSE,"%ld,%p,%ld,%ld",n,dataArray,byteSize,type);
-    igl->api->pwlcurve (n, dataArray, byteSize, type);
+    iglThread.api->pwlcurve (n, dataArray, byteSize, type);
 }
 
 void
@@ -971,7 +1052,7 @@ void
 setnurbsproperty (long property, float value)
 {
     _igl_trace (__func__,FALSE,"%ld,%g",property,value);
-    igl->api->setnurbsproperty (property, value);
+    iglThread.api->setnurbsproperty (property, value);
 }
 
 void
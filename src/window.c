@@ -55,22 +55,118 @@ _igl_findWindowPlaceholder (void)
 }
 
 
-/* find ID of the window by HWND. searches only for main (decorated) window */
-static short
-_igl_findWindowByHandle (HWND wnd)
+/* make a window the current window of the calling thread, -1 for none */
+static void
+_igl_bindWindow (long gwid)
 {
-    short i;
+    if (iglThread.currentWindow >= 0)
+        IGL_CTX ()->bound = 0;
+    iglThread.currentWindow = gwid;
+    if (gwid >= 0)
+        IGL_CTX ()->bound = 1;
+}
 
-    if (wnd != IGL_NULLWND)
+
+/* make a GL context current in the calling thread, None for none */
+void
+_igl_makeCurrent (HWND wnd, HGLRC hrc)
+{
+#ifdef HEADLESS
+    if (IGL_HEADLESS)
+    {
+        _igl_headlessMakeCurrent (wnd, hrc);
+        return;
+    }
+#endif
+#if PLATFORM_X11
+    glXMakeCurrent (IGL_DISPLAY, wnd, hrc);
+#endif
+}
+
+
+#if PLATFORM_X11
+/* create a GL context for the NORMALDRAW layer of a window */
+static HGLRC
+_igl_createContext (HGLRC share)
+{
+#ifdef HEADLESS
+    if (IGL_HEADLESS)
+        return (_igl_headlessCreateContext (share));
+#endif
+    return (glXCreateContext (IGL_DISPLAY, igl->visualInfo[IGL_WLAYER_NORMALDRAW], share, False));
+}
+
+
+static void
+_igl_destroyContext (HGLRC hrc)
+{
+#ifdef HEADLESS
+    if (IGL_HEADLESS)
     {
-        for (i=0; i < IGL_MAXWINDOWS; i++)
+        _igl_headlessDestroyContext (hrc);
+        return;
+    }
+#endif
+    glXDestroyContext (IGL_DISPLAY, hrc);
+}
+#endif
+
+
+/* slot of HWND in igl->wndHash (Fibonacci hashing of the XID) */
+#define IGL_WNDHASH(wnd)    (((unsigned int)(wnd) * 2654435769u) >> (32 - IGL_WNDHASHBITS))
+#define IGL_WNDHASHMASK     ((1 << IGL_WNDHASHBITS) - 1)
+
+
+/* enter a window/layer handle into the HWND hash. handles which are already
+ * known (layers aliasing the query window) keep their first owner */
+static void
+_igl_hashWindow (HWND wnd, short window, short layer)
+{
+    unsigned int i;
+
+    if (wnd == IGL_NULLWND)
+        return;
+
+    for (i = IGL_WNDHASH (wnd); igl->wndHash[i].wnd != IGL_NULLWND; i = (i+1) & IGL_WNDHASHMASK)
+    {
+        if (igl->wndHash[i].wnd == wnd)
+            return;
+    }
+
+    igl->wndHash[i].wnd = wnd;
+    igl->wndHash[i].window = window;
+    igl->wndHash[i].layer = layer;
+}
+
+
+/* remove a window/layer handle from the HWND hash, if it is owned by it */
+static void
+_igl_unhashWindow (HWND wnd, short window, short layer)
+{
+    unsigned int i, j, k;
+
+    if (wnd == IGL_NULLWND)
+        return;
+
+    for (i = IGL_WNDHASH (wnd); igl->wndHash[i].wnd != wnd; i = (i+1) & IGL_WNDHASHMASK)
+    {
+        if (igl->wndHash[i].wnd == IGL_NULLWND)
+            return;
+    }
+    if (igl->wndHash[i].window != window || igl->wndHash[i].layer != layer)
+        return;
+
+    /* shift following entries of the probe chain back into the hole */
+    for (j = (i+1) & IGL_WNDHASHMASK; igl->wndHash[j].wnd != IGL_NULLWND; j = (j+1) & IGL_WNDHASHMASK)
+    {
+        k = IGL_WNDHASH (igl->wndHash[j].wnd);
+        if (((j - k) & IGL_WNDHASHMASK) >= ((j - i) & IGL_WNDHASHMASK))
         {
-            if (igl->openWindows[i].wnd == wnd)
-                return (i);
+            igl->wndHash[i] = igl->wndHash[j];
+            i = j;
         }
     }
-
-    return (-1);
+    igl->wndHash[i].wnd = IGL_NULLWND;
 }
 
 
@@ -78,25 +174,16 @@ _igl_findWindowByHandle (HWND wnd)
 static short
 _igl_findLayerByHandle (HWND wnd, short *layer)
 {
-    igl_layerT *lptr;
-    short i, j;
+    unsigned int i;
 
     if (wnd != IGL_NULLWND)
     {
-        for (i=0; i < IGL_MAXWINDOWS; i++)
+        for (i = IGL_WNDHASH (wnd); igl->wndHash[i].wnd != IGL_NULLWND; i = (i+1) & IGL_WNDHASHMASK)
         {
-            if (igl->openWindows[i].wnd != IGL_NULLWND)
+            if (igl->wndHash[i].wnd == wnd)
             {
-                lptr = igl->openWindows[i].layers;
-                for (j = 0; layer && j < IGL_WLAYER_CURSORDRAW; j++)
-                {
-                    if (lptr->hwnd == wnd)
-                    {
-                        *layer = j;
-                        return (i);
-                    }
-                    lptr ++;
-                }
+                *layer = igl->wndHash[i].layer;
+                return (igl->wndHash[i].window);
             }
         }
     }
@@ -106,6 +193,17 @@ _igl_findLayerByHandle (HWND wnd, short *layer)
 }
 
 
+/* find ID of the window by HWND. searches only for main (decorated) window */
+static short
+_igl_findWindowByHandle (HWND wnd)
+{
+    short layer, i;
+
+    i = _igl_findLayerByHandle (wnd, &layer);
+    return (layer == IGL_WLAYER_NORMALDRAW ? i : -1);
+}
+
+
 /* set the window parameters using the user settings stored in global context */
 static void
 _igl_setWinParams (igl_windowT *wptr)
@@ -228,6 +326,7 @@ _igl_attachLayer (igl_windowT *wptr, int idx, long win)
     XReparentWindow (IGL_DISPLAY, win, IGL_ROOT, x, y);
 
     wptr->layers[idx].hwnd = win;
+    _igl_hashWindow (win, wptr - igl->openWindows, idx);
     _igl_X11ConfigureLayers (wptr);
 
     /* TODO: IrisGL shares lots of stuff across the layers. This is rather
@@ -268,7 +367,7 @@ _igl_detachLayer (igl_windowT *wptr, int idx)
         if (wptr == IGL_CTX ())
         {
 #if PLATFORM_X11
-            glXMakeCurrent (IGL_DISPLAY, wptr->layers[normal].hwnd, wptr->layers[normal].hrc);
+            _igl_makeCurrent (wptr->layers[normal].hwnd, wptr->layers[normal].hrc);
 #endif
         }
     }
@@ -279,9 +378,13 @@ _igl_detachLayer (igl_windowT *wptr, int idx)
 #if PLATFORM_X11
     if (wptr->layers[idx].hrc != IGL_WINDOW (0)->layers[normal].hrc &&
                     wptr->layers[idx].hrc != wptr->layers[normal].hrc)
+    {
+        _igl_releaseObjectLists (wptr->layers[idx].hrc);
         glXDestroyContext (IGL_DISPLAY, wptr->layers[idx].hrc);
+    }
 #endif
 
+    _igl_unhashWindow (wptr->layers[idx].hwnd, wptr - igl->openWindows, idx);
     wptr->layers[idx].hrc = IGL_NULLCTX;
     wptr->layers[idx].hwnd = IGL_NULLWND;
 }
@@ -322,7 +425,7 @@ _igl_createLayer (igl_windowT *wptr, int idx)
     _igl_attachLayer (wptr, idx, win);
     XMapWindow (IGL_DISPLAY, win);
 
-    glXMakeCurrent (IGL_DISPLAY, wptr->layers[idx].hwnd, wptr->layers[idx].hrc);
+    _igl_makeCurrent (wptr->layers[idx].hwnd, wptr->layers[idx].hrc);
 #endif
 
     /* make the layer transparent */
@@ -335,7 +438,7 @@ _igl_createLayer (igl_windowT *wptr, int idx)
 #if PLATFORM_X11
     glXWaitGL ();
     /* back to the previous context */
-    glXMakeCurrent (IGL_DISPLAY, wptr->currentLayer->hwnd, wptr->currentLayer->hrc);
+    _igl_makeCurrent (wptr->currentLayer->hwnd, wptr->currentLayer->hrc);
 #endif
 }
 
@@ -377,13 +480,24 @@ _igl_attachWindow (long idx, long win)
     wptr->rgbPlanes = 32;
 
 #if PLATFORM_X11
-    /* Create shareable context to share between the layers */
-    wptr->layers[IGL_WLAYER_NORMALDRAW].hrc = glXCreateContext (IGL_DISPLAY,
-                    igl->visualInfo[IGL_WLAYER_NORMALDRAW], NULL, False);
+    /* Create shareable context to share between the layers. All windows share
+     * their objects with the query window, so that fonts are only set up once
+     */
+    wptr->shared = 1;
+    if (idx != 0 && IGL_WINDOW (0)->wnd != IGL_NULLWND)
+        wptr->layers[IGL_WLAYER_NORMALDRAW].hrc =
+                        _igl_createContext (IGL_WINDOW (0)->layers[IGL_WLAYER_NORMALDRAW].hrc);
+    else
+        wptr->layers[IGL_WLAYER_NORMALDRAW].hrc = IGL_NULLCTX;
+    if (wptr->layers[IGL_WLAYER_NORMALDRAW].hrc == IGL_NULLCTX)
+    {
+        wptr->shared = (idx == 0);
+        wptr->layers[IGL_WLAYER_NORMALDRAW].hrc = _igl_createContext (NULL);
+    }
     if (wptr->layers[IGL_WLAYER_NORMALDRAW].hrc == IGL_NULLCTX)
         return (-1);
 
-    glXMakeCurrent (IGL_DISPLAY, wptr->wnd, wptr->layers[IGL_WLAYER_NORMALDRAW].hrc);
+    _igl_makeCurrent (wptr->wnd, wptr->layers[IGL_WLAYER_NORMALDRAW].hrc);
 #endif
 
     /* initialize layer management */
@@ -401,6 +515,7 @@ _igl_attachWindow (long idx, long win)
 
     wptr->currentLayer = &wptr->layers[IGL_WLAYER_NORMALDRAW];
     wptr->currentLayer->hwnd = wptr->wnd;
+    _igl_hashWindow (wptr->wnd, idx, IGL_WLAYER_NORMALDRAW);
 
     _igl_fontInit (wptr, IGL_WLAYER_NORMALDRAW);
 
@@ -416,9 +531,7 @@ _igl_attachWindow (long idx, long win)
     wptr->pixInType = wptr->pixOutType = PM_UNSIGNED_BYTE;
 
     wptr->matrixMode = MSINGLE;
-    glMatrixMode (GL_PROJECTION);
-
-    gluOrtho2D(-0.5, wptr->width-0.5, -0.5, wptr->height-0.5);
+    _igl_initTransform (wptr);
     wptr->pickDeltax = wptr->pickDeltay = 10;
 
     wptr->patchCurvesU = wptr->patchCurvesV = 10;
@@ -429,6 +542,9 @@ _igl_attachWindow (long idx, long win)
     wptr->currentColor[0] = wptr->currentColor[1] = wptr->currentColor[2] = 255;
     glColor4ubv (wptr->currentColor);
 
+    /* nothing is known about the state of the new context */
+    IGL_CLR (&wptr->glState);
+
     glEnable (GL_RESCALE_NORMAL);
 
     return 0;
@@ -440,37 +556,67 @@ static void
 _igl_detachWindow(long gwid)
 {
     igl_windowT *wptr;
-    int i;
+    int i, current = iglThread.currentWindow;
+
+    /* release the window resources in its own context. In the share group
+     * they may be shared objects, which outlive the context */
+    wptr = IGL_WINDOW (gwid);
+    if (gwid != current)
+    {
+        iglThread.currentWindow = gwid;
+#if PLATFORM_X11
+        _igl_makeCurrent (wptr->wnd, wptr->layers[IGL_WLAYER_NORMALDRAW].hrc);
+#endif
+    }
+
+    _igl_fontRelease (wptr, IGL_WLAYER_NORMALDRAW);
+    if (igl->fmReleaseCB)
+        igl->fmReleaseCB (wptr);
 
+    _igl_releaseReads (wptr);
+    _igl_pixTrimBuffers (wptr);
+    _igl_releaseObjectLists (wptr->layers[IGL_WLAYER_NORMALDRAW].hrc);
+
+    if (gwid != current)
+    {
+        /* back to the previous context */
+        iglThread.currentWindow = current;
+#if PLATFORM_X11
+        if (current >= 0)
+            _igl_makeCurrent (IGL_CTX ()->currentLayer->hwnd, IGL_CTX ()->currentLayer->hrc);
+        else
+            _igl_makeCurrent (None, NULL);
+#endif
+    }
     /* find the new current window if the current one is to be closed */
-    if (gwid == igl->currentWindow)
+    else
     {
-        igl->currentWindow = -1;    /* in case this is the last window */
+        _igl_bindWindow (-1);    /* in case this is the last window */
         for (i = 1, wptr = IGL_WINDOW (i); i < IGL_MAXWINDOWS; i++, wptr++)
         {
-            if (wptr->wnd != IGL_NULLWND && i != gwid)
+            /* windows current in other threads can't be made current here */
+            if (wptr->wnd != IGL_NULLWND && i != gwid && !wptr->bound)
             {
-                igl->currentWindow = i;
+                _igl_bindWindow (i);
 #if PLATFORM_X11
-                glXMakeCurrent (IGL_DISPLAY, wptr->wnd, wptr->currentLayer->hrc);
+                _igl_makeCurrent (wptr->wnd, wptr->currentLayer->hrc);
 #endif
                 break;
             }
         }
-        if (igl->currentWindow == -1)
-            glXMakeCurrent (IGL_DISPLAY, None, NULL);
+        if (iglThread.currentWindow == -1)
+            _igl_makeCurrent (None, NULL);
     }
 
-    wptr = IGL_WINDOW (gwid);
-    _igl_fontRelease (wptr, IGL_WLAYER_NORMALDRAW);
-    if (igl->fmReleaseCB)
-        igl->fmReleaseCB (wptr);
-
     /* destroy the OpenGL context associated with the window */
+    wptr = IGL_WINDOW (gwid);
 #if PLATFORM_X11
-    glXDestroyContext (IGL_DISPLAY, wptr->layers[IGL_WLAYER_NORMALDRAW].hrc);
+    _igl_destroyContext (wptr->layers[IGL_WLAYER_NORMALDRAW].hrc);
 #endif
 
+    /* drop the window and any layers still attached from the HWND hash */
+    for (i = 0; i < IGL_WLAYER_CURSORDRAW; i++)
+        _igl_unhashWindow (wptr->layers[i].hwnd, gwid, i);
     wptr->wnd = IGL_NULLWND;
 }
 
@@ -512,6 +658,21 @@ _igl_createWindow (char *winTitle, long parentId)
     _igl_setWinParams (wptr);
 
 #if PLATFORM_X11
+#ifdef HEADLESS
+    if (IGL_HEADLESS)
+    {
+        /* render into a pbuffer of screen size, windows are moved and
+         * resized just by changing the viewport */
+        scrsave = NULL;
+        if (igl->windowFlags & IGL_WFLAGS_NOPORT)
+            wptr->wnd = _igl_headlessCreateSurface (1, 1);
+        else
+            wptr->wnd = _igl_headlessCreateSurface (igl->gdXPMAX, igl->gdYPMAX);
+        if (wptr->wnd == IGL_NULLWND)
+            return (-1);
+    }
+    else
+#endif
     if (scrsave && parentId == -1 && idx == 1)
     {
         Window root, child;
@@ -586,7 +747,7 @@ _igl_createWindow (char *winTitle, long parentId)
     /* attach system window to GL window and make it the active window */
     _igl_attachWindow (idx, wptr->wnd);
 
-    igl->currentWindow = idx;
+    _igl_bindWindow (idx);
     swapinterval (1);
 
     /* reset the user setting to defaults since they have been consumed */
@@ -619,6 +780,13 @@ _igl_destroyWindow(long gwid)
     }
     _igl_detachWindow (gwid);
 
+#ifdef HEADLESS
+    if (IGL_HEADLESS)
+    {
+        _igl_headlessDestroySurface (wnd);
+        return;
+    }
+#endif
 #if PLATFORM_X11
     glXWaitGL ();
     XDestroyWindow (IGL_DISPLAY, wnd);
@@ -747,6 +915,24 @@ static void
 _igl_X11MoveResize (igl_windowT *wptr)
 {
     XEvent xev;
+    short gwid = wptr - igl->openWindows;
+
+    /* without X server there's no WM. New windows get the input focus */
+    if (IGL_HEADLESS)
+    {
+        wptr->state |= IGL_WSTATE_MAPPED;
+        IGL_LOCK (IGL_LOCK_QUEUE);
+        if (wptr->parent < 0 && igl->activeWindow != gwid)
+        {
+            igl->activeWindow = gwid;
+            if (igl->deviceQueue[INPUTCHANGE])
+                _igl_qenter (INPUTCHANGE, gwid, False);
+        }
+        if (igl->deviceQueue[REDRAW])
+            _igl_qenter (REDRAW, gwid, False);
+        IGL_UNLOCK (IGL_LOCK_QUEUE);
+        return;
+    }
 
     /* set window type to DESKTOP if imakebackground. Is there something better? */
     if ((wptr->flags & IGL_WFLAGS_BACKGROUND) && wptr->wnd != IGL_ROOT)
@@ -960,6 +1146,115 @@ _igl_X11processDevice (XEvent *event)
 }
 
 
+#ifdef XINPUT2
+/* select XInput2 raw motion events, used for tablet valuators */
+void
+_igl_X11initXInput2 (void)
+{
+    unsigned char mask[XIMaskLen (XI_RawMotion)];
+    XIEventMask evmask;
+    int event, error, major = 2, minor = 0;
+
+    if (!XQueryExtension (IGL_DISPLAY, "XInputExtension", &igl->xiOpcode, &event, &error) ||
+                    XIQueryVersion (IGL_DISPLAY, &major, &minor) != Success)
+    {
+        igl->xiOpcode = 0;
+        return;
+    }
+
+    /* raw events are only delivered to the root window */
+    memset (mask, 0, sizeof(mask));
+    XISetMask (mask, XI_RawMotion);
+    evmask.deviceid = XIAllMasterDevices;
+    evmask.mask_len = sizeof(mask);
+    evmask.mask = mask;
+    XISelectEvents (IGL_DISPLAY, IGL_ROOT, &evmask, 1);
+}
+
+
+/* find the X/Y axes properties of an XInput2 device */
+static int
+_igl_X11xiDevice (int id)
+{
+    XIDeviceInfo *info;
+    int i, n;
+
+    for (i = 0; i < igl->numXiDevices; i++)
+    {
+        if (igl->xiDevices[i].id == id)
+            return (i);
+    }
+
+    /* unknown device, ask the server. Forget the oldest if there's no room */
+    if (igl->numXiDevices == IGL_MAXXIDEVICES)
+    {
+        memmove (&igl->xiDevices[0], &igl->xiDevices[1],
+                    (IGL_MAXXIDEVICES-1) * sizeof(igl->xiDevices[0]));
+        igl->numXiDevices --;
+    }
+    i = igl->numXiDevices++;
+    IGL_CLR (&igl->xiDevices[i]);
+    igl->xiDevices[i].id = id;
+
+    info = XIQueryDevice (IGL_DISPLAY, id, &n);
+    if (info == NULL)
+        return (i);
+    for (n = 0; n < info->num_classes; n++)
+    {
+        XIValuatorClassInfo *v = (XIValuatorClassInfo *)info->classes[n];
+
+        if (v->type == XIValuatorClass && v->number < 2)
+        {
+            igl->xiDevices[i].absolute = (v->mode == XIModeAbsolute);
+            igl->xiDevices[i].min[v->number] = v->min;
+            igl->xiDevices[i].max[v->number] = v->max;
+        }
+    }
+    XIFreeDeviceInfo (info);
+    return (i);
+}
+
+
+/* raw motion of a pointing device. Absolute devices like tablets report their
+ * axes through the bitpad valuators, at device resolution up to 15 bits
+ */
+static void
+_igl_X11rawMotion (XIRawEvent *ev)
+{
+    Device devs[2] = { BPADX, BPADY };
+    double *raw = ev->raw_values;
+    int d, axis;
+
+    /* the events are for the whole screen, only use them if we have focus */
+    if (igl->activeWindow == -1 || !(igl->deviceQueue[BPADX] || igl->deviceQueue[BPADY]))
+        return;
+
+    d = _igl_X11xiDevice (ev->sourceid);
+    if (!igl->xiDevices[d].absolute)
+        return;
+
+    /* raw values are packed, one for each axis set in the mask */
+    for (axis = 0; axis < 2 && axis < ev->valuators.mask_len * 8; axis++)
+    {
+        double min = igl->xiDevices[d].min[axis];
+        double range = igl->xiDevices[d].max[axis] - min;
+        double val;
+
+        if (!XIMaskIsSet (ev->valuators.mask, axis))
+            continue;
+        val = *raw++ - min;
+        if (range > 32767)
+        {
+            val = val * 32767 / range;
+            range = 32767;
+        }
+        igl->deviceVal[devs[axis]] = (axis == 0 ? val : range - val);
+    }
+    _igl_qmotion (devs, 2);
+}
+#endif
+
+
 void
 igl_X11processEvents (void)
 {
@@ -967,7 +1262,19 @@ igl_X11processEvents (void)
     XEvent event;
     igl_windowT *wptr;
 
+    /* only one thread at a time dispatches events into the queue */
+    IGL_LOCK (IGL_LOCK_WINDOWS);
+    IGL_LOCK (IGL_LOCK_QUEUE);
+
     _igl_glTimers ();
+    if (IGL_HEADLESS)
+    {
+        /* events are only injected by qenter() */
+        IGL_UNLOCK (IGL_LOCK_QUEUE);
+        IGL_UNLOCK (IGL_LOCK_WINDOWS);
+        return;
+    }
+
     /* XEvent processing */
     while (XPending (IGL_DISPLAY) > 0)
     {
@@ -1012,24 +1319,45 @@ igl_X11processEvents (void)
                 break;
 
             case MotionNotify:      /* mouse movements */
+                /* only the last of consecutive motion events is of interest */
+                while (!(igl->flags & IGL_IFLAGS_NOMOTIONCOMP) &&
+                                XEventsQueued (IGL_DISPLAY, QueuedAlready) > 0)
+                {
+                    XEvent next;
+
+                    XPeekEvent (IGL_DISPLAY, &next);
+                    if (next.type != MotionNotify || next.xmotion.window != event.xmotion.window)
+                        break;
+                    XNextEvent (IGL_DISPLAY, &event);
+                }
+
                 igl->deviceVal[igl->tiedValuators[2*CURSORX]] =
                         igl->deviceVal[CURSORX] = event.xbutton.x_root;
                 igl->deviceVal[igl->tiedValuators[2*CURSORY]] =
                         igl->deviceVal[CURSORY] = GL_Y(event.xbutton.y_root);
                 if (event.xmotion.is_hint == NotifyNormal || event.xmotion.is_hint == NotifyHint)
                 {
-                    int devx = igl->tiedValuators[2*CURSORX];
-                    int devy = igl->tiedValuators[2*CURSORY];
-                    if (igl->deviceQueue[CURSORX])
-                        _igl_qenter (CURSORX, (short)igl->deviceVal[CURSORX], True);
-                    if (igl->deviceQueue[CURSORY])
-                        _igl_qenter (CURSORY, (short)igl->deviceVal[CURSORY], True);
-                    if (igl->deviceQueue[devx])
-                        _igl_qenter (devx, (short)igl->deviceVal[devx], True);
-                    if (igl->deviceQueue[devy])
-                        _igl_qenter (devy, (short)igl->deviceVal[devy], True);
+                    Device devs[4];
+
+                    devs[0] = CURSORX;
+                    devs[1] = CURSORY;
+                    devs[2] = igl->tiedValuators[2*CURSORX];
+                    devs[3] = igl->tiedValuators[2*CURSORY];
+                    _igl_qmotion (devs, 4);
+                }
+                break;
+
+#ifdef XINPUT2
+            case GenericEvent:      /* XInput2 events */
+                if (event.xcookie.extension == igl->xiOpcode &&
+                                XGetEventData (IGL_DISPLAY, &event.xcookie))
+                {
+                    if (event.xcookie.evtype == XI_RawMotion)
+                        _igl_X11rawMotion (event.xcookie.data);
+                    XFreeEventData (IGL_DISPLAY, &event.xcookie);
                 }
                 break;
+#endif
 
             case Expose:            /* (part of) window exposed */
                 if (event.xexpose.count == 0)
@@ -1181,6 +1509,9 @@ igl_X11processEvents (void)
                 break;
         }
     }
+
+    IGL_UNLOCK (IGL_LOCK_QUEUE);
+    IGL_UNLOCK (IGL_LOCK_WINDOWS);
 }
 
 
@@ -1321,9 +1652,13 @@ GLXlink (void *disp, GLXconfig *cfg)
     XSync(disp, False);
 
     /* get a GL window for this */
+    IGL_LOCK (IGL_LOCK_WINDOWS);
     idx = _igl_findWindowPlaceholder ();
     if (idx == -1)
+    {
+        IGL_UNLOCK (IGL_LOCK_WINDOWS);
         return (-1);
+    }
     wptr = IGL_WINDOW (idx);
 
     /* parse the descriptor list */
@@ -1381,13 +1716,15 @@ GLXlink (void *disp, GLXconfig *cfg)
                 _igl_attachLayer (wptr, idx, layers[idx]);
         }
 
-        if (igl->currentWindow >= 0)
+        if (iglThread.currentWindow >= 0)
             glXMakeCurrent (IGL_DISPLAY, IGL_CTX ()->currentLayer->hwnd, IGL_CTX ()->currentLayer->hrc);
     }
     else
     {
+        IGL_UNLOCK (IGL_LOCK_WINDOWS);
         return GLWS_NOWINDOW;
     }
+    IGL_UNLOCK (IGL_LOCK_WINDOWS);
 
     /* flush our attach operations */
     XSync (IGL_DISPLAY, False);
@@ -1412,13 +1749,17 @@ GLXunlink (void *disp, unsigned long win)
         for (i = 0; i < IGL_WLAYER_CURSORDRAW; i++)
             if (wptr->layers[i].hwnd == win)
             {
+                IGL_LOCK (IGL_LOCK_WINDOWS);
                 _igl_detachLayer (wptr, i);
+                IGL_UNLOCK (IGL_LOCK_WINDOWS);
                 return GLWS_NOERROR;
             }
         return GLWS_NOCONTEXT;
     }
 
+    IGL_LOCK (IGL_LOCK_WINDOWS);
     _igl_detachWindow (wnd);
+    IGL_UNLOCK (IGL_LOCK_WINDOWS);
 
     return GLWS_NOERROR;
 }
@@ -1439,7 +1780,7 @@ GLXwinset (void *disp, unsigned long win)
 
     if (wnd > 0)
     {
-        igl->currentWindow = wnd;
+        _igl_bindWindow (wnd);
         wptr = IGL_CTX ();
         wptr->currentLayer = &wptr->layers[layer];
 
@@ -1542,9 +1883,13 @@ winX (Display *dpy, Window xid)
     XSync(dpy, False);
 
     /* get a GL window for this */
+    IGL_LOCK (IGL_LOCK_WINDOWS);
     idx = _igl_findWindowPlaceholder ();
     if (idx == -1)
+    {
+        IGL_UNLOCK (IGL_LOCK_WINDOWS);
         return (-1);
+    }
     wptr = IGL_WINDOW (idx);
 
     /* TODO: window flags? */
@@ -1557,6 +1902,7 @@ winX (Display *dpy, Window xid)
 
     /* attach to the IGL window context */
     _igl_attachWindow (idx, xid);
+    IGL_UNLOCK (IGL_LOCK_WINDOWS);
 
     /* flush our attach operations */
     XSync (IGL_DISPLAY, False);
@@ -1719,7 +2065,9 @@ winopen (String winTitle)
     _igl_trace (__func__,TRUE,"%p(%s)",winTitle,winTitle?winTitle:"");
     IGL_CHECKINIT ();
 
+    IGL_LOCK (IGL_LOCK_WINDOWS);
     ret = _igl_createWindow (winTitle, -1);
+    IGL_UNLOCK (IGL_LOCK_WINDOWS);
     return ret;
 }
 
@@ -1736,7 +2084,9 @@ swinopen (long parent)
     if (parent <= 0 || parent >= IGL_MAXWINDOWS || IGL_WINDOW (parent)->wnd == IGL_NULLWND)
         return (-1);
 
+    IGL_LOCK (IGL_LOCK_WINDOWS);
     ret = _igl_createWindow (NULL, parent);
+    IGL_UNLOCK (IGL_LOCK_WINDOWS);
     return ret;
 }
 
@@ -1751,7 +2101,9 @@ winclose (long gwid)
     if (gwid <= 0 || gwid >= IGL_MAXWINDOWS || IGL_WINDOW (gwid)->wnd == IGL_NULLWND)
         return;
 
+    IGL_LOCK (IGL_LOCK_WINDOWS);
     _igl_destroyWindow (gwid);
+    IGL_UNLOCK (IGL_LOCK_WINDOWS);
 }
 
 
@@ -1798,7 +2150,8 @@ winconstraints (void)
         sizeHints.max_width = wptr->maxWidth;
         sizeHints.max_height = wptr->maxHeight;
     }
-    XSetWMNormalHints (IGL_DISPLAY, wptr->wnd, &sizeHints);
+    if (!IGL_HEADLESS)
+        XSetWMNormalHints (IGL_DISPLAY, wptr->wnd, &sizeHints);
 
     /* make changes current */
     _igl_X11MoveResize (wptr);
@@ -1874,7 +2227,7 @@ winget (void)
     _igl_trace (__func__,TRUE,"");
     IGL_CHECKWND (0);
 
-    return (igl->currentWindow);
+    return (iglThread.currentWindow);
 }
 
 
@@ -1883,14 +2236,29 @@ void
 winset (long gwid)
 {
     _igl_trace (__func__,TRUE,"%ld",gwid);
-    IGL_CHECKWNDV ();
 
-    glFlush ();
-    if (gwid >= 0 && gwid < IGL_MAXWINDOWS && gwid != igl->currentWindow)
+    /* the render thread switches windows between batches */
+    if (iglThread.pipelined)
+    {
+        if (gwid >= 0 && gwid < IGL_MAXWINDOWS && gwid != iglThread.currentWindow &&
+                        IGL_WINDOW (gwid)->wnd != IGL_NULLWND)
+        {
+            _igl_pipeFlush ();
+            _igl_bindWindow (gwid);
+        }
+        return;
+    }
+    IGL_CHECKINIT ();
+
+    /* a thread may start without a current window */
+    if (iglThread.currentWindow >= 0)
+        glFlush ();
+    if (gwid >= 0 && gwid < IGL_MAXWINDOWS && gwid != iglThread.currentWindow &&
+                    IGL_WINDOW (gwid)->wnd != IGL_NULLWND)
     {
-        igl->currentWindow = gwid;
+        _igl_bindWindow (gwid);
 #if PLATFORM_X11
-        glXMakeCurrent (IGL_DISPLAY, IGL_WINDOW (gwid)->wnd, IGL_WINDOW (gwid)->currentLayer->hrc);
+        _igl_makeCurrent (IGL_WINDOW (gwid)->wnd, IGL_WINDOW (gwid)->currentLayer->hrc);
 #endif
     }
 }
@@ -1904,6 +2272,7 @@ winpush (void)
     IGL_CHECKWNDV ();
 
 #if PLATFORM_X11
+    if (!IGL_HEADLESS)
     {
         XWindowChanges xwc;
 
@@ -1925,6 +2294,7 @@ winpop (void)
     IGL_CHECKWNDV ();
 
 #if PLATFORM_X11
+    if (!IGL_HEADLESS)
     {
         XWindowChanges xwc;
 
@@ -1948,6 +2318,7 @@ windepth (long gwid)
     IGL_CHECKWND (-1);
 
 #if PLATFORM_X11
+    if (!IGL_HEADLESS)
     {
         Window win, current, root, parent = 0, *children;
         unsigned int nChild;
@@ -2020,7 +2391,8 @@ wintitle (String name)
     strcpy (wptr->title, name);
 
 #if PLATFORM_X11
-    XStoreName (IGL_DISPLAY, wptr->wnd, wptr->title);
+    if (!IGL_HEADLESS)
+        XStoreName (IGL_DISPLAY, wptr->wnd, wptr->title);
 #endif
 }
 
@@ -2131,7 +2503,9 @@ gconfig (void)
 #endif
 
     /* this has to be done here to get the first redraw properly (?) */
-    _igl_qenter (REDRAW, (short)igl->currentWindow, True);
+    IGL_LOCK (IGL_LOCK_QUEUE);
+    _igl_qenter (REDRAW, (short)iglThread.currentWindow, True);
+    IGL_UNLOCK (IGL_LOCK_QUEUE);
 }
 
 
@@ -2304,16 +2678,20 @@ drawmode (int mode)
 #if PLATFORM_X11
     /* create the layer window if it doesn't yet exist */
     if (wptr->currentLayer->hwnd == IGL_NULLWND)
+    {
+        IGL_LOCK (IGL_LOCK_WINDOWS);
         _igl_createLayer (wptr, layer);
+        IGL_UNLOCK (IGL_LOCK_WINDOWS);
+    }
 
-    glXMakeCurrent (IGL_DISPLAY, wptr->currentLayer->hwnd, wptr->currentLayer->hrc);
+    _igl_makeCurrent (wptr->currentLayer->hwnd, wptr->currentLayer->hrc);
 #endif
 
     if (mode != NORMALDRAW)
         glDrawBuffer (GL_FRONT);
     else
         glDrawBuffer ((wptr->flags & IGL_WFLAGS_DOUBLEBUFFER) ? GL_BACK : GL_FRONT);
-    glColor4ubv (wptr->currentColor);
+    _igl_glColor (wptr->currentColor);
 }
 
 